@@ -70,7 +70,7 @@ size_t dt_bilateral_memory_use(const int width,     // width of input image
   // OpenCL path needs two buffers
   return 2 * grid_size * sizeof(float);
 #else
-  return (grid_size + 3 * darktable.num_openmp_threads * b.size_x * b.size_z) * sizeof(float);
+  return grid_size * sizeof(float);
 #endif /* HAVE_OPENCL */
 }
 
@@ -94,7 +94,7 @@ size_t dt_bilateral_singlebuffer_size(const int width,     // width of input ima
   dt_bilateral_t b;
   dt_bilateral_grid_size(&b,width,height,100.0f,sigma_s,sigma_r);
   size_t grid_size = b.size_x * b.size_y * b.size_z;
-  return (grid_size + 3 * darktable.num_openmp_threads * b.size_x * b.size_z) * sizeof(float);
+  return grid_size * sizeof(float);
 }
 
 #ifndef HAVE_OPENCL
@@ -145,10 +145,9 @@ dt_bilateral_t *dt_bilateral_init(const int width,     // width of input image
   dt_bilateral_grid_size(b,width,height,100.0f,sigma_s,sigma_r);
   b->width = width;
   b->height = height;
-  b->numslices = darktable.num_openmp_threads;
-  b->sliceheight = (height + b->numslices - 1) / b->numslices;
-  b->slicerows = (b->size_y + b->numslices - 1) / b->numslices + 2;
-  b->buf = dt_calloc_align_float(b->size_x * b->size_z * b->numslices * b->slicerows);
+  b->numslices = MIN(darktable.num_openmp_threads, b->size_y);
+  b->slicerows = (b->size_y + b->numslices - 1) / b->numslices;
+  b->buf = dt_calloc_align_float(b->size_x * b->size_y * b->size_z);
   if (!b->buf)
   {
     fprintf(stderr,"[bilateral] unable to allocate buffer for %lux%lux%lu grid\n",b->size_x,b->size_y,b->size_z);
@@ -160,204 +159,195 @@ dt_bilateral_t *dt_bilateral_init(const int width,     // width of input image
   return b;
 }
 
-#ifdef _OPENMP
-#pragma omp declare simd aligned(in:64)
-#endif
-void dt_bilateral_splat(const dt_bilateral_t *b, const float *const in)
+// add the contributions of one image row to the two grid rows yi and yi+1 it splats into, but only to
+// those of them for which the weight is non-zero (i.e. which are owned by the calling thread)
+static inline void splat_row(const dt_bilateral_t *const b, const float *const in, float *const buf,
+                             const size_t base, const float w0, const float w1)
 {
   const int ox = b->size_z;
   const int oy = b->size_x * b->size_z;
   const int oz = 1;
+  for(int i = 0; i < b->width; i++)
+  {
+    float xf, zf;
+    const float L = in[4 * i];
+    // nearest neighbour splatting:
+    const size_t gi = base + image_to_relgrid(b, i, L, &xf, &zf);
+    if(w0 != 0.0f)
+    {
+      buf[gi]           += (1.0f - xf) * w0 * (1.0f - zf);
+      buf[gi + ox]      += xf * w0 * (1.0f - zf);
+      buf[gi + oz]      += (1.0f - xf) * w0 * zf;
+      buf[gi + ox + oz] += xf * w0 * zf;
+    }
+    if(w1 != 0.0f)
+    {
+      buf[gi + oy]           += (1.0f - xf) * w1 * (1.0f - zf);
+      buf[gi + oy + ox]      += xf * w1 * (1.0f - zf);
+      buf[gi + oy + oz]      += (1.0f - xf) * w1 * zf;
+      buf[gi + oy + ox + oz] += xf * w1 * zf;
+    }
+  }
+}
+
+void dt_bilateral_splat(const dt_bilateral_t *b, const float *const in)
+{
   const float sigma_s = b->sigma_s * b->sigma_s;
   float *const buf = b->buf;
 
   if (!buf) return;
-  // splat into downsampled grid
-  const int nthreads = darktable.num_openmp_threads;
-  const size_t offsets[8] =
-  {
-    0,
-    ox,
-    oy,
-    ox + oy,
-    oz,
-    oz + ox,
-    oz + oy,
-    oz + oy + ox
-  };
+  const double start = dt_get_wtime();
 
+  // splat into downsampled grid.  Every thread owns a band of grid rows and only ever writes into
+  // those, so there are no write races and no per-thread copies of the grid which would need to be
+  // merged afterwards.  Image rows splatting across a band boundary are visited by both neighbouring
+  // threads, each adding just the share which lands in its own band.
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(in, oy, oz, ox, sigma_s, buf, offsets) \
-  shared(b)
+  dt_omp_firstprivate(in, sigma_s, buf) \
+  shared(b) \
+  schedule(static)
 #endif
-  for(int slice = 0; slice < b->numslices; slice++)
+  for(int band = 0; band < b->numslices; band++)
   {
-    const int firstrow = slice * b->sliceheight;
-    const int lastrow = MIN((slice+1)*b->sliceheight,b->height);
-    // compute the first row of the final grid which this slice splats, and subtract that from the first
-    // row the current thread should use to get an offset
-    const int slice_offset = slice * b->slicerows - (int)(firstrow / b->sigma_s);
-    // now iterate over the rows of the current horizontal slice
+    const int firstgridrow = band * b->slicerows;
+    const int lastgridrow = MIN(firstgridrow + b->slicerows, (int)b->size_y);
+    // all image rows which splat into at least one of the rows of this band
+    const int firstrow = MAX(0, (int)floorf((firstgridrow - 1) * b->sigma_s));
+    const int lastrow = MIN(b->height, (int)ceilf(lastgridrow * b->sigma_s) + 1);
     for(int j = firstrow; j < lastrow; j++)
     {
-      float y = CLAMPS(j / b->sigma_s, 0, b->size_y - 1);
+      const float y = CLAMPS(j / b->sigma_s, 0, b->size_y - 1);
       const int yi = MIN((int)y, b->size_y - 2);
       const float yf = y - yi;
-      const size_t base = (size_t)(yi + slice_offset) * oy;
-      for(int i = 0; i < b->width; i++)
-      {
-        size_t index = 4 * (j * b->width + i);
-        float xf, zf;
-        const float L = in[index];
-        // nearest neighbour splatting:
-        const size_t grid_index = base + image_to_relgrid(b, i, L, &xf, &zf);
-        // sum up payload here
-        const dt_aligned_pixel_t contrib =
-        {
-          (1.0f - xf) * (1.0f - yf) * 100.0f / sigma_s,	// precompute the contributions along the first two dimensions
-          xf * (1.0f - yf) * 100.0f / sigma_s,
-          (1.0f - xf) * yf * 100.0f / sigma_s,
-          xf * yf * 100.0f / sigma_s
-        };
-#ifdef _OPENMP
-#pragma omp simd aligned(buf:64)
-#endif
-        for(int k = 0; k < 4; k++)
-        {
-          buf[grid_index + offsets[k]] += (contrib[k] * (1.0f - zf));
-          buf[grid_index + offsets[k+4]] += (contrib[k] * zf);
-        }
-      }
+      const gboolean own0 = yi >= firstgridrow && yi < lastgridrow;
+      const gboolean own1 = yi + 1 >= firstgridrow && yi + 1 < lastgridrow;
+      if(!own0 && !own1) continue;
+      // precompute the contributions along the y dimension, zero for rows owned by other threads
+      const float w0 = own0 ? (1.0f - yf) * 100.0f / sigma_s : 0.0f;
+      const float w1 = own1 ? yf * 100.0f / sigma_s : 0.0f;
+      splat_row(b, in + (size_t)4 * j * b->width, buf, (size_t)yi * b->size_x * b->size_z, w0, w1);
     }
   }
 
-  // merge the per-thread results into the final result
-  for (int slice = 1 ; slice < nthreads; slice++)
+  dt_print(DT_DEBUG_PERF, "[bilateral] splat %dx%d into [%zu %zu %zu] with %d bands took %.3f secs\n",
+           b->width, b->height, b->size_x, b->size_y, b->size_z, b->numslices, dt_get_wtime() - start);
+}
+
+// number of contiguous floats handled at once when blurring along y
+#define DT_BILATERAL_BLUR_CHUNK 256
+
+// blur a line of vectors with 1 4 6 4 1 along an axis.  Element i of the line starts at buf + i * stride and
+// consists of vlen contiguous floats, which are processed together.
+static inline void blur_line_vec(float *const buf, const size_t stride, const int size, const int vlen)
+{
+  const float w0 = 6.f / 16.f;
+  const float w1 = 4.f / 16.f;
+  const float w2 = 1.f / 16.f;
+  float tmp1[DT_BILATERAL_BLUR_CHUNK];
+  float tmp2[DT_BILATERAL_BLUR_CHUNK];
+  float *p = buf;
+  for(int k = 0; k < vlen; k++)
   {
-    // compute the first row of the final grid which this slice splats
-    const int destrow = (int)(slice * b->sliceheight / b->sigma_s);
-    float *dest = buf + destrow * oy;
-    // now iterate over the grid rows splatted for this slice
-    for(int j = slice * b->slicerows; j < (slice+1)*b->slicerows; j++)
+    tmp1[k] = p[k];
+    p[k] = p[k] * w0 + w1 * p[stride + k] + w2 * p[2 * stride + k];
+  }
+  p += stride;
+  for(int k = 0; k < vlen; k++)
+  {
+    tmp2[k] = p[k];
+    p[k] = p[k] * w0 + w1 * (p[stride + k] + tmp1[k]) + w2 * p[2 * stride + k];
+  }
+  p += stride;
+  for(int i = 2; i < size - 2; i++)
+  {
+    for(int k = 0; k < vlen; k++)
     {
-      float *src = buf + j * oy;
-      for(int i = 0; i < oy; i++)
-      {
-        dest[i] += src[i];
-      }
-      dest += oy;
-      // clear elements in the part of the buffer which holds the final result now that we've read the partial result,
-      // since we'll be adding to those locations later
-      if (j < b->size_y)
-        memset(buf + j*oy, '\0', sizeof(float) * oy);
+      const float tmp3 = p[k];
+      p[k] = p[k] * w0 + w1 * (p[stride + k] + tmp2[k]) + w2 * (p[2 * stride + k] + tmp1[k]);
+      tmp1[k] = tmp2[k];
+      tmp2[k] = tmp3;
     }
+    p += stride;
   }
+  for(int k = 0; k < vlen; k++)
+  {
+    const float tmp3 = p[k];
+    p[k] = p[k] * w0 + w1 * (p[stride + k] + tmp2[k]) + w2 * tmp1[k];
+    tmp1[k] = tmp2[k];
+    tmp2[k] = tmp3;
+  }
+  p += stride;
+  for(int k = 0; k < vlen; k++)
+    p[k] = p[k] * w0 + w1 * tmp2[k] + w2 * tmp1[k];
 }
 
-#ifdef _OPENMP
-#pragma omp declare simd aligned(buf:64)
-#endif
-static void blur_line_z(float *buf, const int offset1, const int offset2, const int offset3, const int size1,
-                        const int size2, const int size3)
+// -2 derivative of the gaussian up to 3 sigma: x*exp(-x*x), along one contiguous line
+static inline void blur_line_z(float *const buf, const int size)
 {
   const float w1 = 4.f / 16.f;
   const float w2 = 2.f / 16.f;
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(size1, size2, size3, offset1, offset2, offset3, w1, w2) \
-    shared(buf)
-#endif
-  for(int k = 0; k < size1; k++)
+  float tmp1 = buf[0];
+  buf[0] = w1 * buf[1] + w2 * buf[2];
+  float tmp2 = buf[1];
+  buf[1] = w1 * (buf[2] - tmp1) + w2 * buf[3];
+  for(int i = 2; i < size - 2; i++)
   {
-    size_t index = (size_t)k * offset1;
-    for(int j = 0; j < size2; j++)
-    {
-      float tmp1 = buf[index];
-      buf[index] = w1 * buf[index + offset3] + w2 * buf[index + 2 * offset3];
-      index += offset3;
-      float tmp2 = buf[index];
-      buf[index] = w1 * (buf[index + offset3] - tmp1) + w2 * buf[index + 2 * offset3];
-      index += offset3;
-      for(int i = 2; i < size3 - 2; i++)
-      {
-        const float tmp3 = buf[index];
-        buf[index] = +w1 * (buf[index + offset3] - tmp2) + w2 * (buf[index + 2 * offset3] - tmp1);
-        index += offset3;
-        tmp1 = tmp2;
-        tmp2 = tmp3;
-      }
-      const float tmp3 = buf[index];
-      buf[index] = w1 * (buf[index + offset3] - tmp2) - w2 * tmp1;
-      index += offset3;
-      buf[index] = -w1 * tmp3 - w2 * tmp2;
-      index += offset3;
-      index += offset2 - offset3 * size3;
-    }
+    const float tmp3 = buf[i];
+    buf[i] = +w1 * (buf[i + 1] - tmp2) + w2 * (buf[i + 2] - tmp1);
+    tmp1 = tmp2;
+    tmp2 = tmp3;
   }
+  const float tmp3 = buf[size - 2];
+  buf[size - 2] = w1 * (buf[size - 1] - tmp2) - w2 * tmp1;
+  buf[size - 1] = -w1 * tmp3 - w2 * tmp2;
 }
 
-#ifdef _OPENMP
-#pragma omp declare simd aligned(buf:64)
-#endif
-static void blur_line(float *buf, const int offset1, const int offset2, const int offset3, const int size1,
-                      const int size2, const int size3)
+void dt_bilateral_blur(const dt_bilateral_t *b)
 {
-  const float w0 = 6.f / 16.f;
-  const float w1 = 4.f / 16.f;
-  const float w2 = 1.f / 16.f;
+  if (!b || !b->buf)
+    return;
+  const int size_x = b->size_x;
+  const int size_y = b->size_y;
+  const int size_z = b->size_z;
+  const size_t oy = (size_t)size_x * size_z;
+  float *const buf = b->buf;
+  const double start = dt_get_wtime();
+
+  // the three blurs are separable, so we can do them in the order that suits the memory layout best.
+  // x and z only mix values within one grid row, so do both while the row is in cache:
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(size1, size2, size3, offset1, offset2, offset3, w0, w1, w2) \
-    shared(buf)
+  dt_omp_firstprivate(buf, size_x, size_y, size_z, oy) \
+  schedule(static)
 #endif
-  for(int k = 0; k < size1; k++)
+  for(int y = 0; y < size_y; y++)
   {
-    size_t index = (size_t)k * offset1;
-    for(int j = 0; j < size2; j++)
-    {
-      float tmp1 = buf[index];
-      buf[index] = buf[index] * w0 + w1 * buf[index + offset3] + w2 * buf[index + 2 * offset3];
-      index += offset3;
-      float tmp2 = buf[index];
-      buf[index] = buf[index] * w0 + w1 * (buf[index + offset3] + tmp1) + w2 * buf[index + 2 * offset3];
-      index += offset3;
-      for(int i = 2; i < size3 - 2; i++)
-      {
-        const float tmp3 = buf[index];
-        buf[index]
-            = buf[index] * w0 + w1 * (buf[index + offset3] + tmp2) + w2 * (buf[index + 2 * offset3] + tmp1);
-        index += offset3;
-        tmp1 = tmp2;
-        tmp2 = tmp3;
-      }
-      const float tmp3 = buf[index];
-      buf[index] = buf[index] * w0 + w1 * (buf[index + offset3] + tmp2) + w2 * tmp1;
-      index += offset3;
-      buf[index] = buf[index] * w0 + w1 * tmp3 + w2 * tmp2;
-      index += offset3;
-      index += offset2 - offset3 * size3;
-    }
+    float *const row = buf + y * oy;
+    // gaussian up to 3 sigma, all z of a grid column at once
+    blur_line_vec(row, size_z, size_x, size_z);
+    // -2 derivative of the gaussian up to 3 sigma
+    for(int x = 0; x < size_x; x++)
+      blur_line_z(row + (size_t)x * size_z, size_z);
   }
-}
 
+  // gaussian up to 3 sigma along y, walking all rows in lockstep on chunks of contiguous memory
+  const size_t nchunks = (oy + DT_BILATERAL_BLUR_CHUNK - 1) / DT_BILATERAL_BLUR_CHUNK;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(buf, size_y, oy, nchunks) \
+  schedule(static)
+#endif
+  for(size_t chunk = 0; chunk < nchunks; chunk++)
+  {
+    const size_t offset = chunk * DT_BILATERAL_BLUR_CHUNK;
+    blur_line_vec(buf + offset, oy, size_y, MIN(DT_BILATERAL_BLUR_CHUNK, oy - offset));
+  }
 
-void dt_bilateral_blur(const dt_bilateral_t *b)
-{
-  if (!b || !b->buf)
-    return;
-  const int ox = b->size_z;
-  const int oy = b->size_x * b->size_z;
-  const int oz = 1;
-  // gaussian up to 3 sigma
-  blur_line(b->buf, oz, oy, ox, b->size_z, b->size_y, b->size_x);
-  // gaussian up to 3 sigma
-  blur_line(b->buf, oz, ox, oy, b->size_z, b->size_x, b->size_y);
-  // -2 derivative of the gaussian up to 3 sigma: x*exp(-x*x)
-  blur_line_z(b->buf, ox, oy, oz, b->size_x, b->size_y, b->size_z);
+  dt_print(DT_DEBUG_PERF, "[bilateral] blur of [%d %d %d] took %.3f secs\n",
+           size_x, size_y, size_z, dt_get_wtime() - start);
 }
 
-
 #ifdef _OPENMP
 #pragma omp declare simd aligned(out, in :64)
 #endif
@@ -455,6 +445,7 @@ void dt_bilateral_free(dt_bilateral_t *b)
   free(b);
 }
 
+#undef DT_BILATERAL_BLUR_CHUNK
 #undef DT_COMMON_BILATERAL_MAX_RES_S
 #undef DT_COMMON_BILATERAL_MAX_RES_R
 
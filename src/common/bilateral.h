@@ -24,7 +24,7 @@ typedef struct dt_bilateral_t
 {
   size_t size_x, size_y, size_z;
   int width, height;
-  int numslices, sliceheight, slicerows; //height--in input image, rows--in grid
+  int numslices, slicerows; // bands of grid rows owned by one thread each during splatting, rows per band
   float sigma_s, sigma_r;
   float *buf __attribute__((aligned(64)));
 } __attribute__((packed)) dt_bilateral_t;
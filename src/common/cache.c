@@ -44,11 +44,13 @@ void dt_cache_init(
   cache->cleanup = 0;
   cache->cleanup_data = 0;
   cache->hashtable = g_hash_table_new(0, 0);
+  cache->pinned = g_hash_table_new(0, 0);
 }
 
 void dt_cache_cleanup(dt_cache_t *cache)
 {
   g_hash_table_destroy(cache->hashtable);
+  g_hash_table_destroy(cache->pinned);
   for(GList *l = cache->lru; l; l = g_list_next(l))
   {
     dt_cache_entry_t *entry = (dt_cache_entry_t *)l->data;
@@ -78,6 +80,25 @@ int32_t dt_cache_contains(dt_cache_t *cache, const uint32_t key)
   return result;
 }
 
+void dt_cache_pin(dt_cache_t *cache, const uint32_t key, const gboolean pin)
+{
+  dt_pthread_mutex_lock(&cache->lock);
+  const int count = GPOINTER_TO_INT(g_hash_table_lookup(cache->pinned, GINT_TO_POINTER(key))) + (pin ? 1 : -1);
+  if(count > 0)
+    g_hash_table_insert(cache->pinned, GINT_TO_POINTER(key), GINT_TO_POINTER(count));
+  else
+    g_hash_table_remove(cache->pinned, GINT_TO_POINTER(key));
+  dt_pthread_mutex_unlock(&cache->lock);
+}
+
+void dt_cache_set_cost(dt_cache_t *cache, dt_cache_entry_t *entry, const size_t cost)
+{
+  dt_pthread_mutex_lock(&cache->lock);
+  cache->cost = cache->cost - entry->cost + cost;
+  entry->cost = cost;
+  dt_pthread_mutex_unlock(&cache->lock);
+}
+
 int dt_cache_for_all(
     dt_cache_t *cache,
     int (*process)(const uint32_t key, const void *data, void *user_data),
@@ -329,6 +350,9 @@ void dt_cache_gc(dt_cache_t *cache, const float fill_ratio)
     l = g_list_next(l); // we might remove this element, so walk to the next one while we still have the pointer..
     if(cache->cost < cache->cost_quota * fill_ratio) break;
 
+    // pinned ones stay, however much over quota we are:
+    if(g_hash_table_contains(cache->pinned, GINT_TO_POINTER(entry->key))) continue;
+
     // if still locked by anyone else give up:
     if(dt_pthread_rwlock_trywrlock(&entry->lock)) continue;
 
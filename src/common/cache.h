@@ -48,6 +48,7 @@ typedef struct dt_cache_t
 
   GHashTable *hashtable; // stores (key, entry) pairs
   GList *lru;            // last element is most recently used, first is about to be kicked from cache.
+  GHashTable *pinned;    // keys (key -> pin count) the garbage collection has to leave alone
 
   // callback functions for cache misses/garbage collection
   dt_cache_allocate_t allocate;
@@ -83,6 +84,12 @@ dt_cache_entry_t *dt_cache_testget(dt_cache_t *cache, const uint32_t key, char m
 #define dt_cache_release(A, B) dt_cache_release_with_caller(A, B, __FILE__, __LINE__)
 void dt_cache_release_with_caller(dt_cache_t *cache, dt_cache_entry_t *entry, const char *file, int line);
 
+// pin (or unpin) a key, whether it's in the cache or not yet. pinned entries are never garbage collected,
+// but can still be removed explicitly. pins are counted, each pin needs its unpin.
+void dt_cache_pin(dt_cache_t *cache, const uint32_t key, const gboolean pin);
+// update the cost of an entry whose buffer changed size. the caller holds a lock on the entry.
+void dt_cache_set_cost(dt_cache_t *cache, dt_cache_entry_t *entry, const size_t cost);
+
 // 0: not contained
 int32_t dt_cache_contains(dt_cache_t *cache, const uint32_t key);
 // returns 0 on success, 1 if the key was not found.
@@ -145,6 +145,96 @@ static char * and_operator(int *term)
   assert(0); // Not reached.
 }
 
+// in-memory copy of memory.collected_images, so that rowids and imgids of the current collection can be
+// mapped without a query. it's rebuilt each time the table is refilled.
+static struct
+{
+  GMutex lock;
+  int32_t *imgids;  // imgid at rowid - 1
+  int32_t *rowids;  // rowid of each imgid, 0 if not collected
+  int count;
+  int max_imgid;
+} _collected;
+
+static void _collection_memory_index_update()
+{
+  sqlite3_stmt *stmt;
+  int count = 0, max_imgid = 0;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT COUNT(*), MAX(imgid) FROM memory.collected_images", -1, &stmt, NULL);
+  if(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    count = sqlite3_column_int(stmt, 0);
+    max_imgid = sqlite3_column_int(stmt, 1);
+  }
+  sqlite3_finalize(stmt);
+
+  int32_t *imgids = count ? malloc(sizeof(int32_t) * count) : NULL;
+  int32_t *rowids = count ? calloc(max_imgid + 1, sizeof(int32_t)) : NULL;
+  if(count && (!imgids || !rowids))
+  {
+    free(imgids);
+    free(rowids);
+    imgids = rowids = NULL;
+    count = max_imgid = 0;
+  }
+
+  // rowids run from 1 to count as the table is filled by a single insert after resetting the sequence
+  int n = 0;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT imgid FROM memory.collected_images ORDER BY rowid", -1, &stmt, NULL);
+  while(n < count && sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const int imgid = sqlite3_column_int(stmt, 0);
+    imgids[n++] = imgid;
+    if(imgid > 0 && imgid <= max_imgid) rowids[imgid] = n;
+  }
+  sqlite3_finalize(stmt);
+
+  g_mutex_lock(&_collected.lock);
+  free(_collected.imgids);
+  free(_collected.rowids);
+  _collected.imgids = imgids;
+  _collected.rowids = rowids;
+  _collected.count = n;
+  _collected.max_imgid = max_imgid;
+  g_mutex_unlock(&_collected.lock);
+}
+
+int dt_collection_memory_count()
+{
+  g_mutex_lock(&_collected.lock);
+  const int count = _collected.count;
+  g_mutex_unlock(&_collected.lock);
+  return count;
+}
+
+int dt_collection_memory_get_imgid(const int rowid)
+{
+  g_mutex_lock(&_collected.lock);
+  const int imgid = (rowid > 0 && rowid <= _collected.count) ? _collected.imgids[rowid - 1] : -1;
+  g_mutex_unlock(&_collected.lock);
+  return imgid;
+}
+
+int dt_collection_memory_get_rowid(const int imgid)
+{
+  g_mutex_lock(&_collected.lock);
+  const int rowid = (imgid > 0 && imgid <= _collected.max_imgid) ? _collected.rowids[imgid] : 0;
+  g_mutex_unlock(&_collected.lock);
+  return rowid ? rowid : -1;
+}
+
+int dt_collection_memory_get_range(const int rowid, const int count, int32_t *imgids)
+{
+  if(rowid < 1) return 0;
+  g_mutex_lock(&_collected.lock);
+  const int n = MAX(0, MIN(count, _collected.count - rowid + 1));
+  if(n > 0) memcpy(imgids, _collected.imgids + rowid - 1, sizeof(int32_t) * n);
+  g_mutex_unlock(&_collected.lock);
+  return n;
+}
+
 void dt_collection_memory_update()
 {
   if(!darktable.collection || !darktable.db) return;
@@ -175,6 +265,9 @@ void dt_collection_memory_update()
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
 
+  // 3. and keep an in-memory index of it
+  _collection_memory_index_update();
+
   g_free(query);
   g_free(ins_query);
 }
@@ -276,6 +276,16 @@ void dt_collection_move_before(const int32_t image_id, GList * selected_images);
 /* initialize memory table */
 void dt_collection_memory_update();
 
+/* lookups in the in-memory index of memory.collected_images, without touching the database */
+/* number of images in the table, the rowids run from 1 to this number */
+int dt_collection_memory_count();
+/* imgid at the given rowid, -1 if out of range */
+int dt_collection_memory_get_imgid(const int rowid);
+/* rowid of the given image, -1 if it's not in the collection */
+int dt_collection_memory_get_rowid(const int imgid);
+/* copy the imgids of at most count images starting at rowid into imgids, returns how many were copied */
+int dt_collection_memory_get_range(const int rowid, const int count, int32_t *imgids);
+
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
 // kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
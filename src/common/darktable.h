@@ -300,6 +300,7 @@ typedef struct darktable_t
   struct dt_image_cache_t *image_cache;
   struct dt_bauhaus_t *bauhaus;
   const struct dt_database_t *db;
+  gint sql_statements; // statements prepared/executed through DT_DEBUG_SQLITE3_*, to measure operations
   const struct dt_pwstorage_t *pwstorage;
   const struct dt_camctl_t *camctl;
   const struct dt_collection_t *collection;
@@ -47,7 +47,7 @@
 
 // whenever _create_*_schema() gets changed you HAVE to bump this version and add an update path to
 // _upgrade_*_schema_step()!
-#define CURRENT_DATABASE_VERSION_LIBRARY 34
+#define CURRENT_DATABASE_VERSION_LIBRARY 35
 #define CURRENT_DATABASE_VERSION_DATA     9
 
 typedef struct dt_database_t
@@ -1968,6 +1968,17 @@ static int _upgrade_library_schema_step(dt_database_t *db, int version)
     sqlite3_exec(db->handle, "COMMIT", NULL, NULL, NULL);
     new_version = 34;
   }
+  else if(version == 34)
+  {
+    sqlite3_exec(db->handle, "BEGIN TRANSACTION", NULL, NULL, NULL);
+
+    TRY_EXEC("CREATE TABLE main.folder_snapshots (folder VARCHAR(1024) PRIMARY KEY, mtime INTEGER,"
+             " size INTEGER, inode INTEGER, recursive INTEGER)",
+             "[init] can't create folder_snapshots table\n");
+
+    sqlite3_exec(db->handle, "COMMIT", NULL, NULL, NULL);
+    new_version = 35;
+  }
   else
     new_version = version; // should be the fallback so that calling code sees that we are in an infinite loop
 
@@ -2317,7 +2328,10 @@ static void _create_library_schema(dt_database_t *db)
   sqlite3_exec(db->handle, "CREATE INDEX main.images_datetime_taken_nc ON images (datetime_taken COLLATE NOCASE)",
                NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE INDEX main.metadata_index_key ON meta_data (key)", NULL, NULL, NULL);
-
+  // v35
+  sqlite3_exec(db->handle, "CREATE TABLE main.folder_snapshots (folder VARCHAR(1024) PRIMARY KEY, mtime INTEGER,"
+               " size INTEGER, inode INTEGER, recursive INTEGER)",
+               NULL, NULL, NULL);
 }
 
 /* create the current database schema and set the version in db_info accordingly */
@@ -2385,6 +2399,11 @@ static void _create_memory_schema(dt_database_t *db)
                NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE TABLE memory.similar_tags (tagid INTEGER PRIMARY KEY)", NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE TABLE memory.darktable_tags (tagid INTEGER PRIMARY KEY)", NULL, NULL, NULL);
+  sqlite3_exec(db->handle, "CREATE TABLE memory.tag_images_temp "
+                           "(seq INTEGER PRIMARY KEY, imgid INTEGER UNIQUE ON CONFLICT IGNORE)",
+               NULL, NULL, NULL);
+  sqlite3_exec(db->handle, "CREATE TABLE memory.tag_tags_temp (tagid INTEGER PRIMARY KEY ON CONFLICT IGNORE)",
+               NULL, NULL, NULL);
   sqlite3_exec(
       db->handle,
       "CREATE TABLE memory.history (imgid INTEGER, num INTEGER, module INTEGER, "
@@ -86,6 +86,7 @@
   do                                                                                                              \
   {                                                                                                               \
     dt_print(DT_DEBUG_SQL, "[sql] %s:%d, function %s(): exec \"%s\"\n", __FILE__, __LINE__, __FUNCTION__, (b));   \
+    g_atomic_int_inc(&darktable.sql_statements);                                                                  \
     __DT_DEBUG_ASSERT_WITH_QUERY__(sqlite3_exec(a, b, c, d, e), (b));                                             \
     __DT_DEBUG_SQL_QUERY__(b)                                                                                     \
   } while(0)
@@ -94,6 +95,7 @@
   do                                                                                                              \
   {                                                                                                               \
     dt_print(DT_DEBUG_SQL, "[sql] %s:%d, function %s(): prepare \"%s\"\n", __FILE__, __LINE__, __FUNCTION__, (b));\
+    g_atomic_int_inc(&darktable.sql_statements);                                                                  \
     __DT_DEBUG_ASSERT_WITH_QUERY__(sqlite3_prepare_v2(a, b, c, d, e), (b));                                       \
     __DT_DEBUG_SQL_QUERY__(b)                                                                                     \
   } while(0)
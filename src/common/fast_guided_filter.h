@@ -27,6 +27,7 @@
 
 #include "common/box_filters.h"
 #include "common/darktable.h"
+#include "common/guided_filter.h"
 #include "common/imagebuf.h"
 
 /** Note :
@@ -169,7 +170,8 @@ static inline void variance_analyse(const float *const restrict guide, // I
                                     const float *const restrict mask, //p
                                     float *const restrict ab,
                                     const size_t width, const size_t height,
-                                    const int radius, const float feathering)
+                                    const int radius, const float feathering,
+                                    float *const restrict input)
 {
   // Compute a box average (filter) on a grey image over a window of size 2*radius + 1
   // then get the variance of the guide and covariance with its mask
@@ -177,12 +179,11 @@ static inline void variance_analyse(const float *const restrict guide, // I
   // p, the mask is the quantised guide I
 
   const size_t Ndim = width * height;
-  const size_t Ndimch = Ndim * 4;
 
   /*
   * input is array of struct : { { guide , mask, guide * guide, guide * mask } }
+  * of 4 * width * height floats, provided by the caller so it can be reused across iterations
   */
-  float *const restrict input = dt_alloc_align_float(Ndimch);
 
   // Pre-multiply guide and mask and pack all inputs into an array of 4×1 SIMD struct
 #ifdef _OPENMP
@@ -216,8 +217,6 @@ static inline void variance_analyse(const float *const restrict guide, // I
     ab[2*idx] = a;
     ab[2*idx+1] = b;
   }
-
-  if(input != NULL) dt_free_align(input);
 }
 
 
@@ -301,9 +300,11 @@ static inline void fast_surface_blur(float *const restrict image,
                                       const size_t width, const size_t height,
                                       const int radius, float feathering, const int iterations,
                                       const dt_iop_guided_filter_blending_t filter, const float scale,
-                                      const float quantization, const float quantize_min, const float quantize_max)
+                                      const float quantization, const float quantize_min, const float quantize_max,
+                                      dt_guided_filter_workspace_t *ws)
 {
   // Works in-place on a grey image
+  // ws may be NULL, otherwise the scratch buffers are kept there for the next call
 
   // A down-scaling of 4 seems empirically safe and consistent no matter the image zoom level
   // see reference paper above for proof.
@@ -316,12 +317,13 @@ static inline void fast_surface_blur(float *const restrict image,
   const size_t num_elem_ds = ds_width * ds_height;
   const size_t num_elem = width * height;
 
-  float *const restrict ds_image = dt_alloc_sse_ps(dt_round_size_sse(num_elem_ds));
-  float *const restrict ds_mask = dt_alloc_sse_ps(dt_round_size_sse(num_elem_ds));
-  float *const restrict ds_ab = dt_alloc_sse_ps(dt_round_size_sse(num_elem_ds * 2));
-  float *const restrict ab = dt_alloc_sse_ps(dt_round_size_sse(num_elem * 2));
+  float *const restrict ds_image = dt_guided_filter_workspace_get(ws, DT_GF_WS_DS_GUIDE, num_elem_ds);
+  float *const restrict ds_mask = dt_guided_filter_workspace_get(ws, DT_GF_WS_DS_INPUT, num_elem_ds);
+  float *const restrict ds_ab = dt_guided_filter_workspace_get(ws, DT_GF_WS_DS_COEFFS, num_elem_ds * 2);
+  float *const restrict ab = dt_guided_filter_workspace_get(ws, DT_GF_WS_COEFFS, num_elem * 2);
+  float *const restrict input = dt_guided_filter_workspace_get(ws, DT_GF_WS_MEAN, num_elem_ds * 4);
 
-  if(!ds_image || !ds_mask || !ds_ab || !ab)
+  if(!ds_image || !ds_mask || !ds_ab || !ab || !input)
   {
     dt_control_log(_("fast guided filter failed to allocate memory, check your RAM settings"));
     goto clean;
@@ -338,7 +340,7 @@ static inline void fast_surface_blur(float *const restrict image,
 
     // Perform the patch-wise variance analyse to get
     // the a and b parameters for the linear blending s.t. mask = a * I + b
-    variance_analyse(ds_mask, ds_image, ds_ab, ds_width, ds_height, ds_radius, feathering);
+    variance_analyse(ds_mask, ds_image, ds_ab, ds_width, ds_height, ds_radius, feathering, input);
 
     // Compute the patch-wise average of parameters a and b
     dt_box_mean(ds_ab, ds_height, ds_width, 2, ds_radius, 1);
@@ -360,8 +362,9 @@ static inline void fast_surface_blur(float *const restrict image,
     apply_linear_blending_w_geomean(image, ab, num_elem);
 
 clean:
-  if(ab) dt_free_align(ab);
-  if(ds_ab) dt_free_align(ds_ab);
-  if(ds_mask) dt_free_align(ds_mask);
-  if(ds_image) dt_free_align(ds_image);
+  dt_guided_filter_workspace_put(ws, input);
+  dt_guided_filter_workspace_put(ws, ab);
+  dt_guided_filter_workspace_put(ws, ds_ab);
+  dt_guided_filter_workspace_put(ws, ds_mask);
+  dt_guided_filter_workspace_put(ws, ds_image);
 }
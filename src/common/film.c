@@ -449,6 +449,14 @@ void dt_film_remove(const int id)
   }
   sqlite3_finalize(stmt);
 
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "UPDATE main.folder_snapshots SET mtime = -1"
+                              " WHERE folder = (SELECT folder FROM main.film_rolls WHERE id = ?1)",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+
   // due to foreign keys, all images with references to the film roll are deleted,
   // and likewise all entries with references to those images
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
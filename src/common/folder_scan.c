@@ -0,0 +1,378 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2021 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/folder_scan.h"
+#include "common/darktable.h"
+#include "common/database.h"
+#include "common/debug.h"
+#include "control/conf.h"
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+typedef struct dt_folder_snapshot_t
+{
+  gint64 mtime;
+  gint64 size;
+  gint64 inode;
+  gboolean recursive;
+} dt_folder_snapshot_t;
+
+// the folders listed by a scan, waiting for their images to be imported
+struct dt_folder_scan_t
+{
+  GHashTable *snapshots; // folder -> dt_folder_snapshot_t
+};
+
+// the outcome of scanning one folder, filled by the worker threads
+typedef struct dt_folder_scan_item_t
+{
+  gchar *folder;
+  gboolean stat_ok;         // the folder still exists
+  gboolean unchanged;       // the folder matches its snapshot and was not read
+  gboolean listed;          // the folder was read
+  gboolean settled;         // and not modified right before, its snapshot can be recorded
+  dt_folder_snapshot_t snap;
+  GList *images;            // reversed
+  GList *subdirs;           // reversed
+} dt_folder_scan_item_t;
+
+// a folder modified less than this many seconds before it was listed might change again within the same
+// second, unnoticed by the mtime which only has a resolution of one second
+#define DT_FOLDER_SCAN_SETTLE_TIME 2
+
+// a snapshot which never matches a folder. the row is kept rather than deleted so that the walk through
+// an unchanged parent still finds the folder in its known sub-folders, and lists it again.
+#define DT_FOLDER_SNAPSHOT_INVALID -1
+
+// the snapshot of a directory changes whenever an entry is added, removed or renamed in it. in-place
+// modifications of files don't show up here, which is fine as we only look for new files.
+static gboolean _folder_snapshot(const char *folder, dt_folder_snapshot_t *snap)
+{
+  GStatBuf statbuf;
+  if(g_stat(folder, &statbuf) || !S_ISDIR(statbuf.st_mode)) return FALSE;
+  snap->mtime = statbuf.st_mtime;
+  snap->size = statbuf.st_size;
+  snap->inode = statbuf.st_ino;
+  return TRUE;
+}
+
+// read the names and types of the entries only, on most file systems the type comes with the directory
+// listing itself and we save one stat per file
+static void _folder_list(dt_folder_scan_item_t *item, const gboolean recursive)
+{
+  GFile *dir = g_file_new_for_path(item->folder);
+  GFileEnumerator *dir_files = g_file_enumerate_children(
+      dir, G_FILE_ATTRIBUTE_STANDARD_NAME "," G_FILE_ATTRIBUTE_STANDARD_TYPE, G_FILE_QUERY_INFO_NONE, NULL, NULL);
+  if(!dir_files)
+  {
+    g_object_unref(dir);
+    return;
+  }
+
+  GFileInfo *info = NULL;
+  while((info = g_file_enumerator_next_file(dir_files, NULL, NULL)))
+  {
+    const char *name = g_file_info_get_name(info);
+    const GFileType type = g_file_info_get_file_type(info);
+
+    if(name[0] != '.')
+    {
+      if(type == G_FILE_TYPE_DIRECTORY)
+      {
+        if(recursive) item->subdirs = g_list_prepend(item->subdirs, g_build_filename(item->folder, name, NULL));
+      }
+      else if(dt_supported_image(name))
+        item->images = g_list_prepend(item->images, g_build_filename(item->folder, name, NULL));
+    }
+    g_object_unref(info);
+  }
+
+  g_file_enumerator_close(dir_files, NULL, NULL);
+  g_object_unref(dir_files);
+  g_object_unref(dir);
+  item->listed = TRUE;
+}
+
+static void _folder_scan_one(dt_folder_scan_item_t *item, const gboolean recursive, GHashTable *known,
+                             GHashTable *known_children)
+{
+  item->stat_ok = _folder_snapshot(item->folder, &item->snap);
+  if(!item->stat_ok) return;
+  item->snap.recursive = recursive;
+
+  const dt_folder_snapshot_t *old = known ? g_hash_table_lookup(known, item->folder) : NULL;
+  if(old && old->mtime == item->snap.mtime && old->size == item->snap.size && old->inode == item->snap.inode
+     && (old->recursive || !recursive))
+  {
+    // nothing was added here since the last scan. the sub-folders still have to be visited as a change
+    // deeper down the tree does not touch the parent.
+    item->unchanged = TRUE;
+    if(recursive)
+    {
+      const GPtrArray *children = g_hash_table_lookup(known_children, item->folder);
+      for(guint k = 0; children && k < children->len; k++)
+        item->subdirs = g_list_prepend(item->subdirs, g_strdup(g_ptr_array_index(children, k)));
+    }
+    return;
+  }
+
+  const gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+  _folder_list(item, recursive);
+  item->settled = item->listed && item->snap.mtime < now - DT_FOLDER_SCAN_SETTLE_TIME;
+}
+
+// read the snapshots of path and everything below it
+static void _folder_snapshots_load(const char *path, GHashTable *known, GHashTable *known_children)
+{
+  sqlite3_stmt *stmt;
+  gchar *prefix = g_strconcat(path, G_DIR_SEPARATOR_S, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT folder, mtime, size, inode, recursive"
+                              " FROM main.folder_snapshots"
+                              " WHERE folder = ?1 OR SUBSTR(folder, 1, LENGTH(?2)) = ?2",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, path, -1, SQLITE_STATIC);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, prefix, -1, SQLITE_STATIC);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const char *folder = (const char *)sqlite3_column_text(stmt, 0);
+    dt_folder_snapshot_t *snap = g_malloc(sizeof(dt_folder_snapshot_t));
+    snap->mtime = sqlite3_column_int64(stmt, 1);
+    snap->size = sqlite3_column_int64(stmt, 2);
+    snap->inode = sqlite3_column_int64(stmt, 3);
+    snap->recursive = sqlite3_column_int(stmt, 4);
+    g_hash_table_insert(known, g_strdup(folder), snap);
+
+    if(strcmp(folder, path))
+    {
+      gchar *parent = g_path_get_dirname(folder);
+      GPtrArray *children = g_hash_table_lookup(known_children, parent);
+      if(!children)
+      {
+        children = g_ptr_array_new_with_free_func(g_free);
+        g_hash_table_insert(known_children, parent, children);
+      }
+      else
+        g_free(parent);
+      g_ptr_array_add(children, g_strdup(folder));
+    }
+  }
+  sqlite3_finalize(stmt);
+  g_free(prefix);
+}
+
+// the snapshots of folders which are gone are dropped right away, the others are only recorded once
+// their images have been imported, see dt_folder_scan_commit()
+static void _folder_snapshots_drop_vanished(GPtrArray *scanned)
+{
+  sqlite3 *db = dt_database_get(darktable.db);
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, "DELETE FROM main.folder_snapshots WHERE folder = ?1", -1, &stmt, NULL);
+
+  DT_DEBUG_SQLITE3_EXEC(db, "SAVEPOINT folder_scan", NULL, NULL, NULL);
+  for(guint i = 0; i < scanned->len; i++)
+  {
+    const dt_folder_scan_item_t *item = g_ptr_array_index(scanned, i);
+    if(item->stat_ok) continue;
+    DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, item->folder, -1, SQLITE_STATIC);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+  }
+  DT_DEBUG_SQLITE3_EXEC(db, "RELEASE folder_scan", NULL, NULL, NULL);
+
+  sqlite3_finalize(stmt);
+}
+
+// the snapshots only hold for the import settings they were taken with, when the files which get
+// imported change all folders have to be listed again
+static void _folder_snapshots_check_filter()
+{
+  gchar *filter = g_strdup_printf("ignore_jpegs=%d", dt_conf_get_bool("ui_last/import_ignore_jpegs"));
+  gchar *last = dt_conf_get_string("ui_last/import_folder_snapshots_filter");
+  if(strcmp(filter, last))
+  {
+    DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "DELETE FROM main.folder_snapshots", NULL, NULL, NULL);
+    dt_conf_set_string("ui_last/import_folder_snapshots_filter", filter);
+  }
+  g_free(last);
+  g_free(filter);
+}
+
+static void _folder_scan_item_free(gpointer data)
+{
+  dt_folder_scan_item_t *item = (dt_folder_scan_item_t *)data;
+  g_free(item->folder);
+  g_list_free_full(item->images, g_free);
+  g_list_free_full(item->subdirs, g_free);
+  g_free(item);
+}
+
+GList *dt_folder_scan_images(const char *path, const gboolean recursive, const gboolean only_changed,
+                             dt_folder_scan_t **scan)
+{
+  const double start = dt_get_wtime();
+
+  if(scan || only_changed) _folder_snapshots_check_filter();
+
+  GHashTable *known = NULL, *known_children = NULL;
+  if(only_changed)
+  {
+    known = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    known_children = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_ptr_array_unref);
+    _folder_snapshots_load(path, known, known_children);
+  }
+
+  // walk the tree level by level, the folders of one level are independent and get scanned in parallel.
+  // network file systems have a high latency per request, so this is where the time goes.
+  GPtrArray *scanned = g_ptr_array_new_with_free_func(_folder_scan_item_free);
+  GPtrArray *level = g_ptr_array_new();
+  g_ptr_array_add(level, g_strdup(path));
+
+  GList *result = NULL;
+  int listed = 0;
+  while(level->len)
+  {
+    const int nfolders = level->len;
+    dt_folder_scan_item_t **items = g_malloc0_n(nfolders, sizeof(dt_folder_scan_item_t *));
+    for(int i = 0; i < nfolders; i++)
+    {
+      items[i] = g_malloc0(sizeof(dt_folder_scan_item_t));
+      items[i]->folder = g_ptr_array_index(level, i);
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+    dt_omp_firstprivate(items, nfolders, recursive, known, known_children) \
+    schedule(dynamic)
+#endif
+    for(int i = 0; i < nfolders; i++)
+      _folder_scan_one(items[i], recursive, known, known_children);
+
+    // merge in order, the next level takes ownership of the sub-folder names
+    g_ptr_array_set_size(level, 0);
+    for(int i = 0; i < nfolders; i++)
+    {
+      dt_folder_scan_item_t *item = items[i];
+      for(GList *s = g_list_last(item->subdirs); s; s = g_list_previous(s))
+        g_ptr_array_add(level, s->data);
+      g_list_free(item->subdirs);
+      item->subdirs = NULL;
+
+      result = g_list_concat(item->images, result);
+      item->images = NULL;
+
+      if(item->listed) listed++;
+      g_ptr_array_add(scanned, item);
+    }
+    g_free(items);
+  }
+  g_ptr_array_free(level, TRUE);
+
+  _folder_snapshots_drop_vanished(scanned);
+
+  if(scan)
+  {
+    *scan = g_malloc0(sizeof(dt_folder_scan_t));
+    (*scan)->snapshots = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    for(guint i = 0; i < scanned->len; i++)
+    {
+      const dt_folder_scan_item_t *item = g_ptr_array_index(scanned, i);
+      if(!item->stat_ok || item->unchanged) continue;
+      // the folders which can't be trusted yet are recorded too, only invalid, as their parent might
+      // be recorded and its next scan has to reach them
+      dt_folder_snapshot_t *snap = g_malloc(sizeof(dt_folder_snapshot_t));
+      *snap = item->snap;
+      if(!item->settled) snap->mtime = DT_FOLDER_SNAPSHOT_INVALID;
+      g_hash_table_insert((*scan)->snapshots, g_strdup(item->folder), snap);
+    }
+  }
+
+  dt_print(DT_DEBUG_PERF, "[folder_scan] %s: %u folders, %d listed, %u images in %.3f secs\n", path,
+           scanned->len, listed, g_list_length(result), dt_get_wtime() - start);
+
+  g_ptr_array_free(scanned, TRUE);
+  if(known) g_hash_table_destroy(known);
+  if(known_children) g_hash_table_destroy(known_children);
+
+  return g_list_reverse(result);
+}
+
+void dt_folder_scan_skip(dt_folder_scan_t *scan, const char *folder)
+{
+  if(!scan) return;
+  dt_folder_snapshot_t *snap = g_hash_table_lookup(scan->snapshots, folder);
+  if(snap) snap->mtime = DT_FOLDER_SNAPSHOT_INVALID;
+}
+
+void dt_folder_scan_commit(dt_folder_scan_t *scan)
+{
+  if(!scan) return;
+
+  sqlite3 *db = dt_database_get(darktable.db);
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "INSERT OR REPLACE INTO main.folder_snapshots"
+                              " (folder, mtime, size, inode, recursive)"
+                              " VALUES (?1, ?2, ?3, ?4, ?5)",
+                              -1, &stmt, NULL);
+
+  DT_DEBUG_SQLITE3_EXEC(db, "SAVEPOINT folder_scan", NULL, NULL, NULL);
+  GHashTableIter it;
+  gpointer key, value;
+  g_hash_table_iter_init(&it, scan->snapshots);
+  while(g_hash_table_iter_next(&it, &key, &value))
+  {
+    const dt_folder_snapshot_t *snap = (dt_folder_snapshot_t *)value;
+    DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, (const char *)key, -1, SQLITE_STATIC);
+    DT_DEBUG_SQLITE3_BIND_INT64(stmt, 2, snap->mtime);
+    DT_DEBUG_SQLITE3_BIND_INT64(stmt, 3, snap->size);
+    DT_DEBUG_SQLITE3_BIND_INT64(stmt, 4, snap->inode);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 5, snap->recursive);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+  }
+  DT_DEBUG_SQLITE3_EXEC(db, "RELEASE folder_scan", NULL, NULL, NULL);
+  sqlite3_finalize(stmt);
+
+  dt_folder_scan_free(scan);
+}
+
+void dt_folder_scan_free(dt_folder_scan_t *scan)
+{
+  if(!scan) return;
+  g_hash_table_destroy(scan->snapshots);
+  g_free(scan);
+}
+
+void dt_folder_scan_forget(const char *folder)
+{
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "UPDATE main.folder_snapshots SET mtime = ?2 WHERE folder = ?1", -1, &stmt,
+                              NULL);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, folder, -1, SQLITE_STATIC);
+  DT_DEBUG_SQLITE3_BIND_INT64(stmt, 2, DT_FOLDER_SNAPSHOT_INVALID);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -0,0 +1,51 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2021 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+
+typedef struct dt_folder_scan_t dt_folder_scan_t;
+
+/** lists the supported image files in path, and in all its sub-folders when recursive. the folders
+ *  of one level of the tree are listed in parallel.
+ *  with only_changed, a folder whose snapshot (mtime, size, inode) still matches the one recorded by
+ *  a previous import is not listed again, only its known sub-folders are visited.
+ *  with scan, the snapshots of the listed folders are handed back, to be recorded by
+ *  dt_folder_scan_commit() once their images have been imported. folders modified within the last
+ *  couple of seconds are recorded as invalid, so that they are listed again but still reached
+ *  below an unchanged parent. all snapshots taken with other import settings are dropped.
+ *  returns the full paths, to be freed with g_list_free_full(list, g_free). */
+GList *dt_folder_scan_images(const char *path, const gboolean recursive, const gboolean only_changed,
+                             dt_folder_scan_t **scan);
+
+/** records the snapshot of folder as invalid, e.g. as some of its images were not imported. */
+void dt_folder_scan_skip(dt_folder_scan_t *scan, const char *folder);
+
+/** records the snapshots left in scan and frees it. */
+void dt_folder_scan_commit(dt_folder_scan_t *scan);
+
+/** frees scan without recording anything. */
+void dt_folder_scan_free(dt_folder_scan_t *scan);
+
+/** invalidates the snapshot of folder, the next scan lists it again. */
+void dt_folder_scan_forget(const char *folder);
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -19,9 +19,6 @@
 
 #include <assert.h>
 #include <math.h>
-#if defined(__SSE__)
-#include <xmmintrin.h>
-#endif
 #include "common/gaussian.h"
 #include "common/math.h"
 #include "common/opencl.h"
@@ -153,347 +150,263 @@ error:
 }
 
 
-void dt_gaussian_blur(dt_gaussian_t *g, const float *const in, float *const out)
-{
-
-  const int width = g->width;
-  const int height = g->height;
-  const int ch = MIN(4, g->channels); // just to appease zealous compiler warnings about stack usage
+// number of image columns (or rows) whose recursive filters are run in lockstep.  the filter chains are
+// independent, so this spreads them over the lanes of the widest vector unit the cpu offers while every
+// step of the vertical pass reads one contiguous run of memory instead of a single pixel.
+#define GAUSS_BLOCK 8
+#define GAUSS_LANES (4 * GAUSS_BLOCK)
 
+typedef struct dt_gaussian_coeffs_t
+{
   float a0, a1, a2, a3, b1, b2, coefp, coefn;
+} dt_gaussian_coeffs_t;
+
+// run the vertical filter on a block of n contiguous floats (a few adjacent columns) for all rows.
+// in and temp point to the first float of the block in the top row, stride is the row length in floats.
+static inline __attribute__((always_inline))
+void _blur_vertical_block(const float *const restrict in, float *const restrict temp, const size_t stride,
+                          const int height, const int n, const float *const restrict lmin,
+                          const float *const restrict lmax, const dt_gaussian_coeffs_t *const c)
+{
+  const float a0 = c->a0, a1 = c->a1, a2 = c->a2, a3 = c->a3;
+  const float b1 = c->b1, b2 = c->b2, coefp = c->coefp, coefn = c->coefn;
+  float xp[GAUSS_LANES], yb[GAUSS_LANES], yp[GAUSS_LANES];
 
-  compute_gauss_params(g->sigma, g->order, &a0, &a1, &a2, &a3, &b1, &b2, &coefp, &coefn);
-
-  float *temp = g->buf;
-
-  float *Labmax = g->max;
-  float *Labmin = g->min;
-
-// vertical blur column by column
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(in, width, height, ch) \
-  shared(temp, Labmin, Labmax, a0, a1, a2, a3, b1, b2, coefp, coefn) \
-  schedule(static)
-#endif
-  for(int i = 0; i < width; i++)
+  // forward filter
+  for(int k = 0; k < n; k++)
   {
-    dt_aligned_pixel_t xp = {0.0f};
-    dt_aligned_pixel_t yb = {0.0f};
-    dt_aligned_pixel_t yp = {0.0f};
+    xp[k] = CLAMPF(in[k], lmin[k], lmax[k]);
+    yb[k] = xp[k] * coefp;
+    yp[k] = yb[k];
+  }
 
-    // forward filter
-    for(int k = 0; k < ch; k++)
+  for(int j = 0; j < height; j++)
+  {
+    const float *const inj = in + (size_t)j * stride;
+    float *const tj = temp + (size_t)j * stride;
+    for(int k = 0; k < n; k++)
     {
-      xp[k] = CLAMPF(in[(size_t)i * ch + k], Labmin[k], Labmax[k]);
-      yb[k] = xp[k] * coefp;
-      yp[k] = yb[k];
+      const float xc = CLAMPF(inj[k], lmin[k], lmax[k]);
+      const float yc = (a0 * xc) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
+      tj[k] = yc;
+      xp[k] = xc;
+      yb[k] = yp[k];
+      yp[k] = yc;
     }
+  }
 
-    dt_aligned_pixel_t xc = {0.0f};
-    dt_aligned_pixel_t yc = {0.0f};
-    dt_aligned_pixel_t xn = {0.0f};
-    dt_aligned_pixel_t xa = {0.0f};
-    dt_aligned_pixel_t yn = {0.0f};
-    dt_aligned_pixel_t ya = {0.0f};
-    for(int j = 0; j < height; j++)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      for(int k = 0; k < ch; k++)
-      {
-        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
-        yc[k] = (a0 * xc[k]) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
-
-        temp[offset + k] = yc[k];
-
-        xp[k] = xc[k];
-        yb[k] = yp[k];
-        yp[k] = yc[k];
-      }
-    }
+  // backward filter
+  float xn[GAUSS_LANES], xa[GAUSS_LANES], yn[GAUSS_LANES], ya[GAUSS_LANES];
+  const float *const inlast = in + (size_t)(height - 1) * stride;
+  for(int k = 0; k < n; k++)
+  {
+    xn[k] = CLAMPF(inlast[k], lmin[k], lmax[k]);
+    xa[k] = xn[k];
+    yn[k] = xn[k] * coefn;
+    ya[k] = yn[k];
+  }
 
-    // backward filter
-    for(int k = 0; k < ch; k++)
+  for(int j = height - 1; j > -1; j--)
+  {
+    const float *const inj = in + (size_t)j * stride;
+    float *const tj = temp + (size_t)j * stride;
+    for(int k = 0; k < n; k++)
     {
-      xn[k] = CLAMPF(in[((size_t)(height - 1) * width + i) * ch + k], Labmin[k], Labmax[k]);
+      const float xc = CLAMPF(inj[k], lmin[k], lmax[k]);
+      const float yc = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
       xa[k] = xn[k];
-      yn[k] = xn[k] * coefn;
+      xn[k] = xc;
       ya[k] = yn[k];
-    }
-
-    for(int j = height - 1; j > -1; j--)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      for(int k = 0; k < ch; k++)
-      {
-        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
-
-        yc[k] = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
-
-        xa[k] = xn[k];
-        xn[k] = xc[k];
-        ya[k] = yn[k];
-        yn[k] = yc[k];
-
-        temp[offset + k] += yc[k];
-      }
+      yn[k] = yc;
+      tj[k] += yc;
     }
   }
+}
 
-// horizontal blur line by line
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(out, ch, width, height) \
-  shared(temp, Labmin, Labmax, a0, a1, a2, a3, b1, b2, coefp, coefn) \
-  schedule(static)
-#endif
-  for(int j = 0; j < height; j++)
+// run the horizontal filter on nrows adjacent rows in lockstep, lane r * ch + k holding channel k of row r.
+// temp and out point to the first pixel of the top row.
+static inline __attribute__((always_inline))
+void _blur_horizontal_rows(const float *const restrict temp, float *const restrict out, const int width,
+                           const int ch, const int nrows, const float *const restrict lmin,
+                           const float *const restrict lmax, const dt_gaussian_coeffs_t *const c)
+{
+  const float a0 = c->a0, a1 = c->a1, a2 = c->a2, a3 = c->a3;
+  const float b1 = c->b1, b2 = c->b2, coefp = c->coefp, coefn = c->coefn;
+  const size_t stride = (size_t)width * ch;
+  const int n = nrows * ch;
+  float xc[GAUSS_LANES], yc[GAUSS_LANES];
+  float xp[GAUSS_LANES], yb[GAUSS_LANES], yp[GAUSS_LANES];
+
+  // forward filter
+  for(int r = 0; r < nrows; r++)
+    for(int k = 0; k < ch; k++)
+      xp[r * ch + k] = temp[r * stride + k];
+  for(int k = 0; k < n; k++)
   {
-    dt_aligned_pixel_t xp = {0.0f};
-    dt_aligned_pixel_t yb = {0.0f};
-    dt_aligned_pixel_t yp = {0.0f};
+    xp[k] = CLAMPF(xp[k], lmin[k], lmax[k]);
+    yb[k] = xp[k] * coefp;
+    yp[k] = yb[k];
+  }
 
-    // forward filter
-    for(int k = 0; k < ch; k++)
+  for(int i = 0; i < width; i++)
+  {
+    for(int r = 0; r < nrows; r++)
+      for(int k = 0; k < ch; k++)
+        xc[r * ch + k] = temp[r * stride + (size_t)i * ch + k];
+    for(int k = 0; k < n; k++)
     {
-      xp[k] = CLAMPF(temp[(size_t)j * width * ch + k], Labmin[k], Labmax[k]);
-      yb[k] = xp[k] * coefp;
-      yp[k] = yb[k];
+      xc[k] = CLAMPF(xc[k], lmin[k], lmax[k]);
+      yc[k] = (a0 * xc[k]) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
+      xp[k] = xc[k];
+      yb[k] = yp[k];
+      yp[k] = yc[k];
     }
-
-    dt_aligned_pixel_t xc = {0.0f};
-    dt_aligned_pixel_t yc = {0.0f};
-    dt_aligned_pixel_t xn = {0.0f};
-    dt_aligned_pixel_t xa = {0.0f};
-    dt_aligned_pixel_t yn = {0.0f};
-    dt_aligned_pixel_t ya = {0.0f};
-
-    for(int i = 0; i < width; i++)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
+    for(int r = 0; r < nrows; r++)
       for(int k = 0; k < ch; k++)
-      {
-        xc[k] = CLAMPF(temp[offset + k], Labmin[k], Labmax[k]);
-        yc[k] = (a0 * xc[k]) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
-
-        out[offset + k] = yc[k];
-
-        xp[k] = xc[k];
-        yb[k] = yp[k];
-        yp[k] = yc[k];
-      }
-    }
+        out[r * stride + (size_t)i * ch + k] = yc[r * ch + k];
+  }
 
-    // backward filter
+  // backward filter
+  float xn[GAUSS_LANES], xa[GAUSS_LANES], yn[GAUSS_LANES], ya[GAUSS_LANES];
+  for(int r = 0; r < nrows; r++)
     for(int k = 0; k < ch; k++)
+      xn[r * ch + k] = temp[r * stride + (size_t)(width - 1) * ch + k];
+  for(int k = 0; k < n; k++)
+  {
+    xn[k] = CLAMPF(xn[k], lmin[k], lmax[k]);
+    xa[k] = xn[k];
+    yn[k] = xn[k] * coefn;
+    ya[k] = yn[k];
+  }
+
+  for(int i = width - 1; i > -1; i--)
+  {
+    for(int r = 0; r < nrows; r++)
+      for(int k = 0; k < ch; k++)
+        xc[r * ch + k] = temp[r * stride + (size_t)i * ch + k];
+    for(int k = 0; k < n; k++)
     {
-      xn[k] = CLAMPF(temp[((size_t)(j + 1) * width - 1) * ch + k], Labmin[k], Labmax[k]);
+      xc[k] = CLAMPF(xc[k], lmin[k], lmax[k]);
+      yc[k] = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
       xa[k] = xn[k];
-      yn[k] = xn[k] * coefn;
+      xn[k] = xc[k];
       ya[k] = yn[k];
+      yn[k] = yc[k];
     }
-
-    for(int i = width - 1; i > -1; i--)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
+    for(int r = 0; r < nrows; r++)
       for(int k = 0; k < ch; k++)
-      {
-        xc[k] = CLAMPF(temp[offset + k], Labmin[k], Labmax[k]);
-
-        yc[k] = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
-
-        xa[k] = xn[k];
-        xn[k] = xc[k];
-        ya[k] = yn[k];
-        yn[k] = yc[k];
-
-        out[offset + k] += yc[k];
-      }
-    }
+        out[r * stride + (size_t)i * ch + k] += yc[r * ch + k];
   }
 }
 
+// the cloned entry points for the block filters.  the target clones have to sit on the functions doing the
+// work, as the outlined bodies of parallel loops are not cloned along with their enclosing function.  the
+// four channel variants see a constant lane count, so the filter state can stay in vector registers.
+__DT_CLONE_TARGETS__
+static void _blur_vertical_block_4c(const float *const in, float *const temp, const size_t stride,
+                                    const int height, const float *const lmin, const float *const lmax,
+                                    const dt_gaussian_coeffs_t *const c)
+{
+  _blur_vertical_block(in, temp, stride, height, GAUSS_LANES, lmin, lmax, c);
+}
 
+__DT_CLONE_TARGETS__
+static void _blur_vertical_block_any(const float *const in, float *const temp, const size_t stride,
+                                     const int height, const int n, const float *const lmin,
+                                     const float *const lmax, const dt_gaussian_coeffs_t *const c)
+{
+  _blur_vertical_block(in, temp, stride, height, n, lmin, lmax, c);
+}
+
+__DT_CLONE_TARGETS__
+static void _blur_horizontal_rows_4c(const float *const temp, float *const out, const int width,
+                                     const float *const lmin, const float *const lmax,
+                                     const dt_gaussian_coeffs_t *const c)
+{
+  _blur_horizontal_rows(temp, out, width, 4, GAUSS_BLOCK, lmin, lmax, c);
+}
 
-#if defined(__SSE__)
-static void dt_gaussian_blur_4c_sse(dt_gaussian_t *g, const float *const in, float *const out)
+__DT_CLONE_TARGETS__
+static void _blur_horizontal_rows_any(const float *const temp, float *const out, const int width,
+                                      const int ch, const int nrows, const float *const lmin,
+                                      const float *const lmax, const dt_gaussian_coeffs_t *const c)
 {
+  _blur_horizontal_rows(temp, out, width, ch, nrows, lmin, lmax, c);
+}
 
+static void _gaussian_blur_blocked(dt_gaussian_t *g, const float *const in, float *const out,
+                                          const int ch)
+{
   const int width = g->width;
   const int height = g->height;
-  const int ch = 4;
-
-  assert(g->channels == 4);
-
-  float a0, a1, a2, a3, b1, b2, coefp, coefn;
-
-  compute_gauss_params(g->sigma, g->order, &a0, &a1, &a2, &a3, &b1, &b2, &coefp, &coefn);
 
-  const __m128 Labmax = _mm_set_ps(g->max[3], g->max[2], g->max[1], g->max[0]);
-  const __m128 Labmin = _mm_set_ps(g->min[3], g->min[2], g->min[1], g->min[0]);
+  dt_gaussian_coeffs_t c;
+  compute_gauss_params(g->sigma, g->order, &c.a0, &c.a1, &c.a2, &c.a3, &c.b1, &c.b2, &c.coefp, &c.coefn);
 
-  float *temp = g->buf;
+  // clamping bounds per vector lane, lanes cycle through the channels
+  float lmin[GAUSS_LANES], lmax[GAUSS_LANES];
+  for(int k = 0; k < GAUSS_LANES; k++)
+  {
+    lmin[k] = g->min[k % ch];
+    lmax[k] = g->max[k % ch];
+  }
 
+  float *const temp = g->buf;
+  const size_t stride = (size_t)width * ch;
+  const int colblocks = (width + GAUSS_BLOCK - 1) / GAUSS_BLOCK;
+  const int rowblocks = (height + GAUSS_BLOCK - 1) / GAUSS_BLOCK;
 
-// vertical blur column by column
+// vertical blur, a block of columns at a time
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(in, Labmin, Labmax, width, height, ch) \
-  shared(temp, a0, a1, a2, a3, b1, b2, coefp, coefn) \
+  dt_omp_firstprivate(in, temp, width, height, ch, stride, colblocks) \
+  shared(lmin, lmax, c) \
   schedule(static)
 #endif
-  for(int i = 0; i < width; i++)
+  for(int b = 0; b < colblocks; b++)
   {
-    __m128 xp = _mm_setzero_ps();
-    __m128 yb = _mm_setzero_ps();
-    __m128 yp = _mm_setzero_ps();
-    __m128 xc = _mm_setzero_ps();
-    __m128 yc = _mm_setzero_ps();
-    __m128 xn = _mm_setzero_ps();
-    __m128 xa = _mm_setzero_ps();
-    __m128 yn = _mm_setzero_ps();
-    __m128 ya = _mm_setzero_ps();
-
-    // forward filter
-    xp = MMCLAMPPS(_mm_load_ps(in + i * ch), Labmin, Labmax);
-    yb = _mm_mul_ps(_mm_set_ps1(coefp), xp);
-    yp = yb;
-
-
-    for(int j = 0; j < height; j++)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      xc = MMCLAMPPS(_mm_load_ps(in + offset), Labmin, Labmax);
-
-
-      yc = _mm_add_ps(
-          _mm_mul_ps(xc, _mm_set_ps1(a0)),
-          _mm_sub_ps(_mm_mul_ps(xp, _mm_set_ps1(a1)),
-                     _mm_add_ps(_mm_mul_ps(yp, _mm_set_ps1(b1)), _mm_mul_ps(yb, _mm_set_ps1(b2)))));
-
-      _mm_store_ps(temp + offset, yc);
-
-      xp = xc;
-      yb = yp;
-      yp = yc;
-    }
-
-    // backward filter
-    xn = MMCLAMPPS(_mm_load_ps(in + ((size_t)(height - 1) * width + i) * ch), Labmin, Labmax);
-    xa = xn;
-    yn = _mm_mul_ps(_mm_set_ps1(coefn), xn);
-    ya = yn;
-
-    for(int j = height - 1; j > -1; j--)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      xc = MMCLAMPPS(_mm_load_ps(in + offset), Labmin, Labmax);
-
-      yc = _mm_add_ps(
-          _mm_mul_ps(xn, _mm_set_ps1(a2)),
-          _mm_sub_ps(_mm_mul_ps(xa, _mm_set_ps1(a3)),
-                     _mm_add_ps(_mm_mul_ps(yn, _mm_set_ps1(b1)), _mm_mul_ps(ya, _mm_set_ps1(b2)))));
-
-
-      xa = xn;
-      xn = xc;
-      ya = yn;
-      yn = yc;
-
-      _mm_store_ps(temp + offset, _mm_add_ps(_mm_load_ps(temp + offset), yc));
-    }
+    const int i = b * GAUSS_BLOCK;
+    const int ncols = MIN(GAUSS_BLOCK, width - i);
+    if(ch == 4 && ncols == GAUSS_BLOCK)
+      _blur_vertical_block_4c(in + (size_t)i * 4, temp + (size_t)i * 4, stride, height, lmin, lmax, &c);
+    else
+      _blur_vertical_block_any(in + (size_t)i * ch, temp + (size_t)i * ch, stride, height, ncols * ch,
+                               lmin, lmax, &c);
   }
 
-// horizontal blur line by line
+// horizontal blur, a block of rows at a time
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(out, Labmin, Labmax, width, height, ch) \
-  shared(temp, a0, a1, a2, a3, b1, b2, coefp, coefn) \
+  dt_omp_firstprivate(out, temp, width, height, ch, stride, rowblocks) \
+  shared(lmin, lmax, c) \
   schedule(static)
 #endif
-  for(size_t j = 0; j < height; j++)
+  for(int b = 0; b < rowblocks; b++)
   {
-    __m128 xp = _mm_setzero_ps();
-    __m128 yb = _mm_setzero_ps();
-    __m128 yp = _mm_setzero_ps();
-    __m128 xc = _mm_setzero_ps();
-    __m128 yc = _mm_setzero_ps();
-    __m128 xn = _mm_setzero_ps();
-    __m128 xa = _mm_setzero_ps();
-    __m128 yn = _mm_setzero_ps();
-    __m128 ya = _mm_setzero_ps();
-
-    // forward filter
-    xp = MMCLAMPPS(_mm_load_ps(temp + j * width * ch), Labmin, Labmax);
-    yb = _mm_mul_ps(_mm_set_ps1(coefp), xp);
-    yp = yb;
-
-
-    for(int i = 0; i < width; i++)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      xc = MMCLAMPPS(_mm_load_ps(temp + offset), Labmin, Labmax);
-
-      yc = _mm_add_ps(
-          _mm_mul_ps(xc, _mm_set_ps1(a0)),
-          _mm_sub_ps(_mm_mul_ps(xp, _mm_set_ps1(a1)),
-                     _mm_add_ps(_mm_mul_ps(yp, _mm_set_ps1(b1)), _mm_mul_ps(yb, _mm_set_ps1(b2)))));
-
-      _mm_store_ps(out + offset, yc);
-
-      xp = xc;
-      yb = yp;
-      yp = yc;
-    }
-
-    // backward filter
-    xn = MMCLAMPPS(_mm_load_ps(temp + ((size_t)(j + 1) * width - 1) * ch), Labmin, Labmax);
-    xa = xn;
-    yn = _mm_mul_ps(_mm_set_ps1(coefn), xn);
-    ya = yn;
-
-
-    for(int i = width - 1; i > -1; i--)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      xc = MMCLAMPPS(_mm_load_ps(temp + offset), Labmin, Labmax);
-
-      yc = _mm_add_ps(
-          _mm_mul_ps(xn, _mm_set_ps1(a2)),
-          _mm_sub_ps(_mm_mul_ps(xa, _mm_set_ps1(a3)),
-                     _mm_add_ps(_mm_mul_ps(yn, _mm_set_ps1(b1)), _mm_mul_ps(ya, _mm_set_ps1(b2)))));
-
-
-      xa = xn;
-      xn = xc;
-      ya = yn;
-      yn = yc;
-
-      _mm_store_ps(out + offset, _mm_add_ps(_mm_load_ps(out + offset), yc));
-    }
+    const int j = b * GAUSS_BLOCK;
+    const int nrows = MIN(GAUSS_BLOCK, height - j);
+    if(ch == 4 && nrows == GAUSS_BLOCK)
+      _blur_horizontal_rows_4c(temp + j * stride, out + j * stride, width, lmin, lmax, &c);
+    else
+      _blur_horizontal_rows_any(temp + j * stride, out + j * stride, width, ch, nrows, lmin, lmax, &c);
   }
 }
-#endif
+
+void dt_gaussian_blur(dt_gaussian_t *g, const float *const in, float *const out)
+{
+  const int ch = MIN(4, g->channels); // just to appease zealous compiler warnings about stack usage
+  _gaussian_blur_blocked(g, in, out, ch);
+}
 
 void dt_gaussian_blur_4c(dt_gaussian_t *g, const float *const in, float *const out)
 {
-  if(darktable.codepath.OPENMP_SIMD) return dt_gaussian_blur(g, in, out);
-#if defined(__SSE__)
-  else if(darktable.codepath.SSE2)
-    return dt_gaussian_blur_4c_sse(g, in, out);
-#endif
-  else
-    dt_unreachable_codepath();
+  assert(g->channels == 4);
+  _gaussian_blur_blocked(g, in, out, 4);
 }
 
+#undef GAUSS_LANES
+#undef GAUSS_BLOCK
+
 void dt_gaussian_free(dt_gaussian_t *g)
 {
   if(!g) return;
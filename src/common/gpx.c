@@ -20,8 +20,12 @@
 #include "common/darktable.h"
 #include "common/math.h"
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <inttypes.h>
 
+/* size of the chunks fed to the xml parser, large logs are never loaded at once */
+#define DT_GPX_READ_CHUNK (1 << 20)
+
 /* GPX XML parser */
 typedef enum _gpx_parser_element_t
 {
@@ -34,13 +38,19 @@ typedef enum _gpx_parser_element_t
 
 typedef struct dt_gpx_t
 {
-  /* the list of track records parsed */
-  GList *trkpts;
+  /* the track records parsed, contiguous and sorted by time once parsing is done */
+  dt_gpx_track_point_t *trkpts;
+  uint32_t nb_trkpts;
   GList *trksegs;
 
-  /* currently parsed track point */
-  dt_gpx_track_point_t *current_track_point;
+  /* parser state */
+  GArray *points;
+  dt_gpx_track_point_t current_track_point;
+  dt_gpx_track_segment_t *current_segment;
+  gint64 current_segment_end;
   _gpx_parser_element_t current_parser_element;
+  gboolean in_track_point;
+  gboolean has_time;
   gboolean invalid_track_point;
   gboolean parsing_trk;
   uint32_t segid;
@@ -59,53 +69,121 @@ static GMarkupParser _gpx_parser
     = { _gpx_parser_start_element, _gpx_parser_end_element, _gpx_parser_text, NULL, NULL };
 
 
+static inline gint64 _datetime_to_usec(GDateTime *dt)
+{
+  return g_date_time_to_unix(dt) * G_USEC_PER_SEC + g_date_time_get_microsecond(dt);
+}
+
+static GDateTime *_usec_to_datetime(const gint64 t)
+{
+  GDateTime *epoch = g_date_time_new_from_unix_utc(0);
+  GDateTime *dt = g_date_time_add(epoch, t);
+  g_date_time_unref(epoch);
+  return dt;
+}
+
 static gint _sort_track(gconstpointer a, gconstpointer b)
 {
   const dt_gpx_track_point_t *pa = (const dt_gpx_track_point_t *)a;
   const dt_gpx_track_point_t *pb = (const dt_gpx_track_point_t *)b;
-  return g_date_time_compare(pa->time, pb->time);
+  if(pa->time != pb->time) return pa->time < pb->time ? -1 : 1;
+  return pa->segid < pb->segid ? -1 : (pa->segid > pb->segid);
 }
 
 static gint _sort_segment(gconstpointer a, gconstpointer b)
 {
   const dt_gpx_track_segment_t *pa = (const dt_gpx_track_segment_t *)a;
   const dt_gpx_track_segment_t *pb = (const dt_gpx_track_segment_t *)b;
+  // segments without any timed point go first
+  if(!pa->start_dt || !pb->start_dt) return (pa->start_dt != NULL) - (pb->start_dt != NULL);
   return g_date_time_compare(pa->start_dt, pb->start_dt);
 }
 
+static void _gpx_index_track(dt_gpx_t *gpx)
+{
+  gpx->nb_trkpts = gpx->points->len;
+  gpx->trkpts = (dt_gpx_track_point_t *)g_array_free(gpx->points, FALSE);
+  gpx->points = NULL;
+
+  /* a trkseg left open by a truncated file */
+  dt_gpx_track_segment_t *open_ts = gpx->current_segment;
+  if(open_ts && open_ts->start_dt && !open_ts->end_dt)
+    open_ts->end_dt = _usec_to_datetime(gpx->current_segment_end);
+
+  /* gpx logs are nearly always written in chronological order, don't pay for a sort then */
+  gboolean sorted = TRUE;
+  for(uint32_t k = 1; k < gpx->nb_trkpts && sorted; k++)
+    sorted = _sort_track(&gpx->trkpts[k - 1], &gpx->trkpts[k]) <= 0;
+  if(!sorted)
+    qsort(gpx->trkpts, gpx->nb_trkpts, sizeof(dt_gpx_track_point_t), _sort_track);
+
+  /* index of the first (earliest) point of each segment */
+  const uint32_t nb_seg = gpx->segid + 1;
+  uint32_t *first = g_malloc_n(nb_seg, sizeof(uint32_t));
+  for(uint32_t k = 0; k < nb_seg; k++) first[k] = UINT32_MAX;
+  for(uint32_t k = 0; k < gpx->nb_trkpts; k++)
+  {
+    const uint32_t segid = gpx->trkpts[k].segid;
+    if(segid < nb_seg && first[segid] == UINT32_MAX) first[segid] = k;
+  }
+  for(GList *iter = gpx->trksegs; iter; iter = g_list_next(iter))
+  {
+    dt_gpx_track_segment_t *ts = (dt_gpx_track_segment_t *)iter->data;
+    ts->trkpt = ts->id < nb_seg ? first[ts->id] : UINT32_MAX;
+  }
+  g_free(first);
+
+  gpx->trksegs = g_list_sort(gpx->trksegs, _sort_segment);
+}
+
 dt_gpx_t *dt_gpx_new(const gchar *filename)
 {
   GError *err = NULL;
-  gint bom_offset = 0;
   GMarkupParseContext *ctx = NULL;
   dt_gpx_t *gpx = NULL;
+  gchar *buf = NULL;
+  const double start = dt_get_wtime();
 
-  /* map gpx file to parse into memory */
-  GMappedFile *gpxmf = g_mapped_file_new(filename, FALSE, &err);
-  if(err) goto error;
+  /* the file is streamed through the parser, multi-million point logs are fine */
+  FILE *f = g_fopen(filename, "rb");
+  if(!f)
+  {
+    fprintf(stderr, "dt_gpx_new: failed to open '%s'\n", filename);
+    return NULL;
+  }
 
-  gchar *gpxmf_content = g_mapped_file_get_contents(gpxmf);
-  const gint gpxmf_size = g_mapped_file_get_length(gpxmf);
-  if(!gpxmf_content || gpxmf_size < 10) goto error;
+  buf = g_malloc(DT_GPX_READ_CHUNK);
+  size_t len = fread(buf, 1, DT_GPX_READ_CHUNK, f);
+  if(len < 10) goto error;
 
   /* allocate new dt_gpx_t context */
   gpx = g_malloc0(sizeof(dt_gpx_t));
+  gpx->points = g_array_sized_new(FALSE, FALSE, sizeof(dt_gpx_track_point_t), 4096);
 
   /* skip UTF-8 BOM */
-  if(gpxmf_content[0] == '\xef' && gpxmf_content[1] == '\xbb' && gpxmf_content[2] == '\xbf')
+  size_t bom_offset = 0;
+  if(buf[0] == '\xef' && buf[1] == '\xbb' && buf[2] == '\xbf')
     bom_offset = 3;
 
   /* initialize the parser and start parse gpx xml data */
   ctx = g_markup_parse_context_new(&_gpx_parser, 0, gpx, NULL);
-  g_markup_parse_context_parse(ctx, gpxmf_content + bom_offset, gpxmf_size - bom_offset, &err);
+  g_markup_parse_context_parse(ctx, buf + bom_offset, len - bom_offset, &err);
+  while(!err && len == DT_GPX_READ_CHUNK)
+  {
+    len = fread(buf, 1, DT_GPX_READ_CHUNK, f);
+    if(len) g_markup_parse_context_parse(ctx, buf, len, &err);
+  }
   if(err) goto error;
 
   /* cleanup and return gpx context */
   g_markup_parse_context_free(ctx);
-  g_mapped_file_unref(gpxmf);
+  g_free(buf);
+  fclose(f);
 
-  gpx->trkpts = g_list_sort(gpx->trkpts, _sort_track);
-  gpx->trksegs = g_list_sort(gpx->trksegs, _sort_segment);
+  _gpx_index_track(gpx);
+
+  dt_print(DT_DEBUG_PERF, "[gpx] loaded %u track points in %u segments from '%s' in %.3f secs\n",
+           gpx->nb_trkpts, g_list_length(gpx->trksegs), filename, dt_get_wtime() - start);
 
   return gpx;
 
@@ -118,31 +196,33 @@ error:
 
   if(ctx) g_markup_parse_context_free(ctx);
 
-  g_free(gpx);
+  if(gpx)
+  {
+    g_array_free(gpx->points, TRUE);
+    dt_gpx_destroy(gpx);
+  }
 
-  if(gpxmf) g_mapped_file_unref(gpxmf);
+  g_free(buf);
+  fclose(f);
 
   return NULL;
 }
 
 void _track_seg_free(dt_gpx_track_segment_t *trkseg)
 {
+  if(trkseg->start_dt) g_date_time_unref(trkseg->start_dt);
+  if(trkseg->end_dt) g_date_time_unref(trkseg->end_dt);
   g_free(trkseg->name);
   g_free(trkseg);
 }
 
-void _track_pts_free(dt_gpx_track_point_t *trkpt)
-{
-  g_date_time_unref(trkpt->time);
-  g_free(trkpt);
-}
-
 void dt_gpx_destroy(struct dt_gpx_t *gpx)
 {
   g_assert(gpx != NULL);
 
-  if(gpx->trkpts) g_list_free_full(gpx->trkpts, (GDestroyNotify)_track_pts_free);
+  g_free(gpx->trkpts);
   if(gpx->trksegs) g_list_free_full(gpx->trksegs, (GDestroyNotify)_track_seg_free);
+  g_free(gpx->seg_name);
 
   g_free(gpx);
 }
@@ -152,105 +232,201 @@ gboolean dt_gpx_get_location(struct dt_gpx_t *gpx, GDateTime *timestamp, dt_imag
   g_assert(gpx != NULL);
 
   /* verify that we got at least 2 trackpoints */
-  if(g_list_shorter_than(gpx->trkpts,2)) return FALSE;
+  if(gpx->nb_trkpts < 2) return FALSE;
+
+  const dt_gpx_track_point_t *pts = gpx->trkpts;
+  const uint32_t last = gpx->nb_trkpts - 1;
+  const gint64 ts = _datetime_to_usec(timestamp);
+
+  /* if timestamp is out of time range return false but fill
+     closest location value start or end point */
+  if(ts <= pts[0].time || ts > pts[last].time)
+  {
+    const dt_gpx_track_point_t *tp = ts <= pts[0].time ? &pts[0] : &pts[last];
+    geoloc->longitude = tp->longitude;
+    geoloc->latitude = tp->latitude;
+    geoloc->elevation = tp->elevation;
+    return FALSE;
+  }
 
-  for(GList *item = gpx->trkpts; item; item = g_list_next(item))
+  /* binary search for the first trackpoint not before timestamp,
+     pts[0].time < ts <= pts[last].time guarantees 1 <= hi <= last */
+  uint32_t lo = 1, hi = last;
+  while(lo < hi)
   {
-    dt_gpx_track_point_t *tp = (dt_gpx_track_point_t *)item->data;
+    const uint32_t mid = lo + (hi - lo) / 2;
+    if(pts[mid].time < ts)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  const dt_gpx_track_point_t *tp = &pts[hi - 1];
+  const dt_gpx_track_point_t *tp_next = &pts[hi];
+
+  const GTimeSpan seg_diff = tp_next->time - tp->time;
+  const GTimeSpan diff = ts - tp->time;
+  if(seg_diff == 0 || diff == 0)
+  {
+    geoloc->longitude = tp->longitude;
+    geoloc->latitude = tp->latitude;
+    geoloc->elevation = tp->elevation;
+  }
+  else
+  {
+    /* get the point by interpolation according to timestamp
+
+    We assume that the maximum difference in longitude is less or equal 180º:
+    since the bigger use case is that of an airplane, never an airplane flies more than 180º in longitude */
+
+    const double lat1 = tp->latitude;
+    const double lon1 = tp->longitude;
+    const double lat2 = tp_next->latitude;
+    const double lon2 = tp_next->longitude;
+
+    double lat, lon;
+
+    const double f = (double)diff / (double)seg_diff; /* the fraction of the distance */
 
-    /* if timestamp is out of time range return false but fill
-       closest location value start or end point */
-    const gint cmp = g_date_time_compare(timestamp, tp->time);
-    if((!item->next && cmp >= 0) || (cmp <= 0))
+    if(fabs(lat2 - lat1) < DT_MINIMUM_ANGULAR_DELTA_FOR_GEODESIC
+        && fabs(lon2 - lon1) < DT_MINIMUM_ANGULAR_DELTA_FOR_GEODESIC)
     {
-      geoloc->longitude = tp->longitude;
-      geoloc->latitude = tp->latitude;
-      geoloc->elevation = tp->elevation;
-      return FALSE;
+      /* short distance (< 10 km), no need for geodesic interpolation */
+      lon = lon1 + (lon2 - lon1) * f;
+      lat = lat1 + (lat2 - lat1) * f;
     }
-
-    dt_gpx_track_point_t *tp_next = (dt_gpx_track_point_t *)item->next->data;
-    /* check if timestamp is within current and next trackpoint */
-    const gint cmp_n = g_date_time_compare(timestamp, tp_next->time);
-    if(item->next && cmp_n <= 0)
+    else
     {
-      GTimeSpan seg_diff = g_date_time_difference(tp_next->time, tp->time);
-      GTimeSpan diff = g_date_time_difference(timestamp, tp->time);
-      if(seg_diff == 0 || diff == 0)
-      {
-        geoloc->longitude = tp->longitude;
-        geoloc->latitude = tp->latitude;
-        geoloc->elevation = tp->elevation;
-      }
-      else
-      {
-        /* get the point by interpolation according to timestamp
-
-        We assume that the maximum difference in longitude is less or equal 180º:
-        since the bigger use case is that of an airplane, never an airplane flies more than 180º in longitude */
-
-        const double lat1 = tp->latitude;
-        const double lon1 = tp->longitude;
-        const double lat2 = tp_next->latitude;
-        const double lon2 = tp_next->longitude;
-
-        double lat, lon;
-
-        const double f = (double)diff / (double)seg_diff; /* the fraction of the distance */
-
-        if(fabs(lat2 - lat1) < DT_MINIMUM_ANGULAR_DELTA_FOR_GEODESIC
-            && fabs(lon2 - lon1) < DT_MINIMUM_ANGULAR_DELTA_FOR_GEODESIC)
-        {
-          /* short distance (< 10 km), no need for geodesic interpolation */
-          lon = lon1 + (lon2 - lon1) * f;
-          lat = lat1 + (lat2 - lat1) * f;
-        }
-        else
-        {
-          /* interpolation on the earth surface
-             formulas from http://www.movable-type.co.uk/scripts/latlong.html
-
-             the formulas are correct even if the two point are across the day line, e.g [(0, -179), (0,179)]
-             TO DO: in this case the line which is drawn is incorrect, but this should be a osm_gps issue
-          */
-
-          /* first, calculate the distance on the earth surface */
-          double d, delta;
-          dt_gpx_geodesic_distance(lat1, lon1,
-                                   lat2, lon2,
-                                   &d, &delta);
-          /* d is the distance on the surface in metres,
-             delta is the angle defined by the two points*/
-
-          /* then, calculate the intermediate point */
-          dt_gpx_geodesic_intermediate_point(lat1, lon1,
-                                             lat2, lon2,
-                                             delta,
-                                             TRUE,
-                                             f,
-                                             &lat, &lon);
-        }
-
-        geoloc->latitude = lat;
-        geoloc->longitude = lon;
-
-        /* make a simple linear interpolation on elevation */
-        if(tp_next->elevation == NAN || tp->elevation == NAN)
-          geoloc->elevation = NAN;
-        else
-          geoloc->elevation = tp->elevation + (tp_next->elevation - tp->elevation) * f;
-      }
-      return TRUE;
+      /* interpolation on the earth surface
+         formulas from http://www.movable-type.co.uk/scripts/latlong.html
+
+         the formulas are correct even if the two point are across the day line, e.g [(0, -179), (0,179)]
+         TO DO: in this case the line which is drawn is incorrect, but this should be a osm_gps issue
+      */
+
+      /* first, calculate the distance on the earth surface */
+      double d, delta;
+      dt_gpx_geodesic_distance(lat1, lon1,
+                               lat2, lon2,
+                               &d, &delta);
+      /* d is the distance on the surface in metres,
+         delta is the angle defined by the two points*/
+
+      /* then, calculate the intermediate point */
+      dt_gpx_geodesic_intermediate_point(lat1, lon1,
+                                         lat2, lon2,
+                                         delta,
+                                         TRUE,
+                                         f,
+                                         &lat, &lon);
     }
-  }
 
-  /* should not reach this point */
-  return FALSE;
+    geoloc->latitude = lat;
+    geoloc->longitude = lon;
+
+    /* make a simple linear interpolation on elevation */
+    if(tp_next->elevation == NAN || tp->elevation == NAN)
+      geoloc->elevation = NAN;
+    else
+      geoloc->elevation = tp->elevation + (tp_next->elevation - tp->elevation) * f;
+  }
+  return TRUE;
 }
 
 /*
  * GPX XML parser code
  */
+
+/* days since 1970-01-01 of a proleptic gregorian date */
+static inline gint64 _days_from_civil(int y, const int m, const int d)
+{
+  y -= m <= 2;
+  const int era = (y >= 0 ? y : y - 399) / 400;
+  const int yoe = y - era * 400;
+  const int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return (gint64)era * 146097 + doe - 719468;
+}
+
+static inline gboolean _parse_digits(const gchar *s, const int n, int *value)
+{
+  int v = 0;
+  for(int k = 0; k < n; k++)
+  {
+    if(!g_ascii_isdigit(s[k])) return FALSE;
+    v = v * 10 + (s[k] - '0');
+  }
+  *value = v;
+  return TRUE;
+}
+
+/* fast path for the "YYYY-MM-DDTHH:MM:SS[.fff][Z|+HH:MM]" timestamps every gps
+   logger writes, avoiding a GDateTime per track point */
+static gboolean _gpx_parse_time_fast(const gchar *text, const gsize len, gint64 *t)
+{
+  int Y, M, D, h, m, sec;
+  if(len < 19
+     || !_parse_digits(text, 4, &Y) || text[4] != '-'
+     || !_parse_digits(text + 5, 2, &M) || text[7] != '-'
+     || !_parse_digits(text + 8, 2, &D) || (text[10] != 'T' && text[10] != 't')
+     || !_parse_digits(text + 11, 2, &h) || text[13] != ':'
+     || !_parse_digits(text + 14, 2, &m) || text[16] != ':'
+     || !_parse_digits(text + 17, 2, &sec))
+    return FALSE;
+  if(M < 1 || M > 12 || D < 1 || D > 31 || h > 23 || m > 59 || sec > 59) return FALSE;
+
+  gsize p = 19;
+  gint64 usec = 0;
+  if(p < len && (text[p] == '.' || text[p] == ','))
+  {
+    p++;
+    int digits = 0;
+    while(p < len && g_ascii_isdigit(text[p]))
+    {
+      if(digits < 6) usec = usec * 10 + (text[p] - '0');
+      digits++;
+      p++;
+    }
+    if(!digits) return FALSE;
+    for(; digits < 6; digits++) usec *= 10;
+  }
+
+  int offset = 0;
+  if(p < len && (text[p] == 'Z' || text[p] == 'z'))
+    p++;
+  else if(p < len && (text[p] == '+' || text[p] == '-'))
+  {
+    const int sign = text[p] == '-' ? -1 : 1;
+    int oh, om = 0;
+    if(p + 3 > len || !_parse_digits(text + p + 1, 2, &oh)) return FALSE;
+    p += 3;
+    if(p < len && text[p] == ':') p++;
+    if(p + 2 <= len && _parse_digits(text + p, 2, &om)) p += 2;
+    offset = sign * (oh * 3600 + om * 60);
+  }
+  else
+    return FALSE; // no timezone, let GDateTime decide about the local time
+
+  if(p != len) return FALSE;
+
+  const gint64 secs = _days_from_civil(Y, M, D) * 86400 + h * 3600 + m * 60 + sec - offset;
+  *t = secs * G_USEC_PER_SEC + usec;
+  return TRUE;
+}
+
+static gboolean _gpx_parse_time(const gchar *text, const gsize len, gint64 *t)
+{
+  if(_gpx_parse_time_fast(text, len, t)) return TRUE;
+
+  gchar *str = g_strndup(text, len);
+  GDateTime *dt = g_date_time_new_from_iso8601(str, NULL);
+  g_free(str);
+  if(!dt) return FALSE;
+  *t = _datetime_to_usec(dt);
+  g_date_time_unref(dt);
+  return TRUE;
+}
+
 void _gpx_parser_start_element(GMarkupParseContext *ctx, const gchar *element_name,
                                const gchar **attribute_names, const gchar **attribute_values,
                                gpointer user_data, GError **error)
@@ -270,41 +446,42 @@ void _gpx_parser_start_element(GMarkupParseContext *ctx, const gchar *element_na
   /* from here on, parse wpType data from track points */
   if(strcmp(element_name, "trkpt") == 0)
   {
-    if(gpx->current_track_point)
-    {
+    if(gpx->in_track_point)
       fprintf(stderr, "broken gpx file, new trkpt element before the previous ended.\n");
-      g_free(gpx->current_track_point);
-    }
 
     const gchar **attribute_name = attribute_names;
     const gchar **attribute_value = attribute_values;
 
     gpx->invalid_track_point = FALSE;
+    gpx->has_time = FALSE;
+    gpx->in_track_point = FALSE;
 
     if(*attribute_name)
     {
-      gpx->current_track_point = g_malloc0(sizeof(dt_gpx_track_point_t));
-      gpx->current_track_point->segid = gpx->segid;
+      dt_gpx_track_point_t *tp = &gpx->current_track_point;
+      gpx->in_track_point = TRUE;
+      tp->segid = gpx->segid;
+      tp->time = 0;
 
       /* initialize with NAN for validation check */
-      gpx->current_track_point->longitude = NAN;
-      gpx->current_track_point->latitude = NAN;
-      gpx->current_track_point->elevation = NAN;
+      tp->longitude = NAN;
+      tp->latitude = NAN;
+      tp->elevation = NAN;
 
       /* go thru the attributes to find and get values of lon / lat*/
       while(*attribute_name)
       {
         if(strcmp(*attribute_name, "lon") == 0)
-          gpx->current_track_point->longitude = g_ascii_strtod(*attribute_value, NULL);
+          tp->longitude = g_ascii_strtod(*attribute_value, NULL);
         else if(strcmp(*attribute_name, "lat") == 0)
-          gpx->current_track_point->latitude = g_ascii_strtod(*attribute_value, NULL);
+          tp->latitude = g_ascii_strtod(*attribute_value, NULL);
 
         attribute_name++;
         attribute_value++;
       }
 
       /* validate that we actually got lon / lat attribute values */
-      if(isnan(gpx->current_track_point->longitude) || isnan(gpx->current_track_point->latitude))
+      if(isnan(tp->longitude) || isnan(tp->latitude))
       {
         fprintf(stderr, "broken gpx file, failed to get lon/lat attribute values for trkpt\n");
         gpx->invalid_track_point = TRUE;
@@ -317,13 +494,13 @@ void _gpx_parser_start_element(GMarkupParseContext *ctx, const gchar *element_na
   }
   else if(strcmp(element_name, "time") == 0)
   {
-    if(!gpx->current_track_point) goto element_error;
+    if(!gpx->in_track_point) goto element_error;
 
     gpx->current_parser_element = GPX_PARSER_ELEMENT_TIME;
   }
   else if(strcmp(element_name, "ele") == 0)
   {
-    if(!gpx->current_track_point) goto element_error;
+    if(!gpx->in_track_point) goto element_error;
 
     gpx->current_parser_element = GPX_PARSER_ELEMENT_ELE;
   }
@@ -336,8 +513,10 @@ void _gpx_parser_start_element(GMarkupParseContext *ctx, const gchar *element_na
     dt_gpx_track_segment_t *ts = g_malloc0(sizeof(dt_gpx_track_segment_t));
     ts->name = gpx->seg_name;
     ts->id = gpx->segid;
+    ts->trkpt = UINT32_MAX;
     gpx->seg_name = NULL;
     gpx->trksegs = g_list_prepend(gpx->trksegs, ts);
+    gpx->current_segment = ts;
   }
 
 end:
@@ -362,15 +541,17 @@ void _gpx_parser_end_element(GMarkupParseContext *context, const gchar *element_
     }
     else if(strcmp(element_name, "trkpt") == 0)
     {
-      if(!gpx->invalid_track_point)
-        gpx->trkpts = g_list_prepend(gpx->trkpts, gpx->current_track_point);
-      else
-        g_free(gpx->current_track_point);
+      if(gpx->in_track_point && !gpx->invalid_track_point && gpx->has_time)
+        g_array_append_val(gpx->points, gpx->current_track_point);
 
-      gpx->current_track_point = NULL;
+      gpx->in_track_point = FALSE;
     }
     else if(strcmp(element_name, "trkseg") == 0)
     {
+      dt_gpx_track_segment_t *ts = gpx->current_segment;
+      if(ts && ts->start_dt && !ts->end_dt)
+        ts->end_dt = _usec_to_datetime(gpx->current_segment_end);
+      gpx->current_segment = NULL;
       gpx->segid++;
     }
 
@@ -387,33 +568,36 @@ void _gpx_parser_text(GMarkupParseContext *context, const gchar *text, gsize tex
   if(gpx->current_parser_element == GPX_PARSER_ELEMENT_NAME)
   {
     if(gpx->seg_name) g_free(gpx->seg_name);
-    gpx->seg_name =  g_strdup(text);
+    gpx->seg_name = g_strndup(text, text_len);
   }
 
-  if(!gpx->current_track_point) return;
+  if(!gpx->in_track_point) return;
 
   if(gpx->current_parser_element == GPX_PARSER_ELEMENT_TIME)
   {
-    gpx->current_track_point->time = g_date_time_new_from_iso8601(text, NULL);
-    if(!gpx->current_track_point->time)
-    {
-      gpx->invalid_track_point = TRUE;
-      fprintf(stderr, "broken gpx file, failed to pars is8601 time '%s' for trackpoint\n", text);
-    }
-    dt_gpx_track_segment_t *ts = (dt_gpx_track_segment_t *)gpx->trksegs->data;
-    if(ts)
+    gint64 t = 0;
+    if(_gpx_parse_time(text, text_len, &t))
     {
-      ts->nb_trkpt++;
-      if(!ts->start_dt)
+      gpx->current_track_point.time = t;
+      gpx->has_time = TRUE;
+
+      dt_gpx_track_segment_t *ts = gpx->current_segment;
+      if(ts)
       {
-        ts->start_dt = gpx->current_track_point->time;
-        ts->trkpt = gpx->current_track_point;
+        ts->nb_trkpt++;
+        if(!ts->start_dt) ts->start_dt = _usec_to_datetime(t);
+        gpx->current_segment_end = t;
       }
-      ts->end_dt = gpx->current_track_point->time;
+    }
+    else
+    {
+      gpx->invalid_track_point = TRUE;
+      fprintf(stderr, "broken gpx file, failed to pars is8601 time '%.*s' for trackpoint\n",
+              (int)text_len, text);
     }
   }
   else if(gpx->current_parser_element == GPX_PARSER_ELEMENT_ELE)
-    gpx->current_track_point->elevation = g_ascii_strtod(text, NULL);
+    gpx->current_track_point.elevation = g_ascii_strtod(text, NULL);
 }
 
 GList *dt_gpx_get_trkseg(struct dt_gpx_t *gpx)
@@ -427,11 +611,9 @@ GList *dt_gpx_get_trkpts(struct dt_gpx_t *gpx, const guint segid)
   GList *ts = g_list_nth(gpx->trksegs, segid);
   if(!ts) return pts;
   dt_gpx_track_segment_t *tsd = (dt_gpx_track_segment_t *)ts->data;
-  GList *tps = g_list_find(gpx->trkpts, tsd->trkpt);
-  if(!tps) return pts;
-  for(GList *tp = tps; tp; tp = g_list_next(tp))
+  for(uint32_t k = tsd->trkpt; k < gpx->nb_trkpts; k++)
   {
-    dt_gpx_track_point_t *tpd = (dt_gpx_track_point_t *)tp->data;
+    const dt_gpx_track_point_t *tpd = &gpx->trkpts[k];
     if(tpd->segid != segid) return pts;
     dt_geo_map_display_point_t *p = g_malloc0(sizeof(dt_geo_map_display_point_t));
     p->lat = tpd->latitude;
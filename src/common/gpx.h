@@ -31,8 +31,8 @@ struct dt_gpx_t;
 
 typedef struct dt_gpx_track_point_t
 {
+  gint64 time; // microseconds since the unix epoch, UTC
   gdouble longitude, latitude, elevation;
-  GDateTime *time;
   uint32_t segid;
 } dt_gpx_track_point_t;
 
@@ -42,7 +42,7 @@ typedef struct dt_gpx_track_segment_t
   GDateTime *start_dt;
   GDateTime *end_dt;
   char *name;
-  dt_gpx_track_point_t *trkpt;
+  uint32_t trkpt;    // index of the first point of the segment in the time sorted track
   uint32_t nb_trkpt;
 } dt_gpx_track_segment_t;
 
@@ -70,19 +70,6 @@ typedef struct color_image
   int width, height, stride;
 } color_image;
 
-// allocate space for n-component image of size width x height
-static inline color_image new_color_image(int width, int height, int ch)
-{
-  return (color_image){ dt_alloc_align_float((size_t)width * height * ch), width, height, ch };
-}
-
-// free space for n-component image
-static inline void free_color_image(color_image *img_p)
-{
-  dt_free_align(img_p->data);
-  img_p->data = NULL;
-}
-
 // get a pointer to pixel number 'i' within the image
 static inline float *get_color_pixel(color_image img, size_t i)
 {
@@ -98,8 +85,11 @@ static inline float *get_color_pixel(color_image img, size_t i)
 //    6 variance (R-R, R-G, R-B, G-G, G-B, B-B)
 // for computational efficiency, we'll pack them into a four-channel image and a 9-channel image
 // image instead of running 13 separate box filters: guide+input, R/G/B/R-R/R-G/R-B/G-G/G-B/B-B.
+// mean and variance have to hold the largest source region, img_bak is per-thread scratch memory.
 static void guided_filter_tiling(color_image imgg, gray_image img, gray_image img_out, tile target, const int w,
-                                 const float eps, const float guide_weight, const float min, const float max)
+                                 const float eps, const float guide_weight, const float min, const float max,
+                                 float *const mean_buf, float *const variance_buf,
+                                 float *const img_bak, const size_t img_bak_sz)
 {
   const tile source = { max_i(target.left - 2 * w, 0), min_i(target.right + 2 * w, imgg.width),
                         max_i(target.lower - 2 * w, 0), min_i(target.upper + 2 * w, imgg.height) };
@@ -121,14 +111,11 @@ static void guided_filter_tiling(color_image imgg, gray_image img, gray_image im
 #define VAR_GG 6
 #define VAR_BB 8
 #define VAR_GB 7
-  color_image mean = new_color_image(width, height, 4);
-  color_image variance = new_color_image(width, height, 9);
-  const size_t img_dimen = mean.width;
-  size_t img_bak_sz;
-  float *img_bak = dt_alloc_perthread_float(9*img_dimen, &img_bak_sz);
+  color_image mean = (color_image){ mean_buf, width, height, 4 };
+  color_image variance = (color_image){ variance_buf, width, height, 9 };
 #ifdef _OPENMP
-#pragma omp parallel for schedule(static) default(none) shared(img, imgg, mean, variance, img_bak) \
-  dt_omp_firstprivate(img_bak_sz, img_dimen, w, guide_weight) dt_omp_sharedconst(source)
+#pragma omp parallel for schedule(static) default(none) shared(img, imgg, mean, variance) \
+  dt_omp_firstprivate(img_bak, img_bak_sz, w, guide_weight) dt_omp_sharedconst(source)
 #endif
   for(int j_imgg = source.lower; j_imgg < source.upper; j_imgg++)
   {
@@ -161,7 +148,6 @@ static void guided_filter_tiling(color_image imgg, gray_image img, gray_image im
     dt_box_mean_horizontal(meanpx, mean.width, 4|BOXFILTER_KAHAN_SUM, w, scratch);
     dt_box_mean_horizontal(varpx, variance.width, 9|BOXFILTER_KAHAN_SUM, w, scratch);
   }
-  dt_free_align(img_bak);
   dt_box_mean_vertical(mean.data, mean.height, mean.width, 4|BOXFILTER_KAHAN_SUM, w);
   dt_box_mean_vertical(variance.data, variance.height, variance.width, 9|BOXFILTER_KAHAN_SUM, w);
   // we will recycle memory of 'mean' for the new coefficient arrays a_? and b to reduce memory foot print
@@ -227,7 +213,6 @@ static void guided_filter_tiling(color_image imgg, gray_image img, gray_image im
     a_b.data[4*i+A_BLUE] = a_b_;
     a_b.data[4*i+B] = b_;
   }
-  free_color_image(&variance);
 
   dt_box_mean(a_b.data, a_b.height, a_b.width, a_b.stride|BOXFILTER_KAHAN_SUM, w, 1);
 
@@ -252,7 +237,6 @@ static void guided_filter_tiling(color_image imgg, gray_image img, gray_image im
       img_out.data[i_imgg + (size_t)j_imgg * imgg.width] = CLAMP(res, min, max);
     }
   }
-  free_color_image(&mean);
 }
 
 static int compute_tile_height(const int height, const int w)
@@ -305,12 +289,47 @@ static int compute_tile_width(const int width, const int w)
   return tile_w;
 }
 
+float *dt_guided_filter_workspace_get(dt_guided_filter_workspace_t *ws, const dt_guided_filter_workspace_slot_t slot,
+                                      const size_t nfloats)
+{
+  if(!ws) return dt_alloc_align_float(nfloats);
+
+  if(ws->size[slot] < nfloats)
+  {
+    dt_free_align(ws->buf[slot]);
+    ws->buf[slot] = dt_alloc_align_float(nfloats);
+    ws->size[slot] = ws->buf[slot] ? nfloats : 0;
+  }
+  return ws->buf[slot];
+}
+
+void dt_guided_filter_workspace_put(dt_guided_filter_workspace_t *ws, float *buf)
+{
+  if(!ws) dt_free_align(buf);
+}
+
+void dt_guided_filter_workspace_free(dt_guided_filter_workspace_t *ws)
+{
+  size_t total = 0;
+  for(int k = 0; k < DT_GF_WS_LAST; k++)
+  {
+    total += ws->size[k];
+    dt_free_align(ws->buf[k]);
+    ws->buf[k] = NULL;
+    ws->size[k] = 0;
+  }
+  if(total)
+    dt_print(DT_DEBUG_MEMORY, "[guided filter] released workspace of %.1f MB\n",
+             (double)(total * sizeof(float)) / (1024.0 * 1024.0));
+}
+
 void guided_filter(const float *const guide, const float *const in, float *const out, const int width,
                    const int height, const int ch,
                    const int w,              // window size
                    const float sqrt_eps,     // regularization parameter
                    const float guide_weight, // to balance the amplitudes in the guiding image and the input image
-                   const float min, const float max)
+                   const float min, const float max,
+                   dt_guided_filter_workspace_t *ws)
 {
   assert(ch >= 3);
   assert(w >= 1);
@@ -322,14 +341,35 @@ void guided_filter(const float *const guide, const float *const in, float *const
   const int tile_height = compute_tile_height(height,w);
   const float eps = sqrt_eps * sqrt_eps; // this is the regularization parameter of the original papers
 
+  // the mean and variance buffers are sized for the largest tile including its borders and shared by all tiles
+  const size_t src_width = min_i(tile_width + 4 * w, width);
+  const size_t src_height = min_i(tile_height + 4 * w, height);
+  float *const mean = dt_guided_filter_workspace_get(ws, DT_GF_WS_MEAN, src_width * src_height * 4);
+  float *const variance = dt_guided_filter_workspace_get(ws, DT_GF_WS_VARIANCE, src_width * src_height * 9);
+  size_t img_bak_sz;
+  float *const img_bak = dt_alloc_perthread_float(9 * src_width, &img_bak_sz);
+
+  if(!mean || !variance || !img_bak)
+  {
+    fprintf(stderr, "[guided filter] unable to allocate memory, passing input through\n");
+    if(out != in) memcpy(out, in, sizeof(float) * width * height);
+    goto cleanup;
+  }
+
   for(int j = 0; j < height; j += tile_height)
   {
     for(int i = 0; i < width; i += tile_width)
     {
       tile target = { i, min_i(i + tile_width, width), j, min_i(j + tile_height, height) };
-      guided_filter_tiling(img_guide, img_in, img_out, target, w, eps, guide_weight, min, max);
+      guided_filter_tiling(img_guide, img_in, img_out, target, w, eps, guide_weight, min, max, mean, variance,
+                           img_bak, img_bak_sz);
     }
   }
+
+cleanup:
+  dt_free_align(img_bak);
+  dt_guided_filter_workspace_put(ws, variance);
+  dt_guided_filter_workspace_put(ws, mean);
 }
 
 #ifdef HAVE_OPENCL
@@ -672,7 +712,7 @@ static void guided_filter_cl_fallback(int devid, cl_mem guide, cl_mem in, cl_mem
   if(err != CL_SUCCESS) goto error;
   err = dt_opencl_read_host_from_device(devid, in_host, in, width, height, sizeof(float));
   if(err != CL_SUCCESS) goto error;
-  guided_filter(guide_host, in_host, out_host, width, height, ch, w, sqrt_eps, guide_weight, min, max);
+  guided_filter(guide_host, in_host, out_host, width, height, ch, w, sqrt_eps, guide_weight, min, max, NULL);
   err = dt_opencl_write_host_to_device(devid, out_host, out, width, height, sizeof(float));
   if(err != CL_SUCCESS) goto error;
 error:
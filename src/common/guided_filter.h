@@ -80,8 +80,39 @@ static inline int max_i(int a, int b)
   return a > b ? a : b;
 }
 
+// scratch buffers of the guided filters, kept alive between runs (e.g. by a pixelpipe) so that
+// consecutive filter calls don't have to allocate and page-fault their working memory again.
+// every slot grows on demand to the largest request seen and is only released by
+// dt_guided_filter_workspace_free(). a workspace must not be used by two filters at once.
+typedef enum dt_guided_filter_workspace_slot_t
+{
+  DT_GF_WS_MEAN = 0,    // packed box means (input, guide) resp. {I, p, I*I, I*p}
+  DT_GF_WS_VARIANCE,    // packed (co)variances of the color guided filter
+  DT_GF_WS_DS_GUIDE,    // guide at reduced resolution
+  DT_GF_WS_DS_INPUT,    // input at reduced resolution
+  DT_GF_WS_DS_COEFFS,   // a and b coefficients at reduced resolution
+  DT_GF_WS_COEFFS,      // a and b coefficients at full resolution
+  DT_GF_WS_LAST
+} dt_guided_filter_workspace_slot_t;
+
+typedef struct dt_guided_filter_workspace_t
+{
+  float *buf[DT_GF_WS_LAST];
+  size_t size[DT_GF_WS_LAST];
+} dt_guided_filter_workspace_t;
+
+// get a buffer of at least nfloats floats from the given slot. with ws == NULL this is a plain
+// allocation which has to be handed back with dt_guided_filter_workspace_put()
+float *dt_guided_filter_workspace_get(dt_guided_filter_workspace_t *ws, dt_guided_filter_workspace_slot_t slot,
+                                      size_t nfloats);
+// hand back a buffer obtained from dt_guided_filter_workspace_get(), only frees it if ws == NULL
+void dt_guided_filter_workspace_put(dt_guided_filter_workspace_t *ws, float *buf);
+// release all memory held by the workspace
+void dt_guided_filter_workspace_free(dt_guided_filter_workspace_t *ws);
+
+// ws may be NULL
 void guided_filter(const float *guide, const float *in, float *out, int width, int height, int ch, int w,
-                   float sqrt_eps, float guide_weight, float min, float max);
+                   float sqrt_eps, float guide_weight, float min, float max, dt_guided_filter_workspace_t *ws);
 
 #ifdef HAVE_OPENCL
 
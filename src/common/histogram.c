@@ -159,6 +159,42 @@ inline static void histogram_helper_cs_rgb_helper_process_pixel_m128_compensated
 }
 #endif
 
+// bin indices of a chunk of pixels are computed in a vectorizable loop, only the increments are scalar
+#define HISTOGRAM_CHUNK 64
+
+inline static void histogram_helper_cs_chunked(const dt_dev_histogram_collection_params_t *const histogram_params,
+                                               const float *in, uint32_t *histogram, const int count,
+                                               const dt_aligned_pixel_t range, const dt_aligned_pixel_t shift)
+{
+  const float max = histogram_params->bins_count - 1;
+  const dt_aligned_pixel_t mul = { histogram_params->mul / range[0], histogram_params->mul / range[1],
+                                   histogram_params->mul / range[2], 0.0f };
+  uint32_t DT_ALIGNED_ARRAY index[4 * HISTOGRAM_CHUNK];
+
+  for(int i = 0; i < count; i += HISTOGRAM_CHUNK)
+  {
+    const int n = MIN(HISTOGRAM_CHUNK, count - i);
+    const float *const chunk = in + 4 * i;
+#ifdef _OPENMP
+#pragma omp simd aligned(index : 64)
+#endif
+    for(int k = 0; k < 4 * n; k++)
+      index[k] = 4 * (uint32_t)CLAMP(mul[k & 3] * (chunk[k] + shift[k & 3]), 0, max) + (k & 3);
+
+    for(int k = 0; k < n; k++)
+    {
+      histogram[index[4 * k]]++;
+      histogram[index[4 * k + 1]]++;
+      histogram[index[4 * k + 2]]++;
+    }
+  }
+}
+
+static const dt_aligned_pixel_t rgb_range = { 1.0f, 1.0f, 1.0f, 1.0f };
+static const dt_aligned_pixel_t rgb_shift = { 0.0f, 0.0f, 0.0f, 0.0f };
+static const dt_aligned_pixel_t Lab_range = { 100.0f, 256.0f, 256.0f, 1.0f };
+static const dt_aligned_pixel_t Lab_shift = { 0.0f, 128.0f, 128.0f, 0.0f };
+
 inline static void histogram_helper_cs_rgb(const dt_dev_histogram_collection_params_t *const histogram_params,
                                            const void *pixel, uint32_t *histogram, int j,
                                            const dt_iop_order_iccprofile_info_t *const profile_info)
@@ -166,18 +202,19 @@ inline static void histogram_helper_cs_rgb(const dt_dev_histogram_collection_par
   const dt_histogram_roi_t *roi = histogram_params->roi;
   float *in = (float *)pixel + 4 * (roi->width * j + roi->crop_x);
 
-  // process aligned pixels with SSE
-  for(int i = 0; i < roi->width - roi->crop_width - roi->crop_x; i++, in += 4)
-  {
-    if(darktable.codepath.OPENMP_SIMD)
-      histogram_helper_cs_rgb_helper_process_pixel_float(histogram_params, in, histogram);
+  if(darktable.codepath.OPENMP_SIMD)
+    histogram_helper_cs_chunked(histogram_params, in, histogram, roi->width - roi->crop_width - roi->crop_x,
+                                rgb_range, rgb_shift);
 #if defined(__SSE2__)
-    else if(darktable.codepath.SSE2)
+  else if(darktable.codepath.SSE2)
+  {
+    // process aligned pixels with SSE
+    for(int i = 0; i < roi->width - roi->crop_width - roi->crop_x; i++, in += 4)
       histogram_helper_cs_rgb_helper_process_pixel_m128(histogram_params, in, histogram);
-#endif
-    else
-      dt_unreachable_codepath();
   }
+#endif
+  else
+    dt_unreachable_codepath();
 }
 
 inline static void histogram_helper_cs_rgb_compensated(const dt_dev_histogram_collection_params_t *const histogram_params,
@@ -255,18 +292,19 @@ inline static void histogram_helper_cs_Lab(const dt_dev_histogram_collection_par
   const dt_histogram_roi_t *roi = histogram_params->roi;
   float *in = (float *)pixel + 4 * (roi->width * j + roi->crop_x);
 
-  // process aligned pixels with SSE
-  for(int i = 0; i < roi->width - roi->crop_width - roi->crop_x; i++, in += 4)
-  {
-    if(darktable.codepath.OPENMP_SIMD)
-      histogram_helper_cs_Lab_helper_process_pixel_float(histogram_params, in, histogram);
+  if(darktable.codepath.OPENMP_SIMD)
+    histogram_helper_cs_chunked(histogram_params, in, histogram, roi->width - roi->crop_width - roi->crop_x,
+                                Lab_range, Lab_shift);
 #if defined(__SSE2__)
-    else if(darktable.codepath.SSE2)
+  else if(darktable.codepath.SSE2)
+  {
+    // process aligned pixels with SSE
+    for(int i = 0; i < roi->width - roi->crop_width - roi->crop_x; i++, in += 4)
       histogram_helper_cs_Lab_helper_process_pixel_m128(histogram_params, in, histogram);
-#endif
-    else
-      dt_unreachable_codepath();
   }
+#endif
+  else
+    dt_unreachable_codepath();
 }
 
 inline static void __attribute__((__unused__)) histogram_helper_cs_Lab_LCh_helper_process_pixel_float(
@@ -319,14 +357,15 @@ void dt_histogram_worker(dt_dev_histogram_collection_params_t *const histogram_p
   if(histogram_params->mul == 0) histogram_params->mul = (double)(histogram_params->bins_count - 1);
 
   const dt_histogram_roi_t *const roi = histogram_params->roi;
+  const int row_step = MAX(histogram_params->row_step, 1);
 
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(histogram_params, pixel, Worker, profile_info, bins_total, roi) \
+  dt_omp_firstprivate(histogram_params, pixel, Worker, profile_info, bins_total, roi, row_step) \
   shared(partial_hists) \
   schedule(static)
 #endif
-  for(int j = roi->crop_y; j < roi->height - roi->crop_height; j++)
+  for(int j = roi->crop_y; j < roi->height - roi->crop_height; j += row_step)
   {
     uint32_t *thread_hist = (uint32_t *)partial_hists + bins_total * omp_get_thread_num();
     Worker(histogram_params, pixel, thread_hist, j, profile_info);
@@ -356,8 +395,9 @@ void dt_histogram_worker(dt_dev_histogram_collection_params_t *const histogram_p
   free(partial_hists);
 
   histogram_stats->bins_count = histogram_params->bins_count;
+  const int rows = roi->height - roi->crop_height - roi->crop_y;
   histogram_stats->pixels = (roi->width - roi->crop_width - roi->crop_x)
-                            * (roi->height - roi->crop_height - roi->crop_y);
+                            * (rows > 0 ? (rows + row_step - 1) / row_step : 0);
 }
 
 //------------------------------------------------------------------------------
@@ -29,6 +29,7 @@
 #include "common/undo.h"
 #include "common/utility.h"
 #include "control/control.h"
+#include "control/jobs/control_jobs.h"
 #include "develop/blend.h"
 #include "develop/develop.h"
 #include "develop/masks.h"
@@ -474,35 +475,52 @@ int dt_history_merge_module_into_history(dt_develop_t *dev_dest, dt_develop_t *d
   return module_added;
 }
 
-static int _history_copy_and_paste_on_image_merge(int32_t imgid, int32_t dest_imgid, GList *ops, const gboolean copy_full)
+// load the source of a paste in memory, it is only read by the merge and can be
+// shared by all the destination images of a bulk paste
+static dt_develop_t *_history_source_dev_new(const int32_t imgid)
+{
+  dt_develop_t *dev_src = (dt_develop_t *)calloc(1, sizeof(dt_develop_t));
+
+  dt_dev_init(dev_src, FALSE);
+  dev_src->iop = dt_iop_load_modules_ext(dev_src, TRUE);
+
+  dt_dev_read_history_ext(dev_src, imgid, TRUE);
+  dt_ioppr_check_iop_order(dev_src, imgid, "_history_source_dev_new ");
+  dt_dev_pop_history_items_ext(dev_src, dev_src->history_end);
+  dt_ioppr_check_iop_order(dev_src, imgid, "_history_source_dev_new 1");
+
+  return dev_src;
+}
+
+static void _history_source_dev_free(dt_develop_t *dev_src)
+{
+  if(!dev_src) return;
+  dt_dev_cleanup(dev_src);
+  free(dev_src);
+}
+
+static int _history_copy_and_paste_on_image_merge(int32_t imgid, int32_t dest_imgid, GList *ops,
+                                                  const gboolean copy_full, dt_develop_t *shared_src)
 {
   GList *modules_used = NULL;
 
-  dt_develop_t _dev_src = { 0 };
   dt_develop_t _dev_dest = { 0 };
 
-  dt_develop_t *dev_src = &_dev_src;
+  dt_develop_t *dev_src = shared_src ? shared_src : _history_source_dev_new(imgid);
   dt_develop_t *dev_dest = &_dev_dest;
 
   // we will do the copy/paste on memory so we can deal with masks
-  dt_dev_init(dev_src, FALSE);
   dt_dev_init(dev_dest, FALSE);
 
-  dev_src->iop = dt_iop_load_modules_ext(dev_src, TRUE);
   dev_dest->iop = dt_iop_load_modules_ext(dev_dest, TRUE);
 
-  dt_dev_read_history_ext(dev_src, imgid, TRUE);
-
   // This prepends the default modules and converts just in case it's an empty history
   dt_dev_read_history_ext(dev_dest, dest_imgid, TRUE);
 
-  dt_ioppr_check_iop_order(dev_src, imgid, "_history_copy_and_paste_on_image_merge ");
   dt_ioppr_check_iop_order(dev_dest, dest_imgid, "_history_copy_and_paste_on_image_merge ");
 
-  dt_dev_pop_history_items_ext(dev_src, dev_src->history_end);
   dt_dev_pop_history_items_ext(dev_dest, dev_dest->history_end);
 
-  dt_ioppr_check_iop_order(dev_src, imgid, "_history_copy_and_paste_on_image_merge 1");
   dt_ioppr_check_iop_order(dev_dest, dest_imgid, "_history_copy_and_paste_on_image_merge 1");
 
   GList *mod_list = NULL;
@@ -570,7 +588,7 @@ static int _history_copy_and_paste_on_image_merge(int32_t imgid, int32_t dest_im
   // write history and forms to db
   dt_dev_write_history_ext(dev_dest, dest_imgid);
 
-  dt_dev_cleanup(dev_src);
+  if(!shared_src) _history_source_dev_free(dev_src);
   dt_dev_cleanup(dev_dest);
 
   g_list_free(modules_used);
@@ -578,7 +596,8 @@ static int _history_copy_and_paste_on_image_merge(int32_t imgid, int32_t dest_im
   return 0;
 }
 
-static int _history_copy_and_paste_on_image_overwrite(const int32_t imgid, const int32_t dest_imgid, GList *ops, const gboolean copy_full)
+static int _history_copy_and_paste_on_image_overwrite(const int32_t imgid, const int32_t dest_imgid, GList *ops,
+                                                      const gboolean copy_full, dt_develop_t *shared_src)
 {
   int ret_val = 0;
   sqlite3_stmt *stmt;
@@ -726,15 +745,18 @@ static int _history_copy_and_paste_on_image_overwrite(const int32_t imgid, const
   else
   {
     // since the history and masks where deleted we can do a merge
-    ret_val = _history_copy_and_paste_on_image_merge(imgid, dest_imgid, ops, copy_full);
+    ret_val = _history_copy_and_paste_on_image_merge(imgid, dest_imgid, ops, copy_full, shared_src);
   }
 
   return ret_val;
 }
 
-int dt_history_copy_and_paste_on_image(const int32_t imgid, const int32_t dest_imgid,
-                                       const gboolean merge, GList *ops,
-                                       const gboolean copy_iop_order, const gboolean copy_full)
+// shared_src: the source already loaded for a bulk paste, NULL otherwise
+// synch: when set the image is appended to it and its sidecar is left to the caller
+static int _history_copy_and_paste_on_image_ext(const int32_t imgid, const int32_t dest_imgid,
+                                                const gboolean merge, GList *ops,
+                                                const gboolean copy_iop_order, const gboolean copy_full,
+                                                dt_develop_t *shared_src, GList **synch)
 {
   if(imgid == dest_imgid) return 1;
 
@@ -747,8 +769,9 @@ int dt_history_copy_and_paste_on_image(const int32_t imgid, const int32_t dest_i
   dt_lock_image_pair(imgid, dest_imgid);
 
   // be sure the current history is written before pasting some other history data
+  // (the bulk paste has done it once before loading the shared source)
   const dt_view_t *cv = dt_view_manager_get_current_view(darktable.view_manager);
-  if(cv->view((dt_view_t *)cv) == DT_VIEW_DARKROOM) dt_dev_write_history(darktable.develop);
+  if(!shared_src && cv->view((dt_view_t *)cv) == DT_VIEW_DARKROOM) dt_dev_write_history(darktable.develop);
 
   dt_undo_lt_history_t *hist = dt_history_snapshot_item_init();
   hist->imgid = dest_imgid;
@@ -763,9 +786,9 @@ int dt_history_copy_and_paste_on_image(const int32_t imgid, const int32_t dest_i
 
   int ret_val = 0;
   if(merge)
-    ret_val = _history_copy_and_paste_on_image_merge(imgid, dest_imgid, ops, copy_full);
+    ret_val = _history_copy_and_paste_on_image_merge(imgid, dest_imgid, ops, copy_full, shared_src);
   else
-    ret_val = _history_copy_and_paste_on_image_overwrite(imgid, dest_imgid, ops, copy_full);
+    ret_val = _history_copy_and_paste_on_image_overwrite(imgid, dest_imgid, ops, copy_full, shared_src);
 
   dt_history_snapshot_undo_create(hist->imgid, &hist->after, &hist->after_history_end);
   dt_undo_start_group(darktable.undo, DT_UNDO_LT_HISTORY);
@@ -788,7 +811,10 @@ int dt_history_copy_and_paste_on_image(const int32_t imgid, const int32_t dest_i
   }
 
   /* update xmp file */
-  dt_image_synch_xmp(dest_imgid);
+  if(synch)
+    *synch = g_list_prepend(*synch, GINT_TO_POINTER(dest_imgid));
+  else
+    dt_image_synch_xmp(dest_imgid);
 
   dt_mipmap_cache_remove(darktable.mipmap_cache, dest_imgid);
   dt_image_update_final_size(imgid);
@@ -807,6 +833,57 @@ int dt_history_copy_and_paste_on_image(const int32_t imgid, const int32_t dest_i
   return ret_val;
 }
 
+int dt_history_copy_and_paste_on_image(const int32_t imgid, const int32_t dest_imgid,
+                                       const gboolean merge, GList *ops,
+                                       const gboolean copy_iop_order, const gboolean copy_full)
+{
+  return _history_copy_and_paste_on_image_ext(imgid, dest_imgid, merge, ops, copy_iop_order, copy_full,
+                                              NULL, NULL);
+}
+
+// paste the copied history on a list of images: the source is loaded once, the
+// histories are written in a few transactions of DT_HISTORY_BATCH_SIZE images and
+// the sidecars are written afterwards by one background job
+static void _history_paste_on_list_ext(const GList *list, const gboolean merge)
+{
+  const int32_t imgid = darktable.view_manager->copy_paste.copied_imageid;
+  GList *ops = darktable.view_manager->copy_paste.selops;
+  const double start = dt_get_wtime();
+
+  // be sure the current history is written before the source is read
+  const dt_view_t *cv = dt_view_manager_get_current_view(darktable.view_manager);
+  if(cv->view((dt_view_t *)cv) == DT_VIEW_DARKROOM) dt_dev_write_history(darktable.develop);
+
+  // the in-memory source is needed whenever the paste goes through a merge
+  dt_develop_t *dev_src = (merge || ops) ? _history_source_dev_new(imgid) : NULL;
+
+  GList *synch = NULL;
+  int count = 0;
+  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "SAVEPOINT history_paste", NULL, NULL, NULL);
+  for(const GList *l = list; l; l = g_list_next(l))
+  {
+    const int dest = GPOINTER_TO_INT(l->data);
+    if(dest == imgid) continue;
+    _history_copy_and_paste_on_image_ext(imgid, dest, merge, ops,
+                                         darktable.view_manager->copy_paste.copy_iop_order,
+                                         darktable.view_manager->copy_paste.full_copy,
+                                         dev_src, &synch);
+    if(++count % DT_HISTORY_BATCH_SIZE == 0)
+    {
+      DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "RELEASE history_paste", NULL, NULL, NULL);
+      DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "SAVEPOINT history_paste", NULL, NULL, NULL);
+    }
+  }
+  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "RELEASE history_paste", NULL, NULL, NULL);
+
+  _history_source_dev_free(dev_src);
+
+  dt_control_write_sidecar_files_list(g_list_reverse(synch));
+
+  dt_print(DT_DEBUG_PERF, "[history] pasted history of image %d on %d images in %.3f secs\n",
+           imgid, count, dt_get_wtime() - start);
+}
+
 GList *dt_history_get_items(const int32_t imgid, gboolean enabled)
 {
   GList *result = NULL;
@@ -976,7 +1053,7 @@ void dt_history_compress_on_image(const int32_t imgid)
   const char *op_mask_manager = "mask_manager";
   gboolean manager_position = FALSE;
 
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "BEGIN", NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "SAVEPOINT history_compress", NULL, NULL, NULL);
 
   // We must know for sure whether there is a mask manager at slot 0 in history
   // because only if this is **not** true history nums and history_end must be increased
@@ -1070,7 +1147,7 @@ void dt_history_compress_on_image(const int32_t imgid)
   dt_unlock_image(imgid);
   dt_history_hash_write_from_history(imgid, DT_HISTORY_HASH_CURRENT);
 
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "RELEASE history_compress", NULL, NULL, NULL);
 
   DT_DEBUG_CONTROL_SIGNAL_RAISE(darktable.signals, DT_SIGNAL_DEVELOP_MIPMAP_UPDATED, imgid);
 }
@@ -1091,7 +1168,7 @@ void dt_history_truncate_on_image(const int32_t imgid, const int32_t history_end
     return;
   }
 
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "BEGIN", NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "SAVEPOINT history_truncate", NULL, NULL, NULL);
 
   // delete end of history
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
@@ -1125,7 +1202,7 @@ void dt_history_truncate_on_image(const int32_t imgid, const int32_t history_end
   dt_unlock_image(imgid);
   dt_history_hash_write_from_history(imgid, DT_HISTORY_HASH_CURRENT);
 
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "RELEASE history_truncate", NULL, NULL, NULL);
 
   DT_DEBUG_CONTROL_SIGNAL_RAISE(darktable.signals, DT_SIGNAL_DEVELOP_MIPMAP_UPDATED, imgid);
 }
@@ -1641,15 +1718,7 @@ gboolean dt_history_paste_on_list(const GList *list, gboolean undo)
   if(mode == 0) merge = TRUE;
 
   if(undo) dt_undo_start_group(darktable.undo, DT_UNDO_LT_HISTORY);
-  for(GList *l = (GList *)list; l; l = g_list_next(l))
-  {
-    const int dest = GPOINTER_TO_INT(l->data);
-    dt_history_copy_and_paste_on_image(darktable.view_manager->copy_paste.copied_imageid,
-                                       dest, merge,
-                                       darktable.view_manager->copy_paste.selops,
-                                       darktable.view_manager->copy_paste.copy_iop_order,
-                                       darktable.view_manager->copy_paste.full_copy);
-  }
+  _history_paste_on_list_ext(list, merge);
   if(undo) dt_undo_end_group(darktable.undo);
 
   // In darkroom and if there is a copy of the iop-order we need to rebuild the pipe
@@ -1692,15 +1761,7 @@ gboolean dt_history_paste_parts_on_list(const GList *list, gboolean undo)
   }
 
   if(undo) dt_undo_start_group(darktable.undo, DT_UNDO_LT_HISTORY);
-  for (const GList *l = l_copy; l; l = g_list_next(l))
-  {
-    const int dest = GPOINTER_TO_INT(l->data);
-    dt_history_copy_and_paste_on_image(darktable.view_manager->copy_paste.copied_imageid,
-                                       dest, merge,
-                                       darktable.view_manager->copy_paste.selops,
-                                       darktable.view_manager->copy_paste.copy_iop_order,
-                                       darktable.view_manager->copy_paste.full_copy);
-  }
+  _history_paste_on_list_ext(l_copy, merge);
   if(undo) dt_undo_end_group(darktable.undo);
 
   g_list_free(l_copy);
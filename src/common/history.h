@@ -26,6 +26,10 @@
 struct dt_develop_t;
 struct dt_iop_module_t;
 
+// the batch operations on a list of images (paste, style apply) commit their transaction after
+// this many images, so that the background jobs writing to the database are not held back for long
+#define DT_HISTORY_BATCH_SIZE 50
+
 // history hash is designed to detect any change made on the image
 // if current = basic the image has only the mandatory modules with their original settings
 // if current = auto the image has the mandatory and auto applied modules with their original settings
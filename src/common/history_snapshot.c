@@ -56,7 +56,8 @@ void dt_history_snapshot_undo_create(const int32_t imgid, int *snap_id, int *his
     *snap_id = sqlite3_column_int(stmt, 0) + 1;
   sqlite3_finalize(stmt);
 
-  sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
+  // a savepoint as this may run inside the transaction of a bulk paste or style apply
+  sqlite3_exec(dt_database_get(darktable.db), "SAVEPOINT history_snapshot", NULL, NULL, NULL);
 
   if(*history_end == 0)
   {
@@ -114,10 +115,11 @@ void dt_history_snapshot_undo_create(const int32_t imgid, int *snap_id, int *his
   sqlite3_finalize(stmt);
 
   if(all_ok)
-    sqlite3_exec(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
+    sqlite3_exec(dt_database_get(darktable.db), "RELEASE history_snapshot", NULL, NULL, NULL);
   else
   {
-    sqlite3_exec(dt_database_get(darktable.db), "ROLLBACK_TRANSACTION", NULL, NULL, NULL);
+    sqlite3_exec(dt_database_get(darktable.db), "ROLLBACK TO history_snapshot", NULL, NULL, NULL);
+    sqlite3_exec(dt_database_get(darktable.db), "RELEASE history_snapshot", NULL, NULL, NULL);
     fprintf(stderr, "[dt_history_snapshot_undo_create] fails to create a snapshot for %d\n", imgid);
   }
 
@@ -132,7 +134,7 @@ static void _history_snapshot_undo_restore(const int32_t imgid, const int snap_i
 
   dt_lock_image(imgid);
 
-  sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
+  sqlite3_exec(dt_database_get(darktable.db), "SAVEPOINT history_snapshot", NULL, NULL, NULL);
 
   dt_history_delete_on_image_ext(imgid, FALSE);
   DT_DEBUG_CONTROL_SIGNAL_RAISE(darktable.signals, DT_SIGNAL_TAG_CHANGED);
@@ -194,10 +196,11 @@ static void _history_snapshot_undo_restore(const int32_t imgid, const int snap_i
   sqlite3_finalize(stmt);
 
   if(all_ok)
-    sqlite3_exec(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
+    sqlite3_exec(dt_database_get(darktable.db), "RELEASE history_snapshot", NULL, NULL, NULL);
   else
   {
-    sqlite3_exec(dt_database_get(darktable.db), "ROLLBACK_TRANSACTION", NULL, NULL, NULL);
+    sqlite3_exec(dt_database_get(darktable.db), "ROLLBACK TO history_snapshot", NULL, NULL, NULL);
+    sqlite3_exec(dt_database_get(darktable.db), "RELEASE history_snapshot", NULL, NULL, NULL);
     fprintf(stderr, "[_history_snapshot_undo_restore] fails to restore a snapshot for %d\n", imgid);
   }
   dt_unlock_image(imgid);
@@ -1220,6 +1220,17 @@ void dt_image_remove(const int32_t imgid)
   if(darktable.gui && darktable.gui->expanded_group_id == old_group_id)
     darktable.gui->expanded_group_id = new_group_id;
 
+  // the folder has to be listed again by the next import to find the image back
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "UPDATE main.folder_snapshots SET mtime = -1"
+                              " WHERE folder = (SELECT f.folder"
+                              "                 FROM main.images AS i, main.film_rolls AS f"
+                              "                 WHERE i.id = ?1 AND f.id = i.film_id)",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+
   // due to foreign keys added in db version 33,
   // all entries from tables having references to the images are deleted as well
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "DELETE FROM main.images WHERE id = ?1", -1, &stmt,
@@ -1786,6 +1797,7 @@ void dt_image_init(dt_image_t *img)
   img->usercrop[0] = img->usercrop[1] = 0;
   img->usercrop[2] = img->usercrop[3] = 1;
   img->cache_entry = 0;
+  img->cache_stamp = 0;
 }
 
 void dt_image_refresh_makermodel(dt_image_t *img)
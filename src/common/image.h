@@ -261,6 +261,9 @@ typedef struct dt_image_t
   dt_boundingbox_t usercrop;
   /* convenience pointer back into the image cache, so we can return dt_image_t* there directly. */
   struct dt_cache_entry_t *cache_entry;
+  /* changes whenever the cached image is (re)loaded or written, 0 outside of the cache. data derived from
+   * the image can be kept as long as the stamp is the same. */
+  uint32_t cache_stamp;
 } dt_image_t;
 
 // image buffer operations:
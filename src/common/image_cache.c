@@ -29,10 +29,12 @@
 
 void dt_image_cache_allocate(void *data, dt_cache_entry_t *entry)
 {
+  dt_image_cache_t *cache = (dt_image_cache_t *)data;
   entry->cost = sizeof(dt_image_t);
 
   dt_image_t *img = (dt_image_t *)g_malloc(sizeof(dt_image_t));
   dt_image_init(img);
+  img->cache_stamp = dt_atomic_add_int(&cache->stamp, 1) + 1;
   entry->data = img;
   // load stuff from db and store in cache:
   sqlite3_stmt *stmt;
@@ -182,6 +184,7 @@ void dt_image_cache_init(dt_image_cache_t *cache)
   dt_cache_init(&cache->cache, sizeof(dt_image_t), max_mem);
   dt_cache_set_allocate_callback(&cache->cache, &dt_image_cache_allocate, cache);
   dt_cache_set_cleanup_callback(&cache->cache, &dt_image_cache_deallocate, cache);
+  dt_atomic_set_int(&cache->stamp, 0);
 
   dt_print(DT_DEBUG_CACHE, "[image_cache] has %d entries\n", num);
 }
@@ -243,6 +246,7 @@ void dt_image_cache_write_release(dt_image_cache_t *cache, dt_image_t *img, dt_i
     else
       img->aspect_ratio = (float )img->height / (float )img->width;
   }
+  img->cache_stamp = dt_atomic_add_int(&cache->stamp, 1) + 1;
   if(img->id <= 0) return;
 
   sqlite3_stmt *stmt;
@@ -18,12 +18,15 @@
 
 #pragma once
 
+#include "common/atomic.h"
 #include "common/cache.h"
 #include "common/image.h"
 
 typedef struct dt_image_cache_t
 {
   dt_cache_t cache;
+  // source of dt_image_t.cache_stamp
+  dt_atomic_int stamp;
 }
 dt_image_cache_t;
 
@@ -57,6 +57,7 @@
 #include "develop/blend.h"
 #include "develop/develop.h"
 #include "develop/imageop.h"
+#include "develop/imageop_math.h"
 
 #ifdef HAVE_GRAPHICSMAGICK
 #include <magick/api.h>
@@ -81,6 +82,13 @@
 // load a full-res thumbnail:
 int dt_imageio_large_thumbnail(const char *filename, uint8_t **buffer, int32_t *width, int32_t *height,
                                dt_colorspaces_color_profile_type_t *color_space)
+{
+  return dt_imageio_large_thumbnail_ext(filename, buffer, width, height, color_space, 0, 0);
+}
+
+int dt_imageio_large_thumbnail_ext(const char *filename, uint8_t **buffer, int32_t *width, int32_t *height,
+                                   dt_colorspaces_color_profile_type_t *color_space, const int fit_width,
+                                   const int fit_height)
 {
   int res = 1;
 
@@ -96,6 +104,7 @@ int dt_imageio_large_thumbnail(const char *filename, uint8_t **buffer, int32_t *
     // Decompress the JPG into our own memory format
     dt_imageio_jpeg_t jpg;
     if(dt_imageio_jpeg_decompress_header(buf, bufsize, &jpg)) goto error;
+    dt_imageio_jpeg_set_scale(&jpg, fit_width, fit_height);
     *buffer = (uint8_t *)dt_alloc_align(64, sizeof(uint8_t) * 4 * jpg.width * jpg.height);
     if(!*buffer) goto error;
 
@@ -666,6 +675,96 @@ int dt_imageio_export(const int32_t imgid, const char *filename, dt_imageio_modu
                                         storage, storage_params, num, total, metadata);
 }
 
+static GPrivate _export_lane;
+
+void dt_imageio_export_set_lane(dt_imageio_export_lane_t *lane)
+{
+  g_private_set(&_export_lane, lane);
+}
+
+dt_imageio_export_lane_t *dt_imageio_export_get_lane()
+{
+  return (dt_imageio_export_lane_t *)g_private_get(&_export_lane);
+}
+
+void dt_imageio_export_lane_cleanup(dt_imageio_export_lane_t *lane)
+{
+  if(lane->pipe)
+  {
+    dt_dev_pixelpipe_cleanup(lane->pipe);
+    free(lane->pipe);
+    lane->pipe = NULL;
+  }
+  if(lane->dev)
+  {
+    dt_dev_cleanup(lane->dev);
+    free(lane->dev);
+    lane->dev = NULL;
+  }
+  g_list_free_full(lane->style_items, dt_style_item_free);
+  lane->style_items = NULL;
+  g_free(lane->style);
+  lane->style = NULL;
+}
+
+// the mosaic is only binned when that leaves at most this fraction of its width and height
+#define DT_IMAGEIO_MOSAIC_BIN_MAX_SCALE 0.5f
+// the mosaic is binned this much finer than one cfa pattern per output pixel, see below
+#define DT_IMAGEIO_MOSAIC_BIN_MARGIN 1.01f
+
+// bin the raw mosaic of a small output before it enters the pipe, to a few photosites per output
+// pixel along each axis: rawprepare, highlights, demosaic and the other raw modules then process
+// a fraction of the sensor data. returns the binned input, to be freed by the caller, or NULL if
+// the pipe keeps the full mosaic.
+static void *_export_bin_mosaic(dt_dev_pixelpipe_t *pipe, const dt_image_t *img, const dt_mipmap_buffer_t *buf,
+                                const int max_width, const int max_height)
+{
+  const uint32_t filters = img->buf_dsc.filters;
+  // the 4bayer layouts have no half size path in demosaic
+  if(!filters || (img->flags & DT_IMAGE_4BAYER)) return NULL;
+  if(img->buf_dsc.channels != 1
+     || (img->buf_dsc.datatype != TYPE_UINT16 && img->buf_dsc.datatype != TYPE_FLOAT))
+    return NULL;
+  if((max_width <= 0 && max_height <= 0) || pipe->processed_width <= 0 || pipe->processed_height <= 0)
+    return NULL;
+
+  const float scale = fminf(max_width > 0 ? (float)max_width / pipe->processed_width : 1.0f,
+                            max_height > 0 ? (float)max_height / pipe->processed_height : 1.0f);
+  // demosaic wants a full cfa pattern per output pixel: 2x2 for bayer, 3x3 for x-trans. its size
+  // reducing path is only taken up to a scale of 1/2 resp. 0.333, a bit below the exact ratio, so
+  // bin slightly finer than that.
+  const float cfa_size = filters == 9u ? 3.0f : 2.0f;
+  const float demosaic_max_scale = filters == 9u ? 0.333f : 0.5f;
+  const float bin_scale = cfa_size * scale * DT_IMAGEIO_MOSAIC_BIN_MARGIN;
+  if(bin_scale > DT_IMAGEIO_MOSAIC_BIN_MAX_SCALE) return NULL;
+
+  const double start = dt_get_wtime();
+  const dt_iop_roi_t roi_in = { .x = 0, .y = 0, .width = buf->width, .height = buf->height, .scale = 1.0f };
+  dt_iop_roi_t roi_out = { .x = 0, .y = 0, .scale = bin_scale };
+  roi_out.width = bin_scale * roi_in.width;
+  roi_out.height = bin_scale * roi_in.height;
+  if(roi_out.width < 16 || roi_out.height < 16) return NULL;
+  // the binned size is rounded down, make sure the scale left for demosaic still takes its fast path
+  if(scale * roi_in.width > demosaic_max_scale * roi_out.width
+     || scale * roi_in.height > demosaic_max_scale * roi_out.height)
+    return NULL;
+
+  const size_t bpp = img->buf_dsc.datatype == TYPE_FLOAT ? sizeof(float) : sizeof(uint16_t);
+  void *binned = dt_alloc_align(64, bpp * roi_out.width * roi_out.height);
+  if(!binned) return NULL;
+
+  dt_iop_clip_and_zoom_mosaic(binned, buf->buf, &roi_out, &roi_in, roi_out.width, roi_in.width,
+                              img->buf_dsc.datatype, filters, img->buf_dsc.xtrans);
+
+  dt_dev_pixelpipe_rescale_input(pipe, (float *)binned, roi_out.width, roi_out.height,
+                                 (float)roi_in.width / (float)roi_out.width);
+
+  dt_print(DT_DEBUG_IMAGEIO | DT_DEBUG_PERF,
+           "[dt_imageio_export_with_flags] mosaic binned from %dx%d to %dx%d in %.4f s\n",
+           roi_in.width, roi_in.height, roi_out.width, roi_out.height, dt_get_wtime() - start);
+  return binned;
+}
+
 // internal function: to avoid exif blob reading + 8-bit byteorder flag + high-quality override
 int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
                                  dt_imageio_module_format_t *format, dt_imageio_module_data_t *format_params,
@@ -677,18 +776,32 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
                                  dt_imageio_module_data_t *storage_params, int num, int total,
                                  dt_export_metadata_t *metadata)
 {
-  dt_develop_t dev;
-  dt_dev_init(&dev, 0);
-  dt_dev_load_image(&dev, imgid);
+  // a lane of an export job keeps its develop from one image to the next, with all modules loaded, and
+  // only swaps history and input. it keeps its pipe and pipe cache as well, pipe_lock only serializes
+  // their use across the lanes and the encoder can still read the pipe of the lane after unlocking.
+  dt_imageio_export_lane_t *lane = thumbnail_export ? NULL : dt_imageio_export_get_lane();
+  const double setup_start = dt_get_wtime();
+  const gboolean reuse = lane && lane->dev;
+  dt_develop_t dev_local;
+  dt_develop_t *dev = lane ? lane->dev : &dev_local;
+  if(reuse)
+    dt_dev_retarget_image(dev, imgid);
+  else
+  {
+    if(lane) dev = lane->dev = (dt_develop_t *)malloc(sizeof(dt_develop_t));
+    dt_dev_init(dev, 0);
+    dt_dev_load_image(dev, imgid);
+  }
 
   const gboolean buf_is_downscaled = (thumbnail_export && dt_conf_get_bool("ui/performance"));
+  void *binned = NULL;
   dt_mipmap_buffer_t buf;
   if(buf_is_downscaled)
     dt_mipmap_cache_get(darktable.mipmap_cache, &buf, imgid, DT_MIPMAP_F, DT_MIPMAP_BLOCKING, 'r');
   else
     dt_mipmap_cache_get(darktable.mipmap_cache, &buf, imgid, DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING, 'r');
 
-  const dt_image_t *img = &dev.image_storage;
+  const dt_image_t *img = &dev->image_storage;
 
   if(!buf.buf || !buf.width || !buf.height)
   {
@@ -705,9 +818,34 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
 
   dt_times_t start;
   dt_get_times(&start);
-  dt_dev_pixelpipe_t pipe;
-  res = thumbnail_export ? dt_dev_pixelpipe_init_thumbnail(&pipe, wd, ht)
-                         : dt_dev_pixelpipe_init_export(&pipe, wd, ht, format->levels(format_params), export_masks);
+  dt_dev_pixelpipe_t pipe_local;
+  dt_dev_pixelpipe_t *pipe = lane ? lane->pipe : &pipe_local;
+  if(lane && lane->pipe)
+  {
+    dt_dev_pixelpipe_reset(pipe);
+    pipe->levels = format->levels(format_params);
+    pipe->store_all_raster_masks = export_masks;
+    res = 1;
+  }
+  else
+  {
+    if(lane) pipe = (dt_dev_pixelpipe_t *)calloc(1, sizeof(dt_dev_pixelpipe_t));
+    res = pipe
+          && (thumbnail_export ? dt_dev_pixelpipe_init_thumbnail(pipe, wd, ht)
+                               : dt_dev_pixelpipe_init_export(pipe, wd, ht, format->levels(format_params),
+                                                              export_masks));
+    if(lane)
+    {
+      // the lane only takes a pipe which is fully set up, its cleanup relies on that
+      if(res)
+        lane->pipe = pipe;
+      else
+      {
+        free(pipe);
+        pipe = NULL;
+      }
+    }
+  }
   if(!res)
   {
     dt_control_log(
@@ -721,7 +859,23 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
   //  If a style is to be applied during export, add the iop params into the history
   if(use_style)
   {
-    GList *style_items = dt_styles_get_item_list(format_params->style, TRUE, -1);
+    const double style_start = dt_get_wtime();
+    GList *style_items = NULL;
+    if(lane)
+    {
+      // the style is read once per lane and each image merges a copy. only items of the current module
+      // versions come pre-converted, older ones still go through legacy_params() for every image
+      if(!lane->style || strcmp(lane->style, format_params->style))
+      {
+        g_list_free_full(lane->style_items, dt_style_item_free);
+        g_free(lane->style);
+        lane->style = g_strdup(format_params->style);
+        lane->style_items = dt_styles_get_resolved_item_list(dev, format_params->style);
+      }
+      style_items = dt_styles_item_list_copy(lane->style_items);
+    }
+    else
+      style_items = dt_styles_get_item_list(format_params->style, TRUE, -1);
     if(!style_items)
     {
       dt_control_log(_("cannot find the style '%s' to apply during export."), format_params->style);
@@ -730,25 +884,28 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
 
     GList *modules_used = NULL;
 
-    dt_dev_pop_history_items_ext(&dev, appending ? dev.history_end : 0);
-    dt_ioppr_update_for_style_items(&dev, style_items, appending);
+    dt_dev_pop_history_items_ext(dev, appending ? dev->history_end : 0);
+    dt_ioppr_update_for_style_items(dev, style_items, appending);
 
     for(GList *st_items = style_items; st_items; st_items = g_list_next(st_items))
     {
       dt_style_item_t *st_item = (dt_style_item_t *)st_items->data;
-      dt_styles_apply_style_item(&dev, st_item, &modules_used, appending);
+      dt_styles_apply_style_item(dev, st_item, &modules_used, appending);
     }
 
     g_list_free(modules_used);
     g_list_free_full(style_items, dt_style_item_free);
+
+    dt_print(DT_DEBUG_IMAGEIO, "[dt_imageio_export_with_flags] style `%s' merged into image %d in %.4f s\n",
+             format_params->style, imgid, dt_get_wtime() - style_start);
   }
 
-  dt_ioppr_resync_modules_order(&dev);
+  dt_ioppr_resync_modules_order(dev);
 
-  dt_dev_pixelpipe_set_icc(&pipe, icc_type, icc_filename, icc_intent);
-  dt_dev_pixelpipe_set_input(&pipe, &dev, (float *)buf.buf, buf.width, buf.height, buf.iscale);
-  dt_dev_pixelpipe_create_nodes(&pipe, &dev);
-  dt_dev_pixelpipe_synch_all(&pipe, &dev);
+  dt_dev_pixelpipe_set_icc(pipe, icc_type, icc_filename, icc_intent);
+  dt_dev_pixelpipe_set_input(pipe, dev, (float *)buf.buf, buf.width, buf.height, buf.iscale);
+  dt_dev_pixelpipe_create_nodes(pipe, dev);
+  dt_dev_pixelpipe_synch_all(pipe, dev);
   if(darktable.unmuted & DT_DEBUG_IMAGEIO)
   {
     fprintf(stderr,"[dt_imageio_export_with_flags] ");
@@ -759,7 +916,7 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
     }
     else fprintf(stderr,"\n");
     int cnt = 0;
-    for(GList *nodes = pipe.nodes; nodes; nodes = g_list_next(nodes))
+    for(GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
     {
       dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)nodes->data;
       if(piece->enabled)
@@ -773,14 +930,29 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
 
   if(filter)
   {
-    if(!strncmp(filter, "pre:", 4)) dt_dev_pixelpipe_disable_after(&pipe, filter + 4);
-    if(!strncmp(filter, "post:", 5)) dt_dev_pixelpipe_disable_before(&pipe, filter + 5);
+    if(!strncmp(filter, "pre:", 4)) dt_dev_pixelpipe_disable_after(pipe, filter + 4);
+    if(!strncmp(filter, "post:", 5)) dt_dev_pixelpipe_disable_before(pipe, filter + 5);
   }
 
-  dt_dev_pixelpipe_get_dimensions(&pipe, &dev, pipe.iwidth, pipe.iheight, &pipe.processed_width,
-                                  &pipe.processed_height);
+  dt_dev_pixelpipe_get_dimensions(pipe, dev, pipe->iwidth, pipe->iheight, &pipe->processed_width,
+                                  &pipe->processed_height);
+
+  // thumbnails far smaller than the sensor get a binned mosaic as input. exports keep working on
+  // the full mosaic, whatever their quality setting, and downscale in the pipe.
+  if(thumbnail_export && !buf_is_downscaled && !upscale)
+  {
+    binned = _export_bin_mosaic(pipe, img, &buf, format_params->max_width, format_params->max_height);
+    if(binned)
+      dt_dev_pixelpipe_get_dimensions(pipe, dev, pipe->iwidth, pipe->iheight, &pipe->processed_width,
+                                      &pipe->processed_height);
+  }
 
   dt_show_times(&start, "[export] creating pixelpipe");
+  if(lane)
+  {
+    lane->setup += dt_get_wtime() - setup_start;
+    if(reuse) lane->reused++;
+  }
 
   // find output color profile for this image:
   int sRGB = 1;
@@ -791,7 +963,7 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
   else if(icc_type == DT_COLORSPACE_NONE)
   {
     dt_iop_module_t *colorout = NULL;
-    for(GList *modules = dev.iop; modules; modules = g_list_next(modules))
+    for(GList *modules = dev->iop; modules; modules = g_list_next(modules))
     {
       colorout = (dt_iop_module_t *)modules->data;
       if(colorout->get_p && strcmp(colorout->op, "colorout") == 0)
@@ -809,8 +981,8 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
 
   // get only once at the beginning, in case the user changes it on the way:
   const gboolean high_quality_processing
-      = ((format_params->max_width == 0 || format_params->max_width >= pipe.processed_width)
-         && (format_params->max_height == 0 || format_params->max_height >= pipe.processed_height))
+      = ((format_params->max_width == 0 || format_params->max_width >= pipe->processed_width)
+         && (format_params->max_height == 0 || format_params->max_height >= pipe->processed_height))
             ? FALSE
             : high_quality;
 
@@ -834,8 +1006,8 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
   */
 
   const gboolean iscropped =
-    ((pipe.processed_width < (wd - img->crop_x - img->crop_width)) ||
-     (pipe.processed_height < (ht - img->crop_y - img->crop_height)));
+    ((pipe->processed_width < (wd - img->crop_x - img->crop_width)) ||
+     (pipe->processed_height < (ht - img->crop_y - img->crop_height)));
 
   const gboolean exact_size = (
       iscropped ||
@@ -849,14 +1021,14 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
 
   if(iscropped && !thumbnail_export && width == 0 && height == 0)
   {
-    width = pipe.processed_width;
-    height = pipe.processed_height;
+    width = pipe->processed_width;
+    height = pipe->processed_height;
   }
 
   const double max_scale = ( upscale && ( width > 0 || height > 0 )) ? 100.0 : 1.0;
 
-  const double scalex = width > 0 ? fmin((double)width / (double)pipe.processed_width, max_scale) : max_scale;
-  const double scaley = height > 0 ? fmin((double)height / (double)pipe.processed_height, max_scale) : max_scale;
+  const double scalex = width > 0 ? fmin((double)width / (double)pipe->processed_width, max_scale) : max_scale;
+  const double scaley = height > 0 ? fmin((double)height / (double)pipe->processed_height, max_scale) : max_scale;
   double scale = fmin(scalex, scaley);
   double corrscale = 1.0f;
 
@@ -866,15 +1038,15 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
   gboolean corrected = FALSE;
   float origin[] = { 0.0f, 0.0f };
 
-  if(dt_dev_distort_backtransform_plus(&dev, &pipe, 0.f, DT_DEV_TRANSFORM_DIR_ALL, origin, 1))
+  if(dt_dev_distort_backtransform_plus(dev, pipe, 0.f, DT_DEV_TRANSFORM_DIR_ALL, origin, 1))
   {
     if((width == 0) && exact_size)
-      width = pipe.processed_width;
+      width = pipe->processed_width;
     if((height == 0) && exact_size)
-      height = pipe.processed_height;
+      height = pipe->processed_height;
 
-    scale = fmin(width >  0 ? fmin((double)width / (double)pipe.processed_width, max_scale) : max_scale,
-                 height > 0 ? fmin((double)height / (double)pipe.processed_height, max_scale) : max_scale);
+    scale = fmin(width >  0 ? fmin((double)width / (double)pipe->processed_width, max_scale) : max_scale,
+                 height > 0 ? fmin((double)height / (double)pipe->processed_height, max_scale) : max_scale);
 
     const gboolean is_scaling =
       dt_conf_is_equal("plugins/lighttable/export/resizing", "scaling");
@@ -894,11 +1066,11 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
       }
     }
 
-    processed_width = scale * pipe.processed_width + 0.8f;
-    processed_height = scale * pipe.processed_height + 0.8f;
+    processed_width = scale * pipe->processed_width + 0.8f;
+    processed_height = scale * pipe->processed_height + 0.8f;
 
-    if((ceil((double)processed_width / scale) + origin[0] > pipe.iwidth) ||
-       (ceil((double)processed_height / scale) + origin[1] > pipe.iheight))
+    if((ceil((double)processed_width / scale) + origin[0] > pipe->iwidth) ||
+       (ceil((double)processed_height / scale) + origin[1] > pipe->iheight))
     {
       corrected = TRUE;
      /* Here the scale is too **small** so while reading data from the right or low borders we are out-of-bounds.
@@ -908,8 +1080,8 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
      */
       if(exact_size)
       {
-        corrscale = fmax( ((double)(pipe.processed_width + 1) / (double)(pipe.processed_width)),
-                           ((double)(pipe.processed_height +1) / (double)(pipe.processed_height)) );
+        corrscale = fmax( ((double)(pipe->processed_width + 1) / (double)(pipe->processed_width)),
+                           ((double)(pipe->processed_height +1) / (double)(pipe->processed_height)) );
         scale = scale * corrscale;
       }
       else
@@ -920,20 +1092,30 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
     }
 
     dt_print(DT_DEBUG_IMAGEIO,"[dt_imageio_export] imgid %d, pipe %ix%i, range %ix%i --> exact %i, upscale %i, corrected %i, scale %.7f, corr %.6f, size %ix%i\n",
-             imgid, pipe.processed_width, pipe.processed_height, format_params->max_width, format_params->max_height,
+             imgid, pipe->processed_width, pipe->processed_height, format_params->max_width, format_params->max_height,
              exact_size, upscale, corrected, scale, corrscale, processed_width, processed_height);
   }
   else
   {
-    processed_width = floor(scale * pipe.processed_width);
-    processed_height = floor(scale * pipe.processed_height);
+    processed_width = floor(scale * pipe->processed_width);
+    processed_height = floor(scale * pipe->processed_height);
     dt_print(DT_DEBUG_IMAGEIO,"[dt_imageio_export] (direct) imgid %d, pipe %ix%i, range %ix%i --> size %ix%i / %ix%i\n",
-             imgid, pipe.processed_width, pipe.processed_height, format_params->max_width, format_params->max_height,
+             imgid, pipe->processed_width, pipe->processed_height, format_params->max_width, format_params->max_height,
              processed_width, processed_height, width, height);
   }
 
   const int bpp = format->bpp(format_params);
 
+  // in a staged export only one image at a time goes through the pipe
+  double stage_start = dt_get_wtime();
+  if(lane && lane->pipe_lock)
+  {
+    dt_pthread_mutex_lock(lane->pipe_lock);
+    const double now = dt_get_wtime();
+    lane->pipe_wait += now - stage_start;
+    stage_start = now;
+  }
+
   dt_get_times(&start);
   if(high_quality_processing)
   {
@@ -941,7 +1123,7 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
      * if high quality processing was requested, downsampling will be done
      * at the very end of the pipe (just before border and watermark)
      */
-    dt_dev_pixelpipe_process_no_gamma(&pipe, &dev, 0, 0, processed_width, processed_height, scale);
+    dt_dev_pixelpipe_process_no_gamma(pipe, dev, 0, 0, processed_width, processed_height, scale);
   }
   else
   {
@@ -952,7 +1134,7 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
     // find the finalscale module
     dt_dev_pixelpipe_iop_t *finalscale = NULL;
     {
-      for(const GList *nodes = g_list_last(pipe.nodes); nodes; nodes = g_list_previous(nodes))
+      for(const GList *nodes = g_list_last(pipe->nodes); nodes; nodes = g_list_previous(nodes))
       {
         dt_dev_pixelpipe_iop_t *node = (dt_dev_pixelpipe_iop_t *)(nodes->data);
         if(!strcmp(node->module->op, "finalscale"))
@@ -967,16 +1149,16 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
 
     // do the processing (8-bit with special treatment, to make sure we can use openmp further down):
     if(bpp == 8)
-      dt_dev_pixelpipe_process(&pipe, &dev, 0, 0, processed_width, processed_height, scale);
+      dt_dev_pixelpipe_process(pipe, dev, 0, 0, processed_width, processed_height, scale);
     else
-      dt_dev_pixelpipe_process_no_gamma(&pipe, &dev, 0, 0, processed_width, processed_height, scale);
+      dt_dev_pixelpipe_process_no_gamma(pipe, dev, 0, 0, processed_width, processed_height, scale);
 
     if(finalscale) finalscale->enabled = 1;
   }
   dt_show_times(&start, thumbnail_export ? "[dev_process_thumbnail] pixel pipeline processing"
                                          : "[dev_process_export] pixel pipeline processing");
 
-  uint8_t *outbuf = pipe.backbuf;
+  uint8_t *outbuf = pipe->backbuf;
 
   // downconversion to low-precision formats:
   if(bpp == 8)
@@ -1018,7 +1200,7 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
       }
       else
       { // !display_byteorder, need to swap:
-        uint8_t *const buf8 = pipe.backbuf;
+        uint8_t *const buf8 = pipe->backbuf;
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
   dt_omp_firstprivate(processed_width, processed_height, buf8) \
@@ -1049,6 +1231,14 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
   }
   // else output float, no further harm done to the pixels :)
 
+  if(lane)
+  {
+    if(lane->pipe_lock) dt_pthread_mutex_unlock(lane->pipe_lock);
+    const double now = dt_get_wtime();
+    lane->busy[DT_IMAGEIO_EXPORT_STAGE_PIPE] += now - stage_start;
+    stage_start = now;
+  }
+
   format_params->width = processed_width;
   format_params->height = processed_height;
 
@@ -1065,22 +1255,28 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
     length = dt_exif_read_blob(&exif_profile, pathname, imgid, sRGB, processed_width, processed_height, 0);
 
     res = format->write_image(format_params, filename, outbuf, icc_type, icc_filename, exif_profile, length, imgid,
-                              num, total, &pipe, export_masks);
+                              num, total, pipe, export_masks);
 
     free(exif_profile);
   }
   else
   {
     res = format->write_image(format_params, filename, outbuf, icc_type, icc_filename, NULL, 0, imgid, num, total,
-                              &pipe, export_masks);
+                              pipe, export_masks);
   }
 
+  if(lane) lane->busy[DT_IMAGEIO_EXPORT_STAGE_ENCODE] += dt_get_wtime() - stage_start;
+
   if(res)
     goto error;
 
-  dt_dev_pixelpipe_cleanup(&pipe);
-  dt_dev_cleanup(&dev);
+  if(!lane)
+  {
+    dt_dev_pixelpipe_cleanup(pipe);
+    dt_dev_cleanup(dev);
+  }
   dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+  dt_free_align(binned);
 
   /* now write xmp into that container, if possible */
   if(copy_metadata && (format->flags(format_params) & FORMAT_FLAGS_SUPPORT_XMP))
@@ -1121,10 +1317,15 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
   return 0; // success
 
 error:
-  dt_dev_pixelpipe_cleanup(&pipe);
+  if(!lane) dt_dev_pixelpipe_cleanup(pipe);
 error_early:
-  dt_dev_cleanup(&dev);
+  // don't carry over whatever state a failed export left behind
+  if(lane)
+    dt_imageio_export_lane_cleanup(lane);
+  else
+    dt_dev_cleanup(dev);
   dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+  dt_free_align(binned);
   return 1;
 }
 
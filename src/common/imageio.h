@@ -88,6 +88,38 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
                                  dt_imageio_module_storage_t *storage, dt_imageio_module_data_t *storage_params,
                                  int num, int total, dt_export_metadata_t *metadata);
 
+// stages of exporting one image. pipe and encode are timed inside dt_imageio_export_with_flags(),
+// store is whatever the storage module does around it.
+typedef enum dt_imageio_export_stage_t
+{
+  DT_IMAGEIO_EXPORT_STAGE_PIPE = 0,
+  DT_IMAGEIO_EXPORT_STAGE_ENCODE,
+  DT_IMAGEIO_EXPORT_STAGE_STORE,
+  DT_IMAGEIO_EXPORT_STAGE_LAST
+} dt_imageio_export_stage_t;
+
+// one thread of a staged export job. all lanes of a job share pipe_lock so that only one of them
+// runs a pixelpipe at a time, while the others encode or store their previous image.
+typedef struct dt_imageio_export_lane_t
+{
+  dt_pthread_mutex_t *pipe_lock;              // NULL: no gating
+  double busy[DT_IMAGEIO_EXPORT_STAGE_LAST];  // seconds spent in each stage
+  double pipe_wait;                           // seconds spent waiting for pipe_lock
+  double setup;                               // seconds spent loading history and setting up the pipe
+  int images;
+  int reused;                                 // exports which got the develop and pipe of the previous one
+  struct dt_develop_t *dev;                   // kept from one export to the next, NULL until the first
+  struct dt_dev_pixelpipe_t *pipe;
+  gchar *style;                               // export style, and its items ready to be merged
+  GList *style_items;
+} dt_imageio_export_lane_t;
+
+// attach a lane to the calling thread, exports run by this thread account to it. NULL detaches.
+void dt_imageio_export_set_lane(dt_imageio_export_lane_t *lane);
+dt_imageio_export_lane_t *dt_imageio_export_get_lane();
+// free the develop, pipe and style kept by the lane
+void dt_imageio_export_lane_cleanup(dt_imageio_export_lane_t *lane);
+
 size_t dt_imageio_write_pos(int i, int j, int wd, int ht, float fwd, float fht,
                             dt_image_orientation_t orientation);
 
@@ -105,6 +137,12 @@ void dt_imageio_flip_buffers_ui8_to_float(float *out, const uint8_t *in, const f
 // allocate buffer and return 0 on success along with largest jpg thumbnail from raw.
 int dt_imageio_large_thumbnail(const char *filename, uint8_t **buffer, int32_t *width, int32_t *height,
                                dt_colorspaces_color_profile_type_t *color_space);
+// same, but a jpeg thumbnail is decoded at the smallest dct scale still covering a fit into
+// fit_width x fit_height, 0 for full size. the box is taken as is, without the image orientation,
+// so callers which flip the thumbnail afterwards have to swap it for ORIENTATION_SWAP_XY.
+int dt_imageio_large_thumbnail_ext(const char *filename, uint8_t **buffer, int32_t *width, int32_t *height,
+                                   dt_colorspaces_color_profile_type_t *color_space, const int fit_width,
+                                   const int fit_height);
 
 // lookup maker and model, dispatch lookup to rawspeed or libraw
 gboolean dt_imageio_lookup_makermodel(const char *maker, const char *model,
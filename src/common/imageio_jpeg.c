@@ -154,11 +154,41 @@ int dt_imageio_jpeg_decompress_header(const void *in, size_t length, dt_imageio_
   return 0;
 }
 
+int dt_imageio_jpeg_set_scale(dt_imageio_jpeg_t *jpg, const int width, const int height)
+{
+  if(width <= 0 || height <= 0) return 1;
+
+  // the largest dct scale down of 1/2, 1/4 or 1/8 which still covers a box fit into width x height
+  unsigned int denom = 1;
+  for(unsigned int d = 8; d > 1 && denom == 1; d /= 2)
+    if(jpg->dinfo.image_width >= d * width || jpg->dinfo.image_height >= d * height) denom = d;
+  if(denom == 1) return 1;
+
+  struct dt_imageio_jpeg_error_mgr jerr;
+  jpg->dinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit = dt_imageio_jpeg_error_exit;
+  if(setjmp(jerr.setjmp_buffer))
+  {
+    // keep decoding at full size
+    jpg->dinfo.scale_denom = 1;
+    jpg->width = jpg->dinfo.image_width;
+    jpg->height = jpg->dinfo.image_height;
+    return 1;
+  }
+
+  jpg->dinfo.scale_num = 1;
+  jpg->dinfo.scale_denom = denom;
+  jpeg_calc_output_dimensions(&(jpg->dinfo));
+  jpg->width = jpg->dinfo.output_width;
+  jpg->height = jpg->dinfo.output_height;
+  return denom;
+}
+
 #ifdef JCS_EXTENSIONS
 static int decompress_jsc(dt_imageio_jpeg_t *jpg, uint8_t *out)
 {
   uint8_t *tmp = out;
-  while(jpg->dinfo.output_scanline < jpg->dinfo.image_height)
+  while(jpg->dinfo.output_scanline < jpg->dinfo.output_height)
   {
     if(jpeg_read_scanlines(&(jpg->dinfo), &tmp, 1) != 1)
     {
@@ -175,14 +205,14 @@ static int decompress_plain(dt_imageio_jpeg_t *jpg, uint8_t *out)
   JSAMPROW row_pointer[1];
   row_pointer[0] = (uint8_t *)dt_alloc_align(64, (size_t)jpg->dinfo.output_width * jpg->dinfo.num_components);
   uint8_t *tmp = out;
-  while(jpg->dinfo.output_scanline < jpg->dinfo.image_height)
+  while(jpg->dinfo.output_scanline < jpg->dinfo.output_height)
   {
     if(jpeg_read_scanlines(&(jpg->dinfo), row_pointer, 1) != 1)
     {
       dt_free_align(row_pointer[0]);
       return 1;
     }
-    for(unsigned int i = 0; i < jpg->dinfo.image_width; i++)
+    for(unsigned int i = 0; i < jpg->dinfo.output_width; i++)
     {
       for(int k = 0; k < 3; k++) tmp[4 * i + k] = row_pointer[0][3 * i + k];
     }
@@ -597,7 +627,7 @@ int dt_imageio_jpeg_read_header(const char *filename, dt_imageio_jpeg_t *jpg)
 static int read_jsc(dt_imageio_jpeg_t *jpg, uint8_t *out)
 {
   uint8_t *tmp = out;
-  while(jpg->dinfo.output_scanline < jpg->dinfo.image_height)
+  while(jpg->dinfo.output_scanline < jpg->dinfo.output_height)
   {
     if(jpeg_read_scanlines(&(jpg->dinfo), &tmp, 1) != 1)
     {
@@ -614,7 +644,7 @@ static int read_plain(dt_imageio_jpeg_t *jpg, uint8_t *out)
   JSAMPROW row_pointer[1];
   row_pointer[0] = (uint8_t *)dt_alloc_align(64, (size_t)jpg->dinfo.output_width * jpg->dinfo.num_components);
   uint8_t *tmp = out;
-  while(jpg->dinfo.output_scanline < jpg->dinfo.image_height)
+  while(jpg->dinfo.output_scanline < jpg->dinfo.output_height)
   {
     if(jpeg_read_scanlines(&(jpg->dinfo), row_pointer, 1) != 1)
     {
@@ -623,7 +653,7 @@ static int read_plain(dt_imageio_jpeg_t *jpg, uint8_t *out)
       fclose(jpg->f);
       return 1;
     }
-    for(unsigned int i = 0; i < jpg->dinfo.image_width; i++)
+    for(unsigned int i = 0; i < jpg->dinfo.output_width; i++)
       for(int k = 0; k < 3; k++) tmp[4 * i + k] = row_pointer[0][3 * i + k];
     tmp += 4 * jpg->width;
   }
@@ -44,6 +44,42 @@ static inline int dl(int size, const int level)
   return size;
 }
 
+// round up buffer sizes so that all pyramid levels carved from one block stay 64-byte aligned
+static inline size_t ll_align(const size_t size)
+{
+  return (size + 15) & ~(size_t)15;
+}
+
+// number of floats needed to hold levels first..last of a pyramid of the given size
+static inline size_t ll_pyramid_size(
+    const int wd,
+    const int ht,
+    const int first,
+    const int last)
+{
+  size_t size = 0;
+  for(int l=first;l<=last;l++)
+    size += ll_align((size_t)dl(wd,l) * dl(ht,l));
+  return size;
+}
+
+// carve levels first..last of a pyramid out of mem, returns the first unused float
+static inline float *ll_pyramid_carve(
+    float *mem,
+    float **pyramid,
+    const int wd,
+    const int ht,
+    const int first,
+    const int last)
+{
+  for(int l=first;l<=last;l++)
+  {
+    pyramid[l] = mem;
+    mem += ll_align((size_t)dl(wd,l) * dl(ht,l));
+  }
+  return mem;
+}
+
 #ifdef DEBUG_DUMP
 static void dump_PFM(const char *filename, const float* out, const uint32_t w, const uint32_t h)
 {
@@ -269,10 +305,11 @@ static inline void gauss_reduce(
   ll_fill_boundary1(coarse, cw, ch);
 }
 
-// allocate output buffer with monochrome brightness channel from input, padded
+// fill output buffer with monochrome brightness channel from input, padded
 // up by max_supp on all four sides, dimensions written to wd2 ht2
 static inline float *ll_pad_input(
     const float *const input,
+    float *const out,
     const int wd,
     const int ht,
     const int max_supp,
@@ -283,7 +320,6 @@ static inline float *ll_pad_input(
   const int stride = 4;
   *wd2 = 2*max_supp + wd;
   *ht2 = 2*max_supp + ht;
-  float *const out = dt_alloc_align_float((size_t) *wd2 * *ht2);
 
   if(b && b->mode == 2)
   { // pad by preview buffer
@@ -560,6 +596,28 @@ void apply_curve(
   pad_by_replication(out, w, h, padding);
 }
 
+void local_laplacian_arena_free(
+    local_laplacian_arena_t *a)
+{
+  if(!a) return;
+  dt_free_align(a->mem);
+  memset(a, 0, sizeof(*a));
+}
+
+// make sure the arena can hold at least size floats. old contents are not preserved.
+static float *ll_arena_reserve(
+    local_laplacian_arena_t *a,
+    const size_t size)
+{
+  if(a->size < size)
+  {
+    dt_free_align(a->mem);
+    a->mem = dt_alloc_align_float(size);
+    a->size = a->mem ? size : 0;
+  }
+  return a->mem;
+}
+
 void local_laplacian_internal(
     const float *const input,   // input buffer in some Labx or yuvx format
     float *const out,           // output buffer with colour
@@ -570,7 +628,8 @@ void local_laplacian_internal(
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
     const int use_sse2,         // flag whether to use SSE version
-    local_laplacian_boundary_t *b)
+    local_laplacian_boundary_t *b,
+    local_laplacian_arena_t *arena)
 {
   if(wd <= 1 || ht <= 1) return;
 
@@ -580,21 +639,57 @@ void local_laplacian_internal(
   if(b && b->mode == 2) // higher number here makes it less prone to aliasing and slower.
     last_level = num_levels > 4 ? 4 : num_levels-1;
   const int max_supp = 1<<last_level;
-  int w, h;
+  const int w = 2*max_supp + wd, h = 2*max_supp + ht;
+
+  // the finest padded input and the output pyramid are passed out for preview
+  // rendering in mode 1, so these can't live in the (reused) arena.
+  const int collect = b && b->mode == 1;
+
+  // we only ever hold three pyramids: the padded input, the output and the one
+  // for the gamma level currently being processed. the output pyramid
+  // doubles as accumulator for the laplacian coefficients of all gamma levels.
+  const size_t arena_size = ll_pyramid_size(w, h, collect ? 1 : 0, last_level)
+                          + (collect ? 0 : ll_pyramid_size(w, h, 0, last_level))
+                          + ll_pyramid_size(w, h, 0, last_level);
+  local_laplacian_arena_t tmp_arena = { 0 };
+  local_laplacian_arena_t *const ar = arena ? arena : &tmp_arena;
+  float *mem = ll_arena_reserve(ar, arena_size);
+  if(!mem)
+  {
+    fprintf(stderr, "[local laplacian] failed to allocate %zu MB working set\n",
+            arena_size * sizeof(float) / (1024 * 1024));
+    memcpy(out, input, sizeof(float) * 4 * wd * ht);
+    return;
+  }
+
   float *padded[max_levels] = {0};
-  if(b && b->mode == 2)
-    padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, b);
+  float *output[max_levels] = {0};
+  float *buf[max_levels] = {0};
+  if(collect)
+  {
+    padded[0] = dt_alloc_align_float((size_t)w * h);
+    for(int l=0;l<=last_level;l++)
+      output[l] = dt_alloc_align_float((size_t)dl(w,l) * dl(h,l));
+    mem = ll_pyramid_carve(mem, padded, w, h, 1, last_level);
+  }
   else
-    padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, 0);
+  {
+    mem = ll_pyramid_carve(mem, padded, w, h, 0, last_level);
+    mem = ll_pyramid_carve(mem, output, w, h, 0, last_level);
+  }
+  mem = ll_pyramid_carve(mem, buf, w, h, 0, last_level);
 
-  // allocate pyramid pointers for padded input
-  for(int l=1;l<=last_level;l++)
-    padded[l] = dt_alloc_align_float((size_t)dl(w,l) * dl(h,l));
+  const size_t working_set = sizeof(float) * (arena_size + (collect ? ll_pyramid_size(w, h, 0, last_level)
+                                                                    + ll_align((size_t)w * h) : 0));
+  ar->peak = MAX(ar->peak, working_set);
+  dt_print(DT_DEBUG_MEMORY, "[local laplacian] %dx%d, %d levels: working set %.1f MB, peak %.1f MB\n",
+           wd, ht, last_level + 1, working_set / (1024.0 * 1024.0), ar->peak / (1024.0 * 1024.0));
 
-  // allocate pyramid pointers for output
-  float *output[max_levels] = {0};
-  for(int l=0;l<=last_level;l++)
-    output[l] = dt_alloc_align_float((size_t)dl(w,l) * dl(h,l));
+  int wd2, ht2;
+  if(b && b->mode == 2)
+    ll_pad_input(input, padded[0], wd, ht, max_supp, &wd2, &ht2, b);
+  else
+    ll_pad_input(input, padded[0], wd, ht, max_supp, &wd2, &ht2, 0);
 
   // create gauss pyramid of padded input, write coarse directly to output
 #if defined(__SSE2__)
@@ -617,10 +712,9 @@ void local_laplacian_internal(
   for(int k=0;k<num_gamma;k++) gamma[k] = (k+.5f)/(float)num_gamma;
   // for(int k=0;k<num_gamma;k++) gamma[k] = k/(num_gamma-1.0f);
 
-  // allocate memory for intermediate laplacian pyramids
-  float *buf[num_gamma][max_levels] = {{0}};
-  for(int k=0;k<num_gamma;k++) for(int l=0;l<=last_level;l++)
-    buf[k][l] = dt_alloc_align_float((size_t)dl(w,l)*dl(h,l));
+  // the finer output levels collect the interpolated laplacian coefficients
+  for(int l=0;l<last_level;l++)
+    memset(output[l], 0, sizeof(float) * dl(w,l) * dl(h,l));
 
   // the paper says remapping only level 3 not 0 does the trick, too
   // (but i really like the additional octave of sharpness we get,
@@ -629,19 +723,50 @@ void local_laplacian_internal(
   { // process images
 #if defined(__SSE2__)
     if(use_sse2)
-      apply_curve_sse2(buf[k][0], padded[0], w, h, max_supp, gamma[k], sigma, shadows, highlights, clarity);
+      apply_curve_sse2(buf[0], padded[0], w, h, max_supp, gamma[k], sigma, shadows, highlights, clarity);
     else // brackets in next line needed for silly gcc warning:
 #endif
-    {apply_curve(buf[k][0], padded[0], w, h, max_supp, gamma[k], sigma, shadows, highlights, clarity);}
+    {apply_curve(buf[0], padded[0], w, h, max_supp, gamma[k], sigma, shadows, highlights, clarity);}
 
     // create gaussian pyramids
     for(int l=1;l<=last_level;l++)
 #if defined(__SSE2__)
       if(use_sse2)
-        gauss_reduce_sse2(buf[k][l-1], buf[k][l], dl(w,l-1), dl(h,l-1));
+        gauss_reduce_sse2(buf[l-1], buf[l], dl(w,l-1), dl(h,l-1));
       else
 #endif
-        gauss_reduce(buf[k][l-1], buf[k][l], dl(w,l-1), dl(h,l-1));
+        gauss_reduce(buf[l-1], buf[l], dl(w,l-1), dl(h,l-1));
+
+    // add this gamma level's share of the laplacian coefficients. every pixel
+    // interpolates between the two gamma levels bracketing its brightness, so
+    // this pyramid can be dropped before the next one is built.
+    for(int l=0;l<last_level;l++)
+    {
+      const int pw = dl(w,l), ph = dl(h,l);
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+      dt_omp_firstprivate(ph, pw, k, l) \
+      shared(buf,output,gamma,padded) \
+      schedule(static) \
+      collapse(2)
+#endif
+      for(int j=0;j<ph;j++) for(int i=0;i<pw;i++)
+      {
+        const float v = padded[l][j*pw+i];
+        int hi = 1;
+        for(;hi<num_gamma-1 && gamma[hi] <= v;hi++);
+        const int lo = hi-1;
+        if(k != lo && k != hi) continue;
+        const float a = CLAMPS((v - gamma[lo])/(gamma[hi]-gamma[lo]), 0.0f, 1.0f);
+        const float weight = k == hi ? a : 1.0f-a;
+        output[l][j*pw+i] += weight * ll_laplacian(buf[l+1], buf[l], i, j, pw, ph);
+        // we could do this to save on memory (no need for finest buf[]).
+        // unfortunately it results in a quite noticeable loss of sharpness, i think
+        // the extra level is worth it.
+        // else if(l == 0) // use finest scale from input to not amplify noise (and use less memory)
+        //   output[l][j*pw+i] += ll_laplacian(padded[l+1], padded[l], i, j, pw, ph);
+      }
+    }
   }
 
   // resample output[last_level] from preview
@@ -706,37 +831,24 @@ void local_laplacian_internal(
   for(int l=last_level-1;l >= 0; l--)
   {
     const int pw = dl(w,l), ph = dl(h,l);
+    const size_t npx = (size_t)pw * ph;
 
-    gauss_expand(output[l+1], output[l], pw, ph);
-    // go through all coefficients in the upsampled gauss buffer:
+    // the gamma pyramid is not needed any more, use it as scratch for the upsampled gauss buffer
+    gauss_expand(output[l+1], buf[l], pw, ph);
+    float *const outl = output[l];
+    const float *const bufl = buf[l];
 #ifdef _OPENMP
-#pragma omp parallel for default(none) \
-    dt_omp_firstprivate(ph, pw) \
-    shared(w,h,buf,output,l,gamma,padded) \
-    schedule(static) \
-    collapse(2)
+#pragma omp parallel for simd default(none) \
+    dt_omp_firstprivate(npx, outl, bufl) \
+    schedule(static)
 #endif
-    for(int j=0;j<ph;j++) for(int i=0;i<pw;i++)
-    {
-      const float v = padded[l][j*pw+i];
-      int hi = 1;
-      for(;hi<num_gamma-1 && gamma[hi] <= v;hi++);
-      int lo = hi-1;
-      const float a = CLAMPS((v - gamma[lo])/(gamma[hi]-gamma[lo]), 0.0f, 1.0f);
-      const float l0 = ll_laplacian(buf[lo][l+1], buf[lo][l], i, j, pw, ph);
-      const float l1 = ll_laplacian(buf[hi][l+1], buf[hi][l], i, j, pw, ph);
-      output[l][j*pw+i] += l0 * (1.0f-a) + l1 * a;
-      // we could do this to save on memory (no need for finest buf[][]).
-      // unfortunately it results in a quite noticeable loss of sharpness, i think
-      // the extra level is worth it.
-      // else if(l == 0) // use finest scale from input to not amplify noise (and use less memory)
-      //   output[l][j*pw+i] += ll_laplacian(padded[l+1], padded[l], i, j, pw, ph);
-    }
+    for(size_t k=0;k<npx;k++)
+      outl[k] += bufl[k];
   }
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(ht, input, max_supp, out, wd) \
-  shared(w,output,buf) \
+  dt_omp_firstprivate(ht, input, max_supp, out, wd, w) \
+  shared(output) \
   schedule(static) \
   collapse(2)
 #endif
@@ -756,13 +868,8 @@ void local_laplacian_internal(
     b->num_levels = num_levels;
     for(int l=0;l<num_levels;l++) b->output[l] = output[l];
   }
-  // free all buffers except the ones passed out for preview rendering
-  for(int l=0;l<max_levels;l++)
-  {
-    if(!b || b->mode != 1 || l)   dt_free_align(padded[l]);
-    if(!b || b->mode != 1)        dt_free_align(output[l]);
-    for(int k=0; k<num_gamma;k++) dt_free_align(buf[k][l]);
-  }
+  // everything else lives in the arena, which is kept by the caller
+  local_laplacian_arena_free(&tmp_arena);
 }
 
 
@@ -777,7 +884,7 @@ size_t local_laplacian_memory_use(const int width,     // width of input image
   size_t memory_use = 0;
 
   for(int l=0;l<num_levels;l++)
-    memory_use += sizeof(float) * (2 + num_gamma) * dl(paddwd, l) * dl(paddht, l);
+    memory_use += sizeof(float) * 3 * dl(paddwd, l) * dl(paddht, l);
 
   return memory_use;
 }
@@ -45,6 +45,19 @@ void local_laplacian_boundary_free(
   memset(b, 0, sizeof(*b));
 }
 
+// scratch memory holding all pyramids of one call, kept alive between
+// calls (e.g. per pixelpipe piece) to avoid reallocating it for every run
+typedef struct local_laplacian_arena_t
+{
+  float *mem;              // one block carved into the pyramids (allocated via dt_alloc_align)
+  size_t size;             // capacity of mem in floats
+  size_t peak;             // peak working set in bytes seen by this arena
+}
+local_laplacian_arena_t;
+
+void local_laplacian_arena_free(
+    local_laplacian_arena_t *a);
+
 void local_laplacian_internal(
     const float *const input,   // input buffer in some Labx or yuvx format
     float *const out,           // output buffer with colour
@@ -56,7 +69,9 @@ void local_laplacian_internal(
     const float clarity,        // user param: increase clarity/local contrast
     const int use_sse2,         // switch on sse optimised version, if available
     // the following is just needed for clipped roi with boundary conditions from coarse buffer (can be 0)
-    local_laplacian_boundary_t *b);
+    local_laplacian_boundary_t *b,
+    // scratch memory to be reused across calls (can be 0)
+    local_laplacian_arena_t *arena);
 
 void local_laplacian(
     const float *const input,   // input buffer in some Labx or yuvx format
@@ -67,9 +82,10 @@ void local_laplacian(
     const float shadows,        // user param: lift shadows
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
-    local_laplacian_boundary_t *b) // can be 0
+    local_laplacian_boundary_t *b, // can be 0
+    local_laplacian_arena_t *arena) // can be 0
 {
-  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, 0, b);
+  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, 0, b, arena);
 }
 
 size_t local_laplacian_memory_use(const int width,      // width of input image
@@ -90,8 +106,9 @@ void local_laplacian_sse2(
     const float shadows,        // user param: lift shadows
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
-    local_laplacian_boundary_t *b) // can be 0
+    local_laplacian_boundary_t *b, // can be 0
+    local_laplacian_arena_t *arena) // can be 0
 {
-  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, 1, b);
+  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, 1, b, arena);
 }
 #endif
@@ -378,7 +378,8 @@ GList *dt_map_location_find_locations(const guint imgid)
   GList *tags = NULL;
   sqlite3_stmt *stmt;
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT l.tagid, l.type, i.longitude, i.latitude FROM main.images AS i"
+                              "SELECT l.tagid, l.type, i.longitude, i.latitude, l.polygons"
+                              "  FROM main.images AS i"
                               "  JOIN data.locations AS l"
                               "  ON (l.type = ?2"
                               "      AND ((((i.longitude-l.longitude)*(i.longitude-l.longitude))/"
@@ -403,24 +404,13 @@ GList *dt_map_location_find_locations(const guint imgid)
     const int id = sqlite3_column_int(stmt, 0);
     if(sqlite3_column_int(stmt, 1) == MAP_LOCATION_SHAPE_POLYGONS)
     {
+      // the bounding box of the polygon has already been checked by the query
       dt_geo_map_display_point_t pt;
       pt.lon = sqlite3_column_double(stmt, 2);
       pt.lat = sqlite3_column_double(stmt, 3);
-      sqlite3_stmt *stmt2;
-      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                  "SELECT polygons FROM data.locations "
-                                  " WHERE tagid = ?1",
-                                  -1, &stmt2, NULL);
-      DT_DEBUG_SQLITE3_BIND_INT(stmt2, 1, id);
-      if(sqlite3_step(stmt2) == SQLITE_ROW)
-      {
-        const gint plg_pts = sqlite3_column_bytes(stmt2, 0) / sizeof(dt_geo_map_display_point_t);
-        if(_is_point_in_polygon(&pt, plg_pts, sqlite3_column_blob(stmt2, 0)))
-        {
-          tags = g_list_prepend(tags, GINT_TO_POINTER(id));
-        }
-      }
-      sqlite3_finalize(stmt2);
+      const gint plg_pts = sqlite3_column_bytes(stmt, 4) / sizeof(dt_geo_map_display_point_t);
+      if(plg_pts && _is_point_in_polygon(&pt, plg_pts, sqlite3_column_blob(stmt, 4)))
+        tags = g_list_prepend(tags, GINT_TO_POINTER(id));
     }
     else
     {
@@ -435,58 +425,41 @@ GList *dt_map_location_find_locations(const guint imgid)
 GList *_map_location_find_images(dt_location_draw_t *ld)
 {
   GList *imgs = NULL;
+  const dt_map_location_data_t *g = &ld->data;
+
+  // the bounding box of the location (or of the polygon) is bound as constants,
+  // the latitude range is then served by images_latlong_index
   sqlite3_stmt *stmt;
-  if(ld->data.shape == MAP_LOCATION_SHAPE_ELLIPSE)
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "SELECT i.id FROM main.images AS i"
-                                "  JOIN data.locations AS l"
-                                "  ON (l.type = ?2"
-                                "      AND ((((i.longitude-l.longitude)*(i.longitude-l.longitude))/"
-                                              "(delta1*delta1) +"
-                                "            ((i.latitude-l.latitude)*(i.latitude-l.latitude))/"
-                                              "(delta2*delta2)) <= 1))"
-                                "  WHERE l.tagid = ?1 ",
-                                -1, &stmt, NULL);
-  else if(ld->data.shape == MAP_LOCATION_SHAPE_RECTANGLE)
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "SELECT i.id FROM main.images AS i"
-                                "  JOIN data.locations AS l"
-                                "  ON (l.type = ?2"
-                                "       AND i.longitude>=(l.longitude-delta1)"
-                                "       AND i.longitude<=(l.longitude+delta1)"
-                                "       AND i.latitude>=(l.latitude-delta2)"
-                                "       AND i.latitude<=(l.latitude+delta2))"
-                                "  WHERE l.tagid = ?1 ",
-                                -1, &stmt, NULL);
-  else // MAP_LOCATION_SHAPE_POLYGONS
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "SELECT i.id, i.longitude, i.latitude FROM main.images AS i"
-                                "  JOIN data.locations AS l"
-                                "  ON (l.type = ?2"
-                                "       AND i.longitude>=(l.longitude-delta1)"
-                                "       AND i.longitude<=(l.longitude+delta1)"
-                                "       AND i.latitude>=(l.latitude-delta2)"
-                                "       AND i.latitude<=(l.latitude+delta2))"
-                                "  WHERE l.tagid = ?1 ",
-                                -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, ld->id);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, ld->data.shape);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT id, longitude, latitude FROM main.images"
+                              "  WHERE latitude >= ?1 AND latitude <= ?2"
+                              "    AND longitude >= ?3 AND longitude <= ?4",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_DOUBLE(stmt, 1, g->lat - g->delta2);
+  DT_DEBUG_SQLITE3_BIND_DOUBLE(stmt, 2, g->lat + g->delta2);
+  DT_DEBUG_SQLITE3_BIND_DOUBLE(stmt, 3, g->lon - g->delta1);
+  DT_DEBUG_SQLITE3_BIND_DOUBLE(stmt, 4, g->lon + g->delta1);
 
-  int i = 0;
   while(sqlite3_step(stmt) == SQLITE_ROW)
   {
     const int id = sqlite3_column_int(stmt, 0);
-    if(ld->data.shape == MAP_LOCATION_SHAPE_POLYGONS)
+    const double lon = sqlite3_column_double(stmt, 1);
+    const double lat = sqlite3_column_double(stmt, 2);
+    gboolean inside = TRUE;
+    if(g->shape == MAP_LOCATION_SHAPE_ELLIPSE)
+    {
+      inside = ((lon - g->lon) * (lon - g->lon) / (g->delta1 * g->delta1)
+                + (lat - g->lat) * (lat - g->lat) / (g->delta2 * g->delta2)) <= 1.0;
+    }
+    else if(g->shape == MAP_LOCATION_SHAPE_POLYGONS)
     {
       dt_geo_map_display_point_t pt;
-      pt.lon = sqlite3_column_double(stmt, 1);
-      pt.lat = sqlite3_column_double(stmt, 2);
-      if(_is_point_in_polygon(&pt, ld->data.plg_pts, ld->data.polygons->data))
-        imgs = g_list_prepend(imgs, GINT_TO_POINTER(id));
+      pt.lon = lon;
+      pt.lat = lat;
+      inside = g->polygons && _is_point_in_polygon(&pt, g->plg_pts, g->polygons->data);
     }
-    else
+    if(inside)
       imgs = g_list_prepend(imgs, GINT_TO_POINTER(id));
-    i++;
   }
   sqlite3_finalize(stmt);
   return imgs;
@@ -544,11 +517,18 @@ gboolean dt_map_location_update_images(dt_location_draw_t *ld)
   // find images in that location
   GList *new_imgs = _map_location_find_images(ld);
 
+  GHashTable *old_set = g_hash_table_new(NULL, NULL);
+  for(GList *img = imgs; img; img = g_list_next(img))
+    g_hash_table_add(old_set, img->data);
+  GHashTable *new_set = g_hash_table_new(NULL, NULL);
+  for(GList *img = new_imgs; img; img = g_list_next(img))
+    g_hash_table_add(new_set, img->data);
+
   gboolean res = FALSE;
   // detach images which are not in location anymore
   for(GList *img = imgs; img; img = g_list_next(img))
   {
-    if(!g_list_find(new_imgs, img->data))
+    if(!g_hash_table_contains(new_set, img->data))
     {
       dt_tag_detach(ld->id, GPOINTER_TO_INT(img->data), FALSE, FALSE);
       res = TRUE;
@@ -558,17 +538,115 @@ gboolean dt_map_location_update_images(dt_location_draw_t *ld)
   // add new images to location
   for(GList *img = new_imgs; img; img = g_list_next(img))
   {
-    if(!g_list_find(imgs, img->data))
+    if(!g_hash_table_contains(old_set, img->data))
     {
       dt_tag_attach(ld->id, GPOINTER_TO_INT(img->data), FALSE, FALSE);
       res = TRUE;
     }
   }
+  g_hash_table_destroy(old_set);
+  g_hash_table_destroy(new_set);
   g_list_free(new_imgs);
   g_list_free(imgs);
   return res;
 }
 
+typedef struct _location_index_t
+{
+  guint id;
+  int shape;
+  double lon, lat, delta1, delta2;
+  dt_geo_map_display_point_t *plg;
+  int plg_pts;
+} _location_index_t;
+
+// update the locations of a list of images. the locations are loaded once and
+// each image is checked against their bounding box before the shape itself
+void dt_map_location_update_locations_list(const GList *imgs)
+{
+  if(!imgs) return;
+
+  const double start = dt_get_wtime();
+  GArray *locs = g_array_new(FALSE, FALSE, sizeof(_location_index_t));
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT tagid, type, longitude, latitude, delta1, delta2, polygons"
+                              "  FROM data.locations"
+                              "  WHERE longitude IS NOT NULL AND latitude IS NOT NULL",
+                              -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    _location_index_t l = { 0 };
+    l.id = sqlite3_column_int(stmt, 0);
+    l.shape = sqlite3_column_int(stmt, 1);
+    l.lon = sqlite3_column_double(stmt, 2);
+    l.lat = sqlite3_column_double(stmt, 3);
+    l.delta1 = sqlite3_column_double(stmt, 4);
+    l.delta2 = sqlite3_column_double(stmt, 5);
+    if(l.shape == MAP_LOCATION_SHAPE_POLYGONS)
+    {
+      const int size = sqlite3_column_bytes(stmt, 6);
+      l.plg_pts = size / sizeof(dt_geo_map_display_point_t);
+      if(!l.plg_pts) continue;
+      l.plg = malloc(size);
+      memcpy(l.plg, sqlite3_column_blob(stmt, 6), size);
+    }
+    g_array_append_val(locs, l);
+  }
+  sqlite3_finalize(stmt);
+
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT longitude, latitude FROM main.images"
+                              "  WHERE id = ?1 AND longitude IS NOT NULL AND latitude IS NOT NULL",
+                              -1, &stmt, NULL);
+  int nb_imgs = 0;
+  for(const GList *img = imgs; img; img = g_list_next(img))
+  {
+    const int imgid = GPOINTER_TO_INT(img->data);
+    GList *tags = NULL;
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+    if(sqlite3_step(stmt) == SQLITE_ROW)
+    {
+      const double lon = sqlite3_column_double(stmt, 0);
+      const double lat = sqlite3_column_double(stmt, 1);
+      for(guint k = 0; k < locs->len; k++)
+      {
+        const _location_index_t *l = &g_array_index(locs, _location_index_t, k);
+        if(lon < l->lon - l->delta1 || lon > l->lon + l->delta1
+           || lat < l->lat - l->delta2 || lat > l->lat + l->delta2)
+          continue;
+        gboolean inside = TRUE;
+        if(l->shape == MAP_LOCATION_SHAPE_ELLIPSE)
+          inside = ((lon - l->lon) * (lon - l->lon) / (l->delta1 * l->delta1)
+                    + (lat - l->lat) * (lat - l->lat) / (l->delta2 * l->delta2)) <= 1.0;
+        else if(l->shape == MAP_LOCATION_SHAPE_POLYGONS)
+        {
+          dt_geo_map_display_point_t pt;
+          pt.lon = lon;
+          pt.lat = lat;
+          inside = _is_point_in_polygon(&pt, l->plg_pts, l->plg);
+        }
+        if(inside)
+          tags = g_list_prepend(tags, GINT_TO_POINTER(l->id));
+      }
+    }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
+    dt_map_location_update_locations(imgid, tags);
+    g_list_free(tags);
+    nb_imgs++;
+  }
+  sqlite3_finalize(stmt);
+
+  dt_print(DT_DEBUG_PERF, "[map_locations] %d images checked against %u locations in %.3f secs\n",
+           nb_imgs, locs->len, dt_get_wtime() - start);
+
+  for(guint k = 0; k < locs->len; k++)
+    free(g_array_index(locs, _location_index_t, k).plg);
+  g_array_free(locs, TRUE);
+}
+
 // return root tag for location geotagging
 const char *dt_map_location_data_tag_root()
 {
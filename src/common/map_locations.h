@@ -105,6 +105,9 @@ void dt_map_location_update_locations(const guint imgid, const GList *tags);
 // update location's images - remove old ones and add new ones
 gboolean dt_map_location_update_images(dt_location_draw_t *ld);
 
+// find and update the locations of a list of images
+void dt_map_location_update_locations_list(const GList *imgs);
+
 // return root tag for location geotagging
 const char *dt_map_location_data_tag_root();
 
@@ -61,7 +61,8 @@ typedef enum dt_mipmap_buffer_dsc_flags
 {
   DT_MIPMAP_BUFFER_DSC_FLAG_NONE = 0,
   DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE = 1 << 0,
-  DT_MIPMAP_BUFFER_DSC_FLAG_INVALIDATE = 1 << 1
+  DT_MIPMAP_BUFFER_DSC_FLAG_INVALIDATE = 1 << 1,
+  DT_MIPMAP_BUFFER_DSC_FLAG_PREVIEW = 1 << 2 // made from the embedded preview, waiting to be refined
 } dt_mipmap_buffer_dsc_flags;
 
 // the embedded Exif data to tag thumbnails as sRGB or AdobeRGB
@@ -241,7 +242,8 @@ static void _init_f(dt_mipmap_buffer_t *mipmap_buf, float *buf, uint32_t *width,
                     const uint32_t imgid);
 static void _init_8(uint8_t *buf, uint32_t *width, uint32_t *height, float *iscale,
                     dt_colorspaces_color_profile_type_t *color_space, const uint32_t imgid,
-                    const dt_mipmap_size_t size);
+                    const dt_mipmap_size_t size, gboolean *preview_tier);
+static void _refine_queue(dt_mipmap_cache_t *cache, const uint32_t imgid, const dt_mipmap_size_t mip);
 
 // callback for the imageio core to allocate memory.
 // only needed for _F and _FULL buffers, as they change size
@@ -282,6 +284,9 @@ void *dt_mipmap_cache_alloc(dt_mipmap_buffer_t *buf, const dt_image_t *img)
 
     // set buffer size only if we're making it larger.
     dsc = (struct dt_mipmap_buffer_dsc *)entry->data;
+
+    // the full buffer quota is in bytes
+    dt_cache_set_cost(&darktable.mipmap_cache->mip_full.cache, entry, buffer_size);
   }
 
   dsc->size = buffer_size;
@@ -307,6 +312,84 @@ void *dt_mipmap_cache_alloc(dt_mipmap_buffer_t *buf, const dt_image_t *img)
   return dsc + 1;
 }
 
+// decode the disk cache jpeg of mip k into the buffer of mip (k >= mip) of entry
+static int _load_from_disk_cache(dt_mipmap_cache_t *cache, dt_cache_entry_t *entry, const dt_mipmap_size_t mip,
+                                 const dt_mipmap_size_t k)
+{
+  struct dt_mipmap_buffer_dsc *dsc = (struct dt_mipmap_buffer_dsc *)entry->data;
+  const uint32_t imgid = get_imgid(entry->key);
+  int loaded = 0;
+
+  char filename[PATH_MAX] = {0};
+  snprintf(filename, sizeof(filename), "%s.d/%d/%" PRIu32 ".jpg", cache->cachedir, (int)k, imgid);
+  FILE *f = g_fopen(filename, "rb");
+  if(!f) return 0;
+
+  uint8_t *blob = 0;
+  uint8_t *tmp = 0;
+  fseek(f, 0, SEEK_END);
+  const long len = ftell(f);
+  if(len <= 0) goto read_error; // coverity madness
+  blob = (uint8_t *)dt_alloc_align(64, len);
+  if(!blob) goto read_error;
+  fseek(f, 0, SEEK_SET);
+  const int rd = fread(blob, sizeof(uint8_t), len, f);
+  if(rd != len) goto read_error;
+  dt_colorspaces_color_profile_type_t color_space;
+  dt_imageio_jpeg_t jpg;
+  if(dt_imageio_jpeg_decompress_header(blob, len, &jpg)
+     || (jpg.width > cache->max_width[k] || jpg.height > cache->max_height[k])
+     || ((color_space = dt_imageio_jpeg_read_color_space(&jpg)) == DT_COLORSPACE_NONE)) // pointless test to keep it in the if clause
+  {
+    fprintf(stderr, "[mipmap_cache] failed to decompress thumbnail for image %" PRIu32 " from `%s'!\n", imgid,
+            filename);
+    goto read_error;
+  }
+
+  if(k == mip)
+  {
+    if(dt_imageio_jpeg_decompress(&jpg, entry->data + sizeof(*dsc)))
+    {
+      fprintf(stderr, "[mipmap_cache] failed to decompress thumbnail for image %" PRIu32 " from `%s'!\n", imgid,
+              filename);
+      goto read_error;
+    }
+    dsc->width = jpg.width;
+    dsc->height = jpg.height;
+    dt_print(DT_DEBUG_CACHE, "[mipmap_cache] grab mip %d for image %" PRIu32 " from disk cache\n", mip, imgid);
+  }
+  else
+  {
+    const int denom = dt_imageio_jpeg_set_scale(&jpg, cache->max_width[mip], cache->max_height[mip]);
+    tmp = (uint8_t *)dt_alloc_align(64, sizeof(uint8_t) * 4 * jpg.width * jpg.height);
+    if(!tmp || dt_imageio_jpeg_decompress(&jpg, tmp))
+    {
+      fprintf(stderr, "[mipmap_cache] failed to decompress thumbnail for image %" PRIu32 " from `%s'!\n", imgid,
+              filename);
+      goto read_error;
+    }
+    uint32_t width = 0, height = 0;
+    dt_iop_flip_and_zoom_8(tmp, jpg.width, jpg.height, (uint8_t *)(dsc + 1), cache->max_width[mip],
+                           cache->max_height[mip], ORIENTATION_NONE, &width, &height);
+    dsc->width = width;
+    dsc->height = height;
+    dt_print(DT_DEBUG_CACHE, "[mipmap_cache] grab mip %d for image %" PRIu32 " from disk cache of mip %d at 1/%d\n",
+             mip, imgid, k, denom);
+  }
+  dsc->iscale = 1.0f;
+  dsc->color_space = color_space;
+  loaded = 1;
+  if(0)
+  {
+read_error:
+    g_unlink(filename);
+  }
+  dt_free_align(tmp);
+  dt_free_align(blob);
+  fclose(f);
+  return loaded;
+}
+
 // callback for the cache backend to initialize payload pointers
 void dt_mipmap_cache_allocate_dynamic(void *data, dt_cache_entry_t *entry)
 {
@@ -367,53 +450,16 @@ void dt_mipmap_cache_allocate_dynamic(void *data, dt_cache_entry_t *entry)
   assert(dsc->size >= sizeof(*dsc));
 
   int loaded_from_disk = 0;
-  if(mip < DT_MIPMAP_F)
+  if(mip < DT_MIPMAP_F && cache->cachedir[0])
   {
-    if(cache->cachedir[0] && ((dt_conf_get_bool("cache_disk_backend") && mip < DT_MIPMAP_8)
-                              || (dt_conf_get_bool("cache_disk_backend_full") && mip == DT_MIPMAP_8)))
+    // try and load from disk, if successful set flag. a mip which is not there yet is decoded from
+    // the next larger one on disk, at the dct scale which still covers it.
+    const gboolean disk = dt_conf_get_bool("cache_disk_backend");
+    const gboolean disk_full = dt_conf_get_bool("cache_disk_backend_full");
+    for(dt_mipmap_size_t k = mip; k <= DT_MIPMAP_8 && !loaded_from_disk; k++)
     {
-      // try and load from disk, if successful set flag
-      char filename[PATH_MAX] = {0};
-      snprintf(filename, sizeof(filename), "%s.d/%d/%" PRIu32 ".jpg", cache->cachedir, (int)mip,
-               get_imgid(entry->key));
-      FILE *f = g_fopen(filename, "rb");
-      if(f)
-      {
-        uint8_t *blob = 0;
-        fseek(f, 0, SEEK_END);
-        const long len = ftell(f);
-        if(len <= 0) goto read_error; // coverity madness
-        blob = (uint8_t *)dt_alloc_align(64, len);
-        if(!blob) goto read_error;
-        fseek(f, 0, SEEK_SET);
-        const int rd = fread(blob, sizeof(uint8_t), len, f);
-        if(rd != len) goto read_error;
-        dt_colorspaces_color_profile_type_t color_space;
-        dt_imageio_jpeg_t jpg;
-        if(dt_imageio_jpeg_decompress_header(blob, len, &jpg)
-           || (jpg.width > cache->max_width[mip] || jpg.height > cache->max_height[mip])
-           || ((color_space = dt_imageio_jpeg_read_color_space(&jpg)) == DT_COLORSPACE_NONE) // pointless test to keep it in the if clause
-           || dt_imageio_jpeg_decompress(&jpg, entry->data + sizeof(*dsc)))
-        {
-          fprintf(stderr, "[mipmap_cache] failed to decompress thumbnail for image %" PRIu32 " from `%s'!\n",
-                  get_imgid(entry->key), filename);
-          goto read_error;
-        }
-        dt_print(DT_DEBUG_CACHE, "[mipmap_cache] grab mip %d for image %" PRIu32 " from disk cache\n", mip,
-                 get_imgid(entry->key));
-        dsc->width = jpg.width;
-        dsc->height = jpg.height;
-        dsc->iscale = 1.0f;
-        dsc->color_space = color_space;
-        loaded_from_disk = 1;
-        if(0)
-        {
-read_error:
-          g_unlink(filename);
-        }
-        dt_free_align(blob);
-        fclose(f);
-      }
+      if(!((disk && k < DT_MIPMAP_8) || (disk_full && k == DT_MIPMAP_8))) continue;
+      loaded_from_disk = _load_from_disk_cache(cache, entry, mip, k);
     }
   }
 
@@ -421,9 +467,11 @@ read_error:
     dsc->flags = DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE;
   else dsc->flags = 0;
 
-  // cost is just flat one for the buffer, as the buffers might have different sizes,
-  // to make sure quota is meaningful.
-  if(mip >= DT_MIPMAP_F)
+  // cost is just flat one for the float buffer, as the buffers might have different sizes,
+  // to make sure quota is meaningful. full buffers are accounted in bytes once allocated.
+  if(mip == DT_MIPMAP_FULL)
+    entry->cost = entry->data_size;
+  else if(mip == DT_MIPMAP_F)
     entry->cost = 1;
   else if(mip == DT_MIPMAP_8)
     entry->cost = entry->data_size;
@@ -446,10 +494,224 @@ static void dt_mipmap_cache_unlink_ondisk_thumbnail(void *data, uint32_t imgid,
   }
 }
 
+// state of a pending prefetch: the generation it was queued in, and whether it's loaded already
+#define PREFETCH_STATE(generation, loaded) GINT_TO_POINTER(((generation) << 1) | (loaded))
+#define PREFETCH_GENERATION(state) (GPOINTER_TO_INT(state) >> 1)
+#define PREFETCH_LOADED(state) (GPOINTER_TO_INT(state) & 1)
+
+// drop the pending prefetch of key, if any. called with the prefetch lock held.
+static gboolean _prefetch_remove(dt_mipmap_cache_t *cache, const uint32_t key, gpointer *state)
+{
+  dt_mipmap_prefetch_t *pf = &cache->prefetch;
+  gpointer orig_key;
+  if(!g_hash_table_lookup_extended(pf->pending, GUINT_TO_POINTER(key), &orig_key, state)) return FALSE;
+  g_hash_table_remove(pf->pending, GUINT_TO_POINTER(key));
+  pf->pending_bytes -= MIN(pf->pending_bytes, cache->buffer_size[get_size(key)]);
+  return TRUE;
+}
+
+// a thumbnail has been requested for display: account for a prefetch of it
+static void _prefetch_consume(dt_mipmap_cache_t *cache, const uint32_t key)
+{
+  dt_mipmap_prefetch_t *pf = &cache->prefetch;
+  if(!pf->pending) return;
+  dt_pthread_mutex_lock(&pf->lock);
+  gpointer state;
+  if(_prefetch_remove(cache, key, &state))
+  {
+    if(PREFETCH_LOADED(state))
+      pf->stats_hits++;
+    else
+      pf->stats_late++;
+  }
+  dt_pthread_mutex_unlock(&pf->lock);
+}
+
+// one job per prefetch request, the images are loaded in the order given, nearest first
+typedef struct _prefetch_job_t
+{
+  dt_mipmap_size_t mip;
+  int generation;
+  int count;
+  int32_t *imgids;
+} _prefetch_job_t;
+
+// load one image of the job, returns FALSE once the job has been cancelled by a later request
+static gboolean _prefetch_one(dt_mipmap_cache_t *cache, const _prefetch_job_t *params, const int32_t imgid)
+{
+  dt_mipmap_prefetch_t *pf = &cache->prefetch;
+  const uint32_t key = get_key(imgid, params->mip);
+
+  dt_pthread_mutex_lock(&pf->lock);
+  if(params->generation != pf->generation)
+  {
+    dt_pthread_mutex_unlock(&pf->lock);
+    return FALSE;
+  }
+  gpointer state = NULL;
+  // requested meanwhile, or queued again by a later call which will take care of it
+  const gboolean run = g_hash_table_lookup_extended(pf->pending, GUINT_TO_POINTER(key), NULL, &state)
+                       && PREFETCH_GENERATION(state) == params->generation && !PREFETCH_LOADED(state);
+  dt_pthread_mutex_unlock(&pf->lock);
+  if(!run) return TRUE;
+
+  dt_mipmap_buffer_t buf;
+  dt_mipmap_cache_get(cache, &buf, imgid, params->mip, DT_MIPMAP_TESTLOCK, 'r');
+  const gboolean cached = buf.buf != NULL;
+  if(cached)
+    dt_mipmap_cache_release(cache, &buf);
+  else
+  {
+    dt_mipmap_cache_get(cache, &buf, imgid, params->mip, DT_MIPMAP_BLOCKING, 'r');
+    dt_mipmap_cache_release(cache, &buf);
+  }
+
+  dt_pthread_mutex_lock(&pf->lock);
+  if(g_hash_table_lookup_extended(pf->pending, GUINT_TO_POINTER(key), NULL, &state)
+     && PREFETCH_GENERATION(state) == params->generation)
+  {
+    if(cached)
+      // it was there already, nothing to account for
+      _prefetch_remove(cache, key, &state);
+    else
+    {
+      g_hash_table_insert(pf->pending, GUINT_TO_POINTER(key), PREFETCH_STATE(params->generation, 1));
+      pf->stats_loaded++;
+    }
+  }
+  dt_pthread_mutex_unlock(&pf->lock);
+  return TRUE;
+}
+
+static int32_t _prefetch_job_run(dt_job_t *job)
+{
+  _prefetch_job_t *params = dt_control_job_get_params(job);
+  for(int k = 0; k < params->count; k++)
+    if(!_prefetch_one(darktable.mipmap_cache, params, params->imgids[k])) break;
+  return 0;
+}
+
+// also called for a job which never ran: whatever it didn't load doesn't count against the budget anymore
+static void _prefetch_job_free(void *p)
+{
+  _prefetch_job_t *params = (_prefetch_job_t *)p;
+  dt_mipmap_cache_t *cache = darktable.mipmap_cache;
+  dt_mipmap_prefetch_t *pf = &cache->prefetch;
+
+  dt_pthread_mutex_lock(&pf->lock);
+  for(int k = 0; k < params->count; k++)
+  {
+    const uint32_t key = get_key(params->imgids[k], params->mip);
+    gpointer state = NULL;
+    if(g_hash_table_lookup_extended(pf->pending, GUINT_TO_POINTER(key), NULL, &state)
+       && PREFETCH_GENERATION(state) == params->generation && !PREFETCH_LOADED(state))
+    {
+      _prefetch_remove(cache, key, &state);
+      pf->stats_cancelled++;
+    }
+  }
+  dt_pthread_mutex_unlock(&pf->lock);
+
+  free(params->imgids);
+  free(params);
+}
+
+void dt_mipmap_cache_prefetch(dt_mipmap_cache_t *cache, const int32_t *imgids, const int count,
+                              const dt_mipmap_size_t mip, const gboolean restart)
+{
+  dt_mipmap_prefetch_t *pf = &cache->prefetch;
+  if(!cache->cachedir[0] || mip >= DT_MIPMAP_F || (int)mip < DT_MIPMAP_0 || count <= 0) return;
+
+  _prefetch_job_t *params = (_prefetch_job_t *)calloc(1, sizeof(_prefetch_job_t));
+  if(!params) return;
+  params->imgids = (int32_t *)calloc(count, sizeof(int32_t));
+  if(!params->imgids)
+  {
+    free(params);
+    return;
+  }
+  params->mip = mip;
+
+  dt_pthread_mutex_lock(&pf->lock);
+  if(restart) pf->generation++;
+  params->generation = pf->generation;
+  dt_pthread_mutex_unlock(&pf->lock);
+
+  for(int k = 0; k < count; k++)
+  {
+    if(imgids[k] <= 0) continue;
+    const uint32_t key = get_key(imgids[k], mip);
+
+    dt_pthread_mutex_lock(&pf->lock);
+    gpointer state;
+    const gboolean pending = g_hash_table_lookup_extended(pf->pending, GUINT_TO_POINTER(key), NULL, &state);
+    const gboolean over_budget = !pending && pf->pending_bytes + cache->buffer_size[mip] > pf->budget;
+    const gboolean requeue
+        = pending && PREFETCH_GENERATION(state) != params->generation && !PREFETCH_LOADED(state);
+    dt_pthread_mutex_unlock(&pf->lock);
+    if(over_budget) break;
+    if(pending && !requeue) continue;
+
+    // only what the disk cache can deliver, don't run pipelines speculatively
+    char filename[PATH_MAX] = { 0 };
+    snprintf(filename, sizeof(filename), "%s.d/%d/%" PRIu32 ".jpg", cache->cachedir, (int)mip,
+             (uint32_t)imgids[k]);
+    if(!g_file_test(filename, G_FILE_TEST_EXISTS)) continue;
+
+    dt_pthread_mutex_lock(&pf->lock);
+    if(!pending) pf->pending_bytes += cache->buffer_size[mip];
+    g_hash_table_insert(pf->pending, GUINT_TO_POINTER(key), PREFETCH_STATE(params->generation, 0));
+    pf->stats_queued++;
+    dt_pthread_mutex_unlock(&pf->lock);
+
+    params->imgids[params->count++] = imgids[k];
+  }
+
+  dt_job_t *job = params->count ? dt_control_job_create(&_prefetch_job_run, "prefetch %d images mip %d",
+                                                        params->count, mip)
+                                : NULL;
+  if(!job)
+  {
+    // releases what was accounted for above
+    _prefetch_job_free(params);
+    return;
+  }
+  // the thumbnails being displayed go through the foreground queue, stay out of their way
+  dt_control_job_set_params(job, params, _prefetch_job_free);
+  dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_BG, job);
+}
+
+void dt_mipmap_cache_pin_full(dt_mipmap_cache_t *cache, const int32_t *imgids, const int count)
+{
+  dt_cache_t *full = &cache->mip_full.cache;
+  dt_pthread_mutex_lock(&cache->full_lock);
+  // pin the new ones first, so images in both sets never become collectable in between
+  const int old_cnt = cache->full_pinned_cnt;
+  int32_t old[DT_MIPMAP_FULL_PINNED_MAX];
+  memcpy(old, cache->full_pinned, sizeof(int32_t) * old_cnt);
+  cache->full_pinned_cnt = 0;
+  for(int k = 0; k < count && cache->full_pinned_cnt < DT_MIPMAP_FULL_PINNED_MAX; k++)
+  {
+    if(imgids[k] <= 0) continue;
+    dt_cache_pin(full, get_key(imgids[k], DT_MIPMAP_FULL), TRUE);
+    cache->full_pinned[cache->full_pinned_cnt++] = imgids[k];
+  }
+  for(int k = 0; k < old_cnt; k++) dt_cache_pin(full, get_key(old[k], DT_MIPMAP_FULL), FALSE);
+  dt_pthread_mutex_unlock(&cache->full_lock);
+}
+
 void dt_mipmap_cache_deallocate_dynamic(void *data, dt_cache_entry_t *entry)
 {
   dt_mipmap_cache_t *cache = (dt_mipmap_cache_t *)data;
   const dt_mipmap_size_t mip = get_size(entry->key);
+  if(mip < DT_MIPMAP_F && cache->prefetch.pending)
+  {
+    // a prefetched thumbnail which nobody asked for
+    dt_pthread_mutex_lock(&cache->prefetch.lock);
+    gpointer state;
+    if(_prefetch_remove(cache, entry->key, &state) && PREFETCH_LOADED(state)) cache->prefetch.stats_wasted++;
+    dt_pthread_mutex_unlock(&cache->prefetch.lock);
+  }
   if(mip < DT_MIPMAP_F)
   {
     struct dt_mipmap_buffer_dsc *dsc = (struct dt_mipmap_buffer_dsc *)entry->data;
@@ -460,7 +722,9 @@ void dt_mipmap_cache_deallocate_dynamic(void *data, dt_cache_entry_t *entry)
       {
         dt_mipmap_cache_unlink_ondisk_thumbnail(data, get_imgid(entry->key), mip);
       }
-      else if(cache->cachedir[0] && ((dt_conf_get_bool("cache_disk_backend") && mip < DT_MIPMAP_8)
+      // only the refined thumbnails go to the disk cache, the embedded preview is cheap to get again
+      else if(!(dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_PREVIEW)
+              && cache->cachedir[0] && ((dt_conf_get_bool("cache_disk_backend") && mip < DT_MIPMAP_8)
                                      || (dt_conf_get_bool("cache_disk_backend_full") && mip == DT_MIPMAP_8)))
       {
         // serialize to disk
@@ -584,13 +848,25 @@ void dt_mipmap_cache_init(dt_mipmap_cache_t *cache)
   dt_cache_set_allocate_callback(&cache->mip_thumbs.cache, dt_mipmap_cache_allocate_dynamic, cache);
   dt_cache_set_cleanup_callback(&cache->mip_thumbs.cache, dt_mipmap_cache_deallocate_dynamic, cache);
 
+  // prefetched thumbnails may take up to a quarter of the thumbnail cache
+  memset(&cache->prefetch, 0, sizeof(cache->prefetch));
+  dt_pthread_mutex_init(&cache->prefetch.lock, NULL);
+  cache->prefetch.pending = g_hash_table_new(g_direct_hash, g_direct_equal);
+  cache->prefetch.budget = max_mem / 4;
+
   // even with one thread you want two buffers. one for dr one for thumbs.
   // Also have the nr of cache entries larger than worker threads
   const int full_entries = 2 * dt_worker_threads();
   const int32_t max_mem_bufs = nearest_power_of_two(full_entries);
 
-  // for this buffer, because it can be very busy during import
-  dt_cache_init(&cache->mip_full.cache, 0, max_mem_bufs);
+  // decoded raws get their own memory quota, shared by darkroom, export and thumbnail pipes.
+  // the darkroom image and its neighbours are pinned on top of it.
+  const int64_t full_memory = dt_conf_get_int64("cache_memory_full");
+  const size_t max_mem_full = CLAMPS(full_memory, 256u << 20, ((size_t)64) << 30);
+  dt_pthread_mutex_init(&cache->full_lock, NULL);
+  cache->full_pinned_cnt = 0;
+  cache->full_decodes = g_hash_table_new(g_direct_hash, g_direct_equal);
+  dt_cache_init(&cache->mip_full.cache, 0, max_mem_full);
   dt_cache_set_allocate_callback(&cache->mip_full.cache, dt_mipmap_cache_allocate_dynamic, cache);
   dt_cache_set_cleanup_callback(&cache->mip_full.cache, dt_mipmap_cache_deallocate_dynamic, cache);
   cache->buffer_size[DT_MIPMAP_FULL] = 0;
@@ -609,6 +885,13 @@ void dt_mipmap_cache_cleanup(dt_mipmap_cache_t *cache)
   dt_cache_cleanup(&cache->mip_thumbs.cache);
   dt_cache_cleanup(&cache->mip_full.cache);
   dt_cache_cleanup(&cache->mip_f.cache);
+
+  g_hash_table_destroy(cache->prefetch.pending);
+  cache->prefetch.pending = NULL;
+  dt_pthread_mutex_destroy(&cache->prefetch.lock);
+
+  g_hash_table_destroy(cache->full_decodes);
+  dt_pthread_mutex_destroy(&cache->full_lock);
 }
 
 void dt_mipmap_cache_print(dt_mipmap_cache_t *cache)
@@ -620,8 +903,9 @@ void dt_mipmap_cache_print(dt_mipmap_cache_t *cache)
   printf("[mipmap_cache] float fill %"PRIu32"/%"PRIu32" slots (%.2f%%)\n",
          (uint32_t)cache->mip_f.cache.cost, (uint32_t)cache->mip_f.cache.cost_quota,
          100.0f * (float)cache->mip_f.cache.cost / (float)cache->mip_f.cache.cost_quota);
-  printf("[mipmap_cache] full  fill %"PRIu32"/%"PRIu32" slots (%.2f%%)\n",
-         (uint32_t)cache->mip_full.cache.cost, (uint32_t)cache->mip_full.cache.cost_quota,
+  printf("[mipmap_cache] full  fill %.2f/%.2f MB (%.2f%%)\n",
+         cache->mip_full.cache.cost / (1024.0 * 1024.0),
+         cache->mip_full.cache.cost_quota / (1024.0 * 1024.0),
          100.0f * (float)cache->mip_full.cache.cost / (float)cache->mip_full.cache.cost_quota);
 
   uint64_t sum = 0;
@@ -655,6 +939,31 @@ void dt_mipmap_cache_print(dt_mipmap_cache_t *cache)
          100.0 * cache->mip_full.stats_standin / (float)sum_standins,
          100.0 * cache->mip_full.stats_fetches / (float)sum_fetches,
          100.0 * cache->mip_full.stats_requests / (float)sum);
+
+  dt_mipmap_prefetch_t *pf = &cache->prefetch;
+  dt_pthread_mutex_lock(&pf->lock);
+  printf("[mipmap_cache] prefetch | %ld queued | %ld loaded | %ld hits | %ld late | %ld wasted | %ld cancelled\n",
+         pf->stats_queued, pf->stats_loaded, pf->stats_hits, pf->stats_late, pf->stats_wasted,
+         pf->stats_cancelled);
+  printf("[mipmap_cache] prefetch | %u pending, %.2f/%.2f MB\n", g_hash_table_size(pf->pending),
+         pf->pending_bytes / (1024.0 * 1024.0), pf->budget / (1024.0 * 1024.0));
+  dt_pthread_mutex_unlock(&pf->lock);
+  dt_pthread_mutex_lock(&cache->full_lock);
+  GHashTableIter iter;
+  gpointer key, value;
+  int decoded = 0, decodes = 0;
+  g_hash_table_iter_init(&iter, cache->full_decodes);
+  while(g_hash_table_iter_next(&iter, &key, &value))
+  {
+    decoded++;
+    decodes += GPOINTER_TO_INT(value);
+    if(GPOINTER_TO_INT(value) > 1)
+      printf("[mipmap_cache] full  | image %d decoded %d times\n", GPOINTER_TO_INT(key), GPOINTER_TO_INT(value));
+  }
+  printf("[mipmap_cache] full  | %d decodes of %d images, %d pinned\n", decodes, decoded, cache->full_pinned_cnt);
+  dt_pthread_mutex_unlock(&cache->full_lock);
+  printf("[mipmap_cache] refine | %ld queued | %ld refined | %ld dropped\n", cache->stats_refine_queued,
+         cache->stats_refined, cache->stats_refine_dropped);
   printf("\n\n");
 }
 
@@ -799,6 +1108,18 @@ void dt_mipmap_cache_get_with_caller(
         }
         else
         {
+          // the decodes are only counted for the debug output, the table would grow with every image viewed
+          if(darktable.unmuted & DT_DEBUG_CACHE)
+          {
+            dt_pthread_mutex_lock(&cache->full_lock);
+            const int decodes
+                = GPOINTER_TO_INT(g_hash_table_lookup(cache->full_decodes, GINT_TO_POINTER(imgid))) + 1;
+            g_hash_table_insert(cache->full_decodes, GINT_TO_POINTER(imgid), GINT_TO_POINTER(decodes));
+            dt_pthread_mutex_unlock(&cache->full_lock);
+            dt_print(DT_DEBUG_CACHE, "[mipmap_cache] full decode #%d of image %d (%s:%d)\n", decodes, imgid,
+                     file, line);
+          }
+
           // swap back new image data:
           dt_image_t *img = dt_image_cache_get(darktable.image_cache, imgid, 'w');
           *img = buffered_image;
@@ -817,7 +1138,14 @@ void dt_mipmap_cache_get_with_caller(
       {
         // 8-bit thumbs
         ASAN_UNPOISON_MEMORY_REGION(dsc + 1, dsc->size - sizeof(struct dt_mipmap_buffer_dsc));
-        _init_8((uint8_t *)(dsc + 1), &dsc->width, &dsc->height, &dsc->iscale, &buf->color_space, imgid, mip);
+        gboolean preview_tier = FALSE;
+        _init_8((uint8_t *)(dsc + 1), &dsc->width, &dsc->height, &dsc->iscale, &buf->color_space, imgid, mip,
+                &preview_tier);
+        if(preview_tier)
+        {
+          dsc->flags |= DT_MIPMAP_BUFFER_DSC_FLAG_PREVIEW;
+          _refine_queue(cache, imgid, mip);
+        }
       }
       dsc->color_space = buf->color_space;
       dsc->flags &= ~DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE;
@@ -882,6 +1210,7 @@ void dt_mipmap_cache_get_with_caller(
   else if(flags == DT_MIPMAP_BEST_EFFORT)
   {
     __sync_fetch_and_add(&(_get_cache(cache, mip)->stats_requests), 1);
+    if(mip < DT_MIPMAP_F) _prefetch_consume(cache, key);
     // best-effort, might also return NULL.
     // never decrease mip level for float buffer or full image:
     dt_mipmap_size_t min_mip = (mip >= DT_MIPMAP_F) ? mip : DT_MIPMAP_0;
@@ -1085,30 +1414,11 @@ static void _init_f(dt_mipmap_buffer_t *mipmap_buf, float *out, uint32_t *width,
 
   if(image->buf_dsc.filters)
   {
-    if(image->buf_dsc.filters != 9u && image->buf_dsc.datatype == TYPE_FLOAT)
-    {
-      dt_iop_clip_and_zoom_mosaic_half_size_f((float *const)out, (const float *const)buf.buf, &roi_out, &roi_in,
-                                              roi_out.width, roi_in.width, image->buf_dsc.filters);
-    }
-    else if(image->buf_dsc.filters != 9u && image->buf_dsc.datatype == TYPE_UINT16)
-    {
-      dt_iop_clip_and_zoom_mosaic_half_size((uint16_t * const)out, (const uint16_t *)buf.buf, &roi_out, &roi_in,
-                                            roi_out.width, roi_in.width, image->buf_dsc.filters);
-    }
-    else if(image->buf_dsc.filters == 9u && image->buf_dsc.datatype == TYPE_UINT16)
-    {
-      dt_iop_clip_and_zoom_mosaic_third_size_xtrans((uint16_t * const)out, (const uint16_t *)buf.buf, &roi_out,
-                                                    &roi_in, roi_out.width, roi_in.width, image->buf_dsc.xtrans);
-    }
-    else if(image->buf_dsc.filters == 9u && image->buf_dsc.datatype == TYPE_FLOAT)
-    {
-      dt_iop_clip_and_zoom_mosaic_third_size_xtrans_f(out, (const float *)buf.buf, &roi_out, &roi_in,
-                                                      roi_out.width, roi_in.width, image->buf_dsc.xtrans);
-    }
-    else
-    {
+    if(image->buf_dsc.datatype != TYPE_FLOAT && image->buf_dsc.datatype != TYPE_UINT16)
       dt_unreachable_codepath();
-    }
+
+    dt_iop_clip_and_zoom_mosaic(out, buf.buf, &roi_out, &roi_in, roi_out.width, roi_in.width,
+                                image->buf_dsc.datatype, image->buf_dsc.filters, image->buf_dsc.xtrans);
   }
   else
   {
@@ -1153,11 +1463,173 @@ static int _write_image(dt_imageio_module_data_t *data, const char *filename, co
   return 0;
 }
 
+// run the full pixelpipe for a thumbnail of at most wd x ht
+static int _init_8_from_pipe(uint8_t *buf, const uint32_t wd, const uint32_t ht, const uint32_t imgid,
+                             uint32_t *width, uint32_t *height)
+{
+  dt_imageio_module_format_t format;
+  _dummy_data_t dat;
+  format.bpp = _bpp;
+  format.write_image = _write_image;
+  format.levels = _levels;
+  dat.head.max_width = wd;
+  dat.head.max_height = ht;
+  dat.buf = buf;
+  // export with flags: ignore exif (don't load from disk), don't swap byte order, don't do hq processing,
+  // no upscaling and signal we want thumbnail export
+  const int res = dt_imageio_export_with_flags(imgid, "unused", &format, (dt_imageio_module_data_t *)&dat, TRUE,
+                                               FALSE, FALSE, FALSE, TRUE, NULL, FALSE, FALSE, DT_COLORSPACE_NONE,
+                                               NULL, DT_INTENT_LAST, NULL, NULL, 1, 1, NULL);
+  if(!res)
+  {
+    // might be smaller, or have a different aspect than what we got as input.
+    *width = dat.head.width;
+    *height = dat.head.height;
+  }
+  return res;
+}
+
+// how often a refinement is queued again when its entry is locked by someone else at swap time
+#define REFINE_RETRIES 3
+
+typedef struct _refine_job_t
+{
+  uint32_t imgid;
+  dt_mipmap_size_t mip;
+  int retries;      // left before the refinement is given up
+  uint8_t *pixels;  // the rendering of a previous attempt, if any, owned by the job
+  uint32_t width, height;
+} _refine_job_t;
+
+static void _refine_job_free(void *data)
+{
+  _refine_job_t *params = (_refine_job_t *)data;
+  dt_free_align(params->pixels);
+  free(params);
+}
+
+static int32_t _refine_job_run(dt_job_t *job);
+
+static gboolean _refine_add_job(_refine_job_t *params)
+{
+  dt_job_t *job = dt_control_job_create(&_refine_job_run, "refine image %d mip %d", params->imgid,
+                                        params->mip);
+  if(!job)
+  {
+    _refine_job_free(params);
+    return FALSE;
+  }
+  dt_control_job_set_params_with_size(job, params, sizeof(_refine_job_t), _refine_job_free);
+  // low priority, thumbnails from the embedded preview are good enough until the queue is idle
+  dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_BG, job);
+  return TRUE;
+}
+
+// render the thumbnail of an unaltered image with the pixelpipe and swap it in place of the one made from
+// the embedded preview
+static int32_t _refine_job_run(dt_job_t *job)
+{
+  _refine_job_t *params = dt_control_job_get_params(job);
+  dt_mipmap_cache_t *cache = darktable.mipmap_cache;
+  const uint32_t imgid = params->imgid;
+  const dt_mipmap_size_t mip = params->mip;
+
+  // still in the cache and not refined yet?
+  dt_mipmap_buffer_t buf;
+  dt_mipmap_cache_get(cache, &buf, imgid, mip, DT_MIPMAP_TESTLOCK, 'r');
+  if(!buf.buf)
+  {
+    __sync_fetch_and_add(&cache->stats_refine_dropped, 1);
+    return 0;
+  }
+  const gboolean pending = ((struct dt_mipmap_buffer_dsc *)buf.buf - 1)->flags & DT_MIPMAP_BUFFER_DSC_FLAG_PREVIEW;
+  dt_mipmap_cache_release(cache, &buf);
+  if(!pending) return 0;
+
+  const double start = dt_get_wtime();
+  if(!params->pixels)
+  {
+    const uint32_t wd = cache->max_width[mip];
+    const uint32_t ht = cache->max_height[mip];
+    params->pixels = dt_alloc_align(64, sizeof(uint8_t) * 4 * wd * ht);
+    if(!params->pixels || _init_8_from_pipe(params->pixels, wd, ht, imgid, &params->width, &params->height))
+    {
+      __sync_fetch_and_add(&cache->stats_refine_dropped, 1);
+      return 0;
+    }
+  }
+  const uint32_t width = params->width;
+  const uint32_t height = params->height;
+
+  // swap it in, unless the entry has been evicted or regenerated meanwhile
+  gboolean swapped = FALSE;
+  dt_mipmap_cache_get(cache, &buf, imgid, mip, DT_MIPMAP_TESTLOCK, 'w');
+  if(!buf.buf)
+  {
+    // most likely read by someone right now. try again later with the same rendering, the job run after
+    // an eviction drops it at the check above.
+    if(params->retries > 0)
+    {
+      _refine_job_t *retry = (_refine_job_t *)malloc(sizeof(_refine_job_t));
+      if(retry)
+      {
+        *retry = *params;
+        retry->retries--;
+        params->pixels = NULL; // handed over to the retry
+        if(_refine_add_job(retry))
+        {
+          dt_print(DT_DEBUG_CACHE, "[mipmap_cache] mip %d for image %d is locked, refinement requeued\n", mip,
+                   imgid);
+          return 0;
+        }
+      }
+    }
+  }
+  else
+  {
+    struct dt_mipmap_buffer_dsc *dsc = (struct dt_mipmap_buffer_dsc *)buf.buf - 1;
+    if((dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_PREVIEW)
+       && sizeof(*dsc) + sizeof(uint8_t) * 4 * width * height <= dsc->size)
+    {
+      memcpy(buf.buf, params->pixels, sizeof(uint8_t) * 4 * width * height);
+      dsc->width = width;
+      dsc->height = height;
+      dsc->iscale = 1.0f;
+      dsc->color_space = dt_mipmap_cache_get_colorspace();
+      dsc->flags &= ~DT_MIPMAP_BUFFER_DSC_FLAG_PREVIEW;
+      swapped = TRUE;
+    }
+    dt_mipmap_cache_release(cache, &buf);
+  }
+
+  if(swapped)
+  {
+    __sync_fetch_and_add(&cache->stats_refined, 1);
+    g_idle_add(_raise_signal_mipmap_updated, GINT_TO_POINTER(imgid));
+    dt_print(DT_DEBUG_CACHE, "[mipmap_cache] refined mip %d for image %d in %.3f sec\n", mip, imgid,
+             dt_get_wtime() - start);
+  }
+  else
+    __sync_fetch_and_add(&cache->stats_refine_dropped, 1);
+  return 0;
+}
+
+static void _refine_queue(dt_mipmap_cache_t *cache, const uint32_t imgid, const dt_mipmap_size_t mip)
+{
+  _refine_job_t *params = (_refine_job_t *)calloc(1, sizeof(_refine_job_t));
+  if(!params) return;
+  params->imgid = imgid;
+  params->mip = mip;
+  params->retries = REFINE_RETRIES;
+  if(_refine_add_job(params)) __sync_fetch_and_add(&cache->stats_refine_queued, 1);
+}
+
 static void _init_8(uint8_t *buf, uint32_t *width, uint32_t *height, float *iscale,
                     dt_colorspaces_color_profile_type_t *color_space, const uint32_t imgid,
-                    const dt_mipmap_size_t size)
+                    const dt_mipmap_size_t size, gboolean *preview_tier)
 {
   *iscale = 1.0f;
+  *preview_tier = FALSE;
   const uint32_t wd = *width, ht = *height;
   char filename[PATH_MAX] = { 0 };
   gboolean from_cache = TRUE;
@@ -1183,11 +1655,17 @@ static void _init_8(uint8_t *buf, uint32_t *width, uint32_t *height, float *isca
 
   const char *min = dt_conf_get_string_const("plugins/lighttable/thumbnail_raw_min_level");
   const dt_mipmap_size_t min_s = dt_mipmap_cache_get_min_mip_from_pref(min);
-  const gboolean use_embedded = (size <= min_s);
+  // in tiered mode the embedded preview is shown first and refined in the background
+  const gboolean tiered = dt_conf_get_bool("plugins/lighttable/thumbnail_tiered");
+  const gboolean use_embedded = (size <= min_s) || tiered;
 
   if(!altered && use_embedded && !incompatible)
   {
     const dt_image_orientation_t orientation = dt_image_get_orientation(imgid);
+    // the jpeg is stored unrotated, the box it has to cover once flipped is wd x ht
+    const gboolean swap_xy = orientation != ORIENTATION_NULL && (orientation & ORIENTATION_SWAP_XY);
+    const uint32_t fit_wd = swap_xy ? ht : wd;
+    const uint32_t fit_ht = swap_xy ? wd : ht;
 
     // try to load the embedded thumbnail in raw
     from_cache = TRUE;
@@ -1202,12 +1680,15 @@ static void _init_8(uint8_t *buf, uint32_t *width, uint32_t *height, float *isca
       dt_imageio_jpeg_t jpg;
       if(!dt_imageio_jpeg_read_header(filename, &jpg))
       {
+        // let libjpeg do most of the downscaling in the dct domain
+        const int denom = dt_imageio_jpeg_set_scale(&jpg, fit_wd, fit_ht);
         uint8_t *tmp = (uint8_t *)malloc(sizeof(uint8_t) * jpg.width * jpg.height * 4);
         *color_space = dt_imageio_jpeg_read_color_space(&jpg);
         if(!dt_imageio_jpeg_read(&jpg, tmp))
         {
           // scale to fit
-          dt_print(DT_DEBUG_CACHE, "[mipmap_cache] generate mip %d for image %d from jpeg\n", size, imgid);
+          dt_print(DT_DEBUG_CACHE, "[mipmap_cache] generate mip %d for image %d from jpeg at 1/%d\n", size,
+                   imgid, denom);
           dt_iop_flip_and_zoom_8(tmp, jpg.width, jpg.height, buf, wd, ht, orientation, width, height);
           res = 0;
         }
@@ -1218,7 +1699,8 @@ static void _init_8(uint8_t *buf, uint32_t *width, uint32_t *height, float *isca
     {
       uint8_t *tmp = 0;
       int32_t thumb_width, thumb_height;
-      res = dt_imageio_large_thumbnail(filename, &tmp, &thumb_width, &thumb_height, color_space);
+      res = dt_imageio_large_thumbnail_ext(filename, &tmp, &thumb_width, &thumb_height, color_space, fit_wd,
+                                           fit_ht);
       if(!res)
       {
         // if the thumbnail is not large enough, we compute one
@@ -1226,7 +1708,7 @@ static void _init_8(uint8_t *buf, uint32_t *width, uint32_t *height, float *isca
         const int imgwd = img2->width;
         const int imght = img2->height;
         dt_image_cache_read_release(darktable.image_cache, img2);
-        if(thumb_width < wd && thumb_height < ht && thumb_width < imgwd - 4 && thumb_height < imght - 4)
+        if(thumb_width < fit_wd && thumb_height < fit_ht && thumb_width < imgwd - 4 && thumb_height < imght - 4)
         {
           res = 1;
         }
@@ -1239,6 +1721,7 @@ static void _init_8(uint8_t *buf, uint32_t *width, uint32_t *height, float *isca
         dt_free_align(tmp);
       }
     }
+    *preview_tier = !res && size > min_s;
   }
 
   if(res)
@@ -1254,6 +1737,10 @@ static void _init_8(uint8_t *buf, uint32_t *width, uint32_t *height, float *isca
       *color_space = tmp.color_space;
       // downsample
       dt_iop_flip_and_zoom_8(tmp.buf, tmp.width, tmp.height, buf, wd, ht, ORIENTATION_NONE, width, height);
+      // a larger embedded preview still waiting for its refinement gives one as well
+      if(size > min_s
+         && (((struct dt_mipmap_buffer_dsc *)tmp.buf - 1)->flags & DT_MIPMAP_BUFFER_DSC_FLAG_PREVIEW))
+        *preview_tier = TRUE;
 
       dt_mipmap_cache_release(darktable.mipmap_cache, &tmp);
       res = 0;
@@ -1264,25 +1751,10 @@ static void _init_8(uint8_t *buf, uint32_t *width, uint32_t *height, float *isca
   if(res)
   {
     // try the real thing: rawspeed + pixelpipe
-    dt_imageio_module_format_t format;
-    _dummy_data_t dat;
-    format.bpp = _bpp;
-    format.write_image = _write_image;
-    format.levels = _levels;
-    dat.head.max_width = wd;
-    dat.head.max_height = ht;
-    dat.buf = buf;
-    // export with flags: ignore exif (don't load from disk), don't swap byte order, don't do hq processing,
-    // no upscaling and signal we want thumbnail export
-    res = dt_imageio_export_with_flags(imgid, "unused", &format, (dt_imageio_module_data_t *)&dat, TRUE, FALSE, FALSE,
-                                       FALSE, TRUE, NULL, FALSE, FALSE, DT_COLORSPACE_NONE, NULL, DT_INTENT_LAST, NULL,
-                                       NULL, 1, 1, NULL);
+    res = _init_8_from_pipe(buf, wd, ht, imgid, width, height);
     if(!res)
     {
       dt_print(DT_DEBUG_CACHE, "[mipmap_cache] generate mip %d for image %d from scratch\n", size, imgid);
-      // might be smaller, or have a different aspect than what we got as input.
-      *width = dat.head.width;
-      *height = dat.head.height;
       *iscale = 1.0f;
       *color_space = dt_mipmap_cache_get_colorspace();
     }
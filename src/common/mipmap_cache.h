@@ -85,6 +85,26 @@ typedef struct dt_mipmap_cache_one_t
   long int stats_standin;    // texture used as stand-in
 } dt_mipmap_cache_one_t;
 
+// speculative loading of thumbnails from the disk cache, ahead of scrolling
+typedef struct dt_mipmap_prefetch_t
+{
+  dt_pthread_mutex_t lock;
+  GHashTable *pending;  // cache key -> state, prefetched (or queued) but not yet requested
+  size_t pending_bytes; // upper bound of the memory taken by pending prefetches
+  size_t budget;        // don't queue more than that
+  int generation;       // bumped to drop the prefetches still queued
+
+  long int stats_queued;    // thumbnails queued for prefetching
+  long int stats_loaded;    // thumbnails actually loaded by a prefetch job
+  long int stats_hits;      // prefetched thumbnails requested afterwards
+  long int stats_late;      // requested before the prefetch job got to them
+  long int stats_wasted;    // prefetched thumbnails evicted without being requested
+  long int stats_cancelled; // queued prefetches dropped on a change of direction
+} dt_mipmap_prefetch_t;
+
+// the edited image and its filmstrip neighbours
+#define DT_MIPMAP_FULL_PINNED_MAX 3
+
 typedef struct dt_mipmap_cache_t
 {
   // real width and height are stored per element
@@ -99,6 +119,19 @@ typedef struct dt_mipmap_cache_t
   dt_mipmap_cache_one_t mip_f;
   dt_mipmap_cache_one_t mip_full;
   char cachedir[PATH_MAX]; // cached sha1sum filename for faster access
+
+  dt_mipmap_prefetch_t prefetch;
+
+  // full size buffers kept around for the darkroom, and how often each image got decoded
+  dt_pthread_mutex_t full_lock;
+  int32_t full_pinned[DT_MIPMAP_FULL_PINNED_MAX];
+  int full_pinned_cnt;
+  GHashTable *full_decodes; // imgid -> number of full decodes, only with -d cache
+
+  // thumbnails served from the embedded preview and refined in the background
+  long int stats_refine_queued;
+  long int stats_refined;
+  long int stats_refine_dropped; // evicted, regenerated or failed before the refinement
 } dt_mipmap_cache_t;
 
 // dynamic memory allocation interface for imageio backend: a write locked
@@ -124,6 +157,16 @@ void dt_mipmap_cache_get_with_caller(
     const char *file,
     int line);
 
+// queue disk cache loads of the given thumbnails, nearest first, as one background job. images already
+// cached, already queued or without a disk cache entry are skipped, and nothing more is queued once the
+// prefetch memory budget is used up. with restart, the prefetches still queued from earlier calls are dropped.
+void dt_mipmap_cache_prefetch(dt_mipmap_cache_t *cache, const int32_t *imgids, const int count,
+                              const dt_mipmap_size_t mip, const gboolean restart);
+
+// replace the set of images whose full size buffer is kept in the cache, once decoded, regardless of the
+// quota. at most DT_MIPMAP_FULL_PINNED_MAX of them, pass count 0 to release them all.
+void dt_mipmap_cache_pin_full(dt_mipmap_cache_t *cache, const int32_t *imgids, const int count);
+
 // convenience function with fewer params
 #define dt_mipmap_cache_write_get(A,B,C,D) dt_mipmap_cache_write_get_with_caller(A,B,C,D,__FILE__,__LINE__)
 void dt_mipmap_cache_write_get_with_caller(
@@ -28,6 +28,7 @@
 #include "common/imageio.h"
 #include "common/tags.h"
 #include "control/control.h"
+#include "control/jobs/control_jobs.h"
 #include "develop/develop.h"
 
 #include "gui/accelerators.h"
@@ -69,6 +70,10 @@ typedef struct
   gboolean in_plugin;
 } StyleData;
 
+static GList *_styles_get_apply_items(const int id);
+static void _styles_apply_to_image_ext(const char *name, const gboolean duplicate, const gboolean overwrite,
+                                       const int32_t imgid, const GList *style_items, GList **synch);
+
 void dt_style_free(gpointer data)
 {
   dt_style_t *style = (dt_style_t *)data;
@@ -604,11 +609,20 @@ void dt_styles_apply_to_list(const char *name, const GList *list, gboolean dupli
   const int mode = dt_conf_get_int("plugins/lighttable/style/applymode");
   const gboolean is_overwrite = (mode == DT_STYLE_HISTORY_OVERWRITE);
 
+  /* the style is read once for all images, the histories are written in transactions of
+     DT_HISTORY_BATCH_SIZE images and the sidecars by one background job at the end */
+  const double start = dt_get_wtime();
+  const int id = dt_styles_get_id_by_name(name);
+  GList *style_items = id ? _styles_get_apply_items(id) : NULL;
+  GList *synch = NULL;
+  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "SAVEPOINT styles_apply", NULL, NULL, NULL);
+
   /* for each selected image apply style */
   dt_undo_start_group(darktable.undo, DT_UNDO_LT_HISTORY);
 
   dt_undo_lt_history_t *hist = NULL;
 
+  int count = 0;
   for(const GList *l = list; l; l = g_list_next(l))
   {
     const int32_t imgid = GPOINTER_TO_INT(l->data);
@@ -622,7 +636,7 @@ void dt_styles_apply_to_list(const char *name, const GList *list, gboolean dupli
       if(!duplicate) dt_history_delete_on_image_ext(imgid, FALSE);
     }
 
-    dt_styles_apply_to_image(name, duplicate, is_overwrite, imgid);
+    _styles_apply_to_image_ext(name, duplicate, is_overwrite, imgid, style_items, &synch);
 
     if(is_overwrite)
     {
@@ -632,10 +646,22 @@ void dt_styles_apply_to_list(const char *name, const GList *list, gboolean dupli
     }
 
     selected = TRUE;
+    if(++count % DT_HISTORY_BATCH_SIZE == 0)
+    {
+      DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "RELEASE styles_apply", NULL, NULL, NULL);
+      DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "SAVEPOINT styles_apply", NULL, NULL, NULL);
+    }
   }
 
   dt_undo_end_group(darktable.undo);
 
+  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "RELEASE styles_apply", NULL, NULL, NULL);
+  g_list_free_full(style_items, dt_style_item_free);
+  dt_control_write_sidecar_files_list(g_list_reverse(synch));
+
+  dt_print(DT_DEBUG_PERF, "[styles] applied style '%s' on %d images in %.3f secs\n",
+           name, g_list_length((GList *)list), dt_get_wtime() - start);
+
   DT_DEBUG_CONTROL_SIGNAL_RAISE(darktable.signals, DT_SIGNAL_TAG_CHANGED);
 
   if(!selected)
@@ -710,6 +736,78 @@ void dt_styles_create_from_list(const GList *list)
   if(!selected) dt_control_log(_("no image selected!"));
 }
 
+// set up module with the params of the style item, converting them from older versions if needed.
+// returns FALSE if they can't be converted.
+static gboolean _styles_item_to_module(dt_iop_module_t *module, const dt_style_item_t *style_item)
+{
+  gboolean do_merge = TRUE;
+
+  module->enabled = style_item->enabled;
+  g_strlcpy(module->multi_name, style_item->multi_name, sizeof(module->multi_name));
+
+  // TODO: this is copied from dt_dev_read_history_ext(), maybe do a helper with this?
+  if(style_item->blendop_params && (style_item->blendop_version == dt_develop_blend_version())
+     && (style_item->blendop_params_size == sizeof(dt_develop_blend_params_t)))
+  {
+    memcpy(module->blend_params, style_item->blendop_params, sizeof(dt_develop_blend_params_t));
+  }
+  else if(style_item->blendop_params
+          && dt_develop_blend_legacy_params(module, style_item->blendop_params, style_item->blendop_version,
+              module->blend_params, dt_develop_blend_version(), style_item->blendop_params_size) == 0)
+  {
+    // do nothing
+  }
+  else
+  {
+    memcpy(module->blend_params, module->default_blendop_params, sizeof(dt_develop_blend_params_t));
+  }
+
+  if(module->version() != style_item->module_version || module->params_size != style_item->params_size
+     || strcmp(style_item->operation, module->op))
+  {
+    if(!module->legacy_params
+       || module->legacy_params(module, style_item->params, labs(style_item->module_version),
+                                      module->params, labs(module->version())))
+    {
+      fprintf(stderr, "[dt_styles_apply_style_item] module `%s' version mismatch: history is %d, dt %d.\n",
+              module->op, style_item->module_version, module->version());
+      dt_control_log(_("module `%s' version mismatch: %d != %d"), module->op,
+                     module->version(), style_item->module_version);
+
+      do_merge = FALSE;
+    }
+    else
+    {
+      if(!strcmp(module->op, "spots") && style_item->module_version == 1)
+      {
+        // FIXME: not sure how to handle this here...
+        // quick and dirty hack to handle spot removal legacy_params
+        /* memcpy(module->blend_params, module->blend_params, sizeof(dt_develop_blend_params_t));
+        memcpy(module->blend_params, module->default_blendop_params,
+               sizeof(dt_develop_blend_params_t)); */
+      }
+    }
+
+    /*
+     * Fix for flip iop: previously it was not always needed, but it might be
+     * in history stack as "orientation (off)", but now we always want it
+     * by default, so if it is disabled, enable it, and replace params with
+     * default_params. if user want to, he can disable it.
+     */
+    if(!strcmp(module->op, "flip") && module->enabled == 0 && labs(style_item->module_version) == 1)
+    {
+      memcpy(module->params, module->default_params, module->params_size);
+      module->enabled = 1;
+    }
+  }
+  else
+  {
+    memcpy(module->params, style_item->params, module->params_size);
+  }
+
+  return do_merge;
+}
+
 void dt_styles_apply_style_item(dt_develop_t *dev, dt_style_item_t *style_item, GList **modules_used, const gboolean append)
 {
   // get any instance of the same operation so we can copy it
@@ -729,91 +827,141 @@ void dt_styles_apply_style_item(dt_develop_t *dev, dt_style_item_t *style_item,
     }
     else
     {
-      gboolean do_merge = TRUE;
-
       module->instance = mod_src->instance;
       module->multi_priority = style_item->multi_priority;
       module->iop_order = style_item->iop_order;
 
-      module->enabled = style_item->enabled;
-      g_strlcpy(module->multi_name, style_item->multi_name, sizeof(module->multi_name));
+      if(_styles_item_to_module(module, style_item))
+        dt_history_merge_module_into_history(dev, NULL, module, modules_used, append);
+    }
 
-      // TODO: this is copied from dt_dev_read_history_ext(), maybe do a helper with this?
-      if(style_item->blendop_params && (style_item->blendop_version == dt_develop_blend_version())
-         && (style_item->blendop_params_size == sizeof(dt_develop_blend_params_t)))
-      {
-        memcpy(module->blend_params, style_item->blendop_params, sizeof(dt_develop_blend_params_t));
-      }
-      else if(style_item->blendop_params
-              && dt_develop_blend_legacy_params(module, style_item->blendop_params, style_item->blendop_version,
-                  module->blend_params, dt_develop_blend_version(), style_item->blendop_params_size) == 0)
-      {
-        // do nothing
-      }
-      else
-      {
-        memcpy(module->blend_params, module->default_blendop_params, sizeof(dt_develop_blend_params_t));
-      }
+    if(module)
+    {
+      dt_iop_cleanup_module(module);
+      free(module);
+    }
+  }
+}
 
-      if(module->version() != style_item->module_version || module->params_size != style_item->params_size
-         || strcmp(style_item->operation, module->op))
-      {
-        if(!module->legacy_params
-           || module->legacy_params(module, style_item->params, labs(style_item->module_version),
-                                          module->params, labs(module->version())))
-        {
-          fprintf(stderr, "[dt_styles_apply_style_item] module `%s' version mismatch: history is %d, dt %d.\n",
-                  module->op, style_item->module_version, module->version());
-          dt_control_log(_("module `%s' version mismatch: %d != %d"), module->op,
-                         module->version(), style_item->module_version);
+GList *dt_styles_get_resolved_item_list(dt_develop_t *dev, const char *name)
+{
+  GList *items = dt_styles_get_item_list(name, TRUE, -1);
 
-          do_merge = FALSE;
-        }
-        else
-        {
-          if(!strcmp(module->op, "spots") && style_item->module_version == 1)
-          {
-            // FIXME: not sure how to handle this here...
-            // quick and dirty hack to handle spot removal legacy_params
-            /* memcpy(module->blend_params, module->blend_params, sizeof(dt_develop_blend_params_t));
-            memcpy(module->blend_params, module->default_blendop_params,
-                   sizeof(dt_develop_blend_params_t)); */
-          }
-        }
+  for(GList *l = items; l; l = g_list_next(l))
+  {
+    dt_style_item_t *style_item = (dt_style_item_t *)l->data;
 
-        /*
-         * Fix for flip iop: previously it was not always needed, but it might be
-         * in history stack as "orientation (off)", but now we always want it
-         * by default, so if it is disabled, enable it, and replace params with
-         * default_params. if user want to, he can disable it.
-         */
-        if(!strcmp(module->op, "flip") && module->enabled == 0 && labs(style_item->module_version) == 1)
-        {
-          memcpy(module->params, module->default_params, module->params_size);
-          module->enabled = 1;
-        }
-      }
-      else
-      {
-        memcpy(module->params, style_item->params, module->params_size);
-      }
+    dt_iop_module_t *mod_src = dt_iop_get_module_by_op_priority(dev->iop, style_item->operation, -1);
+    if(!mod_src) continue;
 
-      if(do_merge)
-        dt_history_merge_module_into_history(dev, NULL, module, modules_used, append);
-    }
+    // some legacy_params() conversions depend on the image (e.g. invert, denoiseprofile), as does the
+    // old flip fix. items of an older module version are left alone and converted for every image.
+    if(mod_src->version() != style_item->module_version || mod_src->params_size != style_item->params_size)
+      continue;
 
-    if(module)
+    dt_iop_module_t *module = (dt_iop_module_t *)calloc(1, sizeof(dt_iop_module_t));
+    module->dev = dev;
+    if(dt_iop_load_module(module, mod_src->so, dev))
     {
-      dt_iop_cleanup_module(module);
       free(module);
+      continue;
+    }
+
+    // the blend params converted to the current version are stored back into the item, applying it
+    // then is a plain copy.
+    if(_styles_item_to_module(module, style_item))
+    {
+      style_item->enabled = module->enabled;
+      style_item->module_version = module->version();
+      style_item->params_size = module->params_size;
+      free(style_item->params);
+      style_item->params = malloc(module->params_size);
+      memcpy(style_item->params, module->params, module->params_size);
+      style_item->blendop_version = dt_develop_blend_version();
+      style_item->blendop_params_size = sizeof(dt_develop_blend_params_t);
+      free(style_item->blendop_params);
+      style_item->blendop_params = malloc(sizeof(dt_develop_blend_params_t));
+      memcpy(style_item->blendop_params, module->blend_params, sizeof(dt_develop_blend_params_t));
     }
+
+    dt_iop_cleanup_module(module);
+    free(module);
   }
+
+  return items;
 }
 
-void dt_styles_apply_to_image(const char *name, const gboolean duplicate, const gboolean overwrite, const int32_t imgid)
+GList *dt_styles_item_list_copy(const GList *items)
+{
+  GList *result = NULL;
+  for(const GList *l = items; l; l = g_list_next(l))
+  {
+    const dt_style_item_t *src = (dt_style_item_t *)l->data;
+    dt_style_item_t *item = malloc(sizeof(dt_style_item_t));
+    *item = *src;
+    item->name = g_strdup(src->name);
+    item->operation = g_strdup(src->operation);
+    item->multi_name = g_strdup(src->multi_name);
+    if(src->params)
+    {
+      item->params = malloc(src->params_size);
+      memcpy(item->params, src->params, src->params_size);
+    }
+    if(src->blendop_params)
+    {
+      item->blendop_params = malloc(src->blendop_params_size);
+      memcpy(item->blendop_params, src->blendop_params, src->blendop_params_size);
+    }
+    result = g_list_prepend(result, item);
+  }
+  return g_list_reverse(result);
+}
+
+// the raw items of a style, as applied on an image
+static GList *_styles_get_apply_items(const int id)
 {
-  int id = 0;
   sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT num, module, operation, op_params, enabled,"
+                              "  blendop_params, blendop_version, multi_priority, multi_name"
+                              " FROM data.style_items WHERE styleid=?1 "
+                              " ORDER BY operation, multi_priority",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
+  GList *si_list = NULL;
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    dt_style_item_t *style_item = (dt_style_item_t *)malloc(sizeof(dt_style_item_t));
+
+    style_item->num = sqlite3_column_int(stmt, 0);
+    style_item->selimg_num = 0;
+    style_item->enabled = sqlite3_column_int(stmt, 4);
+    style_item->multi_priority = sqlite3_column_int(stmt, 7);
+    style_item->name = NULL;
+    style_item->operation = g_strdup((char *)sqlite3_column_text(stmt, 2));
+    style_item->multi_name = g_strdup((char *)sqlite3_column_text(stmt, 8));
+    style_item->module_version = sqlite3_column_int(stmt, 1);
+    style_item->blendop_version = sqlite3_column_int(stmt, 6);
+    style_item->params_size = sqlite3_column_bytes(stmt, 3);
+    style_item->params = (void *)malloc(style_item->params_size);
+    memcpy(style_item->params, (void *)sqlite3_column_blob(stmt, 3), style_item->params_size);
+    style_item->blendop_params_size = sqlite3_column_bytes(stmt, 5);
+    style_item->blendop_params = (void *)malloc(style_item->blendop_params_size);
+    memcpy(style_item->blendop_params, (void *)sqlite3_column_blob(stmt, 5), style_item->blendop_params_size);
+    style_item->iop_order = 0;
+
+    si_list = g_list_prepend(si_list, style_item);
+  }
+  sqlite3_finalize(stmt);
+  return g_list_reverse(si_list);  // list was built in reverse order, so un-reverse it
+}
+
+// style_items: the items of the style already read by the caller, NULL to read them
+// synch: when set the image is appended to it and its sidecar is left to the caller
+static void _styles_apply_to_image_ext(const char *name, const gboolean duplicate, const gboolean overwrite,
+                                       const int32_t imgid, const GList *style_items, GList **synch)
+{
+  int id = 0;
 
   if((id = dt_styles_get_id_by_name(name)) != 0)
   {
@@ -874,39 +1022,7 @@ void dt_styles_apply_to_image(const char *name, const gboolean duplicate, const
       fprintf(stderr,"\n^^^^^ Apply style on image %i, history size %i",imgid,dev_dest->history_end);
 
     // go through all entries in style
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "SELECT num, module, operation, op_params, enabled,"
-                                "  blendop_params, blendop_version, multi_priority, multi_name"
-                                " FROM data.style_items WHERE styleid=?1 "
-                                " ORDER BY operation, multi_priority",
-                                -1, &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
-    GList *si_list = NULL;
-    while(sqlite3_step(stmt) == SQLITE_ROW)
-    {
-      dt_style_item_t *style_item = (dt_style_item_t *)malloc(sizeof(dt_style_item_t));
-
-      style_item->num = sqlite3_column_int(stmt, 0);
-      style_item->selimg_num = 0;
-      style_item->enabled = sqlite3_column_int(stmt, 4);
-      style_item->multi_priority = sqlite3_column_int(stmt, 7);
-      style_item->name = NULL;
-      style_item->operation = g_strdup((char *)sqlite3_column_text(stmt, 2));
-      style_item->multi_name = g_strdup((char *)sqlite3_column_text(stmt, 8));
-      style_item->module_version = sqlite3_column_int(stmt, 1);
-      style_item->blendop_version = sqlite3_column_int(stmt, 6);
-      style_item->params_size = sqlite3_column_bytes(stmt, 3);
-      style_item->params = (void *)malloc(style_item->params_size);
-      memcpy(style_item->params, (void *)sqlite3_column_blob(stmt, 3), style_item->params_size);
-      style_item->blendop_params_size = sqlite3_column_bytes(stmt, 5);
-      style_item->blendop_params = (void *)malloc(style_item->blendop_params_size);
-      memcpy(style_item->blendop_params, (void *)sqlite3_column_blob(stmt, 5), style_item->blendop_params_size);
-      style_item->iop_order = 0;
-
-      si_list = g_list_prepend(si_list, style_item);
-    }
-    sqlite3_finalize(stmt);
-    si_list = g_list_reverse(si_list);  // list was built in reverse order, so un-reverse it
+    GList *si_list = style_items ? dt_styles_item_list_copy(style_items) : _styles_get_apply_items(id);
 
     dt_ioppr_update_for_style_items(dev_dest, si_list, FALSE);
 
@@ -959,7 +1075,10 @@ void dt_styles_apply_to_image(const char *name, const gboolean duplicate, const
     }
 
     /* update xmp file */
-    dt_image_synch_xmp(newimgid);
+    if(synch)
+      *synch = g_list_prepend(*synch, GINT_TO_POINTER(newimgid));
+    else
+      dt_image_synch_xmp(newimgid);
 
     /* remove old obsolete thumbnails */
     dt_mipmap_cache_remove(darktable.mipmap_cache, newimgid);
@@ -976,6 +1095,11 @@ void dt_styles_apply_to_image(const char *name, const gboolean duplicate, const
   }
 }
 
+void dt_styles_apply_to_image(const char *name, const gboolean duplicate, const gboolean overwrite, const int32_t imgid)
+{
+  _styles_apply_to_image_ext(name, duplicate, overwrite, imgid, NULL, NULL);
+}
+
 void dt_styles_delete_by_name_adv(const char *name, const gboolean raise)
 {
   int id = 0;
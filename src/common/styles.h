@@ -111,6 +111,12 @@ GList *dt_styles_get_list(const char *filter);
    the style
 */
 GList *dt_styles_get_item_list(const char *name, gboolean params, int imgid);
+/** get the items of a style with their blend params already converted to the current version, using
+    the modules of dev. for applying one style to many images. the module params of items written by
+    an older module version are left as they are, their conversion may depend on the image. */
+GList *dt_styles_get_resolved_item_list(dt_develop_t *dev, const char *name);
+/** deep copy of a list of style items */
+GList *dt_styles_item_list_copy(const GList *items);
 
 /** get list of items for a named style as a nice string */
 char *dt_styles_get_item_list_as_string(const char *name);
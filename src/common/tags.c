@@ -382,10 +382,130 @@ typedef enum dt_tag_actions_t
 
 static GList *_tag_get_tags(const gint imgid, const dt_tag_type_t type);
 
+// stage the images and the tags of an operation in memory tables, the images keep the list order
+static void _tag_stage(const GList *tags, const GList *imgs)
+{
+  sqlite3 *db = dt_database_get(darktable.db);
+  DT_DEBUG_SQLITE3_EXEC(db, "DELETE FROM memory.tag_images_temp", NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_EXEC(db, "DELETE FROM memory.tag_tags_temp", NULL, NULL, NULL);
+
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, "INSERT INTO memory.tag_images_temp (imgid) VALUES (?1)", -1, &stmt, NULL);
+  for(const GList *images = imgs; images; images = g_list_next(images))
+  {
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, GPOINTER_TO_INT(images->data));
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+  }
+  sqlite3_finalize(stmt);
+
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, "INSERT INTO memory.tag_tags_temp (tagid) VALUES (?1)", -1, &stmt, NULL);
+  for(const GList *t = tags; t; t = g_list_next(t))
+  {
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, GPOINTER_TO_INT(t->data));
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+  }
+  sqlite3_finalize(stmt);
+}
+
+// set-based attach/detach: the before state of all images is read with one query
+// and the change is applied with one statement, whatever the number of images
+static gboolean _tag_execute_bulk(const GList *tags, const GList *imgs, GList **undo, const gboolean undo_on,
+                                  const gint action)
+{
+  sqlite3 *db = dt_database_get(darktable.db);
+  sqlite3_stmt *stmt;
+
+  _tag_stage(tags, imgs);
+
+  if(undo_on)
+  {
+    GHashTable *undo_map = g_hash_table_new(NULL, NULL);
+    GList *undo_list = NULL;
+    for(const GList *images = imgs; images; images = g_list_next(images))
+    {
+      if(g_hash_table_contains(undo_map, images->data)) continue;
+      dt_undo_tags_t *undotags = (dt_undo_tags_t *)malloc(sizeof(dt_undo_tags_t));
+      undotags->imgid = GPOINTER_TO_INT(images->data);
+      undotags->before = NULL;
+      undotags->after = NULL;
+      g_hash_table_insert(undo_map, images->data, undotags);
+      undo_list = g_list_prepend(undo_list, undotags);
+    }
+
+    DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                                "SELECT I.imgid, I.tagid"
+                                "  FROM main.tagged_images AS I"
+                                "  JOIN memory.tag_images_temp AS S ON S.imgid = I.imgid"
+                                "  JOIN data.tags AS T ON T.id = I.tagid",
+                                -1, &stmt, NULL);
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+    {
+      dt_undo_tags_t *undotags = g_hash_table_lookup(undo_map, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
+      if(undotags)
+        undotags->before = g_list_prepend(undotags->before, GINT_TO_POINTER(sqlite3_column_int(stmt, 1)));
+    }
+    sqlite3_finalize(stmt);
+
+    for(GList *l = undo_list; l; l = g_list_next(l))
+    {
+      dt_undo_tags_t *undotags = (dt_undo_tags_t *)l->data;
+      undotags->after = g_list_copy(undotags->before);
+      if(action == DT_TA_ATTACH)
+        _tag_add_tags_to_list(&undotags->after, tags);
+      else
+        _tag_remove_tags_from_list(&undotags->after, tags);
+    }
+    *undo = g_list_concat(*undo, g_list_reverse(undo_list));
+    g_hash_table_destroy(undo_map);
+  }
+
+  if(action == DT_TA_ATTACH)
+    // like _bulk_add_tags(), the images get their position after the current last one, in list order
+    DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                                "INSERT INTO main.tagged_images (imgid, tagid, position)"
+                                "  SELECT S.imgid, T.tagid,"
+                                "         (SELECT IFNULL(MAX(position),0) & 0xFFFFFFFF00000000"
+                                "            FROM main.tagged_images) + (S.seq << 32)"
+                                "  FROM memory.tag_images_temp AS S, memory.tag_tags_temp AS T"
+                                "  WHERE NOT EXISTS (SELECT 1 FROM main.tagged_images AS I"
+                                "                    WHERE I.imgid = S.imgid AND I.tagid = T.tagid)",
+                                -1, &stmt, NULL);
+  else
+    DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                                "DELETE FROM main.tagged_images"
+                                "  WHERE imgid IN (SELECT imgid FROM memory.tag_images_temp)"
+                                "    AND tagid IN (SELECT tagid FROM memory.tag_tags_temp)",
+                                -1, &stmt, NULL);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  const gboolean res = sqlite3_changes(db) > 0;
+
+  DT_DEBUG_SQLITE3_EXEC(db, "DELETE FROM memory.tag_images_temp", NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_EXEC(db, "DELETE FROM memory.tag_tags_temp", NULL, NULL, NULL);
+
+  return res;
+}
+
 static gboolean _tag_execute(const GList *tags, const GList *imgs, GList **undo, const gboolean undo_on,
                              const gint action)
 {
+  const int statements = g_atomic_int_get(&darktable.sql_statements);
+  const double start = dt_get_wtime();
   gboolean res = FALSE;
+
+  // a single image is cheaper done directly than staged
+  if(imgs && imgs->next && (action == DT_TA_ATTACH || action == DT_TA_DETACH))
+  {
+    res = _tag_execute_bulk(tags, imgs, undo, undo_on, action);
+    dt_print(DT_DEBUG_PERF, "[tags] %s %d tag(s) on %d images: %d sql statements in %.3f secs\n",
+             action == DT_TA_ATTACH ? "attach" : "detach", g_list_length((GList *)tags),
+             g_list_length((GList *)imgs), g_atomic_int_get(&darktable.sql_statements) - statements,
+             dt_get_wtime() - start);
+    return res;
+  }
+
   for(const GList *images = imgs; images; images = g_list_next(images))
   {
     const int image_id = GPOINTER_TO_INT(images->data);
@@ -424,6 +544,9 @@ static gboolean _tag_execute(const GList *tags, const GList *imgs, GList **undo,
     else
       _undo_tags_free(undotags);
   }
+  dt_print(DT_DEBUG_PERF, "[tags] action %d of %d tag(s) on %d image(s): %d sql statements in %.3f secs\n",
+           action, g_list_length((GList *)tags), g_list_length((GList *)imgs),
+           g_atomic_int_get(&darktable.sql_statements) - statements, dt_get_wtime() - start);
   return res;
 }
 
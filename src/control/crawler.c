@@ -59,34 +59,87 @@ typedef struct dt_control_crawler_result_t
 } dt_control_crawler_result_t;
 
 
-GList *dt_control_crawler_run()
+// one row of the library, and what the crawler found on disk for it
+typedef struct dt_control_crawler_entry_t
 {
-  sqlite3_stmt *stmt, *inner_stmt;
-  GList *result = NULL;
-  gboolean look_for_xmp = (dt_image_get_xmp_mode() != DT_WRITE_XMP_NEVER);
+  int id;
+  time_t timestamp;
+  int version;
+  int flags, new_flags;
+  gboolean missing;
+  gboolean xmp_newer;
+  time_t timestamp_xmp;
+  gchar *image_path;
+  gchar *xmp_path;
+} dt_control_crawler_entry_t;
 
-  sqlite3_prepare_v2(dt_database_get(darktable.db),
-                     "SELECT i.id, write_timestamp, version, folder || '" G_DIR_SEPARATOR_S "' || filename, flags "
-                     "FROM main.images i, main.film_rolls f ON i.film_id = f.id ORDER BY f.id, filename",
-                     -1, &stmt, NULL);
-  sqlite3_prepare_v2(dt_database_get(darktable.db), "UPDATE main.images SET flags = ?1 WHERE id = ?2", -1,
-                     &inner_stmt, NULL);
+static int _crawler_stat_mtime(const char *path, time_t *mtime)
+{
+  // on Windows the encoding might not be UTF8
+  gchar *path_locale = dt_util_normalize_path(path);
+  int stat_res = -1;
+#ifdef _WIN32
+  // UTF8 paths fail in this context, but converting to UTF16 works
+  struct _stati64 statbuf;
+  if(path_locale) // in Windows dt_util_normalize_path returns NULL if file does not exist
+  {
+    wchar_t *wfilename = g_utf8_to_utf16(path_locale, -1, NULL, NULL, NULL);
+    stat_res = _wstati64(wfilename, &statbuf);
+    g_free(wfilename);
+  }
+#else
+  struct stat statbuf;
+  stat_res = stat(path_locale, &statbuf);
+#endif
+  g_free(path_locale);
+  if(!stat_res) *mtime = statbuf.st_mtime;
+  return stat_res;
+}
 
-  // let's wrap this into a transaction, it might make it a little faster.
-  sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
+static gboolean _crawler_has_file(GHashTable *names, const char *path, const gboolean casefold)
+{
+  // without a directory listing we have to ask the file system
+  if(!names) return g_file_test(path, G_FILE_TEST_EXISTS);
+  gchar *basename = g_path_get_basename(path);
+  gchar *key = casefold ? g_utf8_casefold(basename, -1) : basename;
+  const gboolean found = g_hash_table_contains(names, key);
+  if(casefold) g_free(key);
+  g_free(basename);
+  return found;
+}
 
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+// check all images of one folder. the folder is read once and the names of its files are kept in a set,
+// this replaces the up to six requests per image to the file system, which are slow on network shares.
+static void _crawler_check_folder(const char *folder, dt_control_crawler_entry_t *entries, const int count,
+                                  const gboolean look_for_xmp)
+{
+  GHashTable *names = NULL, *names_casefold = NULL;
+  GDir *dir = g_dir_open(folder, 0, NULL);
+  if(dir)
   {
-    const int id = sqlite3_column_int(stmt, 0);
-    const time_t timestamp = sqlite3_column_int(stmt, 1);
-    const int version = sqlite3_column_int(stmt, 2);
-    const gchar *image_path = (char *)sqlite3_column_text(stmt, 3);
-    int flags = sqlite3_column_int(stmt, 4);
-
-    // if the image is missing we ignore it.
-    if(!g_file_test(image_path, G_FILE_TEST_EXISTS))
+    // the case folded names catch the .xmp/.XMP, .txt/.TXT and .wav/.WAV variants with one lookup
+    names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    names_casefold = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    const gchar *name;
+    while((name = g_dir_read_name(dir)))
     {
-      dt_print(DT_DEBUG_CONTROL, "[crawler] `%s' (id: %d) is missing.\n", image_path, id);
+      g_hash_table_add(names, g_strdup(name));
+      g_hash_table_add(names_casefold, g_utf8_casefold(name, -1));
+    }
+    g_dir_close(dir);
+  }
+
+  for(int i = 0; i < count; i++)
+  {
+    dt_control_crawler_entry_t *e = entries + i;
+    const gchar *image_path = e->image_path;
+    e->new_flags = e->flags;
+
+    // if the image is missing we ignore it. the file system might not be case sensitive, so ask it when the
+    // name is not in the listing.
+    if(!_crawler_has_file(names, image_path, FALSE) && (!names || !g_file_test(image_path, G_FILE_TEST_EXISTS)))
+    {
+      e->missing = TRUE;
       continue;
     }
 
@@ -96,7 +149,7 @@ GList *dt_control_crawler_run()
       // construct the xmp filename for this image
       gchar xmp_path[PATH_MAX] = { 0 };
       g_strlcpy(xmp_path, image_path, sizeof(xmp_path));
-      dt_image_path_append_version_no_db(version, xmp_path, sizeof(xmp_path));
+      dt_image_path_append_version_no_db(e->version, xmp_path, sizeof(xmp_path));
       size_t len = strlen(xmp_path);
       if(len + 4 >= PATH_MAX) continue;
       xmp_path[len++] = '.';
@@ -105,43 +158,20 @@ GList *dt_control_crawler_run()
       xmp_path[len++] = 'p';
       xmp_path[len] = '\0';
 
-      // on Windows the encoding might not be UTF8
-      gchar *xmp_path_locale = dt_util_normalize_path(xmp_path);
-      int stat_res = -1;
-#ifdef _WIN32
-      // UTF8 paths fail in this context, but converting to UTF16 works
-      struct _stati64 statbuf;
-      if(xmp_path_locale) // in Windows dt_util_normalize_path returns NULL if file does not exist
-      {
-        wchar_t *wfilename = g_utf8_to_utf16(xmp_path_locale, -1, NULL, NULL, NULL);
-        stat_res = _wstati64(wfilename, &statbuf);
-        g_free(wfilename);
-      }
- #else
-      struct stat statbuf;
-      stat_res = stat(xmp_path_locale, &statbuf);
-#endif
-      g_free(xmp_path_locale);
-      if(stat_res) continue; // TODO: shall we report these?
+      time_t timestamp_xmp = 0;
+      // TODO: shall we report missing xmp files?
+      if(!_crawler_has_file(names_casefold, xmp_path, TRUE) || _crawler_stat_mtime(xmp_path, &timestamp_xmp))
+        continue;
 
       // step 1: check if the xmp is newer than our db entry
       // FIXME: allow for a few seconds difference?
-      if(timestamp < statbuf.st_mtime)
+      if(e->timestamp < timestamp_xmp)
       {
-        dt_control_crawler_result_t *item
-            = (dt_control_crawler_result_t *)malloc(sizeof(dt_control_crawler_result_t));
-        item->id = id;
-        item->timestamp_xmp = statbuf.st_mtime;
-        item->timestamp_db = timestamp;
-        item->image_path = g_strdup(image_path);
-        item->xmp_path = g_strdup(xmp_path);
-
-        result = g_list_prepend(result, item);
-        dt_print(DT_DEBUG_CONTROL, "[crawler] `%s' (id: %d) is a newer xmp file.\n", xmp_path, id);
+        e->xmp_newer = TRUE;
+        e->timestamp_xmp = timestamp_xmp;
+        e->xmp_path = g_strdup(xmp_path);
       }
       // older timestamps are the case for all images after the db upgrade. better not report these
-      //       else if(timestamp > statbuf.st_mtime)
-      //         printf("`%s' (%d) has an older xmp file.\n", image_path, id);
     }
 
     // step 2: check if the image has associated files (.txt, .wav)
@@ -156,57 +186,138 @@ GList *dt_control_crawler_run()
     extra_path[len] = 't';
     extra_path[len + 1] = 'x';
     extra_path[len + 2] = 't';
-    gboolean has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
-
-    if(!has_txt)
-    {
-      extra_path[len] = 'T';
-      extra_path[len + 1] = 'X';
-      extra_path[len + 2] = 'T';
-      has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
-    }
+    const gboolean has_txt = _crawler_has_file(names_casefold, extra_path, TRUE);
 
     extra_path[len] = 'w';
     extra_path[len + 1] = 'a';
     extra_path[len + 2] = 'v';
-    gboolean has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
-
-    if(!has_wav)
-    {
-      extra_path[len] = 'W';
-      extra_path[len + 1] = 'A';
-      extra_path[len + 2] = 'V';
-      has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
-    }
+    const gboolean has_wav = _crawler_has_file(names_casefold, extra_path, TRUE);
 
     // TODO: decide if we want to remove the flag for images that lost their extra file. currently we do (the
     // else cases)
-    int new_flags = flags;
     if(has_txt)
-      new_flags |= DT_IMAGE_HAS_TXT;
+      e->new_flags |= DT_IMAGE_HAS_TXT;
     else
-      new_flags &= ~DT_IMAGE_HAS_TXT;
+      e->new_flags &= ~DT_IMAGE_HAS_TXT;
     if(has_wav)
-      new_flags |= DT_IMAGE_HAS_WAV;
+      e->new_flags |= DT_IMAGE_HAS_WAV;
     else
-      new_flags &= ~DT_IMAGE_HAS_WAV;
-    if(flags != new_flags)
+      e->new_flags &= ~DT_IMAGE_HAS_WAV;
+
+    free(extra_path);
+  }
+
+  if(names) g_hash_table_destroy(names);
+  if(names_casefold) g_hash_table_destroy(names_casefold);
+}
+
+GList *dt_control_crawler_run()
+{
+  sqlite3_stmt *stmt, *inner_stmt;
+  GList *result = NULL;
+  const gboolean look_for_xmp = (dt_image_get_xmp_mode() != DT_WRITE_XMP_NEVER);
+  const double start = dt_get_wtime();
+
+  // read the library first, the images of a film roll come in a row
+  GArray *entries = g_array_new(FALSE, TRUE, sizeof(dt_control_crawler_entry_t));
+  GArray *folders = g_array_new(FALSE, FALSE, sizeof(int)); // index of the first image of each folder
+  GPtrArray *folder_names = g_ptr_array_new_with_free_func(g_free);
+  sqlite3_prepare_v2(dt_database_get(darktable.db),
+                     "SELECT i.id, write_timestamp, version, folder || '" G_DIR_SEPARATOR_S "' || filename, flags,"
+                     " f.id, folder "
+                     "FROM main.images i, main.film_rolls f ON i.film_id = f.id ORDER BY f.id, filename",
+                     -1, &stmt, NULL);
+  int last_film = -1;
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    dt_control_crawler_entry_t e = { 0 };
+    e.id = sqlite3_column_int(stmt, 0);
+    e.timestamp = sqlite3_column_int(stmt, 1);
+    e.version = sqlite3_column_int(stmt, 2);
+    e.image_path = g_strdup((const char *)sqlite3_column_text(stmt, 3));
+    e.flags = sqlite3_column_int(stmt, 4);
+    const int film_id = sqlite3_column_int(stmt, 5);
+    if(film_id != last_film)
     {
-      sqlite3_bind_int(inner_stmt, 1, new_flags);
-      sqlite3_bind_int(inner_stmt, 2, id);
-      sqlite3_step(inner_stmt);
-      sqlite3_reset(inner_stmt);
-      sqlite3_clear_bindings(inner_stmt);
+      const int first = entries->len;
+      g_array_append_val(folders, first);
+      g_ptr_array_add(folder_names, g_strdup((const char *)sqlite3_column_text(stmt, 6)));
+      last_film = film_id;
     }
+    g_array_append_val(entries, e);
+  }
+  sqlite3_finalize(stmt);
 
-    free(extra_path);
+  // then look at the folders, in parallel as most of the time is spent waiting for the file system
+  const int nfolders = folders->len;
+  const int nentries = entries->len;
+  dt_control_crawler_entry_t *const all = (dt_control_crawler_entry_t *)entries->data;
+  const int *const first = (const int *)folders->data;
+  char **const paths = (char **)folder_names->pdata;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(nfolders, nentries, all, first, paths, look_for_xmp) \
+  schedule(dynamic)
+#endif
+  for(int k = 0; k < nfolders; k++)
+  {
+    const int end = (k + 1 < nfolders) ? first[k + 1] : nentries;
+    _crawler_check_folder(paths[k], all + first[k], end - first[k], look_for_xmp);
+  }
+
+  sqlite3_prepare_v2(dt_database_get(darktable.db), "UPDATE main.images SET flags = ?1 WHERE id = ?2", -1,
+                     &inner_stmt, NULL);
+
+  // let's wrap this into a transaction, it might make it a little faster.
+  sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
+
+  for(int i = 0; i < nentries; i++)
+  {
+    dt_control_crawler_entry_t *e = all + i;
+    if(e->missing)
+    {
+      dt_print(DT_DEBUG_CONTROL, "[crawler] `%s' (id: %d) is missing.\n", e->image_path, e->id);
+    }
+    else
+    {
+      if(e->xmp_newer)
+      {
+        dt_control_crawler_result_t *item
+            = (dt_control_crawler_result_t *)malloc(sizeof(dt_control_crawler_result_t));
+        item->id = e->id;
+        item->timestamp_xmp = e->timestamp_xmp;
+        item->timestamp_db = e->timestamp;
+        item->image_path = g_strdup(e->image_path);
+        item->xmp_path = g_strdup(e->xmp_path);
+
+        result = g_list_prepend(result, item);
+        dt_print(DT_DEBUG_CONTROL, "[crawler] `%s' (id: %d) is a newer xmp file.\n", e->xmp_path, e->id);
+      }
+
+      if(e->flags != e->new_flags)
+      {
+        sqlite3_bind_int(inner_stmt, 1, e->new_flags);
+        sqlite3_bind_int(inner_stmt, 2, e->id);
+        sqlite3_step(inner_stmt);
+        sqlite3_reset(inner_stmt);
+        sqlite3_clear_bindings(inner_stmt);
+      }
+    }
+    g_free(e->image_path);
+    g_free(e->xmp_path);
   }
 
   sqlite3_exec(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
 
-  sqlite3_finalize(stmt);
   sqlite3_finalize(inner_stmt);
 
+  dt_print(DT_DEBUG_PERF, "[crawler] %d images in %d folders checked in %.3f secs\n", nentries, nfolders,
+           dt_get_wtime() - start);
+
+  g_array_free(entries, TRUE);
+  g_array_free(folders, TRUE);
+  g_ptr_array_free(folder_names, TRUE);
+
   return g_list_reverse(result); // list was built in reverse order, so un-reverse it
 }
 
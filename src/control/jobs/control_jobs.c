@@ -61,6 +61,9 @@
 // overall time for a large import.
 #define PROGRESS_UPDATE_INTERVAL 0.5
 
+// upper bound of images in flight in an export job, see plugins/lighttable/export/pipeline_depth
+#define MAX_EXPORT_LANES 8
+
 typedef struct dt_control_datetime_t
 {
   long int offset;
@@ -1319,6 +1322,124 @@ static int32_t dt_control_refresh_exif_run(dt_job_t *job)
 }
 
 
+// shared state of the lanes of a staged export job
+typedef struct _export_job_state_t
+{
+  dt_job_t *job;
+  dt_control_export_t *settings;
+  dt_imageio_module_format_t *mformat;
+  dt_imageio_module_storage_t *mstorage;
+  dt_imageio_module_data_t *sdata;
+  dt_export_metadata_t *metadata;
+  guint tagid, etagid;
+  GList *next;      // next image to be picked up by a lane
+  guint total, started, finished;
+  gboolean tag_change;
+  dt_pthread_mutex_t lock;
+} _export_job_state_t;
+
+typedef struct _export_job_lane_t
+{
+  _export_job_state_t *state;
+  dt_imageio_module_data_t *fdata; // every lane encodes with its own format data
+  dt_imageio_export_lane_t stats;
+  pthread_t thread;
+} _export_job_lane_t;
+
+static void _export_job_image(_export_job_state_t *s, dt_imageio_module_data_t *fdata, const int imgid,
+                              const guint num)
+{
+  dt_control_export_t *settings = s->settings;
+
+  // remove 'changed' tag from image
+  gboolean tag_change = dt_tag_detach(s->tagid, imgid, FALSE, FALSE);
+  // make sure the 'exported' tag is set on the image
+  tag_change |= dt_tag_attach(s->etagid, imgid, FALSE, FALSE);
+  if(tag_change)
+  {
+    dt_pthread_mutex_lock(&s->lock);
+    s->tag_change = TRUE;
+    dt_pthread_mutex_unlock(&s->lock);
+  }
+
+  /* register export timestamp in cache */
+  dt_image_cache_set_export_timestamp(darktable.image_cache, imgid);
+
+  // check if image still exists:
+  const dt_image_t *image = dt_image_cache_get(darktable.image_cache, (int32_t)imgid, 'r');
+  if(image)
+  {
+    char imgfilename[PATH_MAX] = { 0 };
+    gboolean from_cache = TRUE;
+    dt_image_full_path(image->id, imgfilename, sizeof(imgfilename), &from_cache);
+    if(!g_file_test(imgfilename, G_FILE_TEST_IS_REGULAR))
+    {
+      dt_control_log(_("image `%s' is currently unavailable"), image->filename);
+      fprintf(stderr, "image `%s' is currently unavailable\n", imgfilename);
+      // dt_image_remove(imgid);
+      dt_image_cache_read_release(darktable.image_cache, image);
+    }
+    else
+    {
+      dt_image_cache_read_release(darktable.image_cache, image);
+      if(s->mstorage->store(s->mstorage, s->sdata, imgid, s->mformat, fdata, num, s->total, settings->high_quality,
+                            settings->upscale, settings->export_masks, settings->icc_type, settings->icc_filename,
+                            settings->icc_intent, s->metadata) != 0)
+        dt_control_job_cancel(s->job);
+    }
+  }
+}
+
+// a lane picks the next image, runs pipe, encoding and storage for it and goes on with the
+// next one. the pipe stage is serialized between lanes by the pipe lock of the lane stats,
+// so with n lanes up to n-1 images are being encoded or stored while the next one is processed.
+static void *_export_job_lane_run(void *data)
+{
+  _export_job_lane_t *lane = (_export_job_lane_t *)data;
+  _export_job_state_t *s = lane->state;
+  dt_imageio_export_lane_t *stats = &lane->stats;
+
+  dt_imageio_export_set_lane(stats);
+  while(TRUE)
+  {
+    dt_pthread_mutex_lock(&s->lock);
+    if(!s->next || dt_control_job_get_state(s->job) == DT_JOB_STATE_CANCELLED)
+    {
+      dt_pthread_mutex_unlock(&s->lock);
+      break;
+    }
+    const int imgid = GPOINTER_TO_INT(s->next->data);
+    s->next = g_list_next(s->next);
+    const guint num = ++s->started;
+
+    // progress message
+    char message[512] = { 0 };
+    snprintf(message, sizeof(message), _("exporting %d / %d to %s"), num, s->total, s->mstorage->name(s->mstorage));
+    // update the message. initialize_store() might have changed the number of images
+    dt_control_job_set_progress_message(s->job, message);
+    dt_pthread_mutex_unlock(&s->lock);
+
+    // whatever isn't spent in pipe or encoder inside store() is accounted to storing
+    const double start = dt_get_wtime();
+    const double inner = stats->busy[DT_IMAGEIO_EXPORT_STAGE_PIPE] + stats->busy[DT_IMAGEIO_EXPORT_STAGE_ENCODE]
+                         + stats->pipe_wait;
+    _export_job_image(s, lane->fdata, imgid, num);
+    stats->busy[DT_IMAGEIO_EXPORT_STAGE_STORE]
+        += dt_get_wtime() - start
+           - (stats->busy[DT_IMAGEIO_EXPORT_STAGE_PIPE] + stats->busy[DT_IMAGEIO_EXPORT_STAGE_ENCODE]
+              + stats->pipe_wait - inner);
+    stats->images++;
+
+    dt_pthread_mutex_lock(&s->lock);
+    s->finished++;
+    dt_control_job_set_progress(s->job, MIN(1.0, (double)s->finished / s->total));
+    dt_pthread_mutex_unlock(&s->lock);
+  }
+  dt_imageio_export_lane_cleanup(stats);
+  dt_imageio_export_set_lane(NULL);
+  return NULL;
+}
+
 static int32_t dt_control_export_job_run(dt_job_t *job)
 {
   dt_control_image_enumerator_t *params = (dt_control_image_enumerator_t *)dt_control_job_get_params(job);
@@ -1365,8 +1486,6 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
   const guint total = g_list_length(t);
   dt_control_log(ngettext("exporting %d image..", "exporting %d images..", total), total);
 
-  double fraction = 0;
-
   // set up the fdata struct
   fdata->max_width = (settings->max_width != 0 && w != 0) ? MIN(w, settings->max_width) : MAX(w, settings->max_width);
   fdata->max_height = (settings->max_height != 0 && h != 0) ? MIN(h, settings->max_height) : MAX(h, settings->max_height);
@@ -1387,54 +1506,76 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
     metadata.list = g_list_remove(metadata.list, metadata.list->data);
   }
 
-  while(t && dt_control_job_get_state(job) != DT_JOB_STATE_CANCELLED)
-  {
-    const int imgid = GPOINTER_TO_INT(t->data);
-    t = g_list_next(t);
-    const guint num = total - g_list_length(t);
-
-    // progress message
-    char message[512] = { 0 };
-    snprintf(message, sizeof(message), _("exporting %d / %d to %s"), num, total, mstorage->name(mstorage));
-    // update the message. initialize_store() might have changed the number of images
-    dt_control_job_set_progress_message(job, message);
-
-    // remove 'changed' tag from image
-    if(dt_tag_detach(tagid, imgid, FALSE, FALSE)) tag_change = TRUE;
-    // make sure the 'exported' tag is set on the image
-    if(dt_tag_attach(etagid, imgid, FALSE, FALSE)) tag_change = TRUE;
+  _export_job_state_t state = { .job = job, .settings = settings, .mformat = mformat, .mstorage = mstorage,
+                                 .sdata = sdata, .metadata = &metadata, .tagid = tagid, .etagid = etagid,
+                                 .next = t, .total = total };
+  dt_pthread_mutex_init(&state.lock, NULL);
+  dt_pthread_mutex_t pipe_lock;
+  dt_pthread_mutex_init(&pipe_lock, NULL);
 
-    /* register export timestamp in cache */
-    dt_image_cache_set_export_timestamp(darktable.image_cache, imgid);
+  // overlap pipe, encoding and storing of consecutive images if the storage can take it
+  int num_lanes = 1;
+  if(mstorage->concurrent_store && mstorage->concurrent_store(mstorage))
+    num_lanes = CLAMP(dt_conf_get_int("plugins/lighttable/export/pipeline_depth"), 1, MAX_EXPORT_LANES);
+  num_lanes = MIN(num_lanes, MAX(total, 1));
 
-    // check if image still exists:
-    const dt_image_t *image = dt_image_cache_get(darktable.image_cache, (int32_t)imgid, 'r');
-    if(image)
+  _export_job_lane_t lanes[MAX_EXPORT_LANES] = { { 0 } };
+  for(int k = 0; k < num_lanes; k++)
+  {
+    lanes[k].state = &state;
+    lanes[k].stats.pipe_lock = num_lanes > 1 ? &pipe_lock : NULL;
+    if(k == 0)
+      lanes[k].fdata = fdata;
+    else
     {
-      char imgfilename[PATH_MAX] = { 0 };
-      gboolean from_cache = TRUE;
-      dt_image_full_path(image->id, imgfilename, sizeof(imgfilename), &from_cache);
-      if(!g_file_test(imgfilename, G_FILE_TEST_IS_REGULAR))
+      lanes[k].fdata = mformat->get_params(mformat);
+      if(!lanes[k].fdata)
       {
-        dt_control_log(_("image `%s' is currently unavailable"), image->filename);
-        fprintf(stderr, "image `%s' is currently unavailable\n", imgfilename);
-        // dt_image_remove(imgid);
-        dt_image_cache_read_release(darktable.image_cache, image);
-      }
-      else
-      {
-        dt_image_cache_read_release(darktable.image_cache, image);
-        if(mstorage->store(mstorage, sdata, imgid, mformat, fdata, num, total, settings->high_quality, settings->upscale,
-                           settings->export_masks, settings->icc_type, settings->icc_filename, settings->icc_intent,
-                           &metadata) != 0)
-          dt_control_job_cancel(job);
+        num_lanes = k;
+        break;
       }
+      memcpy(lanes[k].fdata, fdata, mformat->params_size(mformat));
     }
+  }
 
-    fraction += 1.0 / total;
-    if(fraction > 1.0) fraction = 1.0;
-    dt_control_job_set_progress(job, fraction);
+  const double job_start = dt_get_wtime();
+  int started_lanes = 1;
+  for(int k = 1; k < num_lanes; k++)
+  {
+    if(dt_pthread_create(&lanes[k].thread, _export_job_lane_run, &lanes[k])) break;
+    started_lanes++;
+  }
+  // the job thread is a lane itself
+  _export_job_lane_run(&lanes[0]);
+  for(int k = 1; k < started_lanes; k++) pthread_join(lanes[k].thread, NULL);
+  const double wall = MAX(dt_get_wtime() - job_start, 1e-6);
+
+  if(darktable.unmuted & DT_DEBUG_PERF)
+  {
+    dt_imageio_export_lane_t sum = { 0 };
+    for(int k = 0; k < started_lanes; k++)
+    {
+      for(int st = 0; st < DT_IMAGEIO_EXPORT_STAGE_LAST; st++) sum.busy[st] += lanes[k].stats.busy[st];
+      sum.pipe_wait += lanes[k].stats.pipe_wait;
+      sum.setup += lanes[k].stats.setup;
+      sum.images += lanes[k].stats.images;
+      sum.reused += lanes[k].stats.reused;
+    }
+    dt_print(DT_DEBUG_PERF,
+             "[export_job] %d images in %.2f s with %d lane(s), stage utilization: pipe %.0f%%, encode %.0f%%, "
+             "store %.0f%%, %.2f s waiting for the pipe\n",
+             sum.images, wall, started_lanes, 100.0 * sum.busy[DT_IMAGEIO_EXPORT_STAGE_PIPE] / wall,
+             100.0 * sum.busy[DT_IMAGEIO_EXPORT_STAGE_ENCODE] / wall,
+             100.0 * sum.busy[DT_IMAGEIO_EXPORT_STAGE_STORE] / wall, sum.pipe_wait);
+    dt_print(DT_DEBUG_PERF, "[export_job] develop and pipe setup %.3f s per image, %d of %d reused\n",
+             sum.images ? sum.setup / sum.images : 0.0, sum.reused, sum.images);
   }
+
+  for(int k = 1; k < num_lanes; k++) mformat->free_params(mformat, lanes[k].fdata);
+  dt_pthread_mutex_destroy(&pipe_lock);
+  dt_pthread_mutex_destroy(&state.lock);
+  tag_change = state.tag_change;
+
   g_list_free_full(metadata.list, g_free);
 
   if(mstorage->finalize_store) mstorage->finalize_store(mstorage, sdata);
@@ -2061,6 +2202,40 @@ void dt_control_write_sidecar_files()
                                                           FALSE));
 }
 
+static int32_t _control_synch_xmps_job_run(dt_job_t *job)
+{
+  dt_control_image_enumerator_t *params = dt_control_job_get_params(job);
+  dt_image_synch_xmps(params->index);
+  return 0;
+}
+
+void dt_control_write_sidecar_files_list(GList *imgs)
+{
+  if(!imgs) return;
+  if(dt_image_get_xmp_mode() == DT_WRITE_XMP_NEVER)
+  {
+    g_list_free(imgs);
+    return;
+  }
+
+  dt_job_t *job = dt_control_job_create(&_control_synch_xmps_job_run, "%s", N_("write sidecar files"));
+  if(!job)
+  {
+    g_list_free(imgs);
+    return;
+  }
+  dt_control_image_enumerator_t *params = dt_control_image_enumerator_alloc();
+  if(!params)
+  {
+    g_list_free(imgs);
+    dt_control_job_dispose(job);
+    return;
+  }
+  params->index = imgs;
+  dt_control_job_set_params(job, params, dt_control_image_enumerator_cleanup);
+  dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_BG, job);
+}
+
 static int _control_import_image_copy(const char *filename,
                                       char **prev_filename, char **prev_output,
                                       struct dt_import_session_t *session, GList **imgs)
@@ -31,6 +31,8 @@ void dt_control_gpx_apply(const gchar *filename, int32_t filmid, const gchar *tz
 void dt_control_datetime(const long int offset, const char *datetime, GList *imgs);
 
 void dt_control_write_sidecar_files();
+/** write the sidecars of the given images in a background job, takes ownership of the list */
+void dt_control_write_sidecar_files_list(GList *imgs);
 void dt_control_delete_images();
 void dt_control_delete_image(int imgid);
 void dt_control_duplicate_images();
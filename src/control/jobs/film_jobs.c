@@ -19,6 +19,7 @@
 #include "common/darktable.h"
 #include "common/collection.h"
 #include "common/film.h"
+#include "common/folder_scan.h"
 #include <stdlib.h>
 
 typedef struct dt_film_import1_t
@@ -122,22 +123,8 @@ dt_job_t *dt_pathlist_import_create(int argc, char *argv[])
     else
     {
       // iterate over the directory, extracting image files
-      GDir *cdir = g_dir_open(path, 0, NULL);
-      if (cdir)
-      {
-        while(TRUE)
-        {
-          const gchar *fname = g_dir_read_name(cdir);
-          if(!fname) break;  			// no more files in directory
-          if(fname[0] == '.') continue; 	// skip hidden files
-          gchar *fullname = g_build_filename(path, fname, NULL);
-          if(!g_file_test(fullname, G_FILE_TEST_IS_DIR) && dt_supported_image(fname))
-            params->imagelist = g_list_prepend(params->imagelist, fullname);
-          else
-            g_free(fullname);
-        }
-      }
-      g_dir_close(cdir);
+      params->imagelist = g_list_concat(g_list_reverse(dt_folder_scan_images(path, FALSE, FALSE, NULL)),
+                                        params->imagelist);
       g_free(path);
     }
   }
@@ -145,49 +132,6 @@ dt_job_t *dt_pathlist_import_create(int argc, char *argv[])
   return job;
 }
 
-static GList *_film_recursive_get_files(const gchar *path, gboolean recursive, GList **result)
-{
-  gchar *fullname;
-
-  /* let's try open current dir */
-  GDir *cdir = g_dir_open(path, 0, NULL);
-  if(!cdir) return *result;
-
-  /* lets read all files in current dir, recurse
-     into directories if we should import recursive.
-   */
-  do
-  {
-    /* get the current filename */
-    const gchar *filename = g_dir_read_name(cdir);
-
-    /* return if no more files are in current dir */
-    if(!filename) break;
-    if(filename[0] == '.') continue;
-
-    /* build full path for filename */
-    fullname = g_build_filename(path, filename, NULL);
-
-    /* recurse into directory if we hit one and we doing a recursive import */
-    if(recursive && g_file_test(fullname, G_FILE_TEST_IS_DIR))
-    {
-      *result = _film_recursive_get_files(fullname, recursive, result);
-      g_free(fullname);
-    }
-    /* or test if we found a supported image format to import */
-    else if(!g_file_test(fullname, G_FILE_TEST_IS_DIR) && dt_supported_image(filename))
-      *result = g_list_prepend(*result, fullname);
-    else
-      g_free(fullname);
-
-  } while(TRUE);
-
-  /* cleanup and return results */
-  g_dir_close(cdir);
-
-  return *result;
-}
-
 /* check if we can find a gpx data file to be auto applied
    to images in the just imported filmroll
 */
@@ -228,15 +172,23 @@ static int _film_filename_cmp(gchar *a, gchar *b)
 
 static void _film_import1(dt_job_t *job, dt_film_t *film, GList *images)
 {
+  // the snapshots of the scanned folders, recorded only once all their images made it into the library
+  dt_folder_scan_t *scan = NULL;
+
   // first, gather all images to import if not already given
   if (!images)
   {
     const gboolean recursive = dt_conf_get_bool("ui_last/import_recursive");
+    const gboolean only_changed = dt_conf_get_bool("ui_last/import_only_changed_folders");
 
-    images = _film_recursive_get_files(film->dirname, recursive, &images);
+    images = dt_folder_scan_images(film->dirname, recursive, only_changed, &scan);
     if(images == NULL)
     {
-      dt_control_log(_("no supported images were found to be imported"));
+      if(only_changed)
+        dt_control_log(_("no new images were found in the changed folders"));
+      else
+        dt_control_log(_("no supported images were found to be imported"));
+      dt_folder_scan_commit(scan);
       return;
     }
   }
@@ -260,7 +212,7 @@ static void _film_import1(dt_job_t *job, dt_film_t *film, GList *images)
   lua_pushvalue(L, -1);
   dt_lua_event_trigger(L, "pre-import", 1);
   {
-    g_list_free_full(images, g_free);
+    GList *listed = images;
     // recreate list of images
     images = NULL;
     for(int i = 1; i < image_count; i++)
@@ -274,6 +226,22 @@ static void _film_import1(dt_job_t *job, dt_film_t *film, GList *images)
       }
       lua_pop(L, 1);
     }
+
+    // the folders of the images filtered out have to be listed again by the next import
+    if(scan)
+    {
+      GHashTable *kept = g_hash_table_new(g_str_hash, g_str_equal);
+      for(GList *elt = images; elt; elt = g_list_next(elt)) g_hash_table_add(kept, elt->data);
+      for(GList *elt = listed; elt; elt = g_list_next(elt))
+      {
+        if(g_hash_table_contains(kept, elt->data)) continue;
+        gchar *folder = g_path_get_dirname((const gchar *)elt->data);
+        dt_folder_scan_skip(scan, folder);
+        g_free(folder);
+      }
+      g_hash_table_destroy(kept);
+    }
+    g_list_free_full(listed, g_free);
   }
 
   lua_pop(L, 1); // remove the table again from the stack
@@ -284,6 +252,7 @@ static void _film_import1(dt_job_t *job, dt_film_t *film, GList *images)
   if(images == NULL)
   {
     // no error message, lua probably emptied the list on purpose
+    dt_folder_scan_commit(scan);
     return;
   }
 
@@ -331,10 +300,11 @@ static void _film_import1(dt_job_t *job, dt_film_t *film, GList *images)
       dt_film_new(cfr, cdn);
     }
 
-    g_free(cdn);
-
     /* import image */
     const int32_t imgid = dt_image_import(cfr->id, (const gchar *)image->data, FALSE, FALSE);
+    // ignored or failed, its folder has to be listed again by the next import
+    if(!imgid) dt_folder_scan_skip(scan, cdn);
+    g_free(cdn);
     pending++;  // we have another image which hasn't been reported yet
     fraction += 1.0 / total;
     dt_control_job_set_progress(job, fraction);
@@ -359,6 +329,11 @@ static void _film_import1(dt_job_t *job, dt_film_t *film, GList *images)
   g_list_free_full(images, g_free);
   all_imgs = g_list_reverse(all_imgs);
 
+  if(dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED)
+    dt_folder_scan_free(scan);
+  else
+    dt_folder_scan_commit(scan);
+
   // only redraw at the end, to not spam the cpu with exposure events
   dt_control_queue_redraw_center();
   DT_DEBUG_CONTROL_SIGNAL_RAISE(darktable.signals, DT_SIGNAL_TAG_CHANGED);
@@ -369,7 +369,8 @@ static inline void _develop_blend_process_free_region(float *const restrict inpu
 
 static void _develop_blend_process_feather(const float *const guide, float *const mask, const size_t width,
                                            const size_t height, const int ch, const float guide_weight,
-                                           const float feathering_radius, const float scale)
+                                           const float feathering_radius, const float scale,
+                                           dt_guided_filter_workspace_t *ws)
 {
   const float sqrt_eps = 1.f;
   int w = (int)(2 * feathering_radius * scale + 0.5f);
@@ -379,7 +380,7 @@ static void _develop_blend_process_feather(const float *const guide, float *cons
   if(mask_bak)
   {
     memcpy(mask_bak, mask, sizeof(float) * width * height);
-    guided_filter(guide, mask_bak, mask, width, height, ch, w, sqrt_eps, guide_weight, 0.f, 1.f);
+    guided_filter(guide, mask_bak, mask, width, height, ch, w, sqrt_eps, guide_weight, 0.f, 1.f, ws);
     dt_free_align(mask_bak);
   }
 }
@@ -593,7 +594,8 @@ void dt_develop_blend_process(struct dt_iop_module_t *self, struct dt_dev_pixelp
                                                      ch * owidth, ch * oheight);
         if(guide)
           _develop_blend_process_feather(guide, mask, owidth, oheight, ch, guide_weight,
-                                         d->feathering_radius, roi_out->scale / piece->iscale);
+                                         d->feathering_radius, roi_out->scale / piece->iscale,
+                                         &piece->pipe->guided_filter_ws);
         if(!rois_equal)
           _develop_blend_process_free_region(guide);
       }
@@ -601,7 +603,8 @@ void dt_develop_blend_process(struct dt_iop_module_t *self, struct dt_dev_pixelp
       {
         const float guide_weight = cst == iop_cs_rgb ? 100.0f : 1.0f;
         _develop_blend_process_feather((const float *const restrict)ovoid, mask, owidth, oheight, ch,
-                                       guide_weight, d->feathering_radius, roi_out->scale / piece->iscale);
+                                       guide_weight, d->feathering_radius, roi_out->scale / piece->iscale,
+                                       &piece->pipe->guided_filter_ws);
       }
       else if(operation == DEVELOP_MASK_POST_BLUR)
       {
@@ -639,10 +639,32 @@ restart:
 
 static inline void _dt_dev_load_pipeline_defaults(dt_develop_t *dev)
 {
+  // exports and thumbnails of the same image share the defaults which only depend on the image. the
+  // darkroom always reloads them, reload_defaults() updates the gui as well.
+  const uint32_t image_stamp = dev->gui_attached ? 0 : dev->image_storage.cache_stamp;
+  GList *reloaded = NULL;
+
   for(const GList *modules = g_list_last(dev->iop); modules; modules = g_list_previous(modules))
   {
     dt_iop_module_t *module = (dt_iop_module_t *)(modules->data);
-    dt_iop_reload_defaults(module);
+    if(!dt_iop_load_cached_defaults(module, image_stamp))
+    {
+      dt_iop_reload_defaults(module);
+      if(image_stamp) reloaded = g_list_prepend(reloaded, module);
+    }
+  }
+
+  if(reloaded)
+  {
+    // reload_defaults() may write to the image (colorin keeps the embedded profile there), so record the
+    // defaults for the image as it is now
+    const dt_image_t *image = dt_image_cache_get(darktable.image_cache, dev->image_storage.id, 'r');
+    const uint32_t new_stamp = image->cache_stamp;
+    dt_image_cache_read_release(darktable.image_cache, image);
+
+    for(const GList *modules = reloaded; modules; modules = g_list_next(modules))
+      dt_iop_cache_defaults((dt_iop_module_t *)modules->data, new_stamp);
+    g_list_free(reloaded);
   }
 }
 
@@ -733,6 +755,87 @@ void dt_dev_load_image(dt_develop_t *dev, const uint32_t imgid)
   dt_unlock_image(imgid);
 }
 
+void dt_dev_retarget_image(dt_develop_t *dev, const uint32_t imgid)
+{
+  assert(!dev->gui_attached);
+
+  dt_lock_image(imgid);
+
+  while(dev->history)
+  {
+    dt_dev_free_history_item((dt_dev_history_item_t *)dev->history->data);
+    dev->history = g_list_delete_link(dev->history, dev->history);
+  }
+  dev->history_end = 0;
+
+  _dt_dev_load_raw(dev, imgid);
+  dev->image_loading = dev->first_load = dev->preview_loading = dev->preview2_loading = TRUE;
+  dev->image_status = dev->preview_status = dev->preview2_status = DT_DEV_PIXELPIPE_DIRTY;
+  dev->proxy.chroma_adaptation = NULL;
+  dev->proxy.wb_is_D65 = TRUE;
+  dev->proxy.wb_coeffs[0] = 0.f;
+
+  dt_pthread_mutex_lock(&darktable.dev_threadsafe);
+
+  // keep the base instance of each module, drop the ones added by history or styles of the previous image
+  for(GList *modules = g_list_last(dev->iop); modules;)
+  {
+    dt_iop_module_t *module = (dt_iop_module_t *)modules->data;
+    GList *prev = g_list_previous(modules);
+
+    int base_multi_priority = G_MAXINT;
+    for(const GList *l = dev->iop; l; l = g_list_next(l))
+    {
+      const dt_iop_module_t *mod = (dt_iop_module_t *)l->data;
+      if(!strcmp(module->op, mod->op)) base_multi_priority = MIN(base_multi_priority, mod->multi_priority);
+    }
+
+    if(module->multi_priority == base_multi_priority)
+    {
+      module->multi_priority = 0;
+      module->multi_name[0] = '\0';
+      module->enabled = module->default_enabled;
+    }
+    else
+    {
+      dev->iop = g_list_delete_link(dev->iop, modules);
+      dt_iop_cleanup_module(module);
+      free(module);
+    }
+    modules = prev;
+  }
+
+  // the raster mask links may point to the instances freed above, they are set up again by the history
+  for(const GList *modules = dev->iop; modules; modules = g_list_next(modules))
+  {
+    dt_iop_module_t *module = (dt_iop_module_t *)modules->data;
+    module->raster_mask.sink.source = NULL;
+    module->raster_mask.sink.id = 0;
+    g_hash_table_remove_all(module->raster_mask.source.users);
+  }
+
+  while(dev->alliop)
+  {
+    dt_iop_cleanup_module((dt_iop_module_t *)dev->alliop->data);
+    free(dev->alliop->data);
+    dev->alliop = g_list_delete_link(dev->alliop, dev->alliop);
+  }
+  g_list_free_full(dev->forms, (void (*)(void *))dt_masks_free_form);
+  dev->forms = NULL;
+  g_list_free_full(dev->allforms, (void (*)(void *))dt_masks_free_form);
+  dev->allforms = NULL;
+
+  // sets the iop order of the new image, reloads the defaults and applies its history
+  dt_dev_read_history(dev);
+  dt_pthread_mutex_unlock(&darktable.dev_threadsafe);
+
+  dev->first_load = FALSE;
+
+  dt_history_set_compress_problem(imgid, FALSE);
+
+  dt_unlock_image(imgid);
+}
+
 void dt_dev_configure(dt_develop_t *dev, int wd, int ht)
 {
   // fixed border on every side
@@ -750,43 +853,43 @@ void dt_dev_configure(dt_develop_t *dev, int wd, int ht)
   }
 }
 
+// the columns of a history item, the statement and its bindings are shared by all the writers so
+// that they can't drift apart
+#define DT_DEV_HISTORY_ITEM_INSERT                                                                          \
+  "INSERT INTO main.history"                                                                                \
+  " (imgid, num, operation, op_params, module, enabled,"                                                    \
+  "  blendop_params, blendop_version, multi_priority, multi_name)"                                          \
+  " VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10)"
+
+static void _dev_bind_history_item(sqlite3_stmt *stmt, const int imgid, const dt_dev_history_item_t *h,
+                                   const int32_t num)
+{
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, num);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 3, h->module->op, -1, SQLITE_TRANSIENT);
+  DT_DEBUG_SQLITE3_BIND_BLOB(stmt, 4, h->params, h->module->params_size, SQLITE_TRANSIENT);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 5, h->module->version());
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 6, h->enabled);
+  DT_DEBUG_SQLITE3_BIND_BLOB(stmt, 7, h->blend_params, sizeof(dt_develop_blend_params_t), SQLITE_TRANSIENT);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 8, dt_develop_blend_version());
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 9, h->multi_priority);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 10, h->multi_name, -1, SQLITE_TRANSIENT);
+}
+
 // helper used to synch a single history item with db
 int dt_dev_write_history_item(const int imgid, dt_dev_history_item_t *h, int32_t num)
 {
   sqlite3_stmt *stmt;
+  // replace the item, if any
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT num FROM main.history WHERE imgid = ?1 AND num = ?2", -1, &stmt, NULL);
+                              "DELETE FROM main.history WHERE imgid = ?1 AND num = ?2", -1, &stmt, NULL);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, num);
-  if(sqlite3_step(stmt) != SQLITE_ROW)
-  {
-    sqlite3_finalize(stmt);
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "INSERT INTO main.history (imgid, num) VALUES (?1, ?2)", -1, &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, num);
-    sqlite3_step(stmt);
-  }
-  // printf("[dev write history item] writing %d - %s params %f %f\n", h->module->instance, h->module->op,
-  // *(float *)h->params, *(((float *)h->params)+1));
+  sqlite3_step(stmt);
   sqlite3_finalize(stmt);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "UPDATE main.history"
-                              " SET operation = ?1, op_params = ?2, module = ?3, enabled = ?4, "
-                              "     blendop_params = ?7, blendop_version = ?8, multi_priority = ?9, multi_name = ?10"
-                              " WHERE imgid = ?5 AND num = ?6",
-                              -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, h->module->op, -1, SQLITE_TRANSIENT);
-  DT_DEBUG_SQLITE3_BIND_BLOB(stmt, 2, h->params, h->module->params_size, SQLITE_TRANSIENT);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 3, h->module->version());
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 4, h->enabled);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 5, imgid);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 6, num);
-  DT_DEBUG_SQLITE3_BIND_BLOB(stmt, 7, h->blend_params, sizeof(dt_develop_blend_params_t), SQLITE_TRANSIENT);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 8, dt_develop_blend_version());
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 9, h->multi_priority);
-  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 10, h->multi_name, -1, SQLITE_TRANSIENT);
 
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), DT_DEV_HISTORY_ITEM_INSERT, -1, &stmt, NULL);
+  _dev_bind_history_item(stmt, imgid, h, num);
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
 
@@ -1306,20 +1409,39 @@ static void _cleanup_history(const int imgid)
 
 void dt_dev_write_history_ext(dt_develop_t *dev, const int imgid)
 {
+  sqlite3 *db = dt_database_get(darktable.db);
   sqlite3_stmt *stmt;
   dt_lock_image(imgid);
 
+  // a savepoint so that the whole history is written in one transaction,
+  // it nests in the one opened by the bulk paste and style apply
+  DT_DEBUG_SQLITE3_EXEC(db, "SAVEPOINT dev_write_history", NULL, NULL, NULL);
+
   _cleanup_history(imgid);
 
-  // write history entries
+  // write history entries, the history has just been cleaned up so a single
+  // insert statement is reused for all items
 
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, DT_DEV_HISTORY_ITEM_INSERT, -1, &stmt, NULL);
   GList *history = dev->history;
   if (DT_IOP_ORDER_INFO)
     fprintf(stderr,"\n^^^^ Writing history image: %i, iop version: %i",imgid,dev->iop_order_version);
   for(int i = 0; history; i++)
   {
     dt_dev_history_item_t *hist = (dt_dev_history_item_t *)(history->data);
-    (void)dt_dev_write_history_item(imgid, hist, i);
+    _dev_bind_history_item(stmt, imgid, hist, i);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
+    // write masks (if any)
+    for(GList *forms = hist->forms; forms; forms = g_list_next(forms))
+    {
+      dt_masks_form_t *form = (dt_masks_form_t *)forms->data;
+      if(form)
+        dt_masks_write_masks_history_item(imgid, i, form);
+    }
+
     if (DT_IOP_ORDER_INFO)
     {
       fprintf(stderr,"\n%20s, num %i, order %d, v(%i), multiprio %i",
@@ -1328,11 +1450,12 @@ void dt_dev_write_history_ext(dt_develop_t *dev, const int imgid)
     }
     history = g_list_next(history);
   }
+  sqlite3_finalize(stmt);
   if (DT_IOP_ORDER_INFO)
     fprintf(stderr,"\nvvvv\n");
 
   // update history end
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
                               "UPDATE main.images SET history_end = ?1 WHERE id = ?2", -1,
                               &stmt, NULL);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dev->history_end);
@@ -1345,6 +1468,8 @@ void dt_dev_write_history_ext(dt_develop_t *dev, const int imgid)
   dt_ioppr_write_iop_order_list(dev->iop_order_list, imgid);
   dt_history_hash_write_from_history(imgid, DT_HISTORY_HASH_CURRENT);
 
+  DT_DEBUG_SQLITE3_EXEC(db, "RELEASE dev_write_history", NULL, NULL, NULL);
+
   dt_unlock_image(imgid);
 }
 
@@ -1684,8 +1809,9 @@ static void _dev_merge_history(dt_develop_t *dev, const int imgid)
                                   "UPDATE memory.history SET num=?1 WHERE rowid=?2",
                                   -1, &stmt, NULL);
 
-      // let's wrap this into a transaction, it might make it a little faster.
-      sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
+      // let's wrap this into a transaction, it might make it a little faster. a savepoint, as it can nest
+      // in the one of a batch paste or style apply running on the gui thread
+      sqlite3_exec(dt_database_get(darktable.db), "SAVEPOINT dev_merge_history", NULL, NULL, NULL);
       for(GList *r = rowids; r; r = g_list_next(r))
       {
         DT_DEBUG_SQLITE3_CLEAR_BINDINGS(stmt);
@@ -1698,7 +1824,7 @@ static void _dev_merge_history(dt_develop_t *dev, const int imgid)
         v++;
       }
 
-      sqlite3_exec(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
+      sqlite3_exec(dt_database_get(darktable.db), "RELEASE dev_merge_history", NULL, NULL, NULL);
 
       g_list_free(rowids);
 
@@ -79,6 +79,7 @@ typedef struct dt_iop_gui_simple_callback_t
 } dt_iop_gui_simple_callback_t;
 
 static void _iop_panel_label(dt_iop_module_t *module);
+static void _cached_defaults_free(gpointer data);
 
 void dt_iop_load_default_params(dt_iop_module_t *module)
 {
@@ -333,6 +334,9 @@ int dt_iop_load_module_so(void *m, const char *libname, const char *module_name)
       fprintf(stderr, "[iop_load_module] failed to initialize introspection for operation `%s'\n", module_name);
   }
 
+  module->cached_defaults = g_hash_table_new_full(NULL, NULL, NULL, _cached_defaults_free);
+  dt_pthread_mutex_init(&module->cached_defaults_mutex, NULL);
+
   if(module->init_global) module->init_global(module);
   return 0;
 }
@@ -1192,6 +1196,92 @@ void dt_iop_reload_defaults(dt_iop_module_t *module)
   if(module->header) _iop_gui_update_header(module);
 }
 
+// results of reload_defaults() kept per image
+typedef struct dt_iop_cached_defaults_t
+{
+  uint32_t image_stamp;
+  gchar *workflow;
+  int32_t default_enabled;
+  int32_t hide_enable_button;
+  int32_t params_size;
+  dt_iop_params_t *params;
+} dt_iop_cached_defaults_t;
+
+// per module, that is a handful of images being exported or thumbnailed at the same time
+#define DT_IOP_CACHED_DEFAULTS_MAX 256
+
+static void _cached_defaults_free(gpointer data)
+{
+  dt_iop_cached_defaults_t *cached = (dt_iop_cached_defaults_t *)data;
+  g_free(cached->workflow);
+  g_free(cached->params);
+  g_free(cached);
+}
+
+// the preferences reload_defaults() may look at besides the image
+static gchar *_cached_defaults_workflow(void)
+{
+  return g_strdup_printf("%s/%s", dt_conf_get_string_const("plugins/darkroom/workflow"),
+                         dt_conf_get_string_const("plugins/darkroom/chromatic-adaptation"));
+}
+
+static gboolean _cached_defaults_usable(dt_iop_module_t *module, const uint32_t image_stamp)
+{
+  return image_stamp && module->dev && module->reload_defaults
+         && (module->flags() & IOP_FLAGS_CACHED_DEFAULTS);
+}
+
+gboolean dt_iop_load_cached_defaults(dt_iop_module_t *module, const uint32_t image_stamp)
+{
+  if(!_cached_defaults_usable(module, image_stamp)) return FALSE;
+
+  dt_iop_module_so_t *so = module->so;
+  gchar *workflow = _cached_defaults_workflow();
+  gboolean found = FALSE;
+
+  dt_pthread_mutex_lock(&so->cached_defaults_mutex);
+  const dt_iop_cached_defaults_t *cached
+      = g_hash_table_lookup(so->cached_defaults, GINT_TO_POINTER(module->dev->image_storage.id));
+  if(cached && cached->image_stamp == image_stamp && cached->params_size == module->params_size
+     && !strcmp(cached->workflow, workflow))
+  {
+    memcpy(module->default_params, cached->params, module->params_size);
+    module->default_enabled = cached->default_enabled;
+    module->hide_enable_button = cached->hide_enable_button;
+    found = TRUE;
+  }
+  dt_pthread_mutex_unlock(&so->cached_defaults_mutex);
+  g_free(workflow);
+
+  if(found)
+  {
+    dt_iop_load_default_params(module);
+    dt_print(DT_DEBUG_PARAMS, "[params] cached defaults loaded for %s\n", module->op);
+  }
+  return found;
+}
+
+void dt_iop_cache_defaults(dt_iop_module_t *module, const uint32_t image_stamp)
+{
+  if(!_cached_defaults_usable(module, image_stamp)) return;
+
+  dt_iop_module_so_t *so = module->so;
+  dt_iop_cached_defaults_t *cached = g_malloc(sizeof(dt_iop_cached_defaults_t));
+  cached->image_stamp = image_stamp;
+  cached->workflow = _cached_defaults_workflow();
+  cached->default_enabled = module->default_enabled;
+  cached->hide_enable_button = module->hide_enable_button;
+  cached->params_size = module->params_size;
+  cached->params = g_malloc(module->params_size);
+  memcpy(cached->params, module->default_params, module->params_size);
+
+  dt_pthread_mutex_lock(&so->cached_defaults_mutex);
+  if(g_hash_table_size(so->cached_defaults) >= DT_IOP_CACHED_DEFAULTS_MAX)
+    g_hash_table_remove_all(so->cached_defaults);
+  g_hash_table_replace(so->cached_defaults, GINT_TO_POINTER(module->dev->image_storage.id), cached);
+  dt_pthread_mutex_unlock(&so->cached_defaults_mutex);
+}
+
 void dt_iop_cleanup_histogram(gpointer data, gpointer user_data)
 {
   dt_iop_module_t *module = (dt_iop_module_t *)data;
@@ -1550,6 +1640,11 @@ void dt_iop_unload_modules_so()
   {
     dt_iop_module_so_t *module = (dt_iop_module_so_t *)darktable.iop->data;
     if(module->cleanup_global) module->cleanup_global(module);
+    if(module->cached_defaults)
+    {
+      g_hash_table_destroy(module->cached_defaults);
+      dt_pthread_mutex_destroy(&module->cached_defaults_mutex);
+    }
     if(module->module) g_module_close(module->module);
     free(darktable.iop->data);
     darktable.iop = g_list_delete_link(darktable.iop, darktable.iop);
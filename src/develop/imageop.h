@@ -108,7 +108,9 @@ typedef enum dt_iop_flags_t
   IOP_FLAGS_ALLOW_FAST_PIPE = 1 << 12,   // Module can work with a fast pipe
   IOP_FLAGS_UNSAFE_COPY = 1 << 13,       // Unsafe to copy as part of history
   IOP_FLAGS_GUIDES_SPECIAL_DRAW = 1 << 14, // handle the grid drawing directly
-  IOP_FLAGS_GUIDES_WIDGET = 1 << 15        // require the guides widget
+  IOP_FLAGS_GUIDES_WIDGET = 1 << 15,       // require the guides widget
+  IOP_FLAGS_CACHED_DEFAULTS = 1 << 16      // reload_defaults() only depends on the image and the workflow
+                                           // preferences, headless instances can share its results
 } dt_iop_flags_t;
 
 /** status of a module*/
@@ -179,6 +181,10 @@ typedef struct dt_iop_module_so_t
 
   // introspection related data
   gboolean have_introspection;
+
+  /** results of reload_defaults() per image, for modules with IOP_FLAGS_CACHED_DEFAULTS. */
+  GHashTable *cached_defaults;
+  dt_pthread_mutex_t cached_defaults_mutex;
 } dt_iop_module_so_t;
 
 typedef struct dt_iop_module_t
@@ -384,6 +390,11 @@ void dt_iop_load_default_params(dt_iop_module_t *module);
 void dt_iop_gui_init(dt_iop_module_t *module);
 /** reloads certain gui/param defaults when the image was switched. */
 void dt_iop_reload_defaults(dt_iop_module_t *module);
+/** loads the defaults recorded by dt_iop_cache_defaults() for the same image stamp instead of calling
+ *  reload_defaults(). returns FALSE if there are none. */
+gboolean dt_iop_load_cached_defaults(dt_iop_module_t *module, const uint32_t image_stamp);
+/** records the current defaults of a module with IOP_FLAGS_CACHED_DEFAULTS for the given image stamp. */
+void dt_iop_cache_defaults(dt_iop_module_t *module, const uint32_t image_stamp);
 
 extern const struct dt_action_def_t dt_action_def_iop;
 
@@ -520,6 +520,31 @@ void dt_iop_clip_and_zoom_mosaic_third_size_xtrans_f(float *const out, const flo
   }
 }
 
+void dt_iop_clip_and_zoom_mosaic(void *const out, const void *const in, const dt_iop_roi_t *const roi_out,
+                                 const dt_iop_roi_t *const roi_in, const int32_t out_stride,
+                                 const int32_t in_stride, const dt_iop_buffer_type_t datatype,
+                                 const uint32_t filters, const uint8_t (*const xtrans)[6])
+{
+  if(filters == 9u)
+  {
+    if(datatype == TYPE_FLOAT)
+      dt_iop_clip_and_zoom_mosaic_third_size_xtrans_f((float *const)out, (const float *const)in, roi_out, roi_in,
+                                                      out_stride, in_stride, xtrans);
+    else
+      dt_iop_clip_and_zoom_mosaic_third_size_xtrans((uint16_t *const)out, (const uint16_t *const)in, roi_out,
+                                                    roi_in, out_stride, in_stride, xtrans);
+  }
+  else
+  {
+    if(datatype == TYPE_FLOAT)
+      dt_iop_clip_and_zoom_mosaic_half_size_f((float *const)out, (const float *const)in, roi_out, roi_in,
+                                              out_stride, in_stride, filters);
+    else
+      dt_iop_clip_and_zoom_mosaic_half_size((uint16_t *const)out, (const uint16_t *const)in, roi_out, roi_in,
+                                            out_stride, in_stride, filters);
+  }
+}
+
 void dt_iop_clip_and_zoom_demosaic_passthrough_monochrome_f(float *out, const float *const in,
                                                                   const dt_iop_roi_t *const roi_out,
                                                                   const dt_iop_roi_t *const roi_in,
@@ -75,6 +75,14 @@ void dt_iop_clip_and_zoom_mosaic_third_size_xtrans_f(float *const out, const flo
                                                      const dt_iop_roi_t *const roi_in, const int32_t out_stride,
                                                      const int32_t in_stride, const uint8_t (*const xtrans)[6]);
 
+/** downscale a bayer or x-trans mosaic by an arbitrary ratio, keeping the cfa layout: every output
+ *  photosite is the average of the input photosites of the same color within its footprint.
+ *  datatype is TYPE_UINT16 or TYPE_FLOAT, for in and out alike. */
+void dt_iop_clip_and_zoom_mosaic(void *const out, const void *const in, const dt_iop_roi_t *const roi_out,
+                                 const dt_iop_roi_t *const roi_in, const int32_t out_stride,
+                                 const int32_t in_stride, const dt_iop_buffer_type_t datatype,
+                                 const uint32_t filters, const uint8_t (*const xtrans)[6]);
+
 void dt_iop_clip_and_zoom_demosaic_passthrough_monochrome_f(float *out, const float *const in,
                                                             const struct dt_iop_roi_t *const roi_out,
                                                             const struct dt_iop_roi_t *const roi_in,
@@ -310,18 +310,17 @@ int dt_masks_get_area(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt
                       int *width, int *height, int *posx, int *posy);
 int dt_masks_get_source_area(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
                              int *width, int *height, int *posx, int *posy);
-/** get the transparency mask of the form and his border */
-static inline int dt_masks_get_mask(const dt_iop_module_t *const module, const dt_dev_pixelpipe_iop_t *const piece,
+/** get the transparency mask of the form and his border.
+ * rendered shapes are kept in a cache shared by all pipes, keyed on the form, the distortions in front of the
+ * module and the pipe scale, so unchanged shapes are not rendered again on the next pipe run */
+int dt_masks_get_mask(const dt_iop_module_t *const module, const dt_dev_pixelpipe_iop_t *const piece,
                       dt_masks_form_t *const form,
-                      float **buffer, int *width, int *height, int *posx, int *posy)
-{
-  return form->functions ? form->functions->get_mask(module, piece, form, buffer, width, height, posx, posy) : 0;
-}
-static inline int dt_masks_get_mask_roi(const dt_iop_module_t *const module, const dt_dev_pixelpipe_iop_t *const piece,
-                          dt_masks_form_t *const form, const dt_iop_roi_t *roi, float *buffer)
-{
-  return form->functions ? form->functions->get_mask_roi(module, piece, form, roi, buffer) : 0;
-}
+                      float **buffer, int *width, int *height, int *posx, int *posy);
+/** same for a region of interest, buffer must be zeroed by the caller */
+int dt_masks_get_mask_roi(const dt_iop_module_t *const module, const dt_dev_pixelpipe_iop_t *const piece,
+                          dt_masks_form_t *const form, const dt_iop_roi_t *roi, float *buffer);
+/** free all the cached shapes */
+void dt_masks_cache_cleanup(void);
 
 int dt_masks_group_render(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
                           float **buffer, int *roi, float scale);
@@ -449,6 +448,14 @@ GSList *dt_masks_mouse_actions(dt_masks_form_t *form);
 void dt_group_events_post_expose(cairo_t *cr, float zoom_scale, dt_masks_form_t *form,
                                  dt_masks_form_gui_t *gui);
 
+/** number of row bands a roi is split into when drawing shapes in parallel. each band is drawn by a single
+ * thread, segments crossing several bands are clipped to each of them, so no pixel is written concurrently */
+static inline int dt_masks_roi_bands(const int height)
+{
+  const int bands = MIN(4 * (int)dt_get_num_threads(), height / 16);
+  return MAX(bands, 1);
+}
+
 /** code for dynamic handling of intermediate buffers */
 static inline gboolean _dt_masks_dynbuf_growto(dt_masks_dynbuf_t *a, size_t size)
 {
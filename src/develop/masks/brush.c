@@ -2756,9 +2756,9 @@ static int _brush_get_mask(const dt_iop_module_t *const module, const dt_dev_pix
   return 1;
 }
 
-/** we write a falloff segment respecting limits of buffer */
-static inline void _brush_falloff_roi(float *buffer, const int *p0, const int *p1, int bw, int bh, float hardness,
-                                      float density)
+/** we write a falloff segment respecting limits of buffer, only rows y0 to y1-1 are touched */
+static inline void _brush_falloff_roi(float *buffer, const int *p0, const int *p1, int bw, int bh, int y0,
+                                      int y1, float hardness, float density)
 {
   // segment length (increase by 1 to avoid division-by-zero special case handling)
   const int l = sqrt((p1[0] - p0[0]) * (p1[0] - p0[0]) + (p1[1] - p0[1]) * (p1[1] - p0[1])) + 1;
@@ -2791,14 +2791,51 @@ static inline void _brush_falloff_roi(float *buffer, const int *p0, const int *p
 
     float *buf = buffer + (size_t)y * bw + x;
 
-    *buf = MAX(*buf, op);
-    if(x + dx >= 0 && x + dx < bw)
-      buf[dpx] = MAX(buf[dpx], op); // this one is to avoid gaps due to int rounding
-    if(y + dy >= 0 && y + dy < bh)
+    if(y >= y0 && y < y1)
+    {
+      *buf = MAX(*buf, op);
+      if(x + dx >= 0 && x + dx < bw)
+        buf[dpx] = MAX(buf[dpx], op); // this one is to avoid gaps due to int rounding
+    }
+    if(y + dy >= y0 && y + dy < y1)
       buf[dpy] = MAX(buf[dpy], op); // this one is to avoid gaps due to int rounding
   }
 }
 
+/** draws the falloff of the segments first to count-1 in nbands bands of rows, in parallel. each band is
+ *  drawn by one thread, which gives the same result as a single band */
+static void _brush_falloff_bands(float *buffer, const float *points, const float *border, const float *payload,
+                                 const int first, const int count, const int width, const int height,
+                                 const int nbands)
+{
+#ifdef _OPENMP
+#if !defined(__SUNOS__) && !defined(__NetBSD__)
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(first, count, width, height, nbands) \
+  shared(buffer, points, border, payload) schedule(dynamic)
+#else
+#pragma omp parallel for shared(buffer)
+#endif
+#endif
+  for(int b = 0; b < nbands; b++)
+  {
+    const int y0 = (int)((size_t)b * height / nbands);
+    const int y1 = (int)((size_t)(b + 1) * height / nbands);
+    for(int i = first; i < count; i++)
+    {
+      const int p0[] = { points[i * 2], points[i * 2 + 1] };
+      const int p1[] = { border[i * 2], border[i * 2 + 1] };
+
+      // rounding of the stepping may take a segment slightly beyond its end points
+      if(MAX(p0[0], p1[0]) < 0 || MIN(p0[0], p1[0]) >= width || MAX(p0[1], p1[1]) + 2 < y0
+         || MIN(p0[1], p1[1]) - 2 >= y1)
+        continue;
+
+      _brush_falloff_roi(buffer, p0, p1, width, height, y0, y1, payload[i * 2], payload[i * 2 + 1]);
+    }
+  }
+}
+
 // build a stamp which can be combined with other shapes in the same group
 // prerequisite: 'buffer' is all zeros
 static int _brush_get_mask_roi(const dt_iop_module_t *const module, const dt_dev_pixelpipe_iop_t *const piece,
@@ -2874,27 +2911,10 @@ static int _brush_get_mask_roi(const dt_iop_module_t *const module, const dt_dev
     return 1;
   }
 
-  // now we fill the falloff
-#ifdef _OPENMP
-#if !defined(__SUNOS__) && !defined(__NetBSD__)
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(nb_corner, border_count, width, height) \
-  shared(buffer, points, border, payload) schedule(static)
-#else
-#pragma omp parallel for shared(buffer)
-#endif
-#endif
-  for(int i = nb_corner * 3; i < border_count; i++)
-  {
-    const int p0[] = { points[i * 2], points[i * 2 + 1] };
-    const int p1[] = { border[i * 2], border[i * 2 + 1] };
-
-    if(MAX(p0[0], p1[0]) < 0 || MIN(p0[0], p1[0]) >= width || MAX(p0[1], p1[1]) < 0
-       || MIN(p0[1], p1[1]) >= height)
-      continue;
-
-    _brush_falloff_roi(buffer, p0, p1, width, height, payload[i * 2], payload[i * 2 + 1]);
-  }
+  // now we fill the falloff, the roi is split in bands of rows so that overlapping segments are never
+  // written by two threads at the same time
+  _brush_falloff_bands(buffer, points, border, payload, nb_corner * 3, border_count, width, height,
+                       dt_masks_roi_bands(height));
 
   dt_free_align(points);
   dt_free_align(border);
@@ -414,6 +414,369 @@ int dt_masks_get_points_border(dt_develop_t *dev, dt_masks_form_t *form, float *
   return 0;
 }
 
+// rendered shapes are cached across pipe runs. the key covers everything a shape rendering depends on: the
+// image, the form and its points, the distortions in front of the module, the pipe scale and the region of
+// interest. entries are shared by all pipes, the full and preview pipe hit the same entry when their keys
+// coincide. the hash only picks the bucket, lookups compare the whole key.
+#define DT_MASKS_CACHE_SIZE ((size_t)256 << 20)
+
+typedef struct _masks_cache_key_t
+{
+  uint64_t hash;
+  int32_t imgid;
+  dt_masks_type_t type;
+  int formid;
+  float source[2];
+  size_t points_size;
+  void *points;      // all point structs of the form, back to back
+  uint64_t distort;
+  int iwidth, iheight;
+  float iscale;
+  float preview_downsampling;
+  const dt_iop_module_t *gui_module;
+  gboolean with_roi;
+  dt_iop_roi_t roi;
+} _masks_cache_key_t;
+
+typedef struct _masks_cache_entry_t
+{
+  _masks_cache_key_t key;
+  int width, height; // size of the stored buffer
+  int posx, posy;    // its position in mask coordinates, or inside the roi for roi renderings
+  uint64_t used;
+  float *buffer;
+} _masks_cache_entry_t;
+
+static struct
+{
+  GMutex lock;
+  GHashTable *entries;
+  size_t size;
+  uint64_t tick;
+  uint64_t hits, misses;
+} _masks_cache = { 0 };
+
+static inline uint64_t _masks_hash(uint64_t hash, const void *data, const size_t size)
+{
+  const uint8_t *bytes = (const uint8_t *)data;
+  for(size_t k = 0; k < size; k++) hash = ((hash << 5) + hash) ^ bytes[k];
+  return hash;
+}
+
+// fills key, to be released with _masks_cache_key_clear()
+static gboolean _masks_cache_key_init(_masks_cache_key_t *key, const dt_iop_module_t *const module,
+                                      const dt_dev_pixelpipe_iop_t *const piece,
+                                      const dt_masks_form_t *const form, const dt_iop_roi_t *roi)
+{
+  memset(key, 0, sizeof(_masks_cache_key_t));
+  dt_dev_pixelpipe_t *pipe = piece->pipe;
+
+  key->imgid = pipe->image.id;
+  key->type = form->type;
+  key->formid = form->formid;
+  key->source[0] = form->source[0];
+  key->source[1] = form->source[1];
+
+  const size_t size_item = form->functions->point_struct_size;
+  key->points_size = size_item * g_list_length(form->points);
+  if(key->points_size)
+  {
+    key->points = malloc(key->points_size);
+    if(!key->points) return FALSE;
+    uint8_t *dst = (uint8_t *)key->points;
+    for(const GList *pt = form->points; pt; pt = g_list_next(pt), dst += size_item) memcpy(dst, pt->data, size_item);
+  }
+
+  key->distort = dt_dev_hash_distort_plus(module->dev, pipe, module->iop_order, DT_DEV_TRANSFORM_DIR_BACK_INCL);
+  key->iwidth = pipe->iwidth;
+  key->iheight = pipe->iheight;
+  key->iscale = pipe->iscale;
+  key->preview_downsampling = module->dev->preview_downsampling;
+  // some shapes take the module being edited into account
+  key->gui_module = module->dev->gui_module;
+  key->with_roi = roi != NULL;
+  if(roi) key->roi = *roi;
+
+  uint64_t hash = 5381;
+  hash = _masks_hash(hash, &key->imgid, sizeof(key->imgid));
+  hash = _masks_hash(hash, &key->type, sizeof(key->type));
+  hash = _masks_hash(hash, &key->formid, sizeof(key->formid));
+  hash = _masks_hash(hash, key->source, sizeof(key->source));
+  if(key->points) hash = _masks_hash(hash, key->points, key->points_size);
+  hash = _masks_hash(hash, &key->distort, sizeof(key->distort));
+  hash = _masks_hash(hash, &key->iwidth, sizeof(key->iwidth));
+  hash = _masks_hash(hash, &key->iheight, sizeof(key->iheight));
+  hash = _masks_hash(hash, &key->iscale, sizeof(key->iscale));
+  hash = _masks_hash(hash, &key->preview_downsampling, sizeof(key->preview_downsampling));
+  hash = _masks_hash(hash, &key->gui_module, sizeof(key->gui_module));
+  hash = _masks_hash(hash, &key->with_roi, sizeof(key->with_roi));
+  if(roi) hash = _masks_hash(hash, &key->roi, sizeof(dt_iop_roi_t));
+  key->hash = hash;
+  return TRUE;
+}
+
+static void _masks_cache_key_clear(_masks_cache_key_t *key)
+{
+  free(key->points);
+  key->points = NULL;
+}
+
+static guint _masks_cache_key_hash(gconstpointer k)
+{
+  const _masks_cache_key_t *key = (const _masks_cache_key_t *)k;
+  return (guint)(key->hash ^ (key->hash >> 32));
+}
+
+static gboolean _masks_cache_key_equal(gconstpointer k1, gconstpointer k2)
+{
+  const _masks_cache_key_t *a = (const _masks_cache_key_t *)k1;
+  const _masks_cache_key_t *b = (const _masks_cache_key_t *)k2;
+  return a->hash == b->hash && a->imgid == b->imgid && a->type == b->type && a->formid == b->formid
+         && a->source[0] == b->source[0] && a->source[1] == b->source[1] && a->distort == b->distort
+         && a->iwidth == b->iwidth && a->iheight == b->iheight && a->iscale == b->iscale
+         && a->preview_downsampling == b->preview_downsampling && a->gui_module == b->gui_module
+         && a->with_roi == b->with_roi
+         && (!a->with_roi
+             || (a->roi.x == b->roi.x && a->roi.y == b->roi.y && a->roi.width == b->roi.width
+                 && a->roi.height == b->roi.height && a->roi.scale == b->roi.scale))
+         && a->points_size == b->points_size
+         && (!a->points_size || !memcmp(a->points, b->points, a->points_size));
+}
+
+static void _masks_cache_entry_free(gpointer data)
+{
+  _masks_cache_entry_t *e = (_masks_cache_entry_t *)data;
+  _masks_cache_key_clear(&e->key);
+  dt_free_align(e->buffer);
+  free(e);
+}
+
+// to be called with the lock held
+static void _masks_cache_evict(const size_t needed)
+{
+  while(_masks_cache.size + needed > DT_MASKS_CACHE_SIZE && g_hash_table_size(_masks_cache.entries) > 0)
+  {
+    GHashTableIter it;
+    gpointer value;
+    _masks_cache_entry_t *oldest = NULL;
+    g_hash_table_iter_init(&it, _masks_cache.entries);
+    while(g_hash_table_iter_next(&it, NULL, &value))
+    {
+      _masks_cache_entry_t *e = (_masks_cache_entry_t *)value;
+      if(!oldest || e->used < oldest->used) oldest = e;
+    }
+    _masks_cache.size -= sizeof(float) * oldest->width * oldest->height;
+    g_hash_table_remove(_masks_cache.entries, &oldest->key);
+  }
+}
+
+// takes ownership of buffer and of the points of key
+static void _masks_cache_insert(_masks_cache_key_t *key, float *buffer, const int width, const int height,
+                                const int posx, const int posy)
+{
+  const size_t size = sizeof(float) * width * height;
+  if(size > DT_MASKS_CACHE_SIZE / 4)
+  {
+    dt_free_align(buffer);
+    return;
+  }
+
+  _masks_cache_entry_t *e = malloc(sizeof(_masks_cache_entry_t));
+  if(!e)
+  {
+    dt_free_align(buffer);
+    return;
+  }
+  e->key = *key;
+  key->points = NULL;
+  e->buffer = buffer;
+  e->width = width;
+  e->height = height;
+  e->posx = posx;
+  e->posy = posy;
+
+  g_mutex_lock(&_masks_cache.lock);
+  if(!_masks_cache.entries)
+    _masks_cache.entries
+        = g_hash_table_new_full(_masks_cache_key_hash, _masks_cache_key_equal, NULL, _masks_cache_entry_free);
+  _masks_cache_entry_t *old = g_hash_table_lookup(_masks_cache.entries, &e->key);
+  if(old)
+  {
+    // another pipe rendered the same shape meanwhile
+    _masks_cache.size -= sizeof(float) * old->width * old->height;
+    g_hash_table_remove(_masks_cache.entries, &e->key);
+  }
+  _masks_cache_evict(size);
+  e->used = ++_masks_cache.tick;
+  g_hash_table_insert(_masks_cache.entries, &e->key, e);
+  _masks_cache.size += size;
+  g_mutex_unlock(&_masks_cache.lock);
+}
+
+// to be called with the lock held
+static _masks_cache_entry_t *_masks_cache_lookup(const _masks_cache_key_t *key)
+{
+  _masks_cache_entry_t *e = _masks_cache.entries ? g_hash_table_lookup(_masks_cache.entries, key) : NULL;
+  if(e)
+  {
+    e->used = ++_masks_cache.tick;
+    _masks_cache.hits++;
+  }
+  else
+    _masks_cache.misses++;
+  return e;
+}
+
+static void _masks_cache_report(const dt_masks_form_t *const form, const gboolean hit)
+{
+  if(!(darktable.unmuted & DT_DEBUG_MASKS)) return;
+  dt_print(DT_DEBUG_MASKS, "[masks %s] cache %s, %" PRIu64 " hits %" PRIu64 " misses, %zu MB in use\n",
+           form->name, hit ? "hit" : "miss", _masks_cache.hits, _masks_cache.misses,
+           _masks_cache.size >> 20);
+}
+
+int dt_masks_get_mask(const dt_iop_module_t *const module, const dt_dev_pixelpipe_iop_t *const piece,
+                      dt_masks_form_t *const form,
+                      float **buffer, int *width, int *height, int *posx, int *posy)
+{
+  if(!form->functions) return 0;
+  // groups are combinations of other forms which are cached themselves
+  if(!module || !piece || (form->type & DT_MASKS_GROUP))
+    return form->functions->get_mask(module, piece, form, buffer, width, height, posx, posy);
+
+  _masks_cache_key_t key;
+  if(!_masks_cache_key_init(&key, module, piece, form, NULL))
+  {
+    _masks_cache_key_clear(&key);
+    return form->functions->get_mask(module, piece, form, buffer, width, height, posx, posy);
+  }
+
+  g_mutex_lock(&_masks_cache.lock);
+  const _masks_cache_entry_t *e = _masks_cache_lookup(&key);
+  if(e)
+  {
+    const size_t size = (size_t)e->width * e->height;
+    *buffer = dt_alloc_align_float(size);
+    if(*buffer)
+    {
+      memcpy(*buffer, e->buffer, sizeof(float) * size);
+      *width = e->width;
+      *height = e->height;
+      *posx = e->posx;
+      *posy = e->posy;
+    }
+  }
+  _masks_cache_report(form, e != NULL);
+  g_mutex_unlock(&_masks_cache.lock);
+  if(e)
+  {
+    _masks_cache_key_clear(&key);
+    return *buffer != NULL;
+  }
+
+  const int ok = form->functions->get_mask(module, piece, form, buffer, width, height, posx, posy);
+  if(ok && *buffer)
+  {
+    const size_t size = (size_t)*width * *height;
+    float *copy = dt_alloc_align_float(size);
+    if(copy)
+    {
+      memcpy(copy, *buffer, sizeof(float) * size);
+      _masks_cache_insert(&key, copy, *width, *height, *posx, *posy);
+    }
+  }
+  _masks_cache_key_clear(&key);
+  return ok;
+}
+
+int dt_masks_get_mask_roi(const dt_iop_module_t *const module, const dt_dev_pixelpipe_iop_t *const piece,
+                          dt_masks_form_t *const form, const dt_iop_roi_t *roi, float *buffer)
+{
+  if(!form->functions) return 0;
+  if(!module || !piece || (form->type & DT_MASKS_GROUP))
+    return form->functions->get_mask_roi(module, piece, form, roi, buffer);
+
+  _masks_cache_key_t key;
+  if(!_masks_cache_key_init(&key, module, piece, form, roi))
+  {
+    _masks_cache_key_clear(&key);
+    return form->functions->get_mask_roi(module, piece, form, roi, buffer);
+  }
+  const int width = roi->width;
+
+  // the buffer is zeroed by the caller, only the part covered by the shape is stored and restored
+  g_mutex_lock(&_masks_cache.lock);
+  const _masks_cache_entry_t *e = _masks_cache_lookup(&key);
+  if(e)
+  {
+    for(int j = 0; j < e->height; j++)
+      memcpy(buffer + (size_t)(e->posy + j) * width + e->posx, e->buffer + (size_t)j * e->width,
+             sizeof(float) * e->width);
+  }
+  _masks_cache_report(form, e != NULL);
+  g_mutex_unlock(&_masks_cache.lock);
+  if(e)
+  {
+    _masks_cache_key_clear(&key);
+    return 1;
+  }
+
+  const int ok = form->functions->get_mask_roi(module, piece, form, roi, buffer);
+  if(!ok)
+  {
+    _masks_cache_key_clear(&key);
+    return ok;
+  }
+
+  // find the extent of the shape inside the roi
+  const int height = roi->height;
+  int xmin = width, xmax = -1, ymin = height, ymax = -1;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(buffer, width, height) \
+  schedule(static) reduction(min : xmin, ymin) reduction(max : xmax, ymax)
+#endif
+  for(int j = 0; j < height; j++)
+  {
+    const float *const row = buffer + (size_t)j * width;
+    int first = 0;
+    while(first < width && row[first] == 0.0f) first++;
+    if(first == width) continue;
+    int last = width - 1;
+    while(row[last] == 0.0f) last--;
+    xmin = MIN(xmin, first);
+    xmax = MAX(xmax, last);
+    ymin = MIN(ymin, j);
+    ymax = MAX(ymax, j);
+  }
+
+  const int w = xmax < xmin ? 0 : xmax - xmin + 1;
+  const int h = ymax < ymin ? 0 : ymax - ymin + 1;
+  float *copy = dt_alloc_align_float(MAX((size_t)w * h, 1));
+  if(copy)
+  {
+    for(int j = 0; j < h; j++)
+      memcpy(copy + (size_t)j * w, buffer + (size_t)(ymin + j) * width + xmin, sizeof(float) * w);
+    _masks_cache_insert(&key, copy, w, h, w ? xmin : 0, h ? ymin : 0);
+  }
+  _masks_cache_key_clear(&key);
+  return ok;
+}
+
+void dt_masks_cache_cleanup(void)
+{
+  g_mutex_lock(&_masks_cache.lock);
+  if(_masks_cache.entries)
+  {
+    dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF, "[masks] shape cache: %" PRIu64 " hits, %" PRIu64 " misses\n",
+             _masks_cache.hits, _masks_cache.misses);
+    g_hash_table_destroy(_masks_cache.entries);
+    _masks_cache.entries = NULL;
+  }
+  _masks_cache.size = 0;
+  g_mutex_unlock(&_masks_cache.lock);
+}
+
 int dt_masks_get_area(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
                       int *width, int *height, int *posx, int *posy)
 {
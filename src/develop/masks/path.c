@@ -2701,8 +2701,8 @@ static int _path_crop_to_roi(float *path, const int point_count, float xmin, flo
   return 1;
 }
 
-/** we write a falloff segment respecting limits of buffer */
-static void _path_falloff_roi(float *buffer, int *p0, int *p1, int bw, int bh)
+/** we write a falloff segment respecting limits of buffer, only rows y0 to y1-1 are touched */
+static void _path_falloff_roi(float *buffer, const int *p0, const int *p1, int bw, int y0, int y1)
 {
   // segment length
   const int l = sqrt((p1[0] - p0[0]) * (p1[0] - p0[0]) + (p1[1] - p0[1]) * (p1[1] - p0[1])) + 1;
@@ -2721,14 +2721,119 @@ static void _path_falloff_roi(float *buffer, int *p0, int *p1, int bw, int bh)
     const int y = (int)((float)i * ly / (float)l) + p0[1];
     const float op = 1.0f - (float)i / (float)l;
     float *buf = buffer + (size_t)y * bw + x;
-    if(x >= 0 && x < bw && y >= 0 && y < bh) buf[0] = MAX(buf[0], op);
-    if(x + dx >= 0 && x + dx < bw && y >= 0 && y < bh)
+    if(x >= 0 && x < bw && y >= y0 && y < y1) buf[0] = MAX(buf[0], op);
+    if(x + dx >= 0 && x + dx < bw && y >= y0 && y < y1)
       buf[dx] = MAX(buf[dx], op); // this one is to avoid gap due to int rounding
-    if(x >= 0 && x < bw && y + dy >= 0 && y + dy < bh)
+    if(x >= 0 && x < bw && y + dy >= y0 && y + dy < y1)
       buf[dpy] = MAX(buf[dpy], op); // this one is to avoid gap due to int rounding
   }
 }
 
+/** draws the edges of the path cpoints[first] to cpoints[count-1] and fills its inside, in nbands bands of
+ *  rows processed in parallel. each band is handled by one thread, which gives the same result as a single
+ *  band */
+static void _path_fill_bands(float *buffer, const float *cpoints, const int first, const int count,
+                             const int width, const int height, const int xxmin, const int xxmax,
+                             const int yymin, const int yymax, const int nbands)
+{
+#ifdef _OPENMP
+#if !defined(__SUNOS__) && !defined(__NetBSD__)
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(xxmin, xxmax, yymin, yymax, width, height, nbands, first, count) \
+  shared(buffer, cpoints) schedule(dynamic)
+#else
+#pragma omp parallel for shared(buffer)
+#endif
+#endif
+  for(int b = 0; b < nbands; b++)
+  {
+    const int y0 = (int)((size_t)b * height / nbands);
+    const int y1 = (int)((size_t)(b + 1) * height / nbands);
+
+    // edge-flag polygon fill: we write all the point around the path into the buffer
+    float xlast = cpoints[(count - 1) * 2];
+    float ylast = cpoints[(count - 1) * 2 + 1];
+
+    for(int i = first; i < count; i++)
+    {
+      float xstart = xlast;
+      float ystart = ylast;
+
+      float xend = xlast = cpoints[i * 2];
+      float yend = ylast = cpoints[i * 2 + 1];
+
+      if(ystart > yend)
+      {
+        float tmp;
+        tmp = ystart, ystart = yend, yend = tmp;
+        tmp = xstart, xstart = xend, xend = tmp;
+      }
+
+      if(yend < y0 || ystart >= y1) continue;
+
+      const float m = (xstart - xend) / (ystart - yend); // we don't need special handling of ystart==yend
+                                                         // as following loop will take care
+
+      for(int yy = MAX((int)ceilf(ystart), y0); (float)yy < yend && yy < y1;
+          yy++) // this would normally never touch the last roi line => see _path_get_mask_roi()
+      {
+        const float xcross = xstart + m * (yy - ystart);
+
+        int xx = floorf(xcross);
+        if((float)xx + 0.5f <= xcross) xx++;
+
+        if(xx < 0 || xx >= width || yy < 0 || yy >= height)
+          continue; // sanity check just to be on the safe side
+
+        const size_t index = (size_t)yy * width + xx;
+
+        buffer[index] = 1.0f - buffer[index];
+      }
+    }
+
+    // we fill the inside plain
+    for(int yy = MAX(yymin, y0); yy <= MIN(yymax, y1 - 1); yy++)
+    {
+      int state = 0;
+      for(int xx = xxmin; xx <= xxmax; xx++)
+      {
+        const size_t index = (size_t)yy * width + xx;
+        const float v = buffer[index];
+        if(v > 0.5f) state = !state;
+        if(state) buffer[index] = 1.0f;
+      }
+    }
+  }
+}
+
+/** draws the falloff segments of dpoints (4 ints each) in nbands bands of rows, in parallel, like above */
+static void _path_falloff_bands(float *buffer, const int *dpoints, const int dindex, const int width,
+                                const int height, const int nbands)
+{
+#ifdef _OPENMP
+#if !defined(__SUNOS__) && !defined(__NetBSD__)
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(width, height, dindex, nbands) \
+  shared(buffer, dpoints) schedule(dynamic)
+#else
+#pragma omp parallel for shared(buffer)
+#endif
+#endif
+  for(int b = 0; b < nbands; b++)
+  {
+    const int y0 = (int)((size_t)b * height / nbands);
+    const int y1 = (int)((size_t)(b + 1) * height / nbands);
+    for(int n = 0; n < dindex; n += 4)
+    {
+      const int *p0 = dpoints + n;
+      const int *p1 = dpoints + n + 2;
+      // a segment never writes further than one row beyond its end points
+      if(MAX(p0[1], p1[1]) + 1 < y0 || MIN(p0[1], p1[1]) - 1 >= y1) continue;
+      _path_falloff_roi(buffer, p0, p1, width, y0, y1);
+    }
+  }
+}
+
 // build a stamp which can be combined with other shapes in the same group
 // prerequisite: 'buffer' is all zeros
 static int _path_get_mask_roi(const dt_iop_module_t *const module, const dt_dev_pixelpipe_iop_t *const piece,
@@ -2914,84 +3019,21 @@ static int _path_get_mask_roi(const dt_iop_module_t *const module, const dt_dev_
     {
       // all other cases
 
-      // edge-flag polygon fill: we write all the point around the path into the buffer
-      float xlast = cpoints[(points_count - 1) * 2];
-      float ylast = cpoints[(points_count - 1) * 2 + 1];
-
-      for(int i = nb_corner * 3; i < points_count; i++)
-      {
-        float xstart = xlast;
-        float ystart = ylast;
-
-        float xend = xlast = cpoints[i * 2];
-        float yend = ylast = cpoints[i * 2 + 1];
-
-        if(ystart > yend)
-        {
-          float tmp;
-          tmp = ystart, ystart = yend, yend = tmp;
-          tmp = xstart, xstart = xend, xend = tmp;
-        }
-
-        const float m = (xstart - xend) / (ystart - yend); // we don't need special handling of ystart==yend
-                                                           // as following loop will take care
-
-        for(int yy = (int)ceilf(ystart); (float)yy < yend;
-            yy++) // this would normally never touch the last roi line => see comment further above
-        {
-          const float xcross = xstart + m * (yy - ystart);
-
-          int xx = floorf(xcross);
-          if((float)xx + 0.5f <= xcross) xx++;
-
-          if(xx < 0 || xx >= width || yy < 0 || yy >= height)
-            continue; // sanity check just to be on the safe side
-
-          const size_t index = (size_t)yy * width + xx;
-
-          buffer[index] = 1.0f - buffer[index];
-        }
-      }
-
-      if(darktable.unmuted & DT_DEBUG_PERF)
-      {
-        dt_print(DT_DEBUG_MASKS, "[masks %s] path_fill draw path took %0.04f sec\n", form->name,
-                 dt_get_wtime() - start2);
-        start2 = dt_get_wtime();
-      }
-
-      // we fill the inside plain
       // we don't need to deal with parts of shape outside of roi
       const int xxmin = MAX(xmin, 0);
       const int xxmax = MIN(xmax, width - 1);
       const int yymin = MAX(ymin, 0);
       const int yymax = MIN(ymax, height - 1);
+      const int nbands = dt_masks_roi_bands(height);
 
-#ifdef _OPENMP
-#if !defined(__SUNOS__) && !defined(__NetBSD__)
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(xxmin, xxmax, yymin, yymax, width) \
-  shared(buffer) schedule(static) num_threads(MIN(8,darktable.num_openmp_threads))
-#else
-#pragma omp parallel for shared(buffer)
-#endif
-#endif
-      for(int yy = yymin; yy <= yymax; yy++)
-      {
-        int state = 0;
-        for(int xx = xxmin; xx <= xxmax; xx++)
-        {
-          const size_t index = (size_t)yy * width + xx;
-          const float v = buffer[index];
-          if(v > 0.5f) state = !state;
-          if(state) buffer[index] = 1.0f;
-        }
-      }
+      // the roi is split in bands of rows, each band gets its edges drawn and is then filled by one thread
+      _path_fill_bands(buffer, cpoints, nb_corner * 3, points_count, width, height, xxmin, xxmax, yymin, yymax,
+                       nbands);
 
       if(darktable.unmuted & DT_DEBUG_PERF)
       {
-        dt_print(DT_DEBUG_MASKS, "[masks %s] path_fill fill plain took %0.04f sec\n", form->name,
-                 dt_get_wtime() - start2);
+        dt_print(DT_DEBUG_MASKS, "[masks %s] path_fill draw and fill path in %d bands took %0.04f sec\n",
+                 form->name, nbands, dt_get_wtime() - start2);
         start2 = dt_get_wtime();
       }
     }
@@ -3058,17 +3100,7 @@ static int _path_get_mask_roi(const dt_iop_module_t *const module, const dt_dev_
       }
     }
 
-#ifdef _OPENMP
-#if !defined(__SUNOS__) && !defined(__NetBSD__)
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(width, height, dindex) \
-  shared(buffer, dpoints)
-#else
-#pragma omp parallel for shared(buffer)
-#endif
-#endif
-    for(int n = 0; n < dindex; n += 4)
-      _path_falloff_roi(buffer, dpoints + n, dpoints + n + 2, width, height);
+    _path_falloff_bands(buffer, dpoints, dindex, width, height, dt_masks_roi_bands(height));
 
     dt_free_align(dpoints);
 
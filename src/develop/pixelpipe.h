@@ -54,6 +54,8 @@ typedef struct dt_dev_histogram_collection_params_t
   uint32_t bins_count;
   /** in most cases, bins_count-1. */
   float mul;
+  /** only sample every row_step-th row, 0 or 1 to sample all rows. */
+  uint32_t row_step;
 } dt_dev_histogram_collection_params_t;
 
 // params used to collect histogram during last histogram capture
@@ -196,6 +196,7 @@ int dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe, size_t size, int32_t
   pipe->iop_order_list = NULL;
   pipe->forms = NULL;
   pipe->store_all_raster_masks = FALSE;
+  memset(&pipe->guided_filter_ws, 0, sizeof(pipe->guided_filter_ws));
   pipe->work_profile_info = NULL;
   pipe->input_profile_info = NULL;
   pipe->output_profile_info = NULL;
@@ -214,6 +215,23 @@ void dt_dev_pixelpipe_set_input(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, flo
   get_output_format(NULL, pipe, NULL, dev, &pipe->dsc);
 }
 
+void dt_dev_pixelpipe_rescale_input(dt_dev_pixelpipe_t *pipe, float *input, int width, int height, float iscale)
+{
+  // same image and buffer format, only the resolution changes: the nodes keep their committed
+  // params and the pipe its dsc, they just have to know about the new input scale.
+  pipe->iwidth = width;
+  pipe->iheight = height;
+  pipe->iscale = iscale;
+  pipe->input = input;
+  for(GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
+  {
+    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)nodes->data;
+    piece->iscale = iscale;
+    piece->iwidth = width;
+    piece->iheight = height;
+  }
+}
+
 void dt_dev_pixelpipe_set_icc(dt_dev_pixelpipe_t *pipe, dt_colorspaces_color_profile_type_t icc_type,
                               const gchar *icc_filename, dt_iop_color_intent_t icc_intent)
 {
@@ -245,6 +263,7 @@ void dt_dev_pixelpipe_cleanup(dt_dev_pixelpipe_t *pipe)
   pipe->output_imgid = 0;
 
   dt_dev_clear_rawdetail_mask(pipe);
+  dt_guided_filter_workspace_free(&pipe->guided_filter_ws);
 
   if(pipe->forms)
   {
@@ -253,6 +272,34 @@ void dt_dev_pixelpipe_cleanup(dt_dev_pixelpipe_t *pipe)
   }
 }
 
+void dt_dev_pixelpipe_reset(dt_dev_pixelpipe_t *pipe)
+{
+  dt_pthread_mutex_lock(&pipe->backbuf_mutex);
+  pipe->backbuf = NULL;
+  dt_dev_pixelpipe_cleanup_nodes(pipe);
+  // keep the buffers, they will most likely fit the next image as well
+  dt_dev_pixelpipe_cache_flush(&(pipe->cache));
+  dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
+
+  pipe->devid = -1;
+  pipe->changed = DT_DEV_PIPE_UNCHANGED;
+  pipe->processed_width = pipe->backbuf_width = pipe->iwidth = 0;
+  pipe->processed_height = pipe->backbuf_height = pipe->iheight = 0;
+  pipe->cache_obsolete = 0;
+  pipe->backbuf_scale = 0.0f;
+  pipe->backbuf_zoom_x = 0.0f;
+  pipe->backbuf_zoom_y = 0.0f;
+  pipe->opencl_error = 0;
+  pipe->tiling = 0;
+  pipe->input_timestamp = 0;
+  dt_dev_clear_rawdetail_mask(pipe);
+  if(pipe->forms)
+  {
+    g_list_free_full(pipe->forms, (void (*)(void *))dt_masks_free_form);
+    pipe->forms = NULL;
+  }
+}
+
 void dt_dev_pixelpipe_cleanup_nodes(dt_dev_pixelpipe_t *pipe)
 {
   dt_atomic_set_int(&pipe->shutdown,TRUE); // tell pipe that it should shut itself down if currently running
@@ -510,28 +557,72 @@ static void get_output_format(dt_iop_module_t *module, dt_dev_pixelpipe_t *pipe,
 
 
 // helper to get per module histogram
-static void histogram_collect(dt_dev_pixelpipe_iop_t *piece, const void *pixel, const dt_iop_roi_t *roi,
-                              uint32_t **histogram, uint32_t *histogram_max)
+// histograms shown in the gui don't need more than that many samples, larger inputs are subsampled
+#define DT_HISTOGRAM_MAX_SAMPLES (1 << 20)
+
+// sets up the histogram parameters and returns the hash identifying the histogram collected with them,
+// 0 if it can't be identified
+static uint64_t histogram_prepare(dt_dev_pixelpipe_iop_t *piece, const dt_iop_roi_t *roi,
+                                  dt_dev_histogram_collection_params_t *histogram_params,
+                                  dt_histogram_roi_t *histogram_roi, const dt_iop_colorspace_type_t cst,
+                                  const uint64_t input_hash)
 {
-  dt_dev_histogram_collection_params_t histogram_params = piece->histogram_params;
-
-  dt_histogram_roi_t histogram_roi;
+  *histogram_params = piece->histogram_params;
 
   // if the current module does did not specified its own ROI, use the full ROI
-  if(histogram_params.roi == NULL)
+  if(histogram_params->roi == NULL)
   {
-    histogram_roi = (dt_histogram_roi_t){
+    *histogram_roi = (dt_histogram_roi_t){
       .width = roi->width, .height = roi->height, .crop_x = 0, .crop_y = 0, .crop_width = 0, .crop_height = 0
     };
 
-    histogram_params.roi = &histogram_roi;
+    histogram_params->roi = histogram_roi;
   }
+  else
+    *histogram_roi = *histogram_params->roi;
+
+  const size_t samples = (size_t)MAX(histogram_roi->width - histogram_roi->crop_width - histogram_roi->crop_x, 0)
+                         * MAX(histogram_roi->height - histogram_roi->crop_height - histogram_roi->crop_y, 0);
+  histogram_params->row_step = MAX(samples / DT_HISTOGRAM_MAX_SAMPLES, 1);
+
+  if(input_hash == 0) return 0;
+
+  // the histogram only depends on the input and on how it is collected
+  const dt_iop_module_t *module = piece->module;
+  const int32_t key[] = { histogram_params->bins_count, histogram_params->row_step, cst,
+                          module->histogram_cst, module->histogram_middle_grey };
+  uint64_t hash = input_hash;
+  const char *str = (const char *)key;
+  for(size_t i = 0; i < sizeof(key); i++) hash = ((hash << 5) + hash) ^ str[i];
+  str = (const char *)&histogram_params->mul;
+  for(size_t i = 0; i < sizeof(histogram_params->mul); i++) hash = ((hash << 5) + hash) ^ str[i];
+  str = (const char *)histogram_roi;
+  for(size_t i = 0; i < sizeof(dt_histogram_roi_t); i++) hash = ((hash << 5) + hash) ^ str[i];
+  return hash;
+}
 
+static void histogram_collect(dt_dev_pixelpipe_iop_t *piece, const void *pixel, const dt_iop_roi_t *roi,
+                              uint32_t **histogram, uint32_t *histogram_max, const uint64_t input_hash)
+{
   const dt_iop_colorspace_type_t cst = piece->module->input_colorspace(piece->module, piece->pipe, piece);
 
+  dt_dev_histogram_collection_params_t histogram_params;
+  dt_histogram_roi_t histogram_roi;
+  const uint64_t hash = histogram_prepare(piece, roi, &histogram_params, &histogram_roi, cst, input_hash);
+
+  // the input did not change since the last collection (e.g. while dragging a slider of this module)
+  if(hash && hash == piece->histogram_hash && *histogram) return;
+
+  const double start = dt_get_wtime();
+
   dt_histogram_helper(&histogram_params, &piece->histogram_stats, cst, piece->module->histogram_cst, pixel, histogram,
       piece->module->histogram_middle_grey, dt_ioppr_get_pipe_work_profile_info(piece->pipe));
   dt_histogram_max_helper(&piece->histogram_stats, cst, piece->module->histogram_cst, histogram, histogram_max);
+  piece->histogram_hash = hash;
+
+  dt_print(DT_DEBUG_PERF, "[histogram] %s collected %u samples (row step %u) in %.4f sec\n",
+           piece->module->op, piece->histogram_stats.pixels, histogram_params.row_step,
+           dt_get_wtime() - start);
 }
 
 #ifdef HAVE_OPENCL
@@ -541,8 +632,17 @@ static void histogram_collect(dt_dev_pixelpipe_iop_t *piece, const void *pixel,
 // as long as we work on small image sizes like in image preview
 static void histogram_collect_cl(int devid, dt_dev_pixelpipe_iop_t *piece, cl_mem img,
                                  const dt_iop_roi_t *roi, uint32_t **histogram, uint32_t *histogram_max,
-                                 float *buffer, size_t bufsize)
+                                 float *buffer, size_t bufsize, const uint64_t input_hash)
 {
+  const dt_iop_colorspace_type_t cst = piece->module->input_colorspace(piece->module, piece->pipe, piece);
+
+  dt_dev_histogram_collection_params_t histogram_params;
+  dt_histogram_roi_t histogram_roi;
+  const uint64_t hash = histogram_prepare(piece, roi, &histogram_params, &histogram_roi, cst, input_hash);
+
+  // no need to copy the image back from the device if the histogram is still valid
+  if(hash && hash == piece->histogram_hash && *histogram) return;
+
   float *tmpbuf = NULL;
   float *pixel = NULL;
 
@@ -561,25 +661,10 @@ static void histogram_collect_cl(int devid, dt_dev_pixelpipe_iop_t *piece, cl_me
     return;
   }
 
-  dt_dev_histogram_collection_params_t histogram_params = piece->histogram_params;
-
-  dt_histogram_roi_t histogram_roi;
-
-  // if the current module does did not specified its own ROI, use the full ROI
-  if(histogram_params.roi == NULL)
-  {
-    histogram_roi = (dt_histogram_roi_t){
-      .width = roi->width, .height = roi->height, .crop_x = 0, .crop_y = 0, .crop_width = 0, .crop_height = 0
-    };
-
-    histogram_params.roi = &histogram_roi;
-  }
-
-  const dt_iop_colorspace_type_t cst = piece->module->input_colorspace(piece->module, piece->pipe, piece);
-
   dt_histogram_helper(&histogram_params, &piece->histogram_stats, cst, piece->module->histogram_cst, pixel, histogram,
       piece->module->histogram_middle_grey, dt_ioppr_get_pipe_work_profile_info(piece->pipe));
   dt_histogram_max_helper(&piece->histogram_stats, cst, piece->module->histogram_cst, histogram, histogram_max);
+  piece->histogram_hash = hash;
 
   if(tmpbuf) dt_free_align(tmpbuf);
 }
@@ -920,13 +1005,13 @@ static gboolean _request_color_pick(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev,
 static void collect_histogram_on_CPU(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev,
                                      float *input, const dt_iop_roi_t *roi_in,
                                      dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece,
-                                     dt_pixelpipe_flow_t *pixelpipe_flow)
+                                     dt_pixelpipe_flow_t *pixelpipe_flow, const uint64_t input_hash)
 {
   // histogram collection for module
   if((dev->gui_attached || !(piece->request_histogram & DT_REQUEST_ONLY_IN_GUI))
      && (piece->request_histogram & DT_REQUEST_ON))
   {
-    histogram_collect(piece, input, roi_in, &(piece->histogram), piece->histogram_max);
+    histogram_collect(piece, input, roi_in, &(piece->histogram), piece->histogram_max, input_hash);
     *pixelpipe_flow |= (PIXELPIPE_FLOW_HISTOGRAM_ON_CPU);
     *pixelpipe_flow &= ~(PIXELPIPE_FLOW_HISTOGRAM_NONE | PIXELPIPE_FLOW_HISTOGRAM_ON_GPU);
 
@@ -949,7 +1034,8 @@ static int pixelpipe_process_on_CPU(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev,
                                     float *input, dt_iop_buffer_dsc_t *input_format, const dt_iop_roi_t *roi_in,
                                     void **output, dt_iop_buffer_dsc_t **out_format, const dt_iop_roi_t *roi_out,
                                     dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece,
-                                    dt_develop_tiling_t *tiling, dt_pixelpipe_flow_t *pixelpipe_flow)
+                                    dt_develop_tiling_t *tiling, dt_pixelpipe_flow_t *pixelpipe_flow,
+                                    const uint64_t input_hash)
 {
   if(dt_atomic_get_int(&pipe->shutdown))
     return 1;
@@ -970,7 +1056,7 @@ static int pixelpipe_process_on_CPU(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev,
   if(dt_atomic_get_int(&pipe->shutdown))
     return 1;
 
-  collect_histogram_on_CPU(pipe, dev, input, roi_in, module, piece, pixelpipe_flow);
+  collect_histogram_on_CPU(pipe, dev, input, roi_in, module, piece, pixelpipe_flow, input_hash);
 
   if(dt_atomic_get_int(&pipe->shutdown))
     return 1;
@@ -1222,6 +1308,10 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
                                     g_list_previous(modules), g_list_previous(pieces), pos - 1))
       return 1;
 
+    // identifies the input of this module, histograms collected from the same input are reused
+    uint64_t input_basichash = 0, input_hash = 0;
+    dt_dev_pixelpipe_cache_fullhash(pipe->image.id, &roi_in, pipe, pos - 1, &input_basichash, &input_hash);
+
     const size_t in_bpp = dt_iop_buffer_dsc_to_bpp(input_format);
 
     piece->dsc_out = piece->dsc_in = *input_format;
@@ -1460,7 +1550,7 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
             size_t outbufsize = bpp * roi_out->width * roi_out->height;
 
             histogram_collect_cl(pipe->devid, piece, cl_mem_input, &roi_in, &(piece->histogram),
-                                 piece->histogram_max, *output, outbufsize);
+                                 piece->histogram_max, *output, outbufsize, input_hash);
             pixelpipe_flow |= (PIXELPIPE_FLOW_HISTOGRAM_ON_GPU);
             pixelpipe_flow &= ~(PIXELPIPE_FLOW_HISTOGRAM_NONE | PIXELPIPE_FLOW_HISTOGRAM_ON_CPU);
 
@@ -1621,7 +1711,7 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
           // histogram collection for module
           if (success_opencl)
           {
-            collect_histogram_on_CPU(pipe, dev, input, &roi_in, module, piece, &pixelpipe_flow);
+            collect_histogram_on_CPU(pipe, dev, input, &roi_in, module, piece, &pixelpipe_flow, input_hash);
           }
 
           if(dt_atomic_get_int(&pipe->shutdown))
@@ -1825,7 +1915,7 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
             valid_input_on_gpu_only = FALSE;
           }
           if (pixelpipe_process_on_CPU(pipe, dev, input, input_format, &roi_in, output, out_format, roi_out,
-                                       module, piece, &tiling, &pixelpipe_flow))
+                                       module, piece, &tiling, &pixelpipe_flow, input_hash))
             return 1;
         }
 
@@ -1872,7 +1962,7 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
         }
 
         if (pixelpipe_process_on_CPU(pipe, dev, input, input_format, &roi_in, output, out_format, roi_out,
-                                     module, piece, &tiling, &pixelpipe_flow))
+                                     module, piece, &tiling, &pixelpipe_flow, input_hash))
           return 1;
       }
 
@@ -1884,12 +1974,12 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
       /* opencl is not inited or not enabled or we got no resource/device -> everything runs on cpu */
 
       if (pixelpipe_process_on_CPU(pipe, dev, input, input_format, &roi_in, output, out_format, roi_out,
-                                   module, piece, &tiling, &pixelpipe_flow))
+                                   module, piece, &tiling, &pixelpipe_flow, input_hash))
         return 1;
     }
 #else // HAVE_OPENCL
     if (pixelpipe_process_on_CPU(pipe, dev, input, input_format, &roi_in, output, out_format, roi_out,
-                                 module, piece, &tiling, &pixelpipe_flow))
+                                 module, piece, &tiling, &pixelpipe_flow, input_hash))
       return 1;
 #endif // HAVE_OPENCL
 
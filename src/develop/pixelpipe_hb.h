@@ -19,6 +19,7 @@
 #pragma once
 
 #include "common/atomic.h"
+#include "common/guided_filter.h"
 #include "common/image.h"
 #include "common/imageio.h"
 #include "common/iop_order.h"
@@ -55,6 +56,7 @@ typedef struct dt_dev_pixelpipe_iop_t
   uint32_t *histogram; // pointer to histogram data; histogram_bins_count bins with 4 channels each
   dt_dev_histogram_stats_t histogram_stats; // stats of captured histogram
   uint32_t histogram_max[4];                // maximum levels in histogram, one per channel
+  uint64_t histogram_hash;                  // identifies the input and parameters the histogram was collected from
 
   float iscale;        // input actually just downscaled buffer? iscale*iwidth = actual width
   int iwidth, iheight; // width and height of input buffer
@@ -173,6 +175,8 @@ typedef struct dt_dev_pixelpipe_t
   GList *forms;
   // the masks generated in the pipe for later reusal are inside dt_dev_pixelpipe_iop_t
   gboolean store_all_raster_masks;
+  // scratch memory of the guided filters run by modules and blending, kept between runs of this pipe
+  dt_guided_filter_workspace_t guided_filter_ws;
 } dt_dev_pixelpipe_t;
 
 struct dt_develop_t;
@@ -196,6 +200,8 @@ int dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe, size_t size, int32_t
 // constructs a new input buffer from given RGB float array.
 void dt_dev_pixelpipe_set_input(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, float *input, int width,
                                 int height, float iscale);
+// replaces the input by a resampled version of the same image, keeping the nodes already synched.
+void dt_dev_pixelpipe_rescale_input(dt_dev_pixelpipe_t *pipe, float *input, int width, int height, float iscale);
 // set some metadata for colorout to avoid race conditions.
 void dt_dev_pixelpipe_set_icc(dt_dev_pixelpipe_t *pipe, dt_colorspaces_color_profile_type_t icc_type,
                               const gchar *icc_filename, dt_iop_color_intent_t icc_intent);
@@ -215,6 +221,9 @@ void dt_dev_pixelpipe_flush_caches(dt_dev_pixelpipe_t *pipe);
 void dt_dev_pixelpipe_change(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev);
 // cleanup all nodes except clean input/output
 void dt_dev_pixelpipe_cleanup_nodes(dt_dev_pixelpipe_t *pipe);
+// get a pipe which processed an image ready for the next one: nodes are destroyed and the cache
+// invalidated, but its buffers and settings are kept.
+void dt_dev_pixelpipe_reset(dt_dev_pixelpipe_t *pipe);
 // sync with develop_t history stack from scratch (new node added, have to pop old ones)
 void dt_dev_pixelpipe_create_nodes(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev);
 // sync with develop_t history stack by just copying the top item params (same op, new params on top)
@@ -74,32 +74,12 @@ static int _get_selection_count()
 // get imgid from rowid
 static int _thumb_get_imgid(int rowid)
 {
-  int id = -1;
-  sqlite3_stmt *stmt;
-  gchar *query = g_strdup_printf("SELECT imgid FROM memory.collected_images WHERE rowid=%d", rowid);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    id = sqlite3_column_int(stmt, 0);
-  }
-  g_free(query);
-  sqlite3_finalize(stmt);
-  return id;
+  return dt_collection_memory_get_imgid(rowid);
 }
 // get rowid from imgid
 static int _thumb_get_rowid(int imgid)
 {
-  int id = -1;
-  sqlite3_stmt *stmt;
-  gchar *query = g_strdup_printf("SELECT rowid FROM memory.collected_images WHERE imgid=%d", imgid);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    id = sqlite3_column_int(stmt, 0);
-  }
-  g_free(query);
-  sqlite3_finalize(stmt);
-  return id;
+  return dt_collection_memory_get_rowid(imgid);
 }
 
 // compute thumb_size, thumbs_per_row and rows for the current widget size
@@ -1043,12 +1023,12 @@ static void _thumbs_prefetch(dt_culling_t *table)
   dt_mipmap_size_t mip = dt_mipmap_cache_get_matching_size(darktable.mipmap_cache, maxw, maxh);
 
   // prefetch next image
-  gchar *query;
-  sqlite3_stmt *stmt;
   dt_thumbnail_t *last = (dt_thumbnail_t *)g_list_last(table->list)->data;
+  int id = -1;
   if(table->navigate_inside_selection)
   {
-    query = g_strdup_printf(
+    sqlite3_stmt *stmt;
+    gchar *query = g_strdup_printf(
                           "SELECT m.imgid "
                           "FROM memory.collected_images AS m, main.selected_images AS s "
                           "WHERE m.imgid = s.imgid"
@@ -1056,31 +1036,25 @@ static void _thumbs_prefetch(dt_culling_t *table)
                           "ORDER BY m.rowid "
                           "LIMIT 1",
                           last->imgid);
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+    if(sqlite3_step(stmt) == SQLITE_ROW) id = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    g_free(query);
   }
   else
   {
-    query = g_strdup_printf(
-                          "SELECT m.imgid "
-                          "FROM memory.collected_images AS m "
-                          "WHERE m.rowid > (SELECT mm.rowid FROM memory.collected_images AS mm WHERE mm.imgid=%d) "
-                          "ORDER BY m.rowid "
-                          "LIMIT 1",
-                          last->imgid);
-  }
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    const int id = sqlite3_column_int(stmt, 0);
-    if(id > 0) dt_mipmap_cache_get(darktable.mipmap_cache, NULL, id, mip, DT_MIPMAP_PREFETCH, 'r');
+    const int rowid = _thumb_get_rowid(last->imgid);
+    if(rowid > 0) id = _thumb_get_imgid(rowid + 1);
   }
-  sqlite3_finalize(stmt);
-  g_free(query);
+  if(id > 0) dt_mipmap_cache_get(darktable.mipmap_cache, NULL, id, mip, DT_MIPMAP_PREFETCH, 'r');
 
   // prefetch previous image
   dt_thumbnail_t *prev = (dt_thumbnail_t *)(table->list)->data;
+  id = -1;
   if(table->navigate_inside_selection)
   {
-    query = g_strdup_printf(
+    sqlite3_stmt *stmt;
+    gchar *query = g_strdup_printf(
                           "SELECT m.imgid "
                           "FROM memory.collected_images AS m, main.selected_images AS s "
                           "WHERE m.imgid = s.imgid"
@@ -1088,24 +1062,17 @@ static void _thumbs_prefetch(dt_culling_t *table)
                           "ORDER BY m.rowid DESC "
                           "LIMIT 1",
                           prev->imgid);
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+    if(sqlite3_step(stmt) == SQLITE_ROW) id = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    g_free(query);
   }
   else
   {
-    query = g_strdup_printf(
-                          "SELECT m.imgid "
-                          "FROM memory.collected_images AS m "
-                          "WHERE m.rowid < (SELECT mm.rowid FROM memory.collected_images AS mm WHERE mm.imgid=%d) "
-                          "ORDER BY m.rowid DESC "
-                          "LIMIT 1",
-                          prev->imgid);
-  }
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    const int id = sqlite3_column_int(stmt, 0);
-    if(id > 0) dt_mipmap_cache_get(darktable.mipmap_cache, NULL, id, mip, DT_MIPMAP_PREFETCH, 'r');
+    const int rowid = _thumb_get_rowid(prev->imgid);
+    if(rowid > 1) id = _thumb_get_imgid(rowid - 1);
   }
-  sqlite3_finalize(stmt);
+  if(id > 0) dt_mipmap_cache_get(darktable.mipmap_cache, NULL, id, mip, DT_MIPMAP_PREFETCH, 'r');
 }
 
 static gboolean _thumbs_recreate_list_at(dt_culling_t *table, const int offset)
@@ -215,32 +215,12 @@ static dt_thumbnail_t *_thumb_get_under_mouse(dt_thumbtable_t *table)
 // get imgid from rowid
 static int _thumb_get_imgid(int rowid)
 {
-  int id = -1;
-  sqlite3_stmt *stmt;
-  gchar *query = g_strdup_printf("SELECT imgid FROM memory.collected_images WHERE rowid=%d", rowid);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    id = sqlite3_column_int(stmt, 0);
-  }
-  g_free(query);
-  sqlite3_finalize(stmt);
-  return id;
+  return dt_collection_memory_get_imgid(rowid);
 }
 // get rowid from imgid
 static int _thumb_get_rowid(int imgid)
 {
-  int id = -1;
-  sqlite3_stmt *stmt;
-  gchar *query = g_strdup_printf("SELECT rowid FROM memory.collected_images WHERE imgid=%d", imgid);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    id = sqlite3_column_int(stmt, 0);
-  }
-  g_free(query);
-  sqlite3_finalize(stmt);
-  return id;
+  return dt_collection_memory_get_rowid(imgid);
 }
 
 // get the coordinate of the rectangular area used by all the loaded thumbs
@@ -408,13 +388,7 @@ static gboolean _thumbtable_update_scrollbars(dt_thumbtable_t *table)
   table->code_scrolling = TRUE;
 
   // get the total number of images
-  int nbid = 1;
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT COUNT(*) FROM memory.collected_images", -1,
-                              &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW) nbid = sqlite3_column_int(stmt, 0);
-  sqlite3_finalize(stmt);
+  const int nbid = dt_collection_memory_count();
 
   // the number of line before
   int lbefore = (table->offset - 1) / table->thumbs_per_row;
@@ -500,7 +474,6 @@ static int _thumbs_remove_unneeded(dt_thumbtable_t *table)
 static int _thumbs_load_needed(dt_thumbtable_t *table)
 {
   if(!table->list) return 0;
-  sqlite3_stmt *stmt;
   int changed = 0;
 
   // we remember image margins for new thumbs (this limit flickering)
@@ -519,23 +492,19 @@ static int _thumbs_load_needed(dt_thumbtable_t *table)
     int space = first->y;
     if(table->mode == DT_THUMBTABLE_MODE_FILMSTRIP) space = first->x;
     const int nb_to_load = space / table->thumb_size + (space % table->thumb_size != 0);
-    gchar *query = g_strdup_printf(
-       "SELECT rowid, imgid"
-       " FROM memory.collected_images"
-       " WHERE rowid<%d"
-       " ORDER BY rowid DESC LIMIT %d",
-        first->rowid, nb_to_load * table->thumbs_per_row);
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+    const int from = MAX(1, first->rowid - nb_to_load * table->thumbs_per_row);
+    int32_t *imgids = malloc(sizeof(int32_t) * MAX(1, first->rowid - from));
+    const int nb = imgids ? dt_collection_memory_get_range(from, first->rowid - from, imgids) : 0;
     int posx = first->x;
     int posy = first->y;
     _pos_get_previous(table, &posx, &posy);
-    while(sqlite3_step(stmt) == SQLITE_ROW)
+    for(int k = nb - 1; k >= 0; k--)
     {
       if(posy < table->view_height) // we don't load invisible thumbs
       {
         dt_thumbnail_t *thumb = dt_thumbnail_new(
-            table->thumb_size, table->thumb_size, IMG_TO_FIT, sqlite3_column_int(stmt, 1),
-            sqlite3_column_int(stmt, 0), table->overlays,
+            table->thumb_size, table->thumb_size, IMG_TO_FIT, imgids[k],
+            from + k, table->overlays,
             DT_THUMBNAIL_CONTAINER_LIGHTTABLE, table->show_tooltips);
 
         if(table->mode == DT_THUMBTABLE_MODE_FILMSTRIP)
@@ -553,8 +522,7 @@ static int _thumbs_load_needed(dt_thumbtable_t *table)
       }
       _pos_get_previous(table, &posx, &posy);
     }
-    g_free(query);
-    sqlite3_finalize(stmt);
+    free(imgids);
   }
 
   // we load images at the end
@@ -573,25 +541,21 @@ static int _thumbs_load_needed(dt_thumbtable_t *table)
     if(table->mode == DT_THUMBTABLE_MODE_FILMSTRIP)
       space = table->view_width - (last->x + table->thumb_size);
     const int nb_to_load = space / table->thumb_size + (space % table->thumb_size != 0);
-    gchar *query = g_strdup_printf(
-       "SELECT rowid, imgid"
-       " FROM memory.collected_images"
-       " WHERE rowid>%d"
-       " ORDER BY rowid LIMIT %d",
-        last->rowid, nb_to_load * table->thumbs_per_row);
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+    const int max = MAX(1, nb_to_load * table->thumbs_per_row);
+    int32_t *imgids = malloc(sizeof(int32_t) * max);
+    const int nb = imgids ? dt_collection_memory_get_range(last->rowid + 1, max, imgids) : 0;
 
     int posx = last->x;
     int posy = last->y;
     _pos_get_next(table, &posx, &posy);
 
-    while(sqlite3_step(stmt) == SQLITE_ROW)
+    for(int k = 0; k < nb; k++)
     {
       if(posy + table->thumb_size >= 0) // we don't load invisible thumbs
       {
         dt_thumbnail_t *thumb = dt_thumbnail_new
-          (table->thumb_size, table->thumb_size, IMG_TO_FIT, sqlite3_column_int(stmt, 1),
-           sqlite3_column_int(stmt, 0), table->overlays,
+          (table->thumb_size, table->thumb_size, IMG_TO_FIT, imgids[k],
+           last->rowid + 1 + k, table->overlays,
            DT_THUMBNAIL_CONTAINER_LIGHTTABLE, table->show_tooltips);
         if(table->mode == DT_THUMBTABLE_MODE_FILMSTRIP)
         {
@@ -608,13 +572,78 @@ static int _thumbs_load_needed(dt_thumbtable_t *table)
       }
       _pos_get_next(table, &posx, &posy);
     }
-    g_free(query);
-    sqlite3_finalize(stmt);
+    free(imgids);
   }
 
   return changed;
 }
 
+// number of screens prefetched ahead of the scrolling, and how far ahead in time we look
+#define PREFETCH_MAX_SCREENS 3
+#define PREFETCH_LOOKAHEAD 1.0 // seconds
+
+// queue disk cache prefetches of the thumbnails which will show up if the scrolling goes on. the faster the
+// scrolling, the more screens ahead. a change of direction drops what is still queued for the other one.
+static void _thumbs_prefetch(dt_thumbtable_t *table, const int x, const int y)
+{
+  if(!table->list) return;
+  const gboolean vertical = table->mode == DT_THUMBTABLE_MODE_FILEMANAGER;
+  if(!vertical && table->mode != DT_THUMBTABLE_MODE_FILMSTRIP) return;
+  const int delta = vertical ? y : x;
+  if(delta == 0) return;
+
+  // moving the thumbs up (or left) means we scroll towards the end of the collection
+  const int dir = delta < 0 ? 1 : -1;
+  const double now = dt_get_wtime();
+  const int view = MAX(1, vertical ? table->view_height : table->view_width);
+  const double dt = now - table->prefetch_time;
+  const float speed = dt > 0.0 && dt < 1.0 ? fabs((double)delta / view / dt) : 0.0f;
+  const gboolean restart = dir != table->prefetch_dir;
+  table->prefetch_speed = restart ? speed : 0.7f * table->prefetch_speed + 0.3f * speed;
+  table->prefetch_dir = dir;
+  table->prefetch_time = now;
+
+  const int screens = CLAMP(1 + (int)(table->prefetch_speed * PREFETCH_LOOKAHEAD), 1, PREFETCH_MAX_SCREENS);
+  const int per_screen = table->rows * table->thumbs_per_row;
+  const int count = screens * per_screen;
+  int32_t *imgids = malloc(sizeof(int32_t) * count);
+  if(!imgids) return;
+
+  int nb = 0;
+  if(dir > 0)
+  {
+    const dt_thumbnail_t *last = (dt_thumbnail_t *)g_list_last(table->list)->data;
+    nb = dt_collection_memory_get_range(last->rowid + 1, count, imgids);
+  }
+  else
+  {
+    const dt_thumbnail_t *first = (dt_thumbnail_t *)table->list->data;
+    const int from = MAX(1, first->rowid - count);
+    nb = dt_collection_memory_get_range(from, first->rowid - from, imgids);
+    // nearest first
+    for(int i = 0, j = nb - 1; i < j; i++, j--)
+    {
+      const int32_t tmp = imgids[i];
+      imgids[i] = imgids[j];
+      imgids[j] = tmp;
+    }
+  }
+
+  // same size as the one the thumbnails will ask for
+  const dt_thumbnail_t *th = (dt_thumbnail_t *)table->list->data;
+  int image_w = table->thumb_size, image_h = table->thumb_size;
+  if(th->img_margin)
+  {
+    image_w = th->width - th->img_margin->left - th->img_margin->right;
+    image_h = th->height - th->img_margin->top - th->img_margin->bottom;
+  }
+  const dt_mipmap_size_t mip = dt_mipmap_cache_get_matching_size(darktable.mipmap_cache,
+                                                                 image_w * darktable.gui->ppd,
+                                                                 image_h * darktable.gui->ppd);
+  if(nb > 0) dt_mipmap_cache_prefetch(darktable.mipmap_cache, imgids, nb, mip, restart);
+  free(imgids);
+}
+
 // move all thumbs from the table.
 // if clamp, we verify that the move is allowed (collection bounds, etc...)
 static gboolean _move(dt_thumbtable_t *table, const int x, const int y, gboolean clamp)
@@ -654,12 +683,7 @@ static gboolean _move(dt_thumbtable_t *table, const int x, const int y, gboolean
       if(table->thumbs_per_row == 1 && posy < 0 && g_list_is_singleton(table->list))
       {
         // special case for zoom == 1 as we don't want any space under last image (the image would have disappear)
-        int nbid = 1;
-        sqlite3_stmt *stmt;
-        DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT COUNT(*) FROM memory.collected_images",
-                                    -1, &stmt, NULL);
-        if(sqlite3_step(stmt) == SQLITE_ROW) nbid = sqlite3_column_int(stmt, 0);
-        sqlite3_finalize(stmt);
+        const int nbid = dt_collection_memory_count();
         if(nbid <= last->rowid) return FALSE;
       }
       else
@@ -747,6 +771,8 @@ static gboolean _move(dt_thumbtable_t *table, const int x, const int y, gboolean
   // update scrollbars
   _thumbtable_update_scrollbars(table);
 
+  _thumbs_prefetch(table, posx, posy);
+
   return TRUE;
 }
 
@@ -1891,7 +1917,6 @@ void dt_thumbtable_full_redraw(dt_thumbtable_t *table, gboolean force)
 
     const double start = dt_get_wtime();
     table->dragging = FALSE;
-    sqlite3_stmt *stmt;
     dt_print(DT_DEBUG_LIGHTTABLE,
              "reload thumbs from db. force=%d w=%d h=%d zoom=%d rows=%d size=%d offset=%d centering=%d...\n",
              force, table->view_width, table->view_height, table->thumbs_per_row, table->rows, table->thumb_size,
@@ -1954,14 +1979,14 @@ void dt_thumbtable_full_redraw(dt_thumbtable_t *table, gboolean force)
     // we add the thumbs
     GList *newlist = NULL;
     int nbnew = 0;
-    gchar *query
-        = g_strdup_printf("SELECT rowid, imgid FROM memory.collected_images WHERE rowid>=%d LIMIT %d",
-                          offset, table->rows * table->thumbs_per_row - empty_start);
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-    while(sqlite3_step(stmt) == SQLITE_ROW)
+    const int first_rowid = MAX(offset, 1);
+    const int max = MAX(1, table->rows * table->thumbs_per_row - empty_start);
+    int32_t *imgids = malloc(sizeof(int32_t) * max);
+    const int nb = imgids ? dt_collection_memory_get_range(first_rowid, max, imgids) : 0;
+    for(int k = 0; k < nb; k++)
     {
-      const int nrow = sqlite3_column_int(stmt, 0);
-      const int nid = sqlite3_column_int(stmt, 1);
+      const int nrow = first_rowid + k;
+      const int nid = imgids[k];
 
       // first, we search if the thumb is already here
       GList *tl = g_list_find_custom(table->list, GINT_TO_POINTER(nid), _list_compare_by_imgid);
@@ -2006,6 +2031,7 @@ void dt_thumbtable_full_redraw(dt_thumbtable_t *table, gboolean force)
       // if it's the offset, we record the imgid
       if(nrow == table->offset) table->offset_imgid = nid;
     }
+    free(imgids);
 
     // now we cleanup all remaining thumbs from old table->list and set it again
     g_list_free_full(table->list, _list_remove_thumb);
@@ -2052,8 +2078,6 @@ void dt_thumbtable_full_redraw(dt_thumbtable_t *table, gboolean force)
     }
 
     dt_print(DT_DEBUG_LIGHTTABLE, "done in %0.04f sec %d thumbs reloaded\n", dt_get_wtime() - start, nbnew);
-    g_free(query);
-    sqlite3_finalize(stmt);
 
     if(darktable.unmuted & DT_DEBUG_CACHE) dt_mipmap_cache_print(darktable.mipmap_cache);
   }
@@ -2541,13 +2565,7 @@ static gboolean _filemanager_key_move(dt_thumbtable_t *table, dt_thumbtable_move
 
   int newrowid = baserowid;
   // last rowid of the current collection
-  int maxrowid = 1;
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT MAX(rowid) FROM memory.collected_images", -1,
-                              &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW) maxrowid = sqlite3_column_int(stmt, 0);
-  sqlite3_finalize(stmt);
+  const int maxrowid = dt_collection_memory_count();
 
   // classic keys
   if(move == DT_THUMBTABLE_MOVE_LEFT && baserowid > 1)
@@ -2620,14 +2638,7 @@ static gboolean _zoomable_key_move(dt_thumbtable_t *table, dt_thumbtable_move_t
     moved = _zoomable_ensure_rowid_visibility(table, 1);
   else if(move == DT_THUMBTABLE_MOVE_END)
   {
-    int maxrowid = 1;
-    sqlite3_stmt *stmt;
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "SELECT MAX(rowid) FROM memory.collected_images",
-                                -1, &stmt, NULL);
-    if(sqlite3_step(stmt) == SQLITE_ROW) maxrowid = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
-    moved = _zoomable_ensure_rowid_visibility(table, maxrowid);
+    moved = _zoomable_ensure_rowid_visibility(table, dt_collection_memory_count());
   }
   else if(move == DT_THUMBTABLE_MOVE_ALIGN)
   {
@@ -103,6 +103,11 @@ typedef struct dt_thumbtable_t
   // let's remember previous thumbnail generation settings to detect if they change
   int pref_embedded;
   int pref_hq;
+
+  // scrolling state to prefetch the thumbnails coming next
+  int prefetch_dir;     // direction of the last move: 1 towards the end of the collection, -1 towards the start
+  double prefetch_time; // time of the last move
+  float prefetch_speed; // smoothed scrolling speed, in screens per second
 } dt_thumbtable_t;
 
 dt_thumbtable_t *dt_thumbtable_new();
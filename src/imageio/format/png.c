@@ -117,6 +117,201 @@ static void PNGwriteRawProfile(png_struct *ping, png_info *ping_info, char *prof
   png_free(ping, text);
 }
 
+// parallel encoder: rows are filtered and deflated in independent blocks, each primed with the
+// last 32k of the previous block as dictionary and ended with a sync flush, like pigz does. the
+// blocks are concatenated into one zlib stream and written as IDAT chunks, so the file is a
+// standard png that any decoder reads.
+#define PNG_BLOCK_SIZE (256 * 1024) // filtered bytes per deflate block
+#define PNG_DICT_SIZE 32768
+
+static inline int _png_paeth(const int a, const int b, const int c)
+{
+  const int p = a + b - c;
+  const int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+  if(pa <= pb && pa <= pc) return a;
+  if(pb <= pc) return b;
+  return c;
+}
+
+// convert row y of the 4 channel input to packed rgb in png byte order
+static void _png_pack_row(uint8_t *out, const void *ivoid, const int width, const int bpp, const int y)
+{
+  if(bpp > 8)
+  {
+    const uint16_t *in = (const uint16_t *)ivoid + (size_t)4 * y * width;
+    for(int x = 0; x < width; x++, in += 4)
+      for(int c = 0; c < 3; c++)
+      {
+        *out++ = in[c] >> 8;
+        *out++ = in[c] & 0xff;
+      }
+  }
+  else
+  {
+    const uint8_t *in = (const uint8_t *)ivoid + (size_t)4 * y * width;
+    for(int x = 0; x < width; x++, in += 4, out += 3) memcpy(out, in, 3);
+  }
+}
+
+// filter one row the way libpng does by default: try all five filters and keep the one with the
+// smallest sum of absolute (signed) residuals. prev is all zeros for the first row of the image.
+static void _png_filter_row(uint8_t *out, const uint8_t *row, const uint8_t *prev, const size_t rowbytes,
+                            const int pixbytes, uint8_t *scratch)
+{
+  uint8_t *const none = (uint8_t *)row, *const sub = scratch, *const up = scratch + rowbytes,
+                 *const avg = scratch + 2 * rowbytes, *const paeth = scratch + 3 * rowbytes;
+  size_t sum[5] = { 0 };
+
+  for(size_t i = 0; i < rowbytes; i++)
+  {
+    const int a = i >= pixbytes ? row[i - pixbytes] : 0;
+    const int b = prev[i];
+    const int c = i >= pixbytes ? prev[i - pixbytes] : 0;
+    sub[i] = row[i] - a;
+    up[i] = row[i] - b;
+    avg[i] = row[i] - ((a + b) >> 1);
+    paeth[i] = row[i] - _png_paeth(a, b, c);
+    sum[0] += abs((int8_t)none[i]);
+    sum[1] += abs((int8_t)sub[i]);
+    sum[2] += abs((int8_t)up[i]);
+    sum[3] += abs((int8_t)avg[i]);
+    sum[4] += abs((int8_t)paeth[i]);
+  }
+
+  const uint8_t *cand[5] = { none, sub, up, avg, paeth };
+  int best = 0;
+  for(int f = 1; f < 5; f++)
+    if(sum[f] < sum[best]) best = f;
+  out[0] = best;
+  memcpy(out + 1, cand[best], rowbytes);
+}
+
+typedef struct _png_block_t
+{
+  uint8_t *data;
+  size_t size;
+  uLong adler;
+  size_t in_size;
+} _png_block_t;
+
+// filter rows y0..y1 and deflate them. the rows before y0 are filtered as well to serve as dictionary.
+static int _png_compress_block(_png_block_t *block, const void *ivoid, const int width, const int bpp,
+                               const int level, const int y0, const int y1, const int dict_rows,
+                               const gboolean last)
+{
+  const int pixbytes = 3 * bpp / 8;
+  const size_t rowbytes = (size_t)width * pixbytes;
+  const size_t stride = rowbytes + 1;
+  const int yd = MAX(0, y0 - dict_rows);
+  int err = 1;
+
+  uint8_t *filtered = malloc(stride * (y1 - yd));
+  // current row, previous row and four filter candidates
+  uint8_t *rows = calloc(6, rowbytes);
+  if(!filtered || !rows) goto error;
+
+  uint8_t *cur = rows, *prev = rows + rowbytes;
+  if(yd > 0) _png_pack_row(prev, ivoid, width, bpp, yd - 1);
+  for(int y = yd; y < y1; y++)
+  {
+    _png_pack_row(cur, ivoid, width, bpp, y);
+    _png_filter_row(filtered + (y - yd) * stride, cur, prev, rowbytes, pixbytes, rows + 2 * rowbytes);
+    uint8_t *tmp = prev;
+    prev = cur;
+    cur = tmp;
+  }
+
+  const uint8_t *in = filtered + (y0 - yd) * stride;
+  const size_t in_size = (y1 - y0) * stride;
+
+  z_stream zs = { 0 };
+  if(deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) goto error;
+  if(y0 > yd)
+  {
+    const size_t dict = MIN(PNG_DICT_SIZE, (y0 - yd) * stride);
+    deflateSetDictionary(&zs, in - dict, dict);
+  }
+  const size_t bound = deflateBound(&zs, in_size) + 16;
+  block->data = malloc(bound);
+  if(block->data)
+  {
+    zs.next_in = (Bytef *)in;
+    zs.avail_in = in_size;
+    zs.next_out = block->data;
+    zs.avail_out = bound;
+    const int ret = deflate(&zs, last ? Z_FINISH : Z_SYNC_FLUSH);
+    if((last && ret == Z_STREAM_END) || (!last && ret == Z_OK && zs.avail_in == 0))
+    {
+      block->size = bound - zs.avail_out;
+      block->adler = adler32(1L, in, in_size);
+      block->in_size = in_size;
+      err = 0;
+    }
+  }
+  deflateEnd(&zs);
+
+error:
+  free(rows);
+  free(filtered);
+  return err;
+}
+
+static int _png_write_idat_parallel(png_structp png_ptr, const void *ivoid, const int width, const int height,
+                                    const int bpp, const int level)
+{
+  const size_t stride = (size_t)width * 3 * bpp / 8 + 1;
+  const int block_rows = MAX(1, PNG_BLOCK_SIZE / stride);
+  const int dict_rows = (PNG_DICT_SIZE + stride - 1) / stride;
+  const int nblocks = (height + block_rows - 1) / block_rows;
+  // keep the number of compressed blocks in memory bounded
+  const int batch = 4 * dt_get_num_threads();
+
+  _png_block_t *blocks = calloc(batch, sizeof(_png_block_t));
+  if(!blocks) return 1;
+
+  // zlib header, see rfc 1950
+  const int flevel = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+  uint8_t header[2] = { 0x78, flevel << 6 };
+  header[1] += 31 - (header[0] * 256 + header[1]) % 31;
+  png_write_chunk(png_ptr, (png_bytep)"IDAT", header, 2);
+
+  uLong adler = 1L;
+  int err = 0;
+  for(int b0 = 0; b0 < nblocks && !err; b0 += batch)
+  {
+    const int n = MIN(batch, nblocks - b0);
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(blocks, ivoid, width, height, bpp, level, block_rows, dict_rows, nblocks, b0, n) \
+  schedule(dynamic) reduction(|:err)
+#endif
+    for(int k = 0; k < n; k++)
+    {
+      const int b = b0 + k;
+      err |= _png_compress_block(&blocks[k], ivoid, width, bpp, level, b * block_rows,
+                                 MIN(height, (b + 1) * block_rows), dict_rows, b == nblocks - 1);
+    }
+
+    for(int k = 0; k < n; k++)
+    {
+      if(!err)
+      {
+        png_write_chunk(png_ptr, (png_bytep)"IDAT", blocks[k].data, blocks[k].size);
+        adler = adler32_combine(adler, blocks[k].adler, blocks[k].in_size);
+      }
+      free(blocks[k].data);
+      blocks[k].data = NULL;
+    }
+  }
+  free(blocks);
+  if(err) return 1;
+
+  const uint8_t trailer[4] = { adler >> 24, (adler >> 16) & 0xff, (adler >> 8) & 0xff, adler & 0xff };
+  png_write_chunk(png_ptr, (png_bytep)"IDAT", (png_bytep)trailer, 4);
+  png_write_chunk(png_ptr, (png_bytep)"IEND", NULL, 0);
+  return 0;
+}
+
 int write_image(dt_imageio_module_data_t *p_tmp, const char *filename, const void *ivoid,
                 dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                 void *exif, int exif_len, int imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe,
@@ -195,31 +390,52 @@ int write_image(dt_imageio_module_data_t *p_tmp, const char *filename, const voi
 
   png_write_info(png_ptr, info_ptr);
 
-  /*
-   * Get rid of filler (OR ALPHA) bytes, pack XRGB/RGBX/ARGB/RGBA into
-   * RGB (4 channels -> 3 channels). The second parameter is not used.
-   */
-  png_set_filler(png_ptr, 0, PNG_FILLER_AFTER);
-
-  png_bytep *row_pointers = dt_alloc_align(64, sizeof(png_bytep) * height);
-
-  if(p->bpp > 8)
+  const double start = dt_get_wtime();
+  const size_t bytes = (size_t)width * height * 3 * p->bpp / 8;
+  const gboolean parallel = dt_get_num_threads() > 1 && bytes >= 4 * PNG_BLOCK_SIZE
+                            && dt_conf_get_bool("plugins/imageio/format/parallel_compression");
+  if(parallel)
   {
-    /* swap bytes of 16 bit files to most significant bit first */
-    png_set_swap(png_ptr);
-
-    for(unsigned i = 0; i < height; i++) row_pointers[i] = (png_bytep)((uint16_t *)ivoid + (size_t)4 * i * width);
+    if(_png_write_idat_parallel(png_ptr, ivoid, width, height, p->bpp, p->compression))
+    {
+      fclose(f);
+      png_destroy_write_struct(&png_ptr, &info_ptr);
+      return 1;
+    }
   }
   else
   {
-    for(unsigned i = 0; i < height; i++) row_pointers[i] = (uint8_t *)ivoid + (size_t)4 * i * width;
-  }
+    /*
+     * Get rid of filler (OR ALPHA) bytes, pack XRGB/RGBX/ARGB/RGBA into
+     * RGB (4 channels -> 3 channels). The second parameter is not used.
+     */
+    png_set_filler(png_ptr, 0, PNG_FILLER_AFTER);
+
+    png_bytep *row_pointers = dt_alloc_align(64, sizeof(png_bytep) * height);
+
+    if(p->bpp > 8)
+    {
+      /* swap bytes of 16 bit files to most significant bit first */
+      png_set_swap(png_ptr);
 
-  png_write_image(png_ptr, row_pointers);
+      for(unsigned i = 0; i < height; i++) row_pointers[i] = (png_bytep)((uint16_t *)ivoid + (size_t)4 * i * width);
+    }
+    else
+    {
+      for(unsigned i = 0; i < height; i++) row_pointers[i] = (uint8_t *)ivoid + (size_t)4 * i * width;
+    }
+
+    png_write_image(png_ptr, row_pointers);
+
+    dt_free_align(row_pointers);
+
+    png_write_end(png_ptr, info_ptr);
+  }
 
-  dt_free_align(row_pointers);
+  const double elapsed = MAX(dt_get_wtime() - start, 1e-6);
+  dt_print(DT_DEBUG_PERF, "[png] %s encoder: %.1f MB in %.3f s (%.1f MB/s)\n", parallel ? "parallel" : "libpng",
+           bytes / 1e6, elapsed, bytes / 1e6 / elapsed);
 
-  png_write_end(png_ptr, info_ptr);
   png_destroy_write_struct(&png_ptr, &info_ptr);
   fclose(f);
   return 0;
@@ -64,6 +64,10 @@ typedef struct dt_imageio_disk_t
   dt_variables_params_t *vp;
 } dt_imageio_disk_t;
 
+// the files being written by concurrent store() calls, guarded by darktable.plugin_threadsafe. two
+// images expanding to the same name must not write that file at the same time, whatever the conflict mode.
+static GHashTable *_files_in_progress = NULL;
+static pthread_cond_t _file_done = PTHREAD_COND_INITIALIZER;
 
 const char *name(const struct dt_imageio_module_storage_t *self)
 {
@@ -234,14 +238,15 @@ int store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *sdata, co
   g_strlcpy(pattern, d->filename, sizeof(pattern));
   gboolean from_cache = FALSE;
   dt_image_full_path(imgid, input_dir, sizeof(input_dir), &from_cache);
-  // set variable values to expand them afterwards in darktable variables
-  dt_variables_set_max_width_height(d->vp, fdata->max_width, fdata->max_height);
-  dt_variables_set_upscale(d->vp, upscale);
 
   gboolean fail = FALSE;
   // we're potentially called in parallel. have sequence number synchronized:
   dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
   {
+    if(!_files_in_progress) _files_in_progress = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    // set variable values to expand them afterwards in darktable variables
+    dt_variables_set_max_width_height(d->vp, fdata->max_width, fdata->max_height);
+    dt_variables_set_upscale(d->vp, upscale);
 try_again:
     // avoid braindead export which is bound to overwrite at random:
     if(total > 1 && !g_strrstr(pattern, "$"))
@@ -302,7 +307,7 @@ try_again:
     if(!fail && d->onsave_action == DT_EXPORT_ONCONFLICT_UNIQUEFILENAME)
     {
       int seq = 1;
-      while(g_file_test(filename, G_FILE_TEST_EXISTS))
+      while(g_file_test(filename, G_FILE_TEST_EXISTS) || g_hash_table_contains(_files_in_progress, filename))
       {
         snprintf(c, filename_free_space, "_%.2d.%s", seq, ext);
         seq++;
@@ -311,7 +316,7 @@ try_again:
 
     if(!fail && d->onsave_action == DT_EXPORT_ONCONFLICT_SKIP)
     {
-      if(g_file_test(filename, G_FILE_TEST_EXISTS))
+      if(g_file_test(filename, G_FILE_TEST_EXISTS) || g_hash_table_contains(_files_in_progress, filename))
       {
         dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
         fprintf(stderr, "[export_job] skipping `%s'\n", filename);
@@ -320,13 +325,28 @@ try_again:
         return 0;
       }
     }
+
+    if(!fail)
+    {
+      // overwrite: wait for the other image to be done with the file, the last one wins
+      while(g_hash_table_contains(_files_in_progress, filename))
+        dt_pthread_cond_wait(&_file_done, &darktable.plugin_threadsafe);
+      g_hash_table_add(_files_in_progress, g_strdup(filename));
+    }
   } // end of critical block
   dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
   if(fail) return 1;
 
   /* export image to file */
-  if(dt_imageio_export(imgid, filename, format, fdata, high_quality, upscale, TRUE, export_masks, icc_type,
-                       icc_filename, icc_intent, self, sdata, num, total, metadata) != 0)
+  const int err = dt_imageio_export(imgid, filename, format, fdata, high_quality, upscale, TRUE, export_masks,
+                                    icc_type, icc_filename, icc_intent, self, sdata, num, total, metadata);
+
+  dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
+  g_hash_table_remove(_files_in_progress, filename);
+  pthread_cond_broadcast(&_file_done);
+  dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+
+  if(err != 0)
   {
     fprintf(stderr, "[imageio_storage_disk] could not export to file: `%s'!\n", filename);
     dt_control_log(_("could not export to file `%s'!"), filename);
@@ -339,6 +359,11 @@ try_again:
   return 0;
 }
 
+gboolean concurrent_store(dt_imageio_module_storage_t *self)
+{
+  return TRUE;
+}
+
 size_t params_size(dt_imageio_module_storage_t *self)
 {
   return sizeof(dt_imageio_disk_t) - sizeof(void *);
@@ -28,6 +28,7 @@
 #include "dtgtk/paint.h"
 #include "gui/gtk.h"
 #include "imageio/storage/imageio_storage_api.h"
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -44,6 +45,7 @@ typedef struct dt_imageio_email_t
 {
   char filename[DT_MAX_PATH_FOR_PARAMS];
   GList *images;
+  dt_pthread_mutex_t images_lock; // store() runs in parallel on the export lanes
 } dt_imageio_email_t;
 
 
@@ -144,19 +146,23 @@ int store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *sdata, co
   dt_control_log(ngettext("%d/%d exported to `%s'", "%d/%d exported to `%s'", num),
                  num, total, attachment->file);
 
-#ifdef _OPENMP // store can be called in parallel, so synch access to shared memory
-#pragma omp critical
-#endif
+  dt_pthread_mutex_lock(&d->images_lock);
   d->images = g_list_append(d->images, attachment);
+  dt_pthread_mutex_unlock(&d->images_lock);
 
   g_free(filename);
 
   return 0;
 }
 
+gboolean concurrent_store(dt_imageio_module_storage_t *self)
+{
+  return TRUE;
+}
+
 size_t params_size(dt_imageio_module_storage_t *self)
 {
-  return sizeof(dt_imageio_email_t) - sizeof(GList *);
+  return offsetof(dt_imageio_email_t, images);
 }
 
 void init(dt_imageio_module_storage_t *self)
@@ -166,6 +172,7 @@ void init(dt_imageio_module_storage_t *self)
 void *get_params(dt_imageio_module_storage_t *self)
 {
   dt_imageio_email_t *d = (dt_imageio_email_t *)g_malloc0(sizeof(dt_imageio_email_t));
+  dt_pthread_mutex_init(&d->images_lock, NULL);
   return d;
 }
 
@@ -178,6 +185,8 @@ int set_params(dt_imageio_module_storage_t *self, const void *params, const int
 void free_params(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *params)
 {
   if(!params) return;
+  dt_imageio_email_t *d = (dt_imageio_email_t *)params;
+  dt_pthread_mutex_destroy(&d->images_lock);
   free(params);
 }
 
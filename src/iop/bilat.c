@@ -74,7 +74,16 @@ typedef struct dt_iop_bilat_params_v1_t
 }
 dt_iop_bilat_params_v1_t;
 
-typedef dt_iop_bilat_params_t dt_iop_bilat_data_t;
+typedef struct dt_iop_bilat_data_t
+{
+  dt_iop_bilat_mode_t mode;
+  float sigma_r;
+  float sigma_s;
+  float detail;
+  float midtone;
+  local_laplacian_arena_t arena; // pyramid buffers kept across runs of this pipe
+}
+dt_iop_bilat_data_t;
 
 typedef struct dt_iop_bilat_gui_data_t
 {
@@ -274,7 +283,12 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
 {
   dt_iop_bilat_params_t *p = (dt_iop_bilat_params_t *)p1;
   dt_iop_bilat_data_t *d = (dt_iop_bilat_data_t *)piece->data;
-  *d = *p;
+  d->mode = p->mode;
+  d->sigma_r = p->sigma_r;
+  d->sigma_s = p->sigma_s;
+  d->detail = p->detail;
+  d->midtone = p->midtone;
+  if(d->mode != s_mode_local_laplacian) local_laplacian_arena_free(&d->arena);
 
 #ifdef HAVE_OPENCL
   if(d->mode == s_mode_bilateral)
@@ -293,6 +307,8 @@ void init_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pi
 
 void cleanup_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
+  dt_iop_bilat_data_t *d = (dt_iop_bilat_data_t *)piece->data;
+  local_laplacian_arena_free(&d->arena);
   free(piece->data);
   piece->data = NULL;
 }
@@ -322,7 +338,8 @@ void process_sse2(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, c
   }
   else // s_mode_local_laplacian
   {
-    local_laplacian_sse2(i, o, roi_in->width, roi_in->height, d->midtone, d->sigma_s, d->sigma_r, d->detail, 0);
+    local_laplacian_sse2(i, o, roi_in->width, roi_in->height, d->midtone, d->sigma_s, d->sigma_r, d->detail, 0,
+                         &d->arena);
   }
 
   if(piece->pipe->mask_display & DT_DEV_PIXELPIPE_DISPLAY_MASK) dt_iop_alpha_copy(i, o, roi_in->width, roi_in->height);
@@ -352,7 +369,7 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
   }
   else // s_mode_local_laplacian
   {
-    local_laplacian(i, o, roi_in->width, roi_in->height, d->midtone, d->sigma_s, d->sigma_r, d->detail, 0);
+    local_laplacian(i, o, roi_in->width, roi_in->height, d->midtone, d->sigma_s, d->sigma_r, d->detail, 0, &d->arena);
   }
 
   if(piece->pipe->mask_display & DT_DEV_PIXELPIPE_DISPLAY_MASK) dt_iop_alpha_copy(i, o, roi_in->width, roi_in->height);
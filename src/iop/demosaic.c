@@ -54,6 +54,11 @@ DT_MODULE_INTROSPECTION(4, dt_iop_demosaic_params_t)
 #define DEMOSAIC_DUAL 2048   // masks for dual demosaicing methods
 #define REDUCESIZE 64
 
+// edge length of the input crop used to measure demosaicer throughput
+#define BENCHMARK_SIZE 768
+// number of algorithms covered by the benchmark
+#define BENCHMARK_METHODS 9
+
 typedef enum dt_iop_demosaic_method_t
 {
   // methods for Bayer images
@@ -190,8 +195,35 @@ typedef struct dt_iop_demosaic_global_data_t
   int kernel_write_blended_dual;
   float *lmmse_gamma_in;
   float *lmmse_gamma_out;
+  // measured throughput in MPix/s per entry of demosaic_benchmarks[], 0 if unknown
+  float bench_mpps[BENCHMARK_METHODS];
+  // benchmark already checked in this session, for bayer and x-trans
+  gboolean bench_done[2];
+  dt_pthread_mutex_t bench_lock;
 } dt_iop_demosaic_global_data_t;
 
+// algorithms covered by the throughput benchmark. per sensor type they are listed by roughly
+// decreasing quality, the time budget policy only ever moves down this list.
+typedef struct dt_iop_demosaic_benchmark_t
+{
+  dt_iop_demosaic_method_t method;
+  const char *key;    // result is stored as plugins/darkroom/demosaic/benchmark/<key>
+  gboolean fallback;  // may be picked in place of a slower method
+} dt_iop_demosaic_benchmark_t;
+
+static const dt_iop_demosaic_benchmark_t demosaic_benchmarks[BENCHMARK_METHODS] =
+{
+  { DT_IOP_DEMOSAIC_LMMSE, "lmmse", TRUE },
+  { DT_IOP_DEMOSAIC_AMAZE, "amaze", TRUE },
+  { DT_IOP_DEMOSAIC_RCD, "rcd", TRUE },
+  { DT_IOP_DEMOSAIC_PPG, "ppg", TRUE },
+  { DT_IOP_DEMOSAIC_VNG4, "vng4", FALSE },
+  { DT_IOP_DEMOSAIC_MARKESTEIJN_3, "markesteijn3", TRUE },
+  { DT_IOP_DEMOSAIC_FDC, "fdc", TRUE },
+  { DT_IOP_DEMOSAIC_MARKESTEIJN, "markesteijn", TRUE },
+  { DT_IOP_DEMOSAIC_VNG, "vng", TRUE },
+};
+
 typedef struct dt_iop_demosaic_data_t
 {
   uint32_t green_eq;
@@ -2933,6 +2965,204 @@ static int demosaic_qual_flags(const dt_dev_pixelpipe_iop_t *const piece,
   return flags;
 }
 
+static void lmmse_gamma_init(dt_iop_demosaic_global_data_t *gd)
+{
+  if(gd->lmmse_gamma_in) return;
+
+  gd->lmmse_gamma_in = dt_alloc_align_float(65536);
+  gd->lmmse_gamma_out = dt_alloc_align_float(65536);
+#ifdef _OPENMP
+    #pragma omp for
+#endif
+  for(int j = 0; j < 65536; j++)
+  {
+    const double x = (double)j / 65535.0;
+    gd->lmmse_gamma_in[j]  = (x <= 0.001867) ? x * 17.0 : 1.044445 * exp(log(x) / 2.4) - 0.044445;
+    gd->lmmse_gamma_out[j] = (x <= 0.031746) ? x / 17.0 : exp(log((x + 0.044445) / 1.044445) * 2.4);
+  }
+}
+
+// time budget in ms for full scale demosaicing in this pipe, 0 means unlimited
+static int demosaic_time_budget(const dt_dev_pixelpipe_t *const pipe)
+{
+  switch(pipe->type & DT_DEV_PIXELPIPE_ANY)
+  {
+    case DT_DEV_PIXELPIPE_THUMBNAIL:
+      return dt_conf_get_int("plugins/darkroom/demosaic/budget_thumbnail");
+    case DT_DEV_PIXELPIPE_PREVIEW:
+      return dt_conf_get_int("plugins/darkroom/demosaic/budget_preview");
+    case DT_DEV_PIXELPIPE_EXPORT:
+      return dt_conf_get_int("plugins/darkroom/demosaic/budget_export");
+    default: // the darkroom main views follow the demosaic quality preference
+      return 0;
+  }
+}
+
+static int demosaic_benchmark_index(const dt_iop_demosaic_method_t method)
+{
+  for(int k = 0; k < BENCHMARK_METHODS; k++)
+    if(demosaic_benchmarks[k].method == method) return k;
+  return -1;
+}
+
+// run every benchmarked algorithm of the sensor type on a centered crop of the actual input,
+// best of two runs, and keep the throughput in MPix/s in memory and in darktablerc
+static void demosaic_benchmark(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const float *const in,
+                               const dt_iop_roi_t *const roi_in)
+{
+  dt_iop_demosaic_global_data_t *gd = (dt_iop_demosaic_global_data_t *)self->global_data;
+  const dt_iop_demosaic_data_t *data = (dt_iop_demosaic_data_t *)piece->data;
+  const uint32_t filters = piece->pipe->dsc.filters;
+  const uint8_t(*const xtrans)[6] = (const uint8_t(*const)[6])piece->pipe->dsc.xtrans;
+  const gboolean is_xtrans = (filters == 9u);
+
+  // keep offsets and size multiples of the CFA period so the pattern phase is preserved
+  const int width = MIN(BENCHMARK_SIZE, roi_in->width) / 6 * 6;
+  const int height = MIN(BENCHMARK_SIZE, roi_in->height) / 6 * 6;
+  if(width < 96 || height < 96) return;
+  const int ox = (roi_in->width - width) / 12 * 6;
+  const int oy = (roi_in->height - height) / 12 * 6;
+
+  float *const crop = dt_alloc_align_float((size_t)width * height);
+  float *const out = dt_alloc_align_float((size_t)4 * width * height);
+  if(!crop || !out)
+  {
+    dt_free_align(crop);
+    dt_free_align(out);
+    return;
+  }
+  for(int j = 0; j < height; j++)
+    memcpy(crop + (size_t)j * width, in + (size_t)(j + oy) * roi_in->width + ox, sizeof(float) * width);
+
+  dt_iop_roi_t roi = { roi_in->x + ox, roi_in->y + oy, width, height, 1.0f };
+  dt_iop_roi_t roo = { 0, 0, width, height, 1.0f };
+  const float mpix = (width * height) / 1.0e6f;
+
+  dt_print(DT_DEBUG_DEMOSAIC | DT_DEBUG_PERF, "[demosaic] benchmarking %s demosaicers on %dx%d\n",
+           is_xtrans ? "x-trans" : "bayer", width, height);
+
+  for(int k = 0; k < BENCHMARK_METHODS; k++)
+  {
+    const dt_iop_demosaic_method_t method = demosaic_benchmarks[k].method;
+    if(((method & DEMOSAIC_XTRANS) != 0) != is_xtrans) continue;
+
+    double best = 0.0;
+    for(int run = 0; run < 2; run++)
+    {
+      const double start = dt_get_wtime();
+      switch(method)
+      {
+        case DT_IOP_DEMOSAIC_PPG:
+          demosaic_ppg(out, crop, &roo, &roi, filters, 0.0f);
+          break;
+        case DT_IOP_DEMOSAIC_AMAZE:
+          amaze_demosaic_RT(piece, crop, out, &roi, &roo, filters);
+          break;
+        case DT_IOP_DEMOSAIC_RCD:
+          rcd_demosaic(piece, out, crop, &roo, &roi, filters);
+          break;
+        case DT_IOP_DEMOSAIC_LMMSE:
+          lmmse_gamma_init(gd);
+          lmmse_demosaic(piece, out, crop, &roo, &roi, filters, data->lmmse_refine, gd->lmmse_gamma_in,
+                         gd->lmmse_gamma_out);
+          break;
+        case DT_IOP_DEMOSAIC_MARKESTEIJN:
+        case DT_IOP_DEMOSAIC_MARKESTEIJN_3:
+          xtrans_markesteijn_interpolate(out, crop, &roo, &roi, xtrans,
+                                         1 + (method - DT_IOP_DEMOSAIC_MARKESTEIJN) * 2);
+          break;
+        case DT_IOP_DEMOSAIC_FDC:
+          xtrans_fdc_interpolate(self, out, crop, &roo, &roi, xtrans);
+          break;
+        default: // VNG4 and x-trans VNG
+          vng_interpolate(out, crop, &roo, &roi, filters, xtrans, FALSE);
+          break;
+      }
+      const double elapsed = dt_get_wtime() - start;
+      best = run ? MIN(best, elapsed) : elapsed;
+    }
+
+    gd->bench_mpps[k] = mpix / MAX(best, 1e-6);
+    gchar *key = g_strdup_printf("plugins/darkroom/demosaic/benchmark/%s", demosaic_benchmarks[k].key);
+    dt_conf_set_float(key, gd->bench_mpps[k]);
+    g_free(key);
+    dt_print(DT_DEBUG_DEMOSAIC | DT_DEBUG_PERF, "[demosaic] benchmark %-24s %8.2f MPix/s\n",
+             method2string(method), gd->bench_mpps[k]);
+  }
+
+  dt_free_align(crop);
+  dt_free_align(out);
+}
+
+// make sure throughput numbers exist for the sensor type of this pipe. measures once per machine,
+// or once per session when running with -d demosaic. never blocks: if another pipe is busy
+// measuring, this one goes on with whatever is known.
+static void demosaic_benchmark_check(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const float *const in,
+                                     const dt_iop_roi_t *const roi_in)
+{
+  dt_iop_demosaic_global_data_t *gd = (dt_iop_demosaic_global_data_t *)self->global_data;
+  const gboolean is_xtrans = (piece->pipe->dsc.filters == 9u);
+  if(gd->bench_done[is_xtrans] || dt_pthread_mutex_trylock(&gd->bench_lock)) return;
+
+  if(!gd->bench_done[is_xtrans])
+  {
+    gboolean known = TRUE;
+    for(int k = 0; k < BENCHMARK_METHODS; k++)
+      if(((demosaic_benchmarks[k].method & DEMOSAIC_XTRANS) != 0) == is_xtrans && gd->bench_mpps[k] <= 0.0f)
+        known = FALSE;
+
+    if(!known || (darktable.unmuted & DT_DEBUG_DEMOSAIC)) demosaic_benchmark(self, piece, in, roi_in);
+    gd->bench_done[is_xtrans] = TRUE;
+  }
+  dt_pthread_mutex_unlock(&gd->bench_lock);
+}
+
+// estimated time in ms to demosaic mpix megapixels, dual demosaicing adds a VNG pass. negative if unknown
+static float demosaic_estimate_ms(const dt_iop_demosaic_global_data_t *const gd,
+                                  const dt_iop_demosaic_method_t method, const float mpix)
+{
+  const int k = demosaic_benchmark_index(method & ~DEMOSAIC_DUAL);
+  if(k < 0 || gd->bench_mpps[k] <= 0.0f) return -1.0f;
+  float ms = 1000.0f * mpix / gd->bench_mpps[k];
+  if(method & DEMOSAIC_DUAL)
+  {
+    const int v = demosaic_benchmark_index((method & DEMOSAIC_XTRANS) ? DT_IOP_DEMOSAIC_VNG : DT_IOP_DEMOSAIC_VNG4);
+    if(gd->bench_mpps[v] <= 0.0f) return -1.0f;
+    ms += 1000.0f * mpix / gd->bench_mpps[v];
+  }
+  return ms;
+}
+
+// pick the best algorithm, not better than the requested one, which is expected to finish within
+// the budget. without measurements the requested method is kept, if nothing fits the fastest is taken.
+static dt_iop_demosaic_method_t demosaic_method_for_budget(const dt_iop_demosaic_global_data_t *const gd,
+                                                           const dt_iop_demosaic_method_t method,
+                                                           const float mpix, const int budget)
+{
+  const float requested = demosaic_estimate_ms(gd, method, mpix);
+  if(budget <= 0 || requested < 0.0f || requested <= budget) return method;
+
+  const dt_iop_demosaic_method_t base = method & ~DEMOSAIC_DUAL;
+  dt_iop_demosaic_method_t fastest = method;
+  float fastest_ms = requested;
+  for(int k = demosaic_benchmark_index(base); k < BENCHMARK_METHODS; k++)
+  {
+    const dt_iop_demosaic_method_t candidate = demosaic_benchmarks[k].method;
+    if((candidate & DEMOSAIC_XTRANS) != (base & DEMOSAIC_XTRANS)) break;
+    if(candidate != base && !demosaic_benchmarks[k].fallback) continue;
+
+    const float ms = demosaic_estimate_ms(gd, candidate, mpix);
+    if(ms < 0.0f) continue;
+    if(ms <= budget) return candidate;
+    if(ms < fastest_ms)
+    {
+      fastest = candidate;
+      fastest_ms = ms;
+    }
+  }
+  return fastest;
+}
+
 #include "dual_demosaic.c"
 
 void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const i, void *const o,
@@ -2978,6 +3208,26 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
 
   const float *const pixels = (float *)i;
 
+  // keep full scale demosaicing of this pipe type within its time budget
+  const int budget = demosaic_time_budget(piece->pipe);
+  if((qual_flags & DEMOSAIC_FULL_SCALE)
+     && (budget > 0 || (darktable.unmuted & DT_DEBUG_DEMOSAIC))
+     && !(img->flags & DT_IMAGE_4BAYER)
+     && (piece->pipe->dsc.filters != 9u || (qual_flags & DEMOSAIC_XTRANS_FULL))
+     && demosaic_benchmark_index(demosaicing_method & ~DEMOSAIC_DUAL) >= 0
+     && !((demosaicing_method & DEMOSAIC_DUAL) && showmask))
+  {
+    demosaic_benchmark_check(self, piece, pixels, roi_in);
+    const float mpix = (roi_in->width * roi_in->height) / 1.0e6f;
+    const dt_iop_demosaic_method_t method = demosaic_method_for_budget(gd, demosaicing_method, mpix, budget);
+    if(method != demosaicing_method)
+      dt_print(DT_DEBUG_DEMOSAIC | DT_DEBUG_PERF,
+               "[demosaic] %s expected to take %.0f ms for %.1f MPix, over the %d ms budget, using %s\n",
+               method2string(demosaicing_method), demosaic_estimate_ms(gd, demosaicing_method, mpix), mpix,
+               budget, method2string(method));
+    demosaicing_method = method;
+  }
+
   if(qual_flags & DEMOSAIC_FULL_SCALE)
   {
     // Full demosaic and then scaling if needed
@@ -3059,20 +3309,7 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
       }
       else if(demosaicing_method == DT_IOP_DEMOSAIC_LMMSE)
       {
-        if(gd->lmmse_gamma_in == NULL)
-        {
-          gd->lmmse_gamma_in = dt_alloc_align_float(65536);
-          gd->lmmse_gamma_out = dt_alloc_align_float(65536);
-#ifdef _OPENMP
-    #pragma omp for
-#endif
-          for(int j = 0; j < 65536; j++)
-          {
-            const double x = (double)j / 65535.0;
-            gd->lmmse_gamma_in[j]  = (x <= 0.001867) ? x * 17.0 : 1.044445 * exp(log(x) / 2.4) - 0.044445;
-            gd->lmmse_gamma_out[j] = (x <= 0.031746) ? x / 17.0 : exp(log((x + 0.044445) / 1.044445) * 2.4);
-          }
-        }
+        lmmse_gamma_init(gd);
         lmmse_demosaic(piece, tmp, in, &roo, &roi, piece->pipe->dsc.filters, data->lmmse_refine, gd->lmmse_gamma_in, gd->lmmse_gamma_out);
       }
       else if((demosaicing_method & ~DEMOSAIC_DUAL) != DT_IOP_DEMOSAIC_AMAZE)
@@ -5463,6 +5700,16 @@ void init_global(dt_iop_module_so_t *module)
   gd->kernel_write_blended_dual  = dt_opencl_create_kernel(rcd, "write_blended_dual");  
   gd->lmmse_gamma_in = NULL;
   gd->lmmse_gamma_out = NULL;
+
+  // throughput numbers measured in earlier sessions
+  for(int k = 0; k < BENCHMARK_METHODS; k++)
+  {
+    gchar *key = g_strdup_printf("plugins/darkroom/demosaic/benchmark/%s", demosaic_benchmarks[k].key);
+    gd->bench_mpps[k] = dt_conf_key_exists(key) ? dt_conf_get_float(key) : 0.0f;
+    g_free(key);
+  }
+  gd->bench_done[0] = gd->bench_done[1] = FALSE;
+  dt_pthread_mutex_init(&gd->bench_lock, NULL);
 }
 
 void cleanup_global(dt_iop_module_so_t *module)
@@ -5519,6 +5766,7 @@ void cleanup_global(dt_iop_module_so_t *module)
   dt_opencl_free_kernel(gd->kernel_write_blended_dual);  
   dt_free_align(gd->lmmse_gamma_in);
   dt_free_align(gd->lmmse_gamma_out);
+  dt_pthread_mutex_destroy(&gd->bench_lock);
   free(module->data);
   module->data = NULL;
 }
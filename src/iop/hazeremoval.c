@@ -502,7 +502,7 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
   gray_image trans_map_filtered = new_gray_image(width, height);
   // apply guided filter with no clipping
   guided_filter(img_in.data, trans_map.data, trans_map_filtered.data, width, height, ch, w2, eps, 1.f, -FLT_MAX,
-                FLT_MAX);
+                FLT_MAX, &piece->pipe->guided_filter_ws);
 
   // finally, calculate the haze-free image
   const float t_min
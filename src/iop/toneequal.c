@@ -809,7 +809,8 @@ static inline float pixel_correction(const float exposure,
 __DT_CLONE_TARGETS__
 static inline void compute_luminance_mask(const float *const restrict in, float *const restrict luminance,
                                           const size_t width, const size_t height, const size_t ch,
-                                          const dt_iop_toneequalizer_data_t *const d)
+                                          const dt_iop_toneequalizer_data_t *const d,
+                                          dt_guided_filter_workspace_t *ws)
 {
   switch(d->details)
   {
@@ -825,7 +826,7 @@ static inline void compute_luminance_mask(const float *const restrict in, float
       // Still no contrast boost
       luminance_mask(in, luminance, width, height, ch, d->method, d->exposure_boost, 0.0f, 1.0f);
       fast_surface_blur(luminance, width, height, d->radius, d->feathering, d->iterations,
-                    DT_GF_BLENDING_GEOMEAN, d->scale, d->quantization, exp2f(-14.0f), 4.0f);
+                    DT_GF_BLENDING_GEOMEAN, d->scale, d->quantization, exp2f(-14.0f), 4.0f, ws);
       break;
     }
 
@@ -841,7 +842,7 @@ static inline void compute_luminance_mask(const float *const restrict in, float
       luminance_mask(in, luminance, width, height, ch, d->method, d->exposure_boost,
                       CONTRAST_FULCRUM, d->contrast_boost);
       fast_surface_blur(luminance, width, height, d->radius, d->feathering, d->iterations,
-                    DT_GF_BLENDING_LINEAR, d->scale, d->quantization, exp2f(-14.0f), 4.0f);
+                    DT_GF_BLENDING_LINEAR, d->scale, d->quantization, exp2f(-14.0f), 4.0f, ws);
       break;
     }
 
@@ -1052,7 +1053,7 @@ void toneeq_process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
       if(hash != saved_hash || !luminance_valid)
       {
         /* compute only if upstream pipe state has changed */
-        compute_luminance_mask(in, luminance, width, height, ch, d);
+        compute_luminance_mask(in, luminance, width, height, ch, d, &piece->pipe->guided_filter_ws);
         hash_set_get(&hash, &g->ui_preview_hash, &self->gui_lock);
       }
     }
@@ -1071,20 +1072,20 @@ void toneeq_process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
         dt_iop_gui_enter_critical_section(self);
         g->thumb_preview_hash = hash;
         g->histogram_valid = FALSE;
-        compute_luminance_mask(in, luminance, width, height, ch, d);
+        compute_luminance_mask(in, luminance, width, height, ch, d, &piece->pipe->guided_filter_ws);
         g->luminance_valid = TRUE;
         dt_iop_gui_leave_critical_section(self);
       }
     }
     else // make it dummy-proof
     {
-      compute_luminance_mask(in, luminance, width, height, ch, d);
+      compute_luminance_mask(in, luminance, width, height, ch, d, &piece->pipe->guided_filter_ws);
     }
   }
   else
   {
     // no caching path : compute no matter what
-    compute_luminance_mask(in, luminance, width, height, ch, d);
+    compute_luminance_mask(in, luminance, width, height, ch, d, &piece->pipe->guided_filter_ws);
   }
 
   // Display output
@@ -435,14 +435,8 @@ static void _view_map_geotag_changed(gpointer instance, GList *imgs, const int n
   }
   else
   {
-    for(GList* img = imgs; img; img = g_list_next(img))
-    {
-      // find new locations for that image
-      GList *tags = dt_map_location_find_locations(GPOINTER_TO_INT(img->data));
-      // update locations for that image
-      dt_map_location_update_locations(GPOINTER_TO_INT(img->data), tags);
-      g_list_free(tags);
-    }
+    // find and update the locations of these images
+    dt_map_location_update_locations_list(imgs);
     // update count on the treeview
     GList *locs = dt_map_location_get_locations_by_path("", TRUE);
     GtkTreeIter iter;
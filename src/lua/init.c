@@ -251,6 +251,7 @@ void dt_lua_finalize_early()
 
 void dt_lua_finalize()
 {
+  dt_lua_lock_print_stats("session");
   dt_lua_lock();
   luaA_close(darktable.lua_state.state);
   lua_close(darktable.lua_state.state);
@@ -141,12 +141,28 @@ void dt_lua_lock_internal(const char *function, const char *file, int line, gboo
 #ifdef _DEBUG
   dt_print(DT_DEBUG_LUA,"LUA DEBUG : thread %p waiting from %s:%d\n", g_thread_self(), function, line);
 #endif
+  const gboolean stats = (darktable.unmuted & DT_DEBUG_LUA) != 0;
+  const double start = stats ? dt_get_wtime() : 0.0;
   dt_pthread_mutex_lock(&darktable.lua_state.mutex);
   while(darktable.lua_state.exec_lock == true) {
     dt_pthread_cond_wait(&darktable.lua_state.cond,&darktable.lua_state.mutex);
   }
   darktable.lua_state.exec_lock = true;
+  double wait = 0.0;
+  if(stats)
+  {
+    wait = dt_get_wtime() - start;
+    darktable.lua_state.lock_count++;
+    darktable.lua_state.lock_wait += wait;
+    if(wait > darktable.lua_state.lock_wait_max)
+    {
+      darktable.lua_state.lock_wait_max = wait;
+      darktable.lua_state.lock_wait_max_function = function;
+    }
+  }
   dt_pthread_mutex_unlock(&darktable.lua_state.mutex);
+  if(wait > 0.1)
+    dt_print(DT_DEBUG_LUA, "LUA lock : %s:%d waited %.3f sec\n", function, line, wait);
 #ifdef _DEBUG
   dt_print(DT_DEBUG_LUA,"LUA DEBUG : thread %p taken from %s:%d\n",  g_thread_self(), function, line);
 #endif
@@ -162,6 +178,20 @@ void dt_lua_unlock_internal(const char *function, int line)
   dt_pthread_mutex_unlock(&darktable.lua_state.mutex);
 }
 
+void dt_lua_lock_print_stats(const char *context)
+{
+  if(!(darktable.unmuted & DT_DEBUG_LUA)) return;
+  dt_pthread_mutex_lock(&darktable.lua_state.mutex);
+  const uint64_t count = darktable.lua_state.lock_count;
+  const double wait = darktable.lua_state.lock_wait;
+  const double wait_max = darktable.lua_state.lock_wait_max;
+  const char *function = darktable.lua_state.lock_wait_max_function;
+  dt_pthread_mutex_unlock(&darktable.lua_state.mutex);
+  dt_print(DT_DEBUG_LUA,
+           "LUA lock (%s) : taken %" PRIu64 " times, waited %.3f sec in total, %.3f sec at most (%s)\n",
+           context, count, wait, wait_max, function ? function : "-");
+}
+
 static gboolean async_redraw(gpointer data)
 {
   dt_control_queue_redraw();
@@ -26,6 +26,7 @@
  */
 #include "common/dtpthread.h"
 #include <glib.h>
+#include <stdint.h>
 
 #ifdef USE_LUA
 #include <lautoc.h>
@@ -63,6 +64,9 @@ void dt_lua_debug_table_internal(lua_State *L, int t, const char *function, int
 #define dt_lua_lock_silent() dt_lua_lock_internal(__FUNCTION__, __FILE__, __LINE__, TRUE)
 #define dt_lua_unlock() dt_lua_unlock_internal( __FUNCTION__, __LINE__)
 
+/** print the statistics on the lua lock gathered with -d lua */
+void dt_lua_lock_print_stats(const char *context);
+
 typedef struct
 {
   lua_State *state;                  // main lua context
@@ -71,6 +75,11 @@ typedef struct
   pthread_cond_t cond;               // condition variable to wait for the lua lock
   bool exec_lock;                    // true if some lua code is running. this is logically a mutex
 
+  uint64_t lock_count;               // number of times the lock was taken, only counted with -d lua
+  double lock_wait;                  // total time spent waiting for the lock
+  double lock_wait_max;              // longest wait for the lock
+  const char *lock_wait_max_function;// and where it happened
+
   bool ending;                       // true if we are in the process of terminating DT
 
   GMainLoop *loop;                   // loop running the lua context
@@ -90,9 +90,12 @@ static int store_wrapper(struct dt_imageio_module_storage_t *self, struct dt_ima
   char dirname[PATH_MAX] = { 0 };
   dt_image_full_path(imgid, dirname, sizeof(dirname), &from_cache);
   dt_image_path_append_version(imgid, dirname, sizeof(dirname));
-  gchar *filename = g_path_get_basename(dirname);
-  gchar *end = g_strrstr(filename, ".") + 1;
-  g_strlcpy(end, format->extension(fdata), sizeof(dirname) - (end - dirname));
+  gchar *basename = g_path_get_basename(dirname);
+  gchar *end = g_strrstr(basename, ".");
+  if(end) *end = '\0';
+  // images from different folders can share their name, the concurrent lanes must not write the same file
+  gchar *filename = g_strdup_printf("%s_%d.%s", basename, imgid, format->extension(fdata));
+  g_free(basename);
 
   gchar *complete_name = g_build_filename(tmpdir, filename, (char *)NULL);
 
@@ -235,6 +238,7 @@ static void finalize_store_wrapper(struct dt_imageio_module_storage_t *self, dt_
   dt_lua_treated_pcall(L, 3, 0);
   lua_pop(L, 2);
   dt_lua_unlock();
+  dt_lua_lock_print_stats(self->plugin_name);
 }
 static size_t params_size_wrapper(struct dt_imageio_module_storage_t *self)
 {
@@ -313,6 +317,13 @@ static char *ask_user_confirmation_wrapper(struct dt_imageio_module_storage_t *s
   return NULL;
 }
 
+static gboolean concurrent_store_wrapper(struct dt_imageio_module_storage_t *self)
+{
+  // several images get processed at once, but all scripts share the one lua state: the calls to the
+  // store function stay serialized on the lua lock, they may just come in any order
+  return TRUE;
+}
+
 static int version_wrapper()
 {
   return 0;
@@ -371,7 +382,7 @@ static dt_imageio_module_storage_t ref_storage = {
 
 static int register_storage(lua_State *L)
 {
-  lua_settop(L, 7);
+  lua_settop(L, 8);
   lua_getfield(L, LUA_REGISTRYINDEX, "dt_lua_storages");
   lua_newtable(L);
 
@@ -442,6 +453,10 @@ static int register_storage(lua_State *L)
     data->widget = widget;
   }
 
+  // unordered_store: the script doesn't rely on the order of the store calls, so the images can be
+  // processed in parallel. store itself still runs one call at a time.
+  if(lua_toboolean(L, 8)) storage->concurrent_store = concurrent_store_wrapper;
+
 
   lua_setfield(L, -2, plugin_name);
 
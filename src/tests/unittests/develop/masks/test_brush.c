@@ -0,0 +1,125 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2021 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for develop/masks/brush.c
+ *
+ * Please see ../../README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../../util/assert.h"
+#include "../../util/tracing.h"
+
+#include "develop/masks/brush.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+// size of the roi
+#define ROI_WIDTH 640
+#define ROI_HEIGHT 480
+
+// number of falloff segments of the synthetic stroke
+#define SEGMENTS 4000
+
+/*
+ * HELPER FUNCTIONS
+ */
+
+// a stroke winding around the roi, partly outside of it, with its falloff pointing outwards. the segments
+// of neighbouring turns overlap, which is where a racy rendering would differ.
+static void stroke_new(float **points, float **border, float **payload)
+{
+  *points = malloc(sizeof(float) * 2 * SEGMENTS);
+  *border = malloc(sizeof(float) * 2 * SEGMENTS);
+  *payload = malloc(sizeof(float) * 2 * SEGMENTS);
+  for(int i = 0; i < SEGMENTS; i++)
+  {
+    const float t = 12.0f * M_PI * i / SEGMENTS;
+    const float r = 40.0f + 300.0f * i / SEGMENTS;
+    const float falloff = 20.0f + 15.0f * sinf(5.0f * t);
+    const float cx = ROI_WIDTH / 2 + r * cosf(t);
+    const float cy = ROI_HEIGHT / 2 + 0.8f * r * sinf(t);
+    (*points)[2 * i] = cx;
+    (*points)[2 * i + 1] = cy;
+    (*border)[2 * i] = cx + falloff * cosf(t);
+    (*border)[2 * i + 1] = cy + falloff * sinf(t);
+    (*payload)[2 * i] = 0.5f + 0.4f * cosf(3.0f * t);  // hardness
+    (*payload)[2 * i + 1] = 0.6f + 0.3f * sinf(7.0f * t); // density
+  }
+}
+
+static float *render(const float *points, const float *border, const float *payload, const int nbands)
+{
+  float *buffer = calloc((size_t)ROI_WIDTH * ROI_HEIGHT, sizeof(float));
+  _brush_falloff_bands(buffer, points, border, payload, 0, SEGMENTS, ROI_WIDTH, ROI_HEIGHT, nbands);
+  return buffer;
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+static void test_falloff_bands_match_serial(void **state)
+{
+  float *points, *border, *payload;
+  stroke_new(&points, &border, &payload);
+
+  float *serial = render(points, border, payload, 1);
+
+  // the default split, and finer ones which don't depend on the number of cores
+  const int nbands[] = { dt_masks_roi_bands(ROI_HEIGHT), 7, ROI_HEIGHT / 16, ROI_HEIGHT };
+  for(int k = 0; k < (int)(sizeof(nbands) / sizeof(nbands[0])); k++)
+  {
+    float *banded = render(points, border, payload, nbands[k]);
+    TR_DEBUG("%d bands", nbands[k]);
+    assert_memory_equal(banded, serial, sizeof(float) * ROI_WIDTH * ROI_HEIGHT);
+    free(banded);
+  }
+
+  free(serial);
+  free(payload);
+  free(border);
+  free(points);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_falloff_bands_match_serial)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,144 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2021 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for develop/masks/path.c
+ *
+ * Please see ../../README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../../util/assert.h"
+#include "../../util/tracing.h"
+
+#include "develop/masks/path.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+// size of the roi
+#define ROI_WIDTH 640
+#define ROI_HEIGHT 480
+
+// number of points of the synthetic path
+#define POINTS 3000
+
+/*
+ * HELPER FUNCTIONS
+ */
+
+// a star shaped path with many spikes, reaching out of the roi at the top and on the right. its edges
+// cross most bands several times.
+static float *path_new(void)
+{
+  float *p = malloc(sizeof(float) * 2 * POINTS);
+  for(int i = 0; i < POINTS; i++)
+  {
+    const float t = 2.0f * M_PI * i / POINTS;
+    const float r = 150.0f + 120.0f * sinf(37.0f * t) + 40.0f * cosf(5.0f * t);
+    p[2 * i] = ROI_WIDTH / 2 + 60.0f + r * cosf(t);
+    p[2 * i + 1] = ROI_HEIGHT / 2 - 50.0f + r * sinf(t);
+  }
+  return p;
+}
+
+// falloff segments from every other point of the path, pointing outwards
+static int *falloff_new(const float *path, int *dindex)
+{
+  int *d = malloc(sizeof(int) * 4 * POINTS);
+  int n = 0;
+  for(int i = 0; i < POINTS; i += 2)
+  {
+    const float t = 2.0f * M_PI * i / POINTS;
+    const float falloff = 25.0f + 10.0f * cosf(11.0f * t);
+    d[n] = floorf(path[2 * i] + 0.5f);
+    d[n + 1] = ceilf(path[2 * i + 1]);
+    d[n + 2] = path[2 * i] + falloff * cosf(t);
+    d[n + 3] = path[2 * i + 1] + falloff * sinf(t);
+    n += 4;
+  }
+  *dindex = n;
+  return d;
+}
+
+static float *render(const float *path, const int *dpoints, const int dindex, const int nbands)
+{
+  float *buffer = calloc((size_t)ROI_WIDTH * ROI_HEIGHT, sizeof(float));
+  _path_fill_bands(buffer, path, 0, POINTS, ROI_WIDTH, ROI_HEIGHT, 0, ROI_WIDTH - 1, 0, ROI_HEIGHT - 1,
+                   nbands);
+  _path_falloff_bands(buffer, dpoints, dindex, ROI_WIDTH, ROI_HEIGHT, nbands);
+  return buffer;
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+static void test_fill_and_falloff_bands_match_serial(void **state)
+{
+  float *path = path_new();
+  int dindex = 0;
+  int *dpoints = falloff_new(path, &dindex);
+
+  float *serial = render(path, dpoints, dindex, 1);
+
+  // the shape must actually be drawn
+  int inside = 0;
+  for(int k = 0; k < ROI_WIDTH * ROI_HEIGHT; k++) inside += serial[k] == 1.0f;
+  TR_DEBUG("%d pixels inside", inside);
+  assert_true(inside > ROI_WIDTH * ROI_HEIGHT / 10);
+
+  // the default split, and finer ones which don't depend on the number of cores
+  const int nbands[] = { dt_masks_roi_bands(ROI_HEIGHT), 7, ROI_HEIGHT / 16, ROI_HEIGHT };
+  for(int k = 0; k < (int)(sizeof(nbands) / sizeof(nbands[0])); k++)
+  {
+    float *banded = render(path, dpoints, dindex, nbands[k]);
+    TR_DEBUG("%d bands", nbands[k]);
+    assert_memory_equal(banded, serial, sizeof(float) * ROI_WIDTH * ROI_HEIGHT);
+    free(banded);
+  }
+
+  free(serial);
+  free(dpoints);
+  free(path);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_fill_and_falloff_bands_match_serial)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,178 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2021 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for develop/imageop_math.c
+ *
+ * Please see ../README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "../util/tracing.h"
+
+#include "develop/imageop_math.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+// RGGB bayer pattern
+#define FILTERS_RGGB 0x94949494u
+
+// size of the synthetic sensor
+#define SENSOR_WIDTH 2400
+#define SENSOR_HEIGHT 1600
+
+// allowed difference between the binned and the direct path, in a [0, 1] range:
+#define MEAN_DIFF 0.005f
+#define MAX_DIFF 0.05f
+
+/*
+ * HELPER FUNCTIONS
+ */
+
+// smooth scene with a bit of structure in green
+static float scene(const int x, const int y, const int c)
+{
+  const float u = (float)x / SENSOR_WIDTH;
+  const float v = (float)y / SENSOR_HEIGHT;
+  if(c == 0) return 0.2f + 0.6f * u;
+  if(c == 2) return 0.5f + 0.3f * u * v;
+  return 0.3f + 0.4f * v + 0.1f * sinf(12.0f * u);
+}
+
+static float *mosaic_new(void)
+{
+  float *m = malloc(sizeof(float) * SENSOR_WIDTH * SENSOR_HEIGHT);
+  for(int y = 0; y < SENSOR_HEIGHT; y++)
+    for(int x = 0; x < SENSOR_WIDTH; x++)
+    {
+      const int c = FC(y, x, FILTERS_RGGB);
+      m[x + SENSOR_WIDTH * y] = scene(x, y, c == 3 ? 1 : c);
+    }
+  return m;
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+static void test_mosaic_keeps_cfa(void **state)
+{
+  // a binned flat field must still hold one constant per cfa color
+  float *m = malloc(sizeof(float) * SENSOR_WIDTH * SENSOR_HEIGHT);
+  const float flat[4] = { 0.1f, 0.5f, 0.9f, 0.5f };
+  for(int y = 0; y < SENSOR_HEIGHT; y++)
+    for(int x = 0; x < SENSOR_WIDTH; x++)
+      m[x + SENSOR_WIDTH * y] = flat[FC(y, x, FILTERS_RGGB)];
+
+  const dt_iop_roi_t roi_in = { .x = 0, .y = 0, .width = SENSOR_WIDTH, .height = SENSOR_HEIGHT, .scale = 1.0f };
+  const float scale = 0.13f;
+  const dt_iop_roi_t roi_out = { .x = 0, .y = 0, .width = scale * SENSOR_WIDTH,
+                                 .height = scale * SENSOR_HEIGHT, .scale = scale };
+  float *b = malloc(sizeof(float) * roi_out.width * roi_out.height);
+  dt_iop_clip_and_zoom_mosaic(b, m, &roi_out, &roi_in, roi_out.width, roi_in.width, TYPE_FLOAT,
+                              FILTERS_RGGB, NULL);
+
+  for(int y = 0; y < roi_out.height; y++)
+    for(int x = 0; x < roi_out.width; x++)
+      assert_float_equal(b[x + roi_out.width * y], flat[FC(y, x, FILTERS_RGGB)], 1e-5f);
+
+  free(b);
+  free(m);
+}
+
+static void test_binned_demosaic_matches_direct(void **state)
+{
+  float *m = mosaic_new();
+  const dt_iop_roi_t roi_in = { .x = 0, .y = 0, .width = SENSOR_WIDTH, .height = SENSOR_HEIGHT, .scale = 1.0f };
+
+  const float scales[] = { 0.2f, 0.1f, 0.05f };
+  for(int k = 0; k < (int)(sizeof(scales) / sizeof(scales[0])); k++)
+  {
+    const float scale = scales[k];
+
+    // current path: the half size demosaic straight from the full mosaic
+    const dt_iop_roi_t roi_out = { .x = 0, .y = 0, .width = scale * SENSOR_WIDTH,
+                                   .height = scale * SENSOR_HEIGHT, .scale = scale };
+    float *direct = malloc(sizeof(float) * 4 * roi_out.width * roi_out.height);
+    dt_iop_clip_and_zoom_demosaic_half_size_f(direct, m, &roi_out, &roi_in, roi_out.width, roi_in.width,
+                                              FILTERS_RGGB);
+
+    // binned path: mosaic binned to twice the output size first, as done for small exports
+    const dt_iop_roi_t roi_bin = { .x = 0, .y = 0, .width = 2.0f * scale * SENSOR_WIDTH,
+                                   .height = 2.0f * scale * SENSOR_HEIGHT, .scale = 2.0f * scale };
+    float *binned = malloc(sizeof(float) * roi_bin.width * roi_bin.height);
+    dt_iop_clip_and_zoom_mosaic(binned, m, &roi_bin, &roi_in, roi_bin.width, roi_in.width, TYPE_FLOAT,
+                                FILTERS_RGGB, NULL);
+
+    const dt_iop_roi_t roi_bin_in = { .x = 0, .y = 0, .width = roi_bin.width, .height = roi_bin.height,
+                                      .scale = 1.0f };
+    const dt_iop_roi_t roi_bin_out = { .x = 0, .y = 0, .width = roi_out.width, .height = roi_out.height,
+                                       .scale = (float)roi_out.width / roi_bin.width };
+    float *out = malloc(sizeof(float) * 4 * roi_out.width * roi_out.height);
+    dt_iop_clip_and_zoom_demosaic_half_size_f(out, binned, &roi_bin_out, &roi_bin_in, roi_out.width,
+                                              roi_bin.width, FILTERS_RGGB);
+
+    double sum = 0.0;
+    float max = 0.0f;
+    for(int i = 0; i < roi_out.width * roi_out.height; i++)
+      for(int c = 0; c < 3; c++)
+      {
+        const float d = fabsf(direct[4 * i + c] - out[4 * i + c]);
+        sum += d;
+        max = fmaxf(max, d);
+      }
+    const float mean = sum / (3.0 * roi_out.width * roi_out.height);
+
+    TR_DEBUG("scale %.2f: mean difference %e, max difference %e", scale, mean, max);
+    assert_true(mean < MEAN_DIFF);
+    assert_true(max < MAX_DIFF);
+
+    free(out);
+    free(binned);
+    free(direct);
+  }
+
+  free(m);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_mosaic_keeps_cfa),
+    cmocka_unit_test(test_binned_demosaic_matches_direct)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -27,6 +27,7 @@
 #include "common/image_cache.h"
 #include "common/imageio.h"
 #include "common/imageio_module.h"
+#include "common/mipmap_cache.h"
 #include "common/selection.h"
 #include "common/styles.h"
 #include "common/tags.h"
@@ -842,6 +843,23 @@ int try_enter(dt_view_t *self)
   return 0;
 }
 
+// keep the decoded raw of the edited image and its filmstrip neighbours around
+static void _pin_full_buffers(const int32_t imgid)
+{
+  int32_t imgids[DT_MIPMAP_FULL_PINNED_MAX] = { imgid };
+  int count = 1;
+  // the neighbours in the film strip, from the in-memory index of the collection
+  const int rowid = dt_collection_memory_get_rowid(imgid);
+  if(rowid > 0)
+  {
+    const int prev = dt_collection_memory_get_imgid(rowid - 1);
+    const int next = dt_collection_memory_get_imgid(rowid + 1);
+    if(prev > 0 && count < DT_MIPMAP_FULL_PINNED_MAX) imgids[count++] = prev;
+    if(next > 0 && count < DT_MIPMAP_FULL_PINNED_MAX) imgids[count++] = next;
+  }
+  dt_mipmap_cache_pin_full(darktable.mipmap_cache, imgids, count);
+}
+
 static void dt_dev_change_image(dt_develop_t *dev, const int32_t imgid)
 {
   // stop crazy users from sleeping on key-repeat spacebar:
@@ -934,6 +952,8 @@ static void dt_dev_change_image(dt_develop_t *dev, const int32_t imgid)
     return;
   }
 
+  _pin_full_buffers(imgid);
+
   // get current plugin in focus before defocus
   gchar *active_plugin = NULL;
   if(darktable.develop->gui_module)
@@ -2998,6 +3018,7 @@ void enter(dt_view_t *self)
   // take a copy of the image struct for convenience.
 
   dt_dev_load_image(darktable.develop, dev->image_storage.id);
+  _pin_full_buffers(dev->image_storage.id);
 
 
   /*
@@ -3111,6 +3132,9 @@ void leave(dt_view_t *self)
 
   _unregister_modules_drag_n_drop(self);
 
+  // the decoded raws don't need to outlive the darkroom
+  dt_mipmap_cache_pin_full(darktable.mipmap_cache, NULL, 0);
+
   /* disconnect from filmstrip image activate */
   DT_DEBUG_CONTROL_SIGNAL_DISCONNECT(darktable.signals, G_CALLBACK(_view_darkroom_filmstrip_activate_callback),
                                (gpointer)self);